@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Runs body repeatedly for roughly minSeconds and returns the median time of a
+// single call in nanoseconds.
+template <typename TBody>
+double MeasureNanoseconds(
+    TBody body,
+    double minSeconds = 0.5)
+{
+    // warm up caches and branch predictors
+    for (int i = 0; i < 3; ++i)
+    {
+        body();
+    }
+
+    std::vector<double> samples;
+    const auto start = std::chrono::steady_clock::now();
+    while (samples.size() < 10 ||
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < minSeconds)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        body();
+        const auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+// keeps the optimizer from discarding benchmark results
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    volatile const void* sink = &value;
+    (void)sink;
+#else
+    asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
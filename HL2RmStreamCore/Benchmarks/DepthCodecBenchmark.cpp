@@ -0,0 +1,148 @@
+// Measures compression ratio and encode/decode throughput of the RVL depth codec
+// against the raw validated wire format.
+//
+// usage: DepthCodecBenchmark [--frames FILE] [--width W] [--height H]
+//
+// Without --frames it runs on the synthetic AHAT frames. FILE holds recorded
+// depth frames back to back, W x H little-endian uint16 values each (512 x 512
+// by default, the AHAT resolution).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BenchmarkUtils.h"
+#include "DepthCodec.h"
+#include "DepthKernels.h"
+#include "ResearchModeFrameEncoder.h"
+#include "SyntheticResearchModeSensor.h"
+
+namespace
+{
+    bool LoadFrames(
+        const std::string& path,
+        size_t pixelsPerFrame,
+        std::vector<std::vector<uint16_t>>& frames)
+    {
+        FILE* pFile = fopen(path.c_str(), "rb");
+        if (!pFile)
+        {
+            return false;
+        }
+        std::vector<uint8_t> bytes(pixelsPerFrame * sizeof(uint16_t));
+        while (fread(bytes.data(), 1, bytes.size(), pFile) == bytes.size())
+        {
+            std::vector<uint16_t> frame(pixelsPerFrame);
+            for (size_t i = 0; i < pixelsPerFrame; ++i)
+            {
+                frame[i] = static_cast<uint16_t>(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+            }
+            frames.push_back(std::move(frame));
+        }
+        fclose(pFile);
+        return !frames.empty();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string framesPath;
+    size_t width = 512;
+    size_t height = 512;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue) framesPath = argv[++i];
+        else if (arg == "--width" && hasValue) width = static_cast<size_t>(atoi(argv[++i]));
+        else if (arg == "--height" && hasValue) height = static_cast<size_t>(atoi(argv[++i]));
+        else
+        {
+            fprintf(stderr, "unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<std::vector<uint16_t>> frames;
+    if (!framesPath.empty())
+    {
+        if (!LoadFrames(framesPath, width * height, frames))
+        {
+            fprintf(stderr, "could not read %zux%zu frames from %s\n", width, height, framesPath.c_str());
+            return 1;
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            frames.push_back(SyntheticResearchModeSensor::GeneratePattern(DEPTH_AHAT, i)->Depth);
+        }
+    }
+
+    const size_t count = frames[0].size();
+    const USHORT maxValue = ResearchModeFrameEncoder::kAhatMaxValue;
+    const double rawBytes = static_cast<double>(count * sizeof(uint16_t));
+
+    std::vector<uint8_t> raw(count * sizeof(uint16_t));
+    std::vector<uint8_t> encoded(RvlMaxEncodedSize(count));
+    std::vector<uint16_t> decoded(count);
+
+    // round trip check and compression ratio over all frames
+    size_t encodedTotal = 0;
+    for (const auto& frame : frames)
+    {
+        const size_t size = RvlEncodeDepth(frame.data(), count, maxValue, encoded.data());
+        if (!RvlDecodeDepth(encoded.data(), size, decoded.data(), count))
+        {
+            printf("decoding failed\n");
+            return 1;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint16_t expected = (frame[i] >= maxValue) ? 0 : frame[i];
+            if (decoded[i] != expected)
+            {
+                printf("pixel %zu decodes to %u instead of %u\n", i, decoded[i], expected);
+                return 1;
+            }
+        }
+        encodedTotal += size;
+    }
+    const double encodedBytes = static_cast<double>(encodedTotal) / frames.size();
+
+    printf("%s depth, %zu frames of %zu pixels\n",
+        framesPath.empty() ? "synthetic AHAT" : framesPath.c_str(), frames.size(), count);
+    printf("raw %.0f bytes/frame, RVL %.0f bytes/frame, ratio %.2f:1\n",
+        rawBytes, encodedBytes, rawBytes / encodedBytes);
+    printf("%-22s %12s %12s\n", "variant", "us/frame", "MB/s");
+
+    // throughput is reported in raw depth bytes for all variants
+    size_t frameIndex = 0;
+    const double validate = MeasureNanoseconds([&]()
+    {
+        const auto& frame = frames[frameIndex++ % frames.size()];
+        ValidateDepthBigEndian(frame.data(), count, maxValue, raw.data());
+        DoNotOptimize(raw);
+    });
+    printf("%-22s %12.1f %12.1f\n", "raw (validate only)", validate * 1e-3, rawBytes / validate * 1e3);
+
+    const double encode = MeasureNanoseconds([&]()
+    {
+        const auto& frame = frames[frameIndex++ % frames.size()];
+        const size_t size = RvlEncodeDepth(frame.data(), count, maxValue, encoded.data());
+        DoNotOptimize(size);
+    });
+    printf("%-22s %12.1f %12.1f\n", "RVL encode", encode * 1e-3, rawBytes / encode * 1e3);
+
+    const size_t size = RvlEncodeDepth(frames[0].data(), count, maxValue, encoded.data());
+    const double decode = MeasureNanoseconds([&]()
+    {
+        RvlDecodeDepth(encoded.data(), size, decoded.data(), count);
+        DoNotOptimize(decoded);
+    });
+    printf("%-22s %12.1f %12.1f\n", "RVL decode", decode * 1e-3, rawBytes / decode * 1e3);
+    return 0;
+}
@@ -0,0 +1,343 @@
+// Compares the per-pixel depth validation loop the streamer used to run against
+// the single-pass validation/byte-order kernels on AHAT shaped frames, and times
+// the masking of the AB image alongside the depth and the sigma based validation
+// of Long Throw frames. The point cloud kernels are compared against mapping every
+// pixel through the camera's unit plane per frame.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "BenchmarkUtils.h"
+#include "DepthKernels.h"
+#include "ResearchModeFrameEncoder.h"
+#include "SyntheticResearchModeSensor.h"
+
+namespace
+{
+    // the loop ResearchModeFrameStreamer::Send used before the kernels existed
+    std::vector<BYTE> ValidateDepthPushBack(
+        const UINT16* pDepth,
+        size_t outBufferCount,
+        USHORT maxValue)
+    {
+        std::vector<BYTE> depthByteData;
+        depthByteData.reserve(outBufferCount * sizeof(UINT16));
+        for (size_t i = 0; i < outBufferCount; ++i)
+        {
+            const bool invalid = (pDepth[i] >= maxValue);
+            UINT16 d;
+            if (invalid)
+            {
+                d = 0;
+            }
+            else
+            {
+                d = pDepth[i];
+            }
+            depthByteData.push_back((BYTE)(d >> 8));
+            depthByteData.push_back((BYTE)d);
+        }
+        return depthByteData;
+    }
+
+    int BenchmarkAb()
+    {
+        auto pattern = SyntheticResearchModeSensor::GeneratePattern(DEPTH_AHAT, 0);
+        const UINT16* pDepth = pattern->Depth.data();
+        const UINT16* pAb = pattern->Ab.data();
+        const size_t count = pattern->Depth.size();
+        const USHORT maxValue = ResearchModeFrameEncoder::kAhatMaxValue;
+
+        std::vector<uint8_t> referenceDepth(count * sizeof(UINT16));
+        std::vector<uint8_t> referenceAb(count * sizeof(UINT16));
+        ValidateDepthAndAbBigEndian(pDepth, pAb, count, maxValue,
+            referenceDepth.data(), referenceAb.data(), SimdLevel::Scalar);
+
+        printf("\nAHAT depth and AB validation, %zu pixels per frame\n", count);
+        printf("%-22s %12s %12s\n", "variant", "us/frame", "Mpixel/s");
+
+        std::vector<uint8_t> depth(count * sizeof(UINT16));
+        std::vector<uint8_t> ab(count * sizeof(UINT16));
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Neon })
+        {
+            if (!IsSimdLevelSupported(level))
+            {
+                continue;
+            }
+
+            ValidateDepthAndAbBigEndian(pDepth, pAb, count, maxValue, depth.data(), ab.data(), level);
+            if (depth != referenceDepth || ab != referenceAb)
+            {
+                printf("%s kernel output differs from the scalar kernel\n", SimdLevelName(level));
+                return 1;
+            }
+            // AB only, as used next to RVL
+            std::fill(ab.begin(), ab.end(), 0xFF);
+            ValidateDepthAndAbBigEndian(pDepth, pAb, count, maxValue, nullptr, ab.data(), level);
+            if (ab != referenceAb)
+            {
+                printf("%s AB only kernel output differs from the scalar kernel\n", SimdLevelName(level));
+                return 1;
+            }
+
+            const double elapsed = MeasureNanoseconds([&]()
+            {
+                ValidateDepthAndAbBigEndian(pDepth, pAb, count, maxValue, depth.data(), ab.data(), level);
+                DoNotOptimize(depth);
+                DoNotOptimize(ab);
+            });
+            char name[32];
+            snprintf(name, sizeof(name), "kernel (%s)", SimdLevelName(level));
+            printf("%-22s %12.1f %12.1f\n", name, elapsed * 1e-3, count / elapsed * 1e3);
+        }
+        return 0;
+    }
+
+    // the point cloud loop without a ray table: a unit plane query per pixel
+    size_t DepthToPointsPerPixel(
+        IResearchModeCameraSensor* pCamera,
+        const UINT16* pDepth,
+        UINT32 width,
+        UINT32 height,
+        USHORT maxValue,
+        std::vector<int16_t>& points)
+    {
+        points.clear();
+        for (UINT32 y = 0; y < height; ++y)
+        {
+            for (UINT32 x = 0; x < width; ++x)
+            {
+                const UINT16 d = pDepth[static_cast<size_t>(y) * width + x];
+                float uv[2] = { x + 0.5f, y + 0.5f };
+                float xy[2];
+                if (d == 0 || d >= maxValue || FAILED(pCamera->MapImagePointToCameraUnitPlane(uv, xy)))
+                {
+                    continue;
+                }
+                const float scale = d / std::sqrt(xy[0] * xy[0] + xy[1] * xy[1] + 1.0f);
+                points.push_back(static_cast<int16_t>(std::lrint(xy[0] * scale)));
+                points.push_back(static_cast<int16_t>(std::lrint(xy[1] * scale)));
+                points.push_back(static_cast<int16_t>(std::lrint(scale)));
+            }
+        }
+        return points.size() / 3;
+    }
+
+    int BenchmarkPoints(ResearchModeSensorType sensorType)
+    {
+        SyntheticSensorSettings settings;
+        settings.SensorType = sensorType;
+        IResearchModeSensor* pSensor = nullptr;
+        IResearchModeCameraSensor* pCamera = nullptr;
+        if (FAILED(SyntheticResearchModeSensor::Create(settings, &pSensor)) ||
+            FAILED(pSensor->QueryInterface(IID_PPV_ARGS(&pCamera))))
+        {
+            printf("no synthetic camera\n");
+            return 1;
+        }
+
+        auto pattern = SyntheticResearchModeSensor::GeneratePattern(sensorType, 0);
+        const ResearchModeSensorResolution resolution = SyntheticResearchModeSensor::ResolutionOf(sensorType);
+        const bool longThrow = (sensorType == DEPTH_LONG_THROW);
+        const UINT16* pDepth = pattern->Depth.data();
+        const BYTE* pSigma = longThrow ? pattern->Sigma.data() : nullptr;
+        const size_t count = pattern->Depth.size();
+        const USHORT maxValue = longThrow ? 0xFFFF : ResearchModeFrameEncoder::kAhatMaxValue;
+
+        // the table the encoder builds once
+        std::vector<float> rayX(count, 0.0f);
+        std::vector<float> rayY(count, 0.0f);
+        std::vector<float> rayZ(count, 0.0f);
+        for (UINT32 y = 0; y < resolution.Height; ++y)
+        {
+            for (UINT32 x = 0; x < resolution.Width; ++x)
+            {
+                float uv[2] = { x + 0.5f, y + 0.5f };
+                float xy[2];
+                if (SUCCEEDED(pCamera->MapImagePointToCameraUnitPlane(uv, xy)))
+                {
+                    const float norm = std::sqrt(xy[0] * xy[0] + xy[1] * xy[1] + 1.0f);
+                    const size_t i = static_cast<size_t>(y) * resolution.Width + x;
+                    rayX[i] = xy[0] / norm;
+                    rayY[i] = xy[1] / norm;
+                    rayZ[i] = 1.0f / norm;
+                }
+            }
+        }
+
+        std::vector<int16_t> referenceMm(count * 3);
+        std::vector<uint16_t> referenceHalf(count * 3);
+        const size_t pointCount = DepthToPointsMm16(pDepth, pSigma, rayX.data(), rayY.data(), rayZ.data(),
+            count, maxValue, referenceMm.data(), SimdLevel::Scalar);
+        DepthToPointsHalf(pDepth, pSigma, rayX.data(), rayY.data(), rayZ.data(),
+            count, maxValue, referenceHalf.data(), SimdLevel::Scalar);
+
+        printf("\n%s point cloud, %zu of %zu pixels valid\n", longThrow ? "Long Throw" : "AHAT", pointCount, count);
+        printf("%-22s %12s %12s %9s\n", "variant", "us/frame", "Mpixel/s", "speedup");
+
+        double baseline = 0.0;
+        if (!longThrow)
+        {
+            // per pixel mapping only knows the AHAT range check
+            std::vector<int16_t> points;
+            baseline = MeasureNanoseconds([&]()
+            {
+                DepthToPointsPerPixel(pCamera, pDepth, resolution.Width, resolution.Height, maxValue, points);
+                DoNotOptimize(points);
+            });
+            printf("%-22s %12.1f %12.1f %8.2fx\n", "unit plane per pixel", baseline * 1e-3, count / baseline * 1e3, 1.0);
+        }
+
+        std::vector<int16_t> mm(count * 3);
+        std::vector<uint16_t> half(count * 3);
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Neon })
+        {
+            if (!IsSimdLevelSupported(level))
+            {
+                continue;
+            }
+
+            if (DepthToPointsMm16(pDepth, pSigma, rayX.data(), rayY.data(), rayZ.data(), count, maxValue, mm.data(), level) != pointCount ||
+                DepthToPointsHalf(pDepth, pSigma, rayX.data(), rayY.data(), rayZ.data(), count, maxValue, half.data(), level) != pointCount ||
+                !std::equal(mm.begin(), mm.begin() + 3 * pointCount, referenceMm.begin()) ||
+                !std::equal(half.begin(), half.begin() + 3 * pointCount, referenceHalf.begin()))
+            {
+                printf("%s kernel output differs from the scalar kernel\n", SimdLevelName(level));
+                return 1;
+            }
+
+            const double elapsedMm = MeasureNanoseconds([&]()
+            {
+                DepthToPointsMm16(pDepth, pSigma, rayX.data(), rayY.data(), rayZ.data(), count, maxValue, mm.data(), level);
+                DoNotOptimize(mm);
+            });
+            const double elapsedHalf = MeasureNanoseconds([&]()
+            {
+                DepthToPointsHalf(pDepth, pSigma, rayX.data(), rayY.data(), rayZ.data(), count, maxValue, half.data(), level);
+                DoNotOptimize(half);
+            });
+            char name[32];
+            snprintf(name, sizeof(name), "mm16 (%s)", SimdLevelName(level));
+            printf("%-22s %12.1f %12.1f", name, elapsedMm * 1e-3, count / elapsedMm * 1e3);
+            printf(baseline > 0.0 ? " %8.2fx\n" : "\n", baseline / elapsedMm);
+            snprintf(name, sizeof(name), "half (%s)", SimdLevelName(level));
+            printf("%-22s %12.1f %12.1f", name, elapsedHalf * 1e-3, count / elapsedHalf * 1e3);
+            printf(baseline > 0.0 ? " %8.2fx\n" : "\n", baseline / elapsedHalf);
+        }
+
+        pCamera->Release();
+        pSensor->Release();
+        return 0;
+    }
+
+    int BenchmarkLongThrow()
+    {
+        auto pattern = SyntheticResearchModeSensor::GeneratePattern(DEPTH_LONG_THROW, 0);
+        const UINT16* pDepth = pattern->Depth.data();
+        const BYTE* pSigma = pattern->Sigma.data();
+        const UINT16* pAb = pattern->Ab.data();
+        const size_t count = pattern->Depth.size();
+
+        std::vector<uint8_t> reference(count * sizeof(UINT16));
+        std::vector<uint8_t> referenceAb(count * sizeof(UINT16));
+        ValidateDepthBySigmaBigEndian(pDepth, pSigma, count, reference.data(), SimdLevel::Scalar);
+        ValidateDepthAndAbBySigmaBigEndian(pDepth, pAb, pSigma, count, nullptr, referenceAb.data(), SimdLevel::Scalar);
+
+        printf("\nLong Throw sigma validation, %zu pixels per frame\n", count);
+        printf("%-22s %12s %12s\n", "variant", "us/frame", "Mpixel/s");
+
+        std::vector<uint8_t> output(count * sizeof(UINT16));
+        std::vector<uint8_t> ab(count * sizeof(UINT16));
+        for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Neon })
+        {
+            if (!IsSimdLevelSupported(level))
+            {
+                continue;
+            }
+
+            ValidateDepthBySigmaBigEndian(pDepth, pSigma, count, output.data(), level);
+            if (output != reference)
+            {
+                printf("%s kernel output differs from the scalar kernel\n", SimdLevelName(level));
+                return 1;
+            }
+            ValidateDepthAndAbBySigmaBigEndian(pDepth, pAb, pSigma, count, output.data(), ab.data(), level);
+            if (ab != referenceAb)
+            {
+                printf("%s AB kernel output differs from the scalar kernel\n", SimdLevelName(level));
+                return 1;
+            }
+
+            const double elapsed = MeasureNanoseconds([&]()
+            {
+                ValidateDepthBySigmaBigEndian(pDepth, pSigma, count, output.data(), level);
+                DoNotOptimize(output);
+            });
+            char name[32];
+            snprintf(name, sizeof(name), "kernel (%s)", SimdLevelName(level));
+            printf("%-22s %12.1f %12.1f\n", name, elapsed * 1e-3, count / elapsed * 1e3);
+        }
+        return 0;
+    }
+}
+
+int main()
+{
+    auto pattern = SyntheticResearchModeSensor::GeneratePattern(DEPTH_AHAT, 0);
+    const UINT16* pDepth = pattern->Depth.data();
+    const size_t count = pattern->Depth.size();
+    const USHORT maxValue = ResearchModeFrameEncoder::kAhatMaxValue;
+
+    const std::vector<BYTE> reference = ValidateDepthPushBack(pDepth, count, maxValue);
+
+    printf("AHAT depth validation, %zu pixels per frame\n", count);
+    printf("%-22s %12s %12s %9s\n", "variant", "us/frame", "Mpixel/s", "speedup");
+
+    const double baseline = MeasureNanoseconds([&]()
+    {
+        auto data = ValidateDepthPushBack(pDepth, count, maxValue);
+        DoNotOptimize(data);
+    });
+    printf("%-22s %12.1f %12.1f %8.2fx\n", "push_back loop", baseline * 1e-3, count / baseline * 1e3, 1.0);
+
+    std::vector<uint8_t> output(count * sizeof(UINT16));
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Neon })
+    {
+        if (!IsSimdLevelSupported(level))
+        {
+            continue;
+        }
+
+        ValidateDepthBigEndian(pDepth, count, maxValue, output.data(), level);
+        if (memcmp(output.data(), reference.data(), reference.size()) != 0)
+        {
+            printf("%s kernel output differs from the reference loop\n", SimdLevelName(level));
+            return 1;
+        }
+
+        const double elapsed = MeasureNanoseconds([&]()
+        {
+            ValidateDepthBigEndian(pDepth, count, maxValue, output.data(), level);
+            DoNotOptimize(output);
+        });
+        char name[32];
+        snprintf(name, sizeof(name), "kernel (%s)", SimdLevelName(level));
+        printf("%-22s %12.1f %12.1f %8.2fx\n", name, elapsed * 1e-3, count / elapsed * 1e3, baseline / elapsed);
+    }
+    if (BenchmarkAb() != 0)
+    {
+        return 1;
+    }
+    if (BenchmarkLongThrow() != 0)
+    {
+        return 1;
+    }
+    if (BenchmarkPoints(DEPTH_AHAT) != 0)
+    {
+        return 1;
+    }
+    return BenchmarkPoints(DEPTH_LONG_THROW);
+}
@@ -0,0 +1,178 @@
+// Compares the per-field DataWriter style serialization the streamers used to do
+// against FrameMessage, both flattened into one buffer and as gather segments.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "BenchmarkUtils.h"
+#include "FrameHeaders.h"
+#include "FrameMessage.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+namespace
+{
+    // Stand-in for DataWriter: every field is a separate call appending to an
+    // internal buffer, which StoreAsync detaches, so it is regrown every frame.
+    class FieldWriter
+    {
+    public:
+        BENCHMARK_NOINLINE void WriteUInt64(uint64_t value) { Append(&value, sizeof(value)); }
+        BENCHMARK_NOINLINE void WriteUInt32(uint32_t value) { Append(&value, sizeof(value)); }
+        BENCHMARK_NOINLINE void WriteUInt16(uint16_t value) { Append(&value, sizeof(value)); }
+        BENCHMARK_NOINLINE void WriteInt32(int32_t value) { Append(&value, sizeof(value)); }
+        BENCHMARK_NOINLINE void WriteSingle(float value) { Append(&value, sizeof(value)); }
+        BENCHMARK_NOINLINE void WriteBytes(const std::vector<uint8_t>& data) { Append(data.data(), data.size()); }
+
+        std::vector<uint8_t> Store()
+        {
+            std::vector<uint8_t> stored;
+            stored.swap(m_buffer);
+            return stored;
+        }
+
+    private:
+        void Append(const void* pData, size_t size)
+        {
+            const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+            m_buffer.insert(m_buffer.end(), pBytes, pBytes + size);
+        }
+
+        std::vector<uint8_t> m_buffer;
+    };
+
+    void WriteMatrix4x4(FieldWriter& writer, const Float4x4& matrix)
+    {
+        const float* pValues = &matrix.m11;
+        for (int i = 0; i < 16; ++i)
+        {
+            writer.WriteSingle(pValues[i]);
+        }
+    }
+
+    void WriteMessageHeader(FieldWriter& writer, const MessageHeader& header)
+    {
+        writer.WriteUInt32(header.Magic);
+        writer.WriteUInt16(header.Version);
+        writer.WriteUInt16(header.HeaderSize);
+        writer.WriteUInt16(header.StreamId);
+        writer.WriteUInt16(header.MessageType);
+        writer.WriteUInt32(header.Codec);
+        writer.WriteUInt32(header.PayloadSize);
+        writer.WriteUInt32(header.Flags);
+    }
+
+    void WriteFields(FieldWriter& writer, const MessageHeader& messageHeader, const ResearchModeFrameHeader& header, const std::vector<uint8_t>& payload)
+    {
+        WriteMessageHeader(writer, messageHeader);
+        writer.WriteUInt64(header.Timestamp);
+        writer.WriteInt32(header.ImageWidth);
+        writer.WriteInt32(header.ImageHeight);
+        writer.WriteInt32(header.PixelStride);
+        writer.WriteInt32(header.RowStride);
+        WriteMatrix4x4(writer, header.Rig2World);
+        writer.WriteUInt32(header.AbSize);
+        writer.WriteUInt32(header.Gain);
+        writer.WriteUInt64(header.Exposure);
+        writer.WriteBytes(payload);
+    }
+
+    void WriteFields(FieldWriter& writer, const MessageHeader& messageHeader, const VideoFrameHeader& header, const std::vector<uint8_t>& payload)
+    {
+        WriteMessageHeader(writer, messageHeader);
+        writer.WriteUInt64(header.Timestamp);
+        writer.WriteInt32(header.ImageWidth);
+        writer.WriteInt32(header.ImageHeight);
+        writer.WriteInt32(header.PixelStride);
+        writer.WriteInt32(header.RowStride);
+        WriteMatrix4x4(writer, header.PVtoWorld);
+        writer.WriteSingle(header.Fx);
+        writer.WriteSingle(header.Fy);
+        writer.WriteBytes(payload);
+    }
+
+    template <typename THeader>
+    bool RunStream(
+        const char* name,
+        StreamId streamId,
+        uint32_t codec,
+        THeader header,
+        size_t payloadSize)
+    {
+        std::vector<uint8_t> payload(payloadSize);
+        for (size_t i = 0; i < payload.size(); ++i)
+        {
+            payload[i] = static_cast<uint8_t>(i * 7);
+        }
+
+        const MessageHeader messageHeader = MakeMessageHeader(streamId, THeader::kType, codec, sizeof(THeader), payloadSize);
+        FieldWriter writer;
+        WriteFields(writer, messageHeader, header, payload);
+        const std::vector<uint8_t> reference = writer.Store();
+
+        FrameMessage message;
+        message.SetHeader(streamId, codec, header);
+        message.AddPayload(payload);
+        std::vector<uint8_t> flattened;
+        message.FlattenInto(flattened);
+        if (flattened != reference)
+        {
+            printf("%s: message bytes differ from the per-field serialization\n", name);
+            return false;
+        }
+
+        printf("\n%s, %zu byte headers + %zu byte payload\n", name, sizeof(MessageHeader) + sizeof(THeader), payloadSize);
+        printf("%-28s %12s %9s\n", "variant", "us/frame", "speedup");
+
+        const double baseline = MeasureNanoseconds([&]()
+        {
+            WriteFields(writer, messageHeader, header, payload);
+            auto stored = writer.Store();
+            DoNotOptimize(stored);
+        });
+        printf("%-28s %12.2f %8.2fx\n", "per-field writes", baseline * 1e-3, 1.0);
+
+        const double flattenedTime = MeasureNanoseconds([&]()
+        {
+            message.SetHeader(streamId, codec, header);
+            message.AddPayload(payload);
+            message.FlattenInto(flattened);
+            DoNotOptimize(flattened);
+        });
+        printf("%-28s %12.2f %8.2fx\n", "message, one buffer", flattenedTime * 1e-3, baseline / flattenedTime);
+
+        const double gathered = MeasureNanoseconds([&]()
+        {
+            message.SetHeader(streamId, codec, header);
+            message.AddPayload(payload);
+            DoNotOptimize(message.Segments());
+        });
+        printf("%-28s %12.2f %8.2fx\n", "message, gather segments", gathered * 1e-3, baseline / gathered);
+        return true;
+    }
+}
+
+int main()
+{
+    ResearchModeFrameHeader ahatHeader{};
+    ahatHeader.ImageWidth = 512;
+    ahatHeader.ImageHeight = 512;
+    ahatHeader.PixelStride = 2;
+    ahatHeader.RowStride = 1024;
+    ahatHeader.Rig2World = Float4x4::Identity();
+
+    VideoFrameHeader pvHeader{};
+    pvHeader.ImageWidth = 640;
+    pvHeader.ImageHeight = 360;
+    pvHeader.PixelStride = 3;
+    pvHeader.RowStride = 1920;
+    pvHeader.PVtoWorld = Float4x4::Identity();
+
+    return (RunStream("AHAT", StreamId::DepthAhat, static_cast<uint32_t>(DepthCodec::Raw), ahatHeader, 512 * 512 * 2) &&
+        RunStream("PV BGR 640x360", StreamId::PhotoVideo, static_cast<uint32_t>(VideoPixelFormat::Bgr8), pvHeader, 640 * 360 * 3)) ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+// Compares the emplace_back loop VideoFrameEncoder used to run against the
+// BGRA to BGR packing kernels, at full resolution and with decimation.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "BenchmarkUtils.h"
+#include "ImageKernels.h"
+#include "SyntheticVideoSource.h"
+
+namespace
+{
+    // the loop VideoFrameEncoder::Encode used before the kernels existed
+    std::vector<uint8_t> PackEmplaceBack(
+        const uint8_t* pBgra,
+        int width,
+        int height,
+        int rowStride,
+        int scaleFactor)
+    {
+        const int pixelStride = 4;
+        std::vector<uint8_t> payload;
+        for (int row = 0; row < height; row += scaleFactor)
+        {
+            for (int col = 0; col < width * pixelStride; col += scaleFactor * pixelStride)
+            {
+                for (int j = 0; j < pixelStride - 1; j++)
+                {
+                    payload.emplace_back(pBgra[row * rowStride + col + j]);
+                }
+            }
+        }
+        return payload;
+    }
+
+    // A copy of a frame that ends where readable memory ends, so that a kernel
+    // loading past the frame faults instead of passing unnoticed. A plain copy
+    // where there are no guard pages.
+    class GuardedFrame
+    {
+    public:
+        explicit GuardedFrame(const std::vector<uint8_t>& frame)
+        {
+#if !defined(_WIN32)
+            const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            m_mappedSize = (frame.size() + page - 1) / page * page + page;
+            void* pMapping = mmap(nullptr, m_mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (pMapping != MAP_FAILED)
+            {
+                m_pMapping = static_cast<uint8_t*>(pMapping);
+                mprotect(m_pMapping + m_mappedSize - page, page, PROT_NONE);
+                m_pData = m_pMapping + m_mappedSize - page - frame.size();
+                memcpy(m_pData, frame.data(), frame.size());
+                return;
+            }
+#endif
+            m_copy = frame;
+            m_pData = m_copy.data();
+        }
+
+        ~GuardedFrame()
+        {
+#if !defined(_WIN32)
+            if (m_pMapping)
+            {
+                munmap(m_pMapping, m_mappedSize);
+            }
+#endif
+        }
+
+        GuardedFrame(const GuardedFrame&) = delete;
+        GuardedFrame& operator=(const GuardedFrame&) = delete;
+
+        const uint8_t* data() const { return m_pData; }
+
+    private:
+        uint8_t* m_pData = nullptr;
+        uint8_t* m_pMapping = nullptr;
+        size_t m_mappedSize = 0;
+        std::vector<uint8_t> m_copy;
+    };
+
+    // Packs narrow frames whose width is not a multiple of the decimation with
+    // every kernel and compares them with the scalar path. The last row of such a
+    // frame lacks the pixels after its last output pixel, which the vector steps
+    // must not load.
+    bool CheckRowTails()
+    {
+        const int height = 3;
+        for (int decimation : { 2, 4 })
+        {
+            for (int width = 1; width <= 80; ++width)
+            {
+                if (width % decimation == 0)
+                {
+                    continue;
+                }
+                const GuardedFrame frame(SyntheticVideoSource::GenerateBgraPattern(width, height, 0));
+                const size_t outputSize = static_cast<size_t>(3) *
+                    DecimatedSize(width, decimation) * DecimatedSize(height, decimation);
+                std::vector<uint8_t> reference(outputSize);
+                PackBgraToBgr(frame.data(), width, height, width * 4, decimation, reference.data(), SimdLevel::Scalar);
+
+                std::vector<uint8_t> output(outputSize);
+                for (SimdLevel level : { SimdLevel::Ssse3, SimdLevel::Avx2, SimdLevel::Neon })
+                {
+                    if (!IsSimdLevelSupported(level))
+                    {
+                        continue;
+                    }
+                    memset(output.data(), 0, output.size());
+                    PackBgraToBgr(frame.data(), width, height, width * 4, decimation, output.data(), level);
+                    if (output != reference)
+                    {
+                        printf("%s kernel output differs from the scalar path at width %d, decimation %d\n",
+                            SimdLevelName(level), width, decimation);
+                        return false;
+                    }
+                }
+            }
+        }
+        printf("Row tails of widths 1 to 80 at decimation 2 and 4 match the scalar path\n");
+        return true;
+    }
+
+    bool RunResolution(
+        int width,
+        int height)
+    {
+        const std::vector<uint8_t> frame = SyntheticVideoSource::GenerateBgraPattern(width, height, 0);
+        const int rowStride = width * 4;
+
+        printf("\nBGRA %dx%d\n", width, height);
+        printf("%-10s %-22s %12s %12s %9s\n", "decimation", "variant", "us/frame", "Mpixel/s", "speedup");
+
+        for (int decimation : { 1, 2, 4 })
+        {
+            const std::vector<uint8_t> reference = PackEmplaceBack(frame.data(), width, height, rowStride, decimation);
+            const double pixels = static_cast<double>(reference.size() / 3);
+
+            const double baseline = MeasureNanoseconds([&]()
+            {
+                auto payload = PackEmplaceBack(frame.data(), width, height, rowStride, decimation);
+                DoNotOptimize(payload);
+            });
+            printf("%-10d %-22s %12.1f %12.1f %8.2fx\n", decimation, "emplace_back loop",
+                baseline * 1e-3, pixels / baseline * 1e3, 1.0);
+
+            std::vector<uint8_t> output(reference.size());
+            for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Ssse3, SimdLevel::Avx2, SimdLevel::Neon })
+            {
+                if (!IsSimdLevelSupported(level))
+                {
+                    continue;
+                }
+
+                memset(output.data(), 0, output.size());
+                PackBgraToBgr(frame.data(), width, height, rowStride, decimation, output.data(), level);
+                if (output != reference)
+                {
+                    printf("%s kernel output differs from the reference loop\n", SimdLevelName(level));
+                    return false;
+                }
+
+                const double elapsed = MeasureNanoseconds([&]()
+                {
+                    PackBgraToBgr(frame.data(), width, height, rowStride, decimation, output.data(), level);
+                    DoNotOptimize(output);
+                });
+                char name[32];
+                snprintf(name, sizeof(name), "kernel (%s)", SimdLevelName(level));
+                printf("%-10d %-22s %12.1f %12.1f %8.2fx\n", decimation, name,
+                    elapsed * 1e-3, pixels / elapsed * 1e3, baseline / elapsed);
+            }
+        }
+        return true;
+    }
+}
+
+int main()
+{
+    // odd sizes exercise the scalar row tails of the vector kernels
+    return (CheckRowTails() &&
+        RunResolution(640, 360) && RunResolution(1920, 1080) && RunResolution(757, 13)) ? 0 : 1;
+}
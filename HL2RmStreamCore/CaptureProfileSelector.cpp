@@ -0,0 +1,85 @@
+#include "CaptureProfileSelector.h"
+
+#include <cmath>
+
+#include "VideoFrameEncoder.h"
+
+namespace
+{
+    // being below the request costs this much more than being above it
+    const double kShortfallWeight = 2.0;
+    const double kConversionPenalty = 0.01;
+
+    // log ratio of actual to wanted, weighted; 0 if nothing is wanted
+    double RatioPenalty(double wanted, double actual)
+    {
+        if (wanted <= 0.0)
+        {
+            return 0.0;
+        }
+        if (actual <= 0.0)
+        {
+            return HUGE_VAL;
+        }
+        const double distance = std::log(actual / wanted);
+        return distance < 0.0 ? -distance * kShortfallWeight : distance;
+    }
+}
+
+double ScoreCaptureProfile(
+    const CaptureProfileRequest& request,
+    const CaptureProfile& profile)
+{
+    double score =
+        RatioPenalty(request.Width, profile.Width) +
+        RatioPenalty(request.Height, profile.Height) +
+        RatioPenalty(request.FrameRate, profile.FrameRate);
+    if (profile.PixelFormat != VideoFrameEncoder::CaptureFormatFor(request.PixelFormat))
+    {
+        score += kConversionPenalty;
+    }
+    return score;
+}
+
+size_t SelectCaptureProfile(
+    const CaptureProfileRequest& request,
+    const std::vector<CaptureProfile>& profiles)
+{
+    size_t selected = SIZE_MAX;
+    double bestScore = HUGE_VAL;
+    for (size_t i = 0; i < profiles.size(); ++i)
+    {
+        const double score = ScoreCaptureProfile(request, profiles[i]);
+        if (selected == SIZE_MAX || score < bestScore)
+        {
+            selected = i;
+            bestScore = score;
+        }
+    }
+    return selected;
+}
+
+const std::vector<CaptureProfile>& HoloLens2PvProfiles()
+{
+    // every resolution at 30 and 15 fps, all NV12
+    static const std::vector<CaptureProfile> profiles = []()
+    {
+        const uint32_t sizes[][2] = {
+            { 1920, 1080 }, { 2272, 1278 }, { 1952, 1100 }, { 1504, 846 }, { 1280, 720 },
+            { 1128, 636 }, { 960, 540 }, { 760, 428 }, { 640, 360 }, { 500, 282 }, { 424, 240 } };
+        std::vector<CaptureProfile> list;
+        for (const auto& size : sizes)
+        {
+            for (double frameRate : { 30.0, 15.0 })
+            {
+                CaptureProfile profile;
+                profile.Width = size[0];
+                profile.Height = size[1];
+                profile.FrameRate = frameRate;
+                list.push_back(profile);
+            }
+        }
+        return list;
+    }();
+    return profiles;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrameHeaders.h"
+
+// One way a camera can capture, e.g. a MediaCaptureVideoProfileMediaDescription
+// or a MediaFrameFormat of the PV camera.
+struct CaptureProfile
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	double FrameRate = 0.0;
+	// Bgra8 or Nv12, the format the frames arrive in
+	VideoPixelFormat PixelFormat = VideoPixelFormat::Nv12;
+};
+
+// What a stream would like to capture. A Width, Height or FrameRate of 0 leaves
+// that dimension to the camera.
+struct CaptureProfileRequest
+{
+	uint32_t Width = 640;
+	uint32_t Height = 360;
+	double FrameRate = 30.0;
+	// the wire format, which needs frames in VideoFrameEncoder::CaptureFormatFor
+	VideoPixelFormat PixelFormat = VideoPixelFormat::Bgr8;
+};
+
+// How far profile is from request, 0 for an exact match. Size and frame rate
+// count by their ratio to the request, twice as much below it as above: a larger
+// image can be decimated and a faster camera paced down, but neither can be made
+// up for. A capture format that needs a conversion only breaks ties.
+double ScoreCaptureProfile(
+	const CaptureProfileRequest& request,
+	const CaptureProfile& profile);
+
+// Index of the profile closest to request, the first of equally close ones, or
+// SIZE_MAX if there are none.
+size_t SelectCaptureProfile(
+	const CaptureProfileRequest& request,
+	const std::vector<CaptureProfile>& profiles);
+
+// The video profiles the HoloLens 2 PV camera lists, for synthetic sources.
+const std::vector<CaptureProfile>& HoloLens2PvProfiles();
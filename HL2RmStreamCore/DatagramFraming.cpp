@@ -0,0 +1,480 @@
+#include "DatagramFraming.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Platform.h"
+
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+namespace
+{
+    const uint64_t kTicksPerMs = 10000;
+
+    // the first fragment has to hold the whole MessageHeader, so that it can be
+    // replaced
+    const size_t kMinFragmentSize = 64;
+    // the largest UDP payload over IPv4
+    const size_t kMaxDatagramSize = 65507;
+
+    // A message this far behind the last one is not late but from a sender that
+    // started over, e.g. after the subscription timed out.
+    const int32_t kRestartDistance = 64;
+
+    void XorInto(
+        uint8_t* pDst,
+        const uint8_t* pSrc,
+        size_t size)
+    {
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t dst, src;
+            memcpy(&dst, pDst + i, sizeof(dst));
+            memcpy(&src, pSrc + i, sizeof(src));
+            dst ^= src;
+            memcpy(pDst + i, &dst, sizeof(dst));
+        }
+        for (; i < size; i++)
+        {
+            pDst[i] ^= pSrc[i];
+        }
+    }
+
+    // bytes of the message in data fragment index
+    size_t FragmentLength(
+        const DatagramHeader& header,
+        uint32_t index)
+    {
+        const size_t offset = static_cast<size_t>(index) * header.FragmentSize;
+        return std::min<size_t>(header.FragmentSize, header.FrameSize - offset);
+    }
+
+    bool IsValid(
+        const DatagramHeader& header,
+        size_t payloadSize)
+    {
+        if (header.Magic != DatagramHeader::kMagic || header.FragmentCount == 0 || header.FragmentSize == 0 ||
+            header.FragmentIndex >= header.FragmentCount)
+        {
+            return false;
+        }
+        // the fragments have to add up to the message
+        const uint64_t capacity = static_cast<uint64_t>(header.FragmentCount) * header.FragmentSize;
+        if (header.FrameSize == 0 || header.FrameSize > capacity || header.FrameSize <= capacity - header.FragmentSize)
+        {
+            return false;
+        }
+        if (header.Flags & static_cast<uint16_t>(DatagramFlags::Parity))
+        {
+            return header.ParityGroupSize != 0 && header.FragmentIndex % header.ParityGroupSize == 0 &&
+                payloadSize == FragmentLength(header, header.FragmentIndex);
+        }
+        return payloadSize == FragmentLength(header, header.FragmentIndex);
+    }
+}
+
+FrameFragmenter::FrameFragmenter(
+    const DatagramSettings& settings) :
+    m_settings(settings)
+{
+    const size_t datagramSize = std::min<size_t>(
+        std::max<size_t>(settings.DatagramSize, sizeof(DatagramHeader) + kMinFragmentSize), kMaxDatagramSize);
+    m_fragmentSize = datagramSize - sizeof(DatagramHeader);
+    m_settings.ParityGroupSize = std::min<uint32_t>(settings.ParityGroupSize, UINT16_MAX);
+}
+
+size_t FrameFragmenter::Fragment(
+    uint32_t frameId,
+    const uint8_t* pMessage,
+    size_t size,
+    uint64_t writeTime,
+    bool session,
+    const SendDatagram& send)
+{
+    const size_t fragmentCount = (size + m_fragmentSize - 1) / m_fragmentSize;
+    if (size < sizeof(MessageHeader) || fragmentCount > UINT16_MAX || size > UINT32_MAX)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"FrameFragmenter::Fragment: Can't send a message of %zu bytes.\n", size);
+        OutputDebugStringW(msgBuffer);
+#endif
+        return 0;
+    }
+
+    MessageHeader messageHeader;
+    memcpy(&messageHeader, pMessage, sizeof(messageHeader));
+
+    DatagramHeader header{};
+    header.Magic = DatagramHeader::kMagic;
+    header.FrameId = frameId;
+    header.FrameSize = static_cast<uint32_t>(size);
+    header.StreamId = messageHeader.StreamId;
+    header.FragmentCount = static_cast<uint16_t>(fragmentCount);
+    header.ParityGroupSize = static_cast<uint16_t>(m_settings.ParityGroupSize);
+    header.FragmentSize = static_cast<uint16_t>(m_fragmentSize);
+
+    const uint16_t flags = session ? static_cast<uint16_t>(DatagramFlags::Session) : 0;
+    const uint32_t groupSize = m_settings.ParityGroupSize;
+    size_t sent = 0;
+    for (uint32_t i = 0; i < fragmentCount; i++)
+    {
+        const size_t offset = static_cast<size_t>(i) * m_fragmentSize;
+        const size_t length = std::min(m_fragmentSize, size - offset);
+        const uint8_t* pFragment = pMessage + offset;
+        if (i == 0 && writeTime != 0)
+        {
+            m_firstFragment.assign(pFragment, pFragment + length);
+            SetWriteTime(m_firstFragment.data(), length, writeTime);
+            pFragment = m_firstFragment.data();
+        }
+
+        if (groupSize != 0)
+        {
+            // the first fragment of a group is the longest
+            if (i % groupSize == 0)
+            {
+                m_parity.assign(pFragment, pFragment + length);
+            }
+            else
+            {
+                XorInto(m_parity.data(), pFragment, length);
+            }
+        }
+
+        header.Flags = flags;
+        header.FragmentIndex = static_cast<uint16_t>(i);
+        if (!send(header, pFragment, length))
+        {
+            return 0;
+        }
+        sent += sizeof(header) + length;
+
+        if (groupSize != 0 && (i % groupSize == groupSize - 1 || i == fragmentCount - 1))
+        {
+            header.Flags = flags | static_cast<uint16_t>(DatagramFlags::Parity);
+            header.FragmentIndex = static_cast<uint16_t>(i - i % groupSize);
+            if (!send(header, m_parity.data(), m_parity.size()))
+            {
+                return 0;
+            }
+            sent += sizeof(header) + m_parity.size();
+        }
+    }
+    return sent;
+}
+
+FrameReassembler::FrameReassembler(
+    uint32_t deadlineMs,
+    uint32_t maxPending) :
+    m_deadlineTicks(deadlineMs * kTicksPerMs),
+    m_pending(std::max(1u, maxPending))
+{
+}
+
+bool FrameReassembler::Add(
+    const uint8_t* pDatagram,
+    size_t size,
+    uint64_t nowTicks,
+    std::vector<uint8_t>& message)
+{
+    Expire(nowTicks);
+
+    DatagramHeader header;
+    if (size < sizeof(header))
+    {
+        m_statistics.Malformed++;
+        return false;
+    }
+    memcpy(&header, pDatagram, sizeof(header));
+    const uint8_t* pPayload = pDatagram + sizeof(header);
+    const size_t payloadSize = size - sizeof(header);
+    if (!IsValid(header, payloadSize))
+    {
+        m_statistics.Malformed++;
+        return false;
+    }
+    m_statistics.Datagrams++;
+
+    if (m_hasLast && static_cast<int32_t>(header.FrameId - m_lastFrameId) < -kRestartDistance)
+    {
+        for (PendingMessage& pending : m_pending)
+        {
+            if (pending.Active)
+            {
+                pending.Active = false;
+                m_statistics.Expired++;
+            }
+        }
+        m_hasLast = false;
+        // the session message of the new subscription is still to come
+        m_hasSession = false;
+    }
+    if (!IsNew(header.FrameId))
+    {
+        m_statistics.Late++;
+        return false;
+    }
+
+    const bool isParity = (header.Flags & static_cast<uint16_t>(DatagramFlags::Parity)) != 0;
+    if (header.FragmentCount == 1 && !isParity)
+    {
+        // most IMU and calibration messages: nothing to put together
+        message.assign(pPayload, pPayload + payloadSize);
+        Deliver(header);
+        return true;
+    }
+
+    PendingMessage* pPending = Find(header, nowTicks);
+    const DatagramHeader& layout = pPending->Layout;
+    if (layout.FrameSize != header.FrameSize || layout.StreamId != header.StreamId ||
+        layout.FragmentCount != header.FragmentCount || layout.FragmentSize != header.FragmentSize ||
+        layout.ParityGroupSize != header.ParityGroupSize)
+    {
+        m_statistics.Malformed++;
+        return false;
+    }
+
+    const uint32_t index = header.FragmentIndex;
+    const size_t offset = static_cast<size_t>(index) * header.FragmentSize;
+    if (isParity)
+    {
+        const uint32_t group = index / header.ParityGroupSize;
+        if (pPending->ParityReceived[group])
+        {
+            m_statistics.Late++;
+            return false;
+        }
+        memcpy(pPending->Parity.data() + static_cast<size_t>(group) * header.FragmentSize, pPayload, payloadSize);
+        pPending->ParityReceived[group] = 1;
+        TryRepair(*pPending, index);
+    }
+    else
+    {
+        if (pPending->Received[index])
+        {
+            m_statistics.Late++;
+            return false;
+        }
+        memcpy(pPending->Data.data() + offset, pPayload, payloadSize);
+        pPending->Received[index] = 1;
+        pPending->Missing--;
+        if (header.ParityGroupSize != 0)
+        {
+            TryRepair(*pPending, index - index % header.ParityGroupSize);
+        }
+    }
+
+    if (pPending->Missing != 0)
+    {
+        return false;
+    }
+    message.swap(pPending->Data);
+    pPending->Active = false;
+    Deliver(header);
+    return true;
+}
+
+SubscribeHeader FrameReassembler::Subscription() const
+{
+    SubscribeHeader subscription{};
+    if (m_hasSession)
+    {
+        subscription.Flags = static_cast<uint32_t>(SubscribeFlags::HasSession);
+        subscription.SessionFrameId = m_sessionFrameId;
+    }
+    return subscription;
+}
+
+void FrameReassembler::Deliver(
+    const DatagramHeader& header)
+{
+    m_statistics.Messages++;
+    Retire(header.FrameId);
+    if (header.Flags & static_cast<uint16_t>(DatagramFlags::Session))
+    {
+        m_hasSession = true;
+        m_sessionFrameId = header.FrameId;
+    }
+}
+
+void FrameReassembler::Expire(
+    uint64_t nowTicks)
+{
+    for (PendingMessage& pending : m_pending)
+    {
+        if (pending.Active && nowTicks >= pending.FirstTicks + m_deadlineTicks)
+        {
+            GiveUp(pending);
+        }
+    }
+}
+
+FrameReassembler::PendingMessage* FrameReassembler::Find(
+    const DatagramHeader& header,
+    uint64_t nowTicks)
+{
+    PendingMessage* pFree = nullptr;
+    PendingMessage* pOldest = nullptr;
+    for (PendingMessage& pending : m_pending)
+    {
+        if (!pending.Active)
+        {
+            pFree = pFree ? pFree : &pending;
+        }
+        else if (pending.FrameId == header.FrameId)
+        {
+            return &pending;
+        }
+        else if (!pOldest || static_cast<int32_t>(pending.FrameId - pOldest->FrameId) < 0)
+        {
+            pOldest = &pending;
+        }
+    }
+    if (!pFree)
+    {
+        GiveUp(*pOldest);
+        pFree = pOldest;
+    }
+
+    // the buffers keep their memory from one message to the next
+    PendingMessage& pending = *pFree;
+    const uint32_t groupCount = header.ParityGroupSize != 0 ?
+        (header.FragmentCount + header.ParityGroupSize - 1) / header.ParityGroupSize : 0;
+    pending.Active = true;
+    pending.FrameId = header.FrameId;
+    pending.FirstTicks = nowTicks;
+    pending.Layout = header;
+    pending.Data.resize(header.FrameSize);
+    pending.Received.assign(header.FragmentCount, 0);
+    pending.Parity.resize(static_cast<size_t>(groupCount) * header.FragmentSize);
+    pending.ParityReceived.assign(groupCount, 0);
+    pending.Missing = header.FragmentCount;
+    return &pending;
+}
+
+void FrameReassembler::TryRepair(
+    PendingMessage& pending,
+    uint32_t first)
+{
+    const DatagramHeader& layout = pending.Layout;
+    const uint32_t group = first / layout.ParityGroupSize;
+    if (!pending.ParityReceived[group] || pending.Missing == 0)
+    {
+        return;
+    }
+    const uint32_t end = std::min<uint32_t>(first + layout.ParityGroupSize, layout.FragmentCount);
+    uint32_t missing = end;
+    for (uint32_t i = first; i < end; i++)
+    {
+        if (!pending.Received[i])
+        {
+            if (missing != end)
+            {
+                return;
+            }
+            missing = i;
+        }
+    }
+    if (missing == end)
+    {
+        return;
+    }
+
+    // the missing fragment is the parity XOR the others of its group
+    const size_t length = FragmentLength(layout, missing);
+    uint8_t* pFragment = pending.Data.data() + static_cast<size_t>(missing) * layout.FragmentSize;
+    memcpy(pFragment, pending.Parity.data() + static_cast<size_t>(group) * layout.FragmentSize, length);
+    for (uint32_t i = first; i < end; i++)
+    {
+        if (i != missing)
+        {
+            XorInto(pFragment, pending.Data.data() + static_cast<size_t>(i) * layout.FragmentSize,
+                std::min(length, FragmentLength(layout, i)));
+        }
+    }
+    pending.Received[missing] = 1;
+    pending.Missing--;
+    m_statistics.Repaired++;
+}
+
+void FrameReassembler::GiveUp(
+    PendingMessage& pending)
+{
+    pending.Active = false;
+    m_statistics.Expired++;
+    Retire(pending.FrameId);
+}
+
+void FrameReassembler::Retire(
+    uint32_t frameId)
+{
+    if (!IsNew(frameId))
+    {
+        return;
+    }
+    m_hasLast = true;
+    m_lastFrameId = frameId;
+    for (PendingMessage& pending : m_pending)
+    {
+        if (pending.Active && !IsNew(pending.FrameId))
+        {
+            pending.Active = false;
+            m_statistics.Expired++;
+        }
+    }
+}
+
+bool FrameReassembler::IsNew(
+    uint32_t frameId) const
+{
+    return !m_hasLast || static_cast<int32_t>(frameId - m_lastFrameId) > 0;
+}
+
+DatagramSessionTracker::DatagramSessionTracker(
+    const DatagramSettings& settings) :
+    m_resendTicks(settings.SessionResendMs * kTicksPerMs)
+{
+}
+
+void DatagramSessionTracker::OnSubscribe(
+    const SubscribeHeader& subscription,
+    uint64_t nowTicks)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_hasSubscription = true;
+    m_subscription = subscription;
+    m_subscriptionTicks = nowTicks;
+}
+
+bool DatagramSessionTracker::NeedsSending(
+    const FrameBufferPtr& session)
+{
+    if (!session)
+    {
+        return false;
+    }
+    if (session != m_sentSession)
+    {
+        return true;
+    }
+    std::lock_guard<std::mutex> guard(m_mutex);
+    // clients that send no header never report a loss
+    if (!m_hasSubscription || m_subscriptionTicks < m_sentTicks + m_resendTicks)
+    {
+        return false;
+    }
+    return !(m_subscription.Flags & static_cast<uint32_t>(SubscribeFlags::HasSession)) ||
+        m_subscription.SessionFrameId != m_sentFrameId;
+}
+
+void DatagramSessionTracker::Sent(
+    const FrameBufferPtr& session,
+    uint32_t frameId,
+    uint64_t nowTicks)
+{
+    m_sentSession = session;
+    m_sentFrameId = frameId;
+    m_sentTicks = nowTicks;
+}
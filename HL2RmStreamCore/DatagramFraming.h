@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "FrameBufferPool.h"
+#include "FrameHeaders.h"
+
+// The UDP transport of a stream. A client subscribes by sending
+// MessageType::Subscribe to the UDP port of the same number as the TCP port of
+// the stream, and from then on gets every message the connections get, split
+// into datagrams (see DatagramHeader). Frames are not sent again: a lost datagram
+// loses its message, unless parity repairs it, so a late frame never holds back
+// the next one. Only the session message is sent again, when the client reports
+// that it lacks it, see DatagramSessionTracker.
+struct DatagramSettings
+{
+	// bytes of a datagram, headers included; 1400 fits a 1500 byte MTU with room
+	// for the IP and UDP headers and a tunnel
+	uint32_t DatagramSize = 1400;
+	// data fragments per parity datagram, 0 for none; 8 costs 1/8 more bytes and
+	// repairs one lost datagram in every 8
+	uint32_t ParityGroupSize = 0;
+	// subscribers that sent nothing for this long are dropped; clients send
+	// MessageType::Subscribe every second or so
+	uint32_t SubscriptionTimeoutMs = 5000;
+	// A client that reports it lacks the session message gets it again, but only
+	// with a report sent this long after the message went out, so that reports
+	// sent while it was on its way do not send it twice.
+	uint32_t SessionResendMs = 1000;
+};
+
+// Splits serialized messages into datagrams. Data fragments are not copied but
+// handed out as a header and a span of the message; only the parity and a first
+// fragment with a replaced MessageHeader are built in buffers of the fragmenter,
+// which keep their memory from one message to the next. Not thread-safe.
+class FrameFragmenter
+{
+public:
+	// Takes a datagram as its header and the bytes that follow it; returns false
+	// to stop.
+	typedef std::function<bool(const DatagramHeader& header, const uint8_t* pFragment, size_t size)> SendDatagram;
+
+	explicit FrameFragmenter(
+		const DatagramSettings& settings = DatagramSettings());
+
+	// Sends message, data fragments in order and the parity of a group right after
+	// its last fragment. writeTime, if not 0, goes into the FrameTraceHeader of the
+	// message, if its first fragment holds one, on a copy of that fragment, as
+	// the message is shared. session marks the datagrams with
+	// DatagramFlags::Session. Returns the bytes sent, headers included, or 0 if
+	// send stopped.
+	size_t Fragment(
+		uint32_t frameId,
+		const uint8_t* pMessage,
+		size_t size,
+		uint64_t writeTime,
+		bool session,
+		const SendDatagram& send);
+
+	// bytes of a message in a data fragment
+	size_t FragmentSize() const { return m_fragmentSize; }
+
+private:
+	DatagramSettings m_settings;
+	size_t m_fragmentSize;
+	std::vector<uint8_t> m_firstFragment;
+	std::vector<uint8_t> m_parity;
+};
+
+struct ReassemblyStatistics
+{
+	// datagrams that were fragments of a message
+	uint64_t Datagrams = 0;
+	// messages put back together
+	uint64_t Messages = 0;
+	// data fragments repaired from parity
+	uint64_t Repaired = 0;
+	// incomplete messages given up, at their deadline or for a newer message
+	uint64_t Expired = 0;
+	// datagrams of messages that were already complete or given up, e.g. parity
+	// that was not needed, or that came twice
+	uint64_t Late = 0;
+	// datagrams that are no fragment or do not fit the others of their message
+	uint64_t Malformed = 0;
+};
+
+// Puts the messages of a FrameFragmenter back together on the client. Messages
+// are delivered as soon as they are complete and only ever newer than the last
+// one: once a message is complete, the older ones still missing fragments are
+// given up, as are messages that are not complete deadlineMs after their first
+// datagram. Not thread-safe.
+class FrameReassembler
+{
+public:
+	explicit FrameReassembler(
+		uint32_t deadlineMs = 100,
+		uint32_t maxPending = 8);
+
+	// Adds a datagram that arrived at nowTicks (100 ns, see MonotonicTicks).
+	// Returns true if it completed a message, which is then swapped into message,
+	// so that the buffer message had is used for a later one.
+	bool Add(
+		const uint8_t* pDatagram,
+		size_t size,
+		uint64_t nowTicks,
+		std::vector<uint8_t>& message);
+
+	// Gives up the messages whose deadline has passed; Add does so as well.
+	void Expire(
+		uint64_t nowTicks);
+
+	// The header of the next MessageType::Subscribe: which session message was put
+	// together last.
+	SubscribeHeader Subscription() const;
+
+	ReassemblyStatistics Statistics() const { return m_statistics; }
+
+private:
+	struct PendingMessage
+	{
+		bool Active = false;
+		uint32_t FrameId = 0;
+		uint64_t FirstTicks = 0;
+		// the header of the first datagram, for the layout of the others
+		DatagramHeader Layout{};
+		std::vector<uint8_t> Data;
+		// per data fragment
+		std::vector<uint8_t> Received;
+		// parity payloads, FragmentSize bytes per group
+		std::vector<uint8_t> Parity;
+		std::vector<uint8_t> ParityReceived;
+		uint32_t Missing = 0;
+	};
+
+	PendingMessage* Find(
+		const DatagramHeader& header,
+		uint64_t nowTicks);
+
+	// Rebuilds the one missing data fragment of the group starting at first, if
+	// that is all that is missing and its parity is there.
+	void TryRepair(
+		PendingMessage& pending,
+		uint32_t first);
+
+	// Gives up pending at its deadline or to make room.
+	void GiveUp(
+		PendingMessage& pending);
+
+	// Makes frameId the last message delivered or given up and gives up the
+	// older ones still pending.
+	void Retire(
+		uint32_t frameId);
+
+	// A message with the DatagramFlags of header was put together.
+	void Deliver(
+		const DatagramHeader& header);
+
+	// whether frameId comes after the last message delivered or given up
+	bool IsNew(
+		uint32_t frameId) const;
+
+	uint64_t m_deadlineTicks;
+	std::vector<PendingMessage> m_pending;
+	bool m_hasLast = false;
+	uint32_t m_lastFrameId = 0;
+	bool m_hasSession = false;
+	uint32_t m_sessionFrameId = 0;
+	ReassemblyStatistics m_statistics;
+};
+
+// Decides when a datagram subscriber gets the session message. Calibration tables
+// of the research mode cameras are megabytes, so it goes out ahead of the first
+// frame and of the first frame after it changed, like over TCP, and again only
+// when the SubscribeHeader of a keep-alive of the client names another one, or
+// none. The writer of the subscriber asks NeedsSending and reports what it Sent;
+// OnSubscribe may come from any thread.
+class DatagramSessionTracker
+{
+public:
+	explicit DatagramSessionTracker(
+		const DatagramSettings& settings = DatagramSettings());
+
+	// A Subscribe of the client, with its header, arrived at nowTicks.
+	void OnSubscribe(
+		const SubscribeHeader& subscription,
+		uint64_t nowTicks);
+
+	// Whether session, the one the next frame goes with, goes out ahead of it.
+	bool NeedsSending(
+		const FrameBufferPtr& session);
+
+	// session went out as the message frameId at nowTicks.
+	void Sent(
+		const FrameBufferPtr& session,
+		uint32_t frameId,
+		uint64_t nowTicks);
+
+private:
+	const uint64_t m_resendTicks;
+
+	std::mutex m_mutex;
+	bool m_hasSubscription = false;
+	SubscribeHeader m_subscription{};
+	uint64_t m_subscriptionTicks = 0;
+
+	// only touched by the writer
+	FrameBufferPtr m_sentSession;
+	uint32_t m_sentFrameId = 0;
+	uint64_t m_sentTicks = 0;
+};
@@ -0,0 +1,221 @@
+#include "DepthCodec.h"
+
+namespace
+{
+    class NibbleWriter
+    {
+    public:
+        explicit NibbleWriter(uint8_t* pOutput) :
+            m_pOutput(pOutput),
+            m_pStart(pOutput)
+        {
+        }
+
+        void WriteValue(uint32_t value)
+        {
+            do
+            {
+                uint32_t nibble = value & 0x7;
+                value >>= 3;
+                if (value)
+                {
+                    nibble |= 0x8;
+                }
+                m_word = (m_word << 4) | nibble;
+                if (++m_nibbles == 8)
+                {
+                    FlushWord();
+                }
+            } while (value);
+        }
+
+        size_t Finish()
+        {
+            if (m_nibbles)
+            {
+                m_word <<= 4 * (8 - m_nibbles);
+                FlushWord();
+            }
+            return static_cast<size_t>(m_pOutput - m_pStart);
+        }
+
+    private:
+        void FlushWord()
+        {
+            m_pOutput[0] = static_cast<uint8_t>(m_word);
+            m_pOutput[1] = static_cast<uint8_t>(m_word >> 8);
+            m_pOutput[2] = static_cast<uint8_t>(m_word >> 16);
+            m_pOutput[3] = static_cast<uint8_t>(m_word >> 24);
+            m_pOutput += 4;
+            m_word = 0;
+            m_nibbles = 0;
+        }
+
+        uint8_t* m_pOutput;
+        uint8_t* m_pStart;
+        uint32_t m_word = 0;
+        int m_nibbles = 0;
+    };
+
+    class NibbleReader
+    {
+    public:
+        NibbleReader(const uint8_t* pData, size_t size) :
+            m_pData(pData),
+            m_pEnd(pData + (size & ~size_t(3)))
+        {
+        }
+
+        // returns false when the data runs out in the middle of a value
+        bool ReadValue(uint32_t& value)
+        {
+            value = 0;
+            for (int shift = 0; shift < 32; shift += 3)
+            {
+                if (m_nibbles == 0)
+                {
+                    if (m_pData == m_pEnd)
+                    {
+                        return false;
+                    }
+                    m_word = static_cast<uint32_t>(m_pData[0]) |
+                        (static_cast<uint32_t>(m_pData[1]) << 8) |
+                        (static_cast<uint32_t>(m_pData[2]) << 16) |
+                        (static_cast<uint32_t>(m_pData[3]) << 24);
+                    m_pData += 4;
+                    m_nibbles = 8;
+                }
+                const uint32_t nibble = m_word >> 28;
+                m_word <<= 4;
+                m_nibbles--;
+
+                value |= (nibble & 0x7) << shift;
+                if (!(nibble & 0x8))
+                {
+                    return true;
+                }
+            }
+            // longer than any 32 bit value
+            return false;
+        }
+
+    private:
+        const uint8_t* m_pData;
+        const uint8_t* m_pEnd;
+        uint32_t m_word = 0;
+        int m_nibbles = 0;
+    };
+    // isInvalid(i) tells whether pixel i is encoded as a zero
+    template <typename TIsInvalid>
+    size_t RvlEncode(
+        const uint16_t* pDepth,
+        size_t count,
+        TIsInvalid isInvalid,
+        uint8_t* pOutput)
+    {
+        NibbleWriter writer(pOutput);
+        int32_t previous = 0;
+        size_t i = 0;
+        while (i != count)
+        {
+            size_t run = i;
+            while (i != count && isInvalid(i))
+            {
+                i++;
+            }
+            writer.WriteValue(static_cast<uint32_t>(i - run));
+
+            run = i;
+            while (i != count && !isInvalid(i))
+            {
+                i++;
+            }
+            writer.WriteValue(static_cast<uint32_t>(i - run));
+
+            for (; run != i; ++run)
+            {
+                const int32_t current = pDepth[run];
+                const int32_t delta = current - previous;
+                // zigzag: small negative deltas become small odd numbers
+                writer.WriteValue((static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+                previous = current;
+            }
+        }
+        return writer.Finish();
+    }
+}
+
+size_t RvlMaxEncodedSize(size_t count)
+{
+    // per pixel at most 6 nibbles for a 17 bit zigzag delta, and each run pair
+    // costs at most 2 nibbles per pixel it covers; plus the padded last word
+    return 4 * count + 4;
+}
+
+size_t RvlEncodeDepth(
+    const uint16_t* pDepth,
+    size_t count,
+    uint16_t maxValue,
+    uint8_t* pOutput)
+{
+    return RvlEncode(
+        pDepth,
+        count,
+        [pDepth, maxValue](size_t i) { return pDepth[i] == 0 || pDepth[i] >= maxValue; },
+        pOutput);
+}
+
+size_t RvlEncodeDepthBySigma(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    size_t count,
+    uint8_t* pOutput)
+{
+    return RvlEncode(
+        pDepth,
+        count,
+        [pDepth, pSigma](size_t i) { return pDepth[i] == 0 || (pSigma[i] & 0x80) != 0; },
+        pOutput);
+}
+
+bool RvlDecodeDepth(
+    const uint8_t* pData,
+    size_t size,
+    uint16_t* pDepth,
+    size_t count)
+{
+    NibbleReader reader(pData, size);
+    int32_t previous = 0;
+    size_t remaining = count;
+    while (remaining > 0)
+    {
+        uint32_t zeros;
+        uint32_t valid;
+        if (!reader.ReadValue(zeros) || zeros > remaining)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < zeros; ++i)
+        {
+            *pDepth++ = 0;
+        }
+        remaining -= zeros;
+
+        if (!reader.ReadValue(valid) || valid > remaining || (zeros == 0 && valid == 0))
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < valid; ++i)
+        {
+            uint32_t encoded;
+            if (!reader.ReadValue(encoded))
+            {
+                return false;
+            }
+            previous += static_cast<int32_t>(encoded >> 1) ^ -static_cast<int32_t>(encoded & 1);
+            *pDepth++ = static_cast<uint16_t>(previous);
+        }
+        remaining -= valid;
+    }
+    return true;
+}
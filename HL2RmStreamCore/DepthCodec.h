@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// RVL lossless depth compression (A. D. Wilson, "Fast Lossless Depth Image
+// Compression", 2017). Pixels are taken in runs of invalid (0) and valid values:
+// each run pair is stored as the length of the zero run and the length of the
+// valid run, followed by the zigzag encoded deltas of the valid values, where
+// every delta is relative to the previous valid value in the image. All numbers
+// are written as variable length nibbles, 3 data bits and a continuation bit,
+// least significant group first. Nibbles are packed eight per 32 bit
+// little-endian word, the first nibble in the top bits; the last word is padded
+// with zero nibbles.
+
+// Upper bound of the encoded size of count pixels in bytes.
+size_t RvlMaxEncodedSize(
+	size_t count);
+
+// Encodes count depth values into pOutput, which must hold at least
+// RvlMaxEncodedSize(count) bytes, and returns the encoded size. Values >= maxValue
+// are encoded as invalid (0), the same validation ValidateDepthBigEndian applies.
+size_t RvlEncodeDepth(
+	const uint16_t* pDepth,
+	size_t count,
+	uint16_t maxValue,
+	uint8_t* pOutput);
+
+// Long Throw variant of RvlEncodeDepth: pixels whose sigma has the most
+// significant bit set are encoded as invalid, as in ValidateDepthBySigmaBigEndian.
+size_t RvlEncodeDepthBySigma(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	size_t count,
+	uint8_t* pOutput);
+
+// Decodes exactly count depth values in host byte order. Returns false if the
+// data is truncated or describes a different number of pixels.
+bool RvlDecodeDepth(
+	const uint8_t* pData,
+	size_t size,
+	uint16_t* pDepth,
+	size_t count);
@@ -0,0 +1,1022 @@
+#include "DepthKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(HL2_SIMD_X86)
+#include <immintrin.h>
+#endif
+#if defined(HL2_SIMD_NEON)
+#if defined(_MSC_VER) && defined(_M_ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace
+{
+    void ValidateDepthBigEndianScalar(
+        const uint16_t* pDepth,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pOutput)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint16_t d = (pDepth[i] >= maxValue) ? 0 : pDepth[i];
+            pOutput[2 * i] = static_cast<uint8_t>(d >> 8);
+            pOutput[2 * i + 1] = static_cast<uint8_t>(d);
+        }
+    }
+
+    void ValidateDepthBySigmaBigEndianScalar(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pOutput)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint16_t d = (pSigma[i] & 0x80) ? 0 : pDepth[i];
+            pOutput[2 * i] = static_cast<uint8_t>(d >> 8);
+            pOutput[2 * i + 1] = static_cast<uint8_t>(d);
+        }
+    }
+
+    // pixels with invalid or zero depth get a zero AB value too, so that both
+    // planes share one mask; pDepthOutput may be null when only AB is needed
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBigEndianScalar(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            // d - 1 wraps for d == 0, which folds the zero test into the range test
+            const bool invalid = static_cast<uint16_t>(pDepth[i] - 1) >= maxValue - 1;
+            const uint16_t d = invalid ? 0 : pDepth[i];
+            const uint16_t ab = invalid ? 0 : pAb[i];
+            if (kWriteDepth)
+            {
+                pDepthOutput[2 * i] = static_cast<uint8_t>(d >> 8);
+                pDepthOutput[2 * i + 1] = static_cast<uint8_t>(d);
+            }
+            pAbOutput[2 * i] = static_cast<uint8_t>(ab >> 8);
+            pAbOutput[2 * i + 1] = static_cast<uint8_t>(ab);
+        }
+    }
+
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBySigmaBigEndianScalar(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const bool invalid = (pSigma[i] & 0x80) || pDepth[i] == 0;
+            const uint16_t d = invalid ? 0 : pDepth[i];
+            const uint16_t ab = invalid ? 0 : pAb[i];
+            if (kWriteDepth)
+            {
+                pDepthOutput[2 * i] = static_cast<uint8_t>(d >> 8);
+                pDepthOutput[2 * i + 1] = static_cast<uint8_t>(d);
+            }
+            pAbOutput[2 * i] = static_cast<uint8_t>(ab >> 8);
+            pAbOutput[2 * i + 1] = static_cast<uint8_t>(ab);
+        }
+    }
+
+#if defined(HL2_SIMD_X86)
+    void ValidateDepthBigEndianSse2(
+        const uint16_t* pDepth,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pOutput)
+    {
+        const __m128i max = _mm_set1_epi16(static_cast<short>(maxValue));
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i));
+            // no unsigned 16 bit compare in SSE2: max -sat d == 0 <=> d >= max
+            const __m128i invalid = _mm_cmpeq_epi16(_mm_subs_epu16(max, d), zero);
+            d = _mm_andnot_si128(invalid, d);
+            d = _mm_or_si128(_mm_slli_epi16(d, 8), _mm_srli_epi16(d, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pOutput + 2 * i), d);
+        }
+        ValidateDepthBigEndianScalar(pDepth + i, count - i, maxValue, pOutput + 2 * i);
+    }
+
+    HL2_TARGET_AVX2 void ValidateDepthBigEndianAvx2(
+        const uint16_t* pDepth,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pOutput)
+    {
+        const __m256i max = _mm256_set1_epi16(static_cast<short>(maxValue));
+        const __m256i swap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDepth + i));
+            __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDepth + i + 16));
+            // d >= max <=> min(d, max) == max
+            const __m256i invalid0 = _mm256_cmpeq_epi16(_mm256_min_epu16(d0, max), max);
+            const __m256i invalid1 = _mm256_cmpeq_epi16(_mm256_min_epu16(d1, max), max);
+            d0 = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid0, d0), swap);
+            d1 = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid1, d1), swap);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutput + 2 * i), d0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutput + 2 * i + 32), d1);
+        }
+        ValidateDepthBigEndianSse2(pDepth + i, count - i, maxValue, pOutput + 2 * i);
+    }
+
+    inline __m128i SwapBytes16Sse2(__m128i v)
+    {
+        return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    }
+
+    void ValidateDepthBySigmaBigEndianSse2(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pOutput)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i));
+            const __m128i sigma = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSigma + i));
+            // duplicating each sigma byte puts its top bit into the sign of the lane
+            const __m128i invalid = _mm_srai_epi16(_mm_unpacklo_epi8(sigma, sigma), 15);
+            d = _mm_andnot_si128(invalid, d);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pOutput + 2 * i), SwapBytes16Sse2(d));
+        }
+        ValidateDepthBySigmaBigEndianScalar(pDepth + i, pSigma + i, count - i, pOutput + 2 * i);
+    }
+
+    HL2_TARGET_AVX2 void ValidateDepthBySigmaBigEndianAvx2(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pOutput)
+    {
+        const __m256i swap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDepth + i));
+            const __m128i sigma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSigma + i));
+            // sign extension makes the lanes of invalid pixels negative
+            const __m256i invalid = _mm256_srai_epi16(_mm256_cvtepi8_epi16(sigma), 15);
+            d = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid, d), swap);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pOutput + 2 * i), d);
+        }
+        ValidateDepthBySigmaBigEndianSse2(pDepth + i, pSigma + i, count - i, pOutput + 2 * i);
+    }
+
+
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBigEndianSse2(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        const __m128i one = _mm_set1_epi16(1);
+        const __m128i maxMinusOne = _mm_set1_epi16(static_cast<short>(maxValue - 1));
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i));
+            __m128i ab = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAb + i));
+            // d - 1 >= max - 1 (unsigned) <=> d == 0 || d >= max
+            const __m128i invalid = _mm_cmpeq_epi16(_mm_subs_epu16(maxMinusOne, _mm_sub_epi16(d, one)), zero);
+            if (kWriteDepth)
+            {
+                d = _mm_andnot_si128(invalid, d);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pDepthOutput + 2 * i), SwapBytes16Sse2(d));
+            }
+            ab = _mm_andnot_si128(invalid, ab);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pAbOutput + 2 * i), SwapBytes16Sse2(ab));
+        }
+        ValidateDepthAndAbBigEndianScalar<kWriteDepth>(
+            pDepth + i, pAb + i, count - i, maxValue, pDepthOutput + (kWriteDepth ? 2 * i : 0), pAbOutput + 2 * i);
+    }
+
+    template <bool kWriteDepth>
+    HL2_TARGET_AVX2 void ValidateDepthAndAbBigEndianAvx2(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        const __m256i one = _mm256_set1_epi16(1);
+        const __m256i maxMinusOne = _mm256_set1_epi16(static_cast<short>(maxValue - 1));
+        const __m256i swap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDepth + i));
+            __m256i ab = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pAb + i));
+            const __m256i dMinusOne = _mm256_sub_epi16(d, one);
+            const __m256i invalid = _mm256_cmpeq_epi16(_mm256_min_epu16(dMinusOne, maxMinusOne), maxMinusOne);
+            if (kWriteDepth)
+            {
+                d = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid, d), swap);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDepthOutput + 2 * i), d);
+            }
+            ab = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid, ab), swap);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pAbOutput + 2 * i), ab);
+        }
+        ValidateDepthAndAbBigEndianSse2<kWriteDepth>(
+            pDepth + i, pAb + i, count - i, maxValue, pDepthOutput + (kWriteDepth ? 2 * i : 0), pAbOutput + 2 * i);
+    }
+
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBySigmaBigEndianSse2(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i));
+            __m128i ab = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAb + i));
+            const __m128i sigma = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSigma + i));
+            const __m128i invalid = _mm_or_si128(
+                _mm_srai_epi16(_mm_unpacklo_epi8(sigma, sigma), 15),
+                _mm_cmpeq_epi16(d, zero));
+            if (kWriteDepth)
+            {
+                d = _mm_andnot_si128(invalid, d);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pDepthOutput + 2 * i), SwapBytes16Sse2(d));
+            }
+            ab = _mm_andnot_si128(invalid, ab);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pAbOutput + 2 * i), SwapBytes16Sse2(ab));
+        }
+        ValidateDepthAndAbBySigmaBigEndianScalar<kWriteDepth>(
+            pDepth + i, pAb + i, pSigma + i, count - i, pDepthOutput + (kWriteDepth ? 2 * i : 0), pAbOutput + 2 * i);
+    }
+
+    template <bool kWriteDepth>
+    HL2_TARGET_AVX2 void ValidateDepthAndAbBySigmaBigEndianAvx2(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i swap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pDepth + i));
+            __m256i ab = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pAb + i));
+            const __m128i sigma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSigma + i));
+            const __m256i invalid = _mm256_or_si256(
+                _mm256_srai_epi16(_mm256_cvtepi8_epi16(sigma), 15),
+                _mm256_cmpeq_epi16(d, zero));
+            if (kWriteDepth)
+            {
+                d = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid, d), swap);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDepthOutput + 2 * i), d);
+            }
+            ab = _mm256_shuffle_epi8(_mm256_andnot_si256(invalid, ab), swap);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pAbOutput + 2 * i), ab);
+        }
+        ValidateDepthAndAbBySigmaBigEndianSse2<kWriteDepth>(
+            pDepth + i, pAb + i, pSigma + i, count - i, pDepthOutput + (kWriteDepth ? 2 * i : 0), pAbOutput + 2 * i);
+    }
+#endif
+
+#if defined(HL2_SIMD_NEON)
+    void ValidateDepthBySigmaBigEndianNeon(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pOutput)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint16x8_t d = vld1q_u16(pDepth + i);
+            // sign extension makes the lanes of invalid pixels negative
+            const int16x8_t sigma = vmovl_s8(vreinterpret_s8_u8(vld1_u8(pSigma + i)));
+            d = vbicq_u16(d, vreinterpretq_u16_s16(vshrq_n_s16(sigma, 15)));
+            vst1q_u8(pOutput + 2 * i, vrev16q_u8(vreinterpretq_u8_u16(d)));
+        }
+        ValidateDepthBySigmaBigEndianScalar(pDepth + i, pSigma + i, count - i, pOutput + 2 * i);
+    }
+
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBigEndianNeon(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        const uint16x8_t one = vdupq_n_u16(1);
+        const uint16x8_t maxMinusOne = vdupq_n_u16(static_cast<uint16_t>(maxValue - 1));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint16x8_t d = vld1q_u16(pDepth + i);
+            uint16x8_t ab = vld1q_u16(pAb + i);
+            // d - 1 >= max - 1 (unsigned) <=> d == 0 || d >= max
+            const uint16x8_t invalid = vcgeq_u16(vsubq_u16(d, one), maxMinusOne);
+            if (kWriteDepth)
+            {
+                d = vbicq_u16(d, invalid);
+                vst1q_u8(pDepthOutput + 2 * i, vrev16q_u8(vreinterpretq_u8_u16(d)));
+            }
+            ab = vbicq_u16(ab, invalid);
+            vst1q_u8(pAbOutput + 2 * i, vrev16q_u8(vreinterpretq_u8_u16(ab)));
+        }
+        ValidateDepthAndAbBigEndianScalar<kWriteDepth>(
+            pDepth + i, pAb + i, count - i, maxValue, pDepthOutput + (kWriteDepth ? 2 * i : 0), pAbOutput + 2 * i);
+    }
+
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBySigmaBigEndianNeon(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint16x8_t d = vld1q_u16(pDepth + i);
+            uint16x8_t ab = vld1q_u16(pAb + i);
+            const int16x8_t sigma = vmovl_s8(vreinterpret_s8_u8(vld1_u8(pSigma + i)));
+            const uint16x8_t invalid = vorrq_u16(
+                vreinterpretq_u16_s16(vshrq_n_s16(sigma, 15)),
+                vceqq_u16(d, vdupq_n_u16(0)));
+            if (kWriteDepth)
+            {
+                d = vbicq_u16(d, invalid);
+                vst1q_u8(pDepthOutput + 2 * i, vrev16q_u8(vreinterpretq_u8_u16(d)));
+            }
+            ab = vbicq_u16(ab, invalid);
+            vst1q_u8(pAbOutput + 2 * i, vrev16q_u8(vreinterpretq_u8_u16(ab)));
+        }
+        ValidateDepthAndAbBySigmaBigEndianScalar<kWriteDepth>(
+            pDepth + i, pAb + i, pSigma + i, count - i, pDepthOutput + (kWriteDepth ? 2 * i : 0), pAbOutput + 2 * i);
+    }
+
+    void ValidateDepthBigEndianNeon(
+        const uint16_t* pDepth,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pOutput)
+    {
+        const uint16x8_t max = vdupq_n_u16(maxValue);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            uint16x8_t d0 = vld1q_u16(pDepth + i);
+            uint16x8_t d1 = vld1q_u16(pDepth + i + 8);
+            d0 = vbicq_u16(d0, vcgeq_u16(d0, max));
+            d1 = vbicq_u16(d1, vcgeq_u16(d1, max));
+            vst1q_u8(pOutput + 2 * i, vrev16q_u8(vreinterpretq_u8_u16(d0)));
+            vst1q_u8(pOutput + 2 * i + 16, vrev16q_u8(vreinterpretq_u8_u16(d1)));
+        }
+        ValidateDepthBigEndianScalar(pDepth + i, count - i, maxValue, pOutput + 2 * i);
+    }
+#endif
+}
+
+void ValidateDepthBigEndian(
+    const uint16_t* pDepth,
+    size_t count,
+    uint16_t maxValue,
+    uint8_t* pOutput)
+{
+    ValidateDepthBigEndian(pDepth, count, maxValue, pOutput, DetectSimdLevel());
+}
+
+void ValidateDepthBigEndian(
+    const uint16_t* pDepth,
+    size_t count,
+    uint16_t maxValue,
+    uint8_t* pOutput,
+    SimdLevel level)
+{
+    switch (level)
+    {
+#if defined(HL2_SIMD_X86)
+    case SimdLevel::Avx2:
+        ValidateDepthBigEndianAvx2(pDepth, count, maxValue, pOutput);
+        return;
+    case SimdLevel::Ssse3:
+    case SimdLevel::Sse2:
+        ValidateDepthBigEndianSse2(pDepth, count, maxValue, pOutput);
+        return;
+#endif
+#if defined(HL2_SIMD_NEON)
+    case SimdLevel::Neon:
+        ValidateDepthBigEndianNeon(pDepth, count, maxValue, pOutput);
+        return;
+#endif
+    default:
+        ValidateDepthBigEndianScalar(pDepth, count, maxValue, pOutput);
+        return;
+    }
+}
+
+void ValidateDepthBySigmaBigEndian(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    size_t count,
+    uint8_t* pOutput)
+{
+    ValidateDepthBySigmaBigEndian(pDepth, pSigma, count, pOutput, DetectSimdLevel());
+}
+
+void ValidateDepthBySigmaBigEndian(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    size_t count,
+    uint8_t* pOutput,
+    SimdLevel level)
+{
+    switch (level)
+    {
+#if defined(HL2_SIMD_X86)
+    case SimdLevel::Avx2:
+        ValidateDepthBySigmaBigEndianAvx2(pDepth, pSigma, count, pOutput);
+        return;
+    case SimdLevel::Ssse3:
+    case SimdLevel::Sse2:
+        ValidateDepthBySigmaBigEndianSse2(pDepth, pSigma, count, pOutput);
+        return;
+#endif
+#if defined(HL2_SIMD_NEON)
+    case SimdLevel::Neon:
+        ValidateDepthBySigmaBigEndianNeon(pDepth, pSigma, count, pOutput);
+        return;
+#endif
+    default:
+        ValidateDepthBySigmaBigEndianScalar(pDepth, pSigma, count, pOutput);
+        return;
+    }
+}
+
+namespace
+{
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBigEndianAt(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        size_t count,
+        uint16_t maxValue,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput,
+        SimdLevel level)
+    {
+        switch (level)
+        {
+#if defined(HL2_SIMD_X86)
+        case SimdLevel::Avx2:
+            ValidateDepthAndAbBigEndianAvx2<kWriteDepth>(pDepth, pAb, count, maxValue, pDepthOutput, pAbOutput);
+            return;
+        case SimdLevel::Ssse3:
+        case SimdLevel::Sse2:
+            ValidateDepthAndAbBigEndianSse2<kWriteDepth>(pDepth, pAb, count, maxValue, pDepthOutput, pAbOutput);
+            return;
+#endif
+#if defined(HL2_SIMD_NEON)
+        case SimdLevel::Neon:
+            ValidateDepthAndAbBigEndianNeon<kWriteDepth>(pDepth, pAb, count, maxValue, pDepthOutput, pAbOutput);
+            return;
+#endif
+        default:
+            ValidateDepthAndAbBigEndianScalar<kWriteDepth>(pDepth, pAb, count, maxValue, pDepthOutput, pAbOutput);
+            return;
+        }
+    }
+
+    template <bool kWriteDepth>
+    void ValidateDepthAndAbBySigmaBigEndianAt(
+        const uint16_t* pDepth,
+        const uint16_t* pAb,
+        const uint8_t* pSigma,
+        size_t count,
+        uint8_t* pDepthOutput,
+        uint8_t* pAbOutput,
+        SimdLevel level)
+    {
+        switch (level)
+        {
+#if defined(HL2_SIMD_X86)
+        case SimdLevel::Avx2:
+            ValidateDepthAndAbBySigmaBigEndianAvx2<kWriteDepth>(pDepth, pAb, pSigma, count, pDepthOutput, pAbOutput);
+            return;
+        case SimdLevel::Ssse3:
+        case SimdLevel::Sse2:
+            ValidateDepthAndAbBySigmaBigEndianSse2<kWriteDepth>(pDepth, pAb, pSigma, count, pDepthOutput, pAbOutput);
+            return;
+#endif
+#if defined(HL2_SIMD_NEON)
+        case SimdLevel::Neon:
+            ValidateDepthAndAbBySigmaBigEndianNeon<kWriteDepth>(pDepth, pAb, pSigma, count, pDepthOutput, pAbOutput);
+            return;
+#endif
+        default:
+            ValidateDepthAndAbBySigmaBigEndianScalar<kWriteDepth>(pDepth, pAb, pSigma, count, pDepthOutput, pAbOutput);
+            return;
+        }
+    }
+}
+
+void ValidateDepthAndAbBigEndian(
+    const uint16_t* pDepth,
+    const uint16_t* pAb,
+    size_t count,
+    uint16_t maxValue,
+    uint8_t* pDepthOutput,
+    uint8_t* pAbOutput)
+{
+    ValidateDepthAndAbBigEndian(pDepth, pAb, count, maxValue, pDepthOutput, pAbOutput, DetectSimdLevel());
+}
+
+void ValidateDepthAndAbBigEndian(
+    const uint16_t* pDepth,
+    const uint16_t* pAb,
+    size_t count,
+    uint16_t maxValue,
+    uint8_t* pDepthOutput,
+    uint8_t* pAbOutput,
+    SimdLevel level)
+{
+    if (pDepthOutput)
+    {
+        ValidateDepthAndAbBigEndianAt<true>(pDepth, pAb, count, maxValue, pDepthOutput, pAbOutput, level);
+    }
+    else
+    {
+        ValidateDepthAndAbBigEndianAt<false>(pDepth, pAb, count, maxValue, nullptr, pAbOutput, level);
+    }
+}
+
+void ValidateDepthAndAbBySigmaBigEndian(
+    const uint16_t* pDepth,
+    const uint16_t* pAb,
+    const uint8_t* pSigma,
+    size_t count,
+    uint8_t* pDepthOutput,
+    uint8_t* pAbOutput)
+{
+    ValidateDepthAndAbBySigmaBigEndian(pDepth, pAb, pSigma, count, pDepthOutput, pAbOutput, DetectSimdLevel());
+}
+
+void ValidateDepthAndAbBySigmaBigEndian(
+    const uint16_t* pDepth,
+    const uint16_t* pAb,
+    const uint8_t* pSigma,
+    size_t count,
+    uint8_t* pDepthOutput,
+    uint8_t* pAbOutput,
+    SimdLevel level)
+{
+    if (pDepthOutput)
+    {
+        ValidateDepthAndAbBySigmaBigEndianAt<true>(pDepth, pAb, pSigma, count, pDepthOutput, pAbOutput, level);
+    }
+    else
+    {
+        ValidateDepthAndAbBySigmaBigEndianAt<false>(pDepth, pAb, pSigma, count, nullptr, pAbOutput, level);
+    }
+}
+
+namespace
+{
+    // the point kernels round with vcvtnq, which only AArch64 has
+#if defined(HL2_SIMD_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define HL2_POINTS_NEON 1
+#endif
+
+    const float kMaxPointMm = 32767.0f;
+
+    // bit pattern of the nearest float16; below the smallest normal float16 the
+    // result is a signed zero, and there is no overflow handling since depth
+    // never gets near 65504 m
+    inline uint32_t FloatToHalfBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const uint32_t magnitude = bits & 0x7FFFFFFF;
+        if (magnitude < 0x38800000)
+        {
+            return sign;
+        }
+        // round to nearest even at the 13 mantissa bits that are cut off, then
+        // rebias the exponent from 127 to 15
+        const uint32_t rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+        return sign | ((rounded >> 13) - (112 << 10));
+    }
+
+    template <bool kHalf>
+    inline int32_t ConvertCoordinate(float value)
+    {
+        if (kHalf)
+        {
+            return static_cast<int32_t>(FloatToHalfBits(value));
+        }
+        // lrint rounds to nearest even, like the SIMD conversions
+        return static_cast<int32_t>(std::lrint(std::min(std::max(value, -kMaxPointMm), kMaxPointMm)));
+    }
+
+    inline unsigned int LowestSetBit(unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+
+    // compacts the lanes of a block whose bits are set in mask
+    template <typename TValue>
+    inline size_t WriteValidPoints(
+        unsigned int mask,
+        const int32_t* pX,
+        const int32_t* pY,
+        const int32_t* pZ,
+        TValue* pOutput)
+    {
+        size_t points = 0;
+        while (mask)
+        {
+            const unsigned int lane = LowestSetBit(mask);
+            mask &= mask - 1;
+            pOutput[3 * points] = static_cast<TValue>(pX[lane]);
+            pOutput[3 * points + 1] = static_cast<TValue>(pY[lane]);
+            pOutput[3 * points + 2] = static_cast<TValue>(pZ[lane]);
+            points++;
+        }
+        return points;
+    }
+
+    template <bool kHalf, typename TValue>
+    size_t DepthToPointsScalar(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const float* pRayX,
+        const float* pRayY,
+        const float* pRayZ,
+        size_t count,
+        uint16_t maxValue,
+        TValue* pOutput)
+    {
+        const float scale = kHalf ? 0.001f : 1.0f;
+        size_t points = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint16_t d = pDepth[i];
+            if (d == 0 || d >= maxValue || pRayZ[i] == 0.0f || (pSigma && (pSigma[i] & 0x80)))
+            {
+                continue;
+            }
+            const float depth = static_cast<float>(d) * scale;
+            pOutput[3 * points] = static_cast<TValue>(ConvertCoordinate<kHalf>(pRayX[i] * depth));
+            pOutput[3 * points + 1] = static_cast<TValue>(ConvertCoordinate<kHalf>(pRayY[i] * depth));
+            pOutput[3 * points + 2] = static_cast<TValue>(ConvertCoordinate<kHalf>(pRayZ[i] * depth));
+            points++;
+        }
+        return points;
+    }
+
+#if defined(HL2_SIMD_X86)
+    template <bool kHalf>
+    inline __m128i ConvertCoordinatesSse2(__m128 value)
+    {
+        if (!kHalf)
+        {
+            const __m128 max = _mm_set1_ps(kMaxPointMm);
+            return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(value, _mm_sub_ps(_mm_setzero_ps(), max)), max));
+        }
+        const __m128i bits = _mm_castps_si128(value);
+        const __m128i sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+        const __m128i magnitude = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+        const __m128i rounded = _mm_add_epi32(_mm_add_epi32(magnitude, _mm_set1_epi32(0xFFF)),
+            _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1)));
+        __m128i half = _mm_sub_epi32(_mm_srli_epi32(rounded, 13), _mm_set1_epi32(112 << 10));
+        half = _mm_andnot_si128(_mm_cmplt_epi32(magnitude, _mm_set1_epi32(0x38800000)), half);
+        return _mm_or_si128(half, sign);
+    }
+
+    template <bool kHalf, typename TValue>
+    size_t DepthToPointsSse2(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const float* pRayX,
+        const float* pRayY,
+        const float* pRayZ,
+        size_t count,
+        uint16_t maxValue,
+        TValue* pOutput)
+    {
+        const __m128 scale = _mm_set1_ps(kHalf ? 0.001f : 1.0f);
+        const __m128i max = _mm_set1_epi32(maxValue);
+        const __m128i zero = _mm_setzero_si128();
+        alignas(16) int32_t x[4];
+        alignas(16) int32_t y[4];
+        alignas(16) int32_t z[4];
+        size_t points = 0;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i d = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pDepth + i)), zero);
+            __m128i valid = _mm_and_si128(_mm_cmpgt_epi32(d, zero), _mm_cmplt_epi32(d, max));
+            if (pSigma)
+            {
+                int32_t sigma;
+                memcpy(&sigma, pSigma + i, sizeof(sigma));
+                // spreading each sigma byte over its lane puts its top bit into the sign
+                __m128i invalid = _mm_cvtsi32_si128(sigma);
+                invalid = _mm_unpacklo_epi8(invalid, invalid);
+                invalid = _mm_srai_epi32(_mm_unpacklo_epi16(invalid, invalid), 31);
+                valid = _mm_andnot_si128(invalid, valid);
+            }
+            const __m128 rayZ = _mm_loadu_ps(pRayZ + i);
+            valid = _mm_and_si128(valid, _mm_castps_si128(_mm_cmpneq_ps(rayZ, _mm_setzero_ps())));
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_castsi128_ps(valid)));
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            const __m128 depth = _mm_mul_ps(_mm_cvtepi32_ps(d), scale);
+            _mm_store_si128(reinterpret_cast<__m128i*>(x), ConvertCoordinatesSse2<kHalf>(_mm_mul_ps(_mm_loadu_ps(pRayX + i), depth)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(y), ConvertCoordinatesSse2<kHalf>(_mm_mul_ps(_mm_loadu_ps(pRayY + i), depth)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(z), ConvertCoordinatesSse2<kHalf>(_mm_mul_ps(rayZ, depth)));
+            points += WriteValidPoints(mask, x, y, z, pOutput + 3 * points);
+        }
+        return points + DepthToPointsScalar<kHalf>(pDepth + i, pSigma ? pSigma + i : nullptr,
+            pRayX + i, pRayY + i, pRayZ + i, count - i, maxValue, pOutput + 3 * points);
+    }
+
+    template <bool kHalf>
+    HL2_TARGET_AVX2 inline __m256i ConvertCoordinatesAvx2(__m256 value)
+    {
+        if (!kHalf)
+        {
+            const __m256 max = _mm256_set1_ps(kMaxPointMm);
+            return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(value, _mm256_sub_ps(_mm256_setzero_ps(), max)), max));
+        }
+        const __m256i bits = _mm256_castps_si256(value);
+        const __m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+        const __m256i magnitude = _mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF));
+        const __m256i rounded = _mm256_add_epi32(_mm256_add_epi32(magnitude, _mm256_set1_epi32(0xFFF)),
+            _mm256_and_si256(_mm256_srli_epi32(magnitude, 13), _mm256_set1_epi32(1)));
+        __m256i half = _mm256_sub_epi32(_mm256_srli_epi32(rounded, 13), _mm256_set1_epi32(112 << 10));
+        half = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(0x38800000), magnitude), half);
+        return _mm256_or_si256(half, sign);
+    }
+
+    template <bool kHalf, typename TValue>
+    HL2_TARGET_AVX2 size_t DepthToPointsAvx2(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const float* pRayX,
+        const float* pRayY,
+        const float* pRayZ,
+        size_t count,
+        uint16_t maxValue,
+        TValue* pOutput)
+    {
+        const __m256 scale = _mm256_set1_ps(kHalf ? 0.001f : 1.0f);
+        const __m256i max = _mm256_set1_epi32(maxValue);
+        const __m256i zero = _mm256_setzero_si256();
+        alignas(32) int32_t x[8];
+        alignas(32) int32_t y[8];
+        alignas(32) int32_t z[8];
+        size_t points = 0;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i)));
+            __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(d, zero), _mm256_cmpgt_epi32(max, d));
+            if (pSigma)
+            {
+                // sign extension makes the lanes of invalid pixels negative
+                const __m256i sigma = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pSigma + i)));
+                valid = _mm256_andnot_si256(_mm256_srai_epi32(sigma, 31), valid);
+            }
+            const __m256 rayZ = _mm256_loadu_ps(pRayZ + i);
+            valid = _mm256_and_si256(valid, _mm256_castps_si256(_mm256_cmp_ps(rayZ, _mm256_setzero_ps(), _CMP_NEQ_OQ)));
+            const unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(valid)));
+            if (mask == 0)
+            {
+                // sparse scenes skip most blocks here
+                continue;
+            }
+
+            const __m256 depth = _mm256_mul_ps(_mm256_cvtepi32_ps(d), scale);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(x), ConvertCoordinatesAvx2<kHalf>(_mm256_mul_ps(_mm256_loadu_ps(pRayX + i), depth)));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(y), ConvertCoordinatesAvx2<kHalf>(_mm256_mul_ps(_mm256_loadu_ps(pRayY + i), depth)));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(z), ConvertCoordinatesAvx2<kHalf>(_mm256_mul_ps(rayZ, depth)));
+            points += WriteValidPoints(mask, x, y, z, pOutput + 3 * points);
+        }
+        return points + DepthToPointsSse2<kHalf>(pDepth + i, pSigma ? pSigma + i : nullptr,
+            pRayX + i, pRayY + i, pRayZ + i, count - i, maxValue, pOutput + 3 * points);
+    }
+#endif
+
+#if defined(HL2_POINTS_NEON)
+    template <bool kHalf>
+    inline int32x4_t ConvertCoordinatesNeon(float32x4_t value)
+    {
+        if (!kHalf)
+        {
+            const float32x4_t max = vdupq_n_f32(kMaxPointMm);
+            return vcvtnq_s32_f32(vminq_f32(vmaxq_f32(value, vnegq_f32(max)), max));
+        }
+        const uint32x4_t bits = vreinterpretq_u32_f32(value);
+        const uint32x4_t sign = vandq_u32(vshrq_n_u32(bits, 16), vdupq_n_u32(0x8000));
+        const uint32x4_t magnitude = vandq_u32(bits, vdupq_n_u32(0x7FFFFFFF));
+        const uint32x4_t rounded = vaddq_u32(vaddq_u32(magnitude, vdupq_n_u32(0xFFF)),
+            vandq_u32(vshrq_n_u32(magnitude, 13), vdupq_n_u32(1)));
+        uint32x4_t half = vsubq_u32(vshrq_n_u32(rounded, 13), vdupq_n_u32(112 << 10));
+        half = vbicq_u32(half, vcltq_u32(magnitude, vdupq_n_u32(0x38800000)));
+        return vreinterpretq_s32_u32(vorrq_u32(half, sign));
+    }
+
+    template <bool kHalf, typename TValue>
+    size_t DepthToPointsNeon(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const float* pRayX,
+        const float* pRayY,
+        const float* pRayZ,
+        size_t count,
+        uint16_t maxValue,
+        TValue* pOutput)
+    {
+        const float32x4_t scale = vdupq_n_f32(kHalf ? 0.001f : 1.0f);
+        const uint32x4_t max = vdupq_n_u32(maxValue);
+        const uint32_t laneBitValues[4] = { 1, 2, 4, 8 };
+        const uint32x4_t laneBits = vld1q_u32(laneBitValues);
+        int32_t x[4];
+        int32_t y[4];
+        int32_t z[4];
+        size_t points = 0;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const uint32x4_t d = vmovl_u16(vld1_u16(pDepth + i));
+            uint32x4_t valid = vandq_u32(vcgtq_u32(d, vdupq_n_u32(0)), vcltq_u32(d, max));
+            if (pSigma)
+            {
+                uint32_t sigma;
+                memcpy(&sigma, pSigma + i, sizeof(sigma));
+                const int16x8_t sigma16 = vmovl_s8(vreinterpret_s8_u32(vdup_n_u32(sigma)));
+                const int32x4_t sigma32 = vmovl_s16(vget_low_s16(sigma16));
+                valid = vbicq_u32(valid, vreinterpretq_u32_s32(vshrq_n_s32(sigma32, 31)));
+            }
+            const float32x4_t rayZ = vld1q_f32(pRayZ + i);
+            valid = vbicq_u32(valid, vceqq_f32(rayZ, vdupq_n_f32(0.0f)));
+            const unsigned int mask = vaddvq_u32(vandq_u32(valid, laneBits));
+            if (mask == 0)
+            {
+                continue;
+            }
+
+            const float32x4_t depth = vmulq_f32(vcvtq_f32_u32(d), scale);
+            vst1q_s32(x, ConvertCoordinatesNeon<kHalf>(vmulq_f32(vld1q_f32(pRayX + i), depth)));
+            vst1q_s32(y, ConvertCoordinatesNeon<kHalf>(vmulq_f32(vld1q_f32(pRayY + i), depth)));
+            vst1q_s32(z, ConvertCoordinatesNeon<kHalf>(vmulq_f32(rayZ, depth)));
+            points += WriteValidPoints(mask, x, y, z, pOutput + 3 * points);
+        }
+        return points + DepthToPointsScalar<kHalf>(pDepth + i, pSigma ? pSigma + i : nullptr,
+            pRayX + i, pRayY + i, pRayZ + i, count - i, maxValue, pOutput + 3 * points);
+    }
+#endif
+
+    template <bool kHalf, typename TValue>
+    size_t DepthToPointsAt(
+        const uint16_t* pDepth,
+        const uint8_t* pSigma,
+        const float* pRayX,
+        const float* pRayY,
+        const float* pRayZ,
+        size_t count,
+        uint16_t maxValue,
+        TValue* pOutput,
+        SimdLevel level)
+    {
+        switch (level)
+        {
+#if defined(HL2_SIMD_X86)
+        case SimdLevel::Avx2:
+            return DepthToPointsAvx2<kHalf>(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput);
+        case SimdLevel::Ssse3:
+        case SimdLevel::Sse2:
+            return DepthToPointsSse2<kHalf>(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput);
+#endif
+#if defined(HL2_POINTS_NEON)
+        case SimdLevel::Neon:
+            return DepthToPointsNeon<kHalf>(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput);
+#endif
+        default:
+            return DepthToPointsScalar<kHalf>(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput);
+        }
+    }
+}
+
+size_t DepthToPointsMm16(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    const float* pRayX,
+    const float* pRayY,
+    const float* pRayZ,
+    size_t count,
+    uint16_t maxValue,
+    int16_t* pOutput)
+{
+    return DepthToPointsMm16(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput, DetectSimdLevel());
+}
+
+size_t DepthToPointsMm16(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    const float* pRayX,
+    const float* pRayY,
+    const float* pRayZ,
+    size_t count,
+    uint16_t maxValue,
+    int16_t* pOutput,
+    SimdLevel level)
+{
+    return DepthToPointsAt<false>(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput, level);
+}
+
+size_t DepthToPointsHalf(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    const float* pRayX,
+    const float* pRayY,
+    const float* pRayZ,
+    size_t count,
+    uint16_t maxValue,
+    uint16_t* pOutput)
+{
+    return DepthToPointsHalf(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput, DetectSimdLevel());
+}
+
+size_t DepthToPointsHalf(
+    const uint16_t* pDepth,
+    const uint8_t* pSigma,
+    const float* pRayX,
+    const float* pRayY,
+    const float* pRayZ,
+    size_t count,
+    uint16_t maxValue,
+    uint16_t* pOutput,
+    SimdLevel level)
+{
+    return DepthToPointsAt<true>(pDepth, pSigma, pRayX, pRayY, pRayZ, count, maxValue, pOutput, level);
+}
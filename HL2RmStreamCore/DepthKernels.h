@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SimdSupport.h"
+
+// Writes count depth values to pOutput (2 * count bytes) in big-endian byte order,
+// replacing every value >= maxValue with 0 (invalid). Uses the best instruction
+// set of the CPU; pDepth and pOutput need no particular alignment.
+void ValidateDepthBigEndian(
+	const uint16_t* pDepth,
+	size_t count,
+	uint16_t maxValue,
+	uint8_t* pOutput);
+
+// Same, with an explicit instruction set. level must be supported by the CPU.
+void ValidateDepthBigEndian(
+	const uint16_t* pDepth,
+	size_t count,
+	uint16_t maxValue,
+	uint8_t* pOutput,
+	SimdLevel level);
+
+// Long Throw variant: writes count depth values to pOutput in big-endian byte
+// order, replacing every value whose sigma has the most significant bit set with 0
+// (invalid). There is no range threshold.
+void ValidateDepthBySigmaBigEndian(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	size_t count,
+	uint8_t* pOutput);
+
+void ValidateDepthBySigmaBigEndian(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	size_t count,
+	uint8_t* pOutput,
+	SimdLevel level);
+
+// Validates depth and the matching active brightness (AB) image in one pass: both
+// are written in big-endian byte order and every pixel whose depth is 0 or
+// >= maxValue (maxValue > 0) is 0 in both planes. pDepthOutput may be null to
+// write only the masked AB image, e.g. when the depth is compressed instead.
+void ValidateDepthAndAbBigEndian(
+	const uint16_t* pDepth,
+	const uint16_t* pAb,
+	size_t count,
+	uint16_t maxValue,
+	uint8_t* pDepthOutput,
+	uint8_t* pAbOutput);
+
+void ValidateDepthAndAbBigEndian(
+	const uint16_t* pDepth,
+	const uint16_t* pAb,
+	size_t count,
+	uint16_t maxValue,
+	uint8_t* pDepthOutput,
+	uint8_t* pAbOutput,
+	SimdLevel level);
+
+// Long Throw variant: the mask is the sigma flag of ValidateDepthBySigmaBigEndian
+// plus zero depth.
+void ValidateDepthAndAbBySigmaBigEndian(
+	const uint16_t* pDepth,
+	const uint16_t* pAb,
+	const uint8_t* pSigma,
+	size_t count,
+	uint8_t* pDepthOutput,
+	uint8_t* pAbOutput);
+
+void ValidateDepthAndAbBySigmaBigEndian(
+	const uint16_t* pDepth,
+	const uint16_t* pAb,
+	const uint8_t* pSigma,
+	size_t count,
+	uint8_t* pDepthOutput,
+	uint8_t* pAbOutput,
+	SimdLevel level);
+
+// Turns the valid pixels of count depth values (millimetres along the ray) into
+// points: pRayX, pRayY and pRayZ hold the unit ray of every pixel in the camera
+// space of the sensor, all zero where the camera has none. A pixel is valid if its
+// depth is neither 0 nor >= maxValue, it has a ray and, if pSigma is not null, its
+// sigma does not have the most significant bit set. Writes x, y and z of every
+// valid pixel in pixel order to pOutput, rounded to whole millimetres and clamped
+// to the int16 range, and returns the number of points. pOutput must hold 3 * count
+// values.
+size_t DepthToPointsMm16(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	const float* pRayX,
+	const float* pRayY,
+	const float* pRayZ,
+	size_t count,
+	uint16_t maxValue,
+	int16_t* pOutput);
+
+size_t DepthToPointsMm16(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	const float* pRayX,
+	const float* pRayY,
+	const float* pRayZ,
+	size_t count,
+	uint16_t maxValue,
+	int16_t* pOutput,
+	SimdLevel level);
+
+// Same, with the coordinates as IEEE float16 metres (bit patterns). Coordinates
+// closer to 0 than 2^-14 m may come out as 0.
+size_t DepthToPointsHalf(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	const float* pRayX,
+	const float* pRayY,
+	const float* pRayZ,
+	size_t count,
+	uint16_t maxValue,
+	uint16_t* pOutput);
+
+size_t DepthToPointsHalf(
+	const uint16_t* pDepth,
+	const uint8_t* pSigma,
+	const float* pRayX,
+	const float* pRayY,
+	const float* pRayZ,
+	size_t count,
+	uint16_t maxValue,
+	uint16_t* pOutput,
+	SimdLevel level);
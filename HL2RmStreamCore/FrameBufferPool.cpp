@@ -0,0 +1,70 @@
+#include "FrameBufferPool.h"
+
+FrameBufferPool::FrameBufferPool(
+    uint32_t maxBuffers) :
+    m_state(std::make_shared<State>())
+{
+    m_state->MaxBuffers = maxBuffers;
+    m_state->FreeBuffers.reserve(maxBuffers);
+}
+
+FrameBufferPtr FrameBufferPool::Acquire(
+    size_t capacity)
+{
+    std::unique_ptr<std::vector<uint8_t>> buffer;
+    {
+        std::lock_guard<std::mutex> guard(m_state->Mutex);
+        if (!m_state->FreeBuffers.empty())
+        {
+            buffer = std::move(m_state->FreeBuffers.back());
+            m_state->FreeBuffers.pop_back();
+        }
+        else if (m_state->Buffers < m_state->MaxBuffers)
+        {
+            buffer = std::make_unique<std::vector<uint8_t>>();
+            m_state->Buffers++;
+        }
+        else
+        {
+            m_state->Exhausted.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        m_state->InUse++;
+    }
+
+    m_state->Acquired.fetch_add(1, std::memory_order_relaxed);
+
+    // the holder may grow the buffer as well, so growth is counted on release
+    std::shared_ptr<State> state = m_state;
+    const size_t initialCapacity = buffer->capacity();
+    buffer->reserve(capacity);
+    return FrameBufferPtr(buffer.release(), [state, initialCapacity](std::vector<uint8_t>* pBuffer)
+    {
+        if (pBuffer->capacity() > initialCapacity)
+        {
+            state->Allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        state->Release(pBuffer);
+    });
+}
+
+FrameBufferPoolStatistics FrameBufferPool::Statistics() const
+{
+    FrameBufferPoolStatistics statistics;
+    statistics.Allocations = m_state->Allocations.load(std::memory_order_relaxed);
+    statistics.Acquired = m_state->Acquired.load(std::memory_order_relaxed);
+    statistics.Exhausted = m_state->Exhausted.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(m_state->Mutex);
+    statistics.InUse = m_state->InUse;
+    statistics.Buffers = m_state->Buffers;
+    return statistics;
+}
+
+void FrameBufferPool::State::Release(std::vector<uint8_t>* pBuffer)
+{
+    std::lock_guard<std::mutex> guard(Mutex);
+    // never reallocates, capacity is reserved for MaxBuffers
+    FreeBuffers.emplace_back(pBuffer);
+    InUse--;
+}
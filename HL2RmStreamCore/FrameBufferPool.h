@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A pooled payload buffer. It returns to its pool when the last reference is
+// dropped, e.g. once the write that sends it has completed.
+typedef std::shared_ptr<std::vector<uint8_t>> FrameBufferPtr;
+
+struct FrameBufferPoolStatistics
+{
+	// heap allocations of buffer memory, i.e. every time a buffer had to grow
+	uint64_t Allocations = 0;
+	// successful Acquire calls
+	uint64_t Acquired = 0;
+	// Acquire calls that failed because every buffer was in use
+	uint64_t Exhausted = 0;
+	// buffers currently handed out
+	uint32_t InUse = 0;
+	// buffers created so far, at most the pool size
+	uint32_t Buffers = 0;
+};
+
+// Fixed-size pool of payload buffers for one stream. Buffers keep their memory
+// when they come back, so in steady state Acquire allocates nothing and the
+// buffers only grow when the resolution of the stream does; Allocations in the
+// statistics stays constant then. Thread-safe; buffers may outlive the pool.
+class FrameBufferPool
+{
+public:
+	explicit FrameBufferPool(
+		uint32_t maxBuffers = 4);
+
+	FrameBufferPool(const FrameBufferPool&) = delete;
+	FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+	// Returns a buffer with room for at least capacity bytes, or nullptr when all
+	// buffers are in use. Size and contents are what the previous holder left, so
+	// an encoder resizing it to the size of the last frame costs nothing.
+	FrameBufferPtr Acquire(
+		size_t capacity = 0);
+
+	FrameBufferPoolStatistics Statistics() const;
+
+private:
+	struct State
+	{
+		std::mutex Mutex;
+		std::vector<std::unique_ptr<std::vector<uint8_t>>> FreeBuffers;
+		uint32_t MaxBuffers = 0;
+		uint32_t Buffers = 0;
+		uint32_t InUse = 0;
+
+		std::atomic<uint64_t> Allocations{ 0 };
+		std::atomic<uint64_t> Acquired{ 0 };
+		std::atomic<uint64_t> Exhausted{ 0 };
+
+		void Release(std::vector<uint8_t>* pBuffer);
+	};
+
+	std::shared_ptr<State> m_state;
+};
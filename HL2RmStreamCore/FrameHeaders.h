@@ -0,0 +1,497 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Row-major 4x4 matrix with the same memory layout as
+// winrt::Windows::Foundation::Numerics::float4x4 (m11 ... m44).
+struct Float4x4
+{
+	float m11, m12, m13, m14;
+	float m21, m22, m23, m24;
+	float m31, m32, m33, m34;
+	float m41, m42, m43, m44;
+
+	static Float4x4 Identity()
+	{
+		return { 1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f };
+	}
+
+	// from any matrix type with m11 ... m44 members, e.g. float4x4
+	template <typename TMatrix>
+	static Float4x4 From(const TMatrix& m)
+	{
+		return { m.m11, m.m12, m.m13, m.m14,
+			m.m21, m.m22, m.m23, m.m24,
+			m.m31, m.m32, m.m33, m.m34,
+			m.m41, m.m42, m.m43, m.m44 };
+	}
+};
+
+static_assert(sizeof(Float4x4) == 16 * sizeof(float), "Float4x4 must be tightly packed");
+
+// Encodings of research mode depth payloads.
+enum class DepthCodec : uint32_t
+{
+	// uncompressed, RowStride bytes per row: 16 bit big-endian depth, or the
+	// 8 bit pixels of the visible light cameras
+	Raw = 0,
+	// RVL compressed depth, see DepthCodec.h
+	Rvl = 1,
+	// depth only: the valid pixels as points in the camera space of the sensor,
+	// x, y and z of each as little-endian int16 millimetres, invalid pixels left out
+	PointsMm16 = 2,
+	// the same with little-endian float16 metres
+	PointsHalf = 3
+};
+
+// every DepthCodec, in the order streamers encode them
+const DepthCodec kDepthCodecs[] = { DepthCodec::Raw, DepthCodec::Rvl, DepthCodec::PointsMm16, DepthCodec::PointsHalf };
+
+// bit of a codec in a mask of codecs
+inline uint32_t CodecBit(DepthCodec codec)
+{
+	return 1u << static_cast<uint32_t>(codec);
+}
+
+// Wire protocol, version 2. Every message on every stream, in both directions,
+// is a MessageHeader, the header of its MessageType and PayloadSize bytes of
+// payload. All fields are little-endian and naturally aligned without any padding,
+// as the size checks below make sure, so clients decode them with '<' struct
+// formats and C++ readers can use them in place (see MessageBody).
+
+// Streams, named after the sensor their messages come from. The research mode
+// sensors use their ResearchModeSensorType.
+enum class StreamId : uint16_t
+{
+	LeftFront = 0,
+	LeftLeft = 1,
+	RightFront = 2,
+	RightRight = 3,
+	DepthAhat = 4,
+	DepthLongThrow = 5,
+	ImuAccel = 6,
+	ImuGyro = 7,
+	ImuMag = 8,
+	PhotoVideo = 0x100,
+	Fused = 0x101
+};
+
+enum class MessageType : uint16_t
+{
+	// a ResearchModeFrameHeader, Codec is a DepthCodec
+	ResearchModeFrame = 1,
+	// a VideoFrameHeader, Codec is a VideoPixelFormat
+	VideoFrame = 2,
+	// an ImuPacketHeader
+	ImuPacket = 3,
+	// a FusedFrameHeader
+	FusedFrame = 4,
+	// a CalibrationHeader
+	Calibration = 5,
+	// Client to device, at any time: send the frames of StreamId in Codec from now
+	// on. No type header. Clients that send none get raw frames, as do requests
+	// for a codec the stream does not support.
+	CodecRequest = 6,
+	// A StreamControlHeader, in both directions and on the connection of any
+	// stream. Client to device: change the stream StreamId names, for every client
+	// of it, from its next frame on. Device to client: the state of that stream,
+	// in reply to every request.
+	StreamControl = 7,
+	// Client to device over UDP: subscribe to the stream of the port, and stay
+	// subscribed, see DatagramSettings. A SubscribeHeader, which clients may leave
+	// out. Only this message subscribes; the device ignores the others of a client
+	// that is not subscribed, and connections ignore it.
+	Subscribe = 8
+};
+
+// Bits of the Flags of a MessageHeader.
+enum class MessageFlags : uint32_t
+{
+	// the headers end with a FrameTraceHeader
+	Trace = 1
+};
+
+struct MessageHeader
+{
+	// "HL2M" read as a little-endian uint32
+	static const uint32_t kMagic = 0x4D324C48;
+	static const uint16_t kVersion = 2;
+
+	// kMagic
+	uint32_t Magic;
+	// kVersion; it only changes when a layout changes incompatibly
+	uint16_t Version;
+	// Bytes from the start of this header to the payload. Fields are only ever
+	// appended to type headers, ahead of a FrameTraceHeader, so readers use the
+	// ones they know and skip the rest.
+	uint16_t HeaderSize;
+	// a StreamId
+	uint16_t StreamId;
+	// a MessageType; readers skip messages of types they do not know
+	uint16_t MessageType;
+	// what the payload is encoded with, as the MessageType says
+	uint32_t Codec;
+	// number of bytes following the headers
+	uint32_t PayloadSize;
+	// MessageFlags; readers ignore the ones they do not know
+	uint32_t Flags;
+
+	bool IsValid() const
+	{
+		return Magic == kMagic && Version == kVersion && HeaderSize >= sizeof(MessageHeader);
+	}
+
+	// the whole message, headers and payload
+	size_t Size() const { return static_cast<size_t>(HeaderSize) + PayloadSize; }
+};
+
+static_assert(sizeof(MessageHeader) == 24, "Unexpected message header size");
+
+inline MessageHeader MakeMessageHeader(
+	StreamId streamId,
+	MessageType messageType,
+	uint32_t codec = 0,
+	size_t typeHeaderSize = 0,
+	size_t payloadSize = 0)
+{
+	MessageHeader header{};
+	header.Magic = MessageHeader::kMagic;
+	header.Version = MessageHeader::kVersion;
+	header.HeaderSize = static_cast<uint16_t>(sizeof(MessageHeader) + typeHeaderSize);
+	header.StreamId = static_cast<uint16_t>(streamId);
+	header.MessageType = static_cast<uint16_t>(messageType);
+	header.Codec = codec;
+	header.PayloadSize = static_cast<uint32_t>(payloadSize);
+	return header;
+}
+
+// The type header of a whole message in a receive buffer, read in place without
+// copying; nullptr if the message is of another type. pMessage has to be 8 byte
+// aligned and hold a valid MessageHeader.
+template <typename THeader>
+const THeader* MessageBody(
+	const uint8_t* pMessage)
+{
+	const MessageHeader* pHeader = reinterpret_cast<const MessageHeader*>(pMessage);
+	if (pHeader->MessageType != static_cast<uint16_t>(THeader::kType) ||
+		pHeader->HeaderSize < sizeof(MessageHeader) + sizeof(THeader))
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<const THeader*>(pMessage + sizeof(MessageHeader));
+}
+
+// the payload of a whole message, behind both headers
+inline const uint8_t* MessagePayload(
+	const uint8_t* pMessage)
+{
+	return pMessage + reinterpret_cast<const MessageHeader*>(pMessage)->HeaderSize;
+}
+
+// Where a frame was when, in the struct format "<IIQQQQ". Frame messages carry it
+// as the last of their headers, after the type header and anything appended to
+// it, and set MessageFlags::Trace, so readers that do not know it skip it with
+// the rest of the headers.
+struct FrameTraceHeader
+{
+	// Frames of the stream the sensor delivered before this one, counting the
+	// ones the device dropped, so that a gap between two messages is frames lost
+	// on the device or in the send queue. The messages of one frame in several
+	// codecs share it.
+	uint32_t Sequence;
+	uint32_t Reserved;
+	// In 100 ns ticks of the device's monotonic clock (see MonotonicTicks), 0
+	// where a stage does not apply. Differences between them are the time spent
+	// in each stage: capture to dequeue waiting for the processing stage, dequeue
+	// to encode encoding, encode to write in the send queue. WriteTime is set per
+	// client as the message starts going out.
+	uint64_t CaptureTime;
+	uint64_t DequeueTime;
+	uint64_t EncodeTime;
+	uint64_t WriteTime;
+};
+
+static_assert(sizeof(FrameTraceHeader) == 40, "Unexpected frame trace size");
+
+// Offset of the FrameTraceHeader in a message with these headers, 0 if it has none.
+inline size_t FrameTraceOffset(
+	const MessageHeader& header)
+{
+	if ((header.Flags & static_cast<uint32_t>(MessageFlags::Trace)) == 0 ||
+		header.HeaderSize < sizeof(MessageHeader) + sizeof(FrameTraceHeader))
+	{
+		return 0;
+	}
+	return header.HeaderSize - sizeof(FrameTraceHeader);
+}
+
+// The FrameTraceHeader of a whole message in a receive buffer, read in place
+// like MessageBody; nullptr if the message has none.
+inline const FrameTraceHeader* MessageTrace(
+	const uint8_t* pMessage)
+{
+	const size_t offset = FrameTraceOffset(*reinterpret_cast<const MessageHeader*>(pMessage));
+	return offset != 0 ? reinterpret_cast<const FrameTraceHeader*>(pMessage + offset) : nullptr;
+}
+
+// Sets the WriteTime of the message at the start of the size bytes at pMessage,
+// which have to be a copy of the client's own, if the message has a
+// FrameTraceHeader within them.
+inline void SetWriteTime(
+	uint8_t* pMessage,
+	size_t size,
+	uint64_t writeTime)
+{
+	if (size < sizeof(MessageHeader))
+	{
+		return;
+	}
+	MessageHeader header;
+	memcpy(&header, pMessage, sizeof(header));
+	const size_t offset = FrameTraceOffset(header);
+	if (offset != 0 && offset + sizeof(FrameTraceHeader) <= size)
+	{
+		memcpy(pMessage + offset + offsetof(FrameTraceHeader, WriteTime), &writeTime, sizeof(writeTime));
+	}
+}
+
+// Research mode frame, in the struct format "<Qiiii16fIIQ". ImageWidth to
+// RowStride describe the decoded image, or the image the points came from. The
+// payload is the depth image or point cloud in the codec of the message,
+// followed by AbSize bytes of the 16 bit big-endian active brightness image if
+// the stream includes it, zero wherever the depth is.
+struct ResearchModeFrameHeader
+{
+	static const MessageType kType = MessageType::ResearchModeFrame;
+
+	uint64_t Timestamp;
+	int32_t ImageWidth;
+	int32_t ImageHeight;
+	int32_t PixelStride;
+	int32_t RowStride;
+	Float4x4 Rig2World;
+	// size of the AB image at the end of the payload, 0 if there is none
+	uint32_t AbSize;
+	// visible light cameras only, as reported by IResearchModeSensorVLCFrame
+	uint32_t Gain;
+	uint64_t Exposure;
+};
+
+static_assert(sizeof(ResearchModeFrameHeader) == 104, "Unexpected research mode header size");
+
+// One IMU sample, in the struct format "<QQ4f". Accelerometer values are in
+// m/s^2, gyroscope values in rad/s, magnetometer values as reported by the sensor.
+struct ImuSample
+{
+	// host ticks (100 ns) on the clock of the frame headers
+	uint64_t Timestamp;
+	// raw sensor clock (VinylHupTicks, ns)
+	uint64_t SensorTicks;
+	float Values[3];
+	// 0 for the magnetometer, which does not report it
+	float Temperature;
+};
+
+static_assert(sizeof(ImuSample) == 32, "Unexpected IMU sample size");
+
+// IMU packet, in the struct format "<QII", one packet per batch the sensor
+// delivers. The payload is SampleCount samples.
+struct ImuPacketHeader
+{
+	static const MessageType kType = MessageType::ImuPacket;
+
+	// host ticks of the first sample
+	uint64_t Timestamp;
+	uint32_t SampleCount;
+	// sizeof(ImuSample)
+	uint32_t SampleSize;
+};
+
+static_assert(sizeof(ImuPacketHeader) == 16, "Unexpected IMU header size");
+
+// Message the camera streams send to every client once per connection, ahead of
+// its first frame, so that clients can project pixels without calibrating the
+// device themselves. Struct format "<ii16f9fI". Extrinsics and intrinsics use the
+// conventions of the frame headers: row vectors, pixels of the image as it is on
+// the wire.
+struct CalibrationHeader
+{
+	static const MessageType kType = MessageType::Calibration;
+
+	int32_t ImageWidth;
+	int32_t ImageHeight;
+	// research mode cameras: rig to camera, as GetCameraExtrinsicsMatrix reports
+	// it; PV: camera to rig, identity until the PV camera was located on the rig
+	Float4x4 Extrinsics;
+	// PV only, as CameraIntrinsics reports them, zero for research mode cameras
+	float FocalLength[2];
+	float PrincipalPoint[2];
+	float RadialDistortion[3];
+	float TangentialDistortion[2];
+	uint32_t Reserved;
+	// Research mode cameras have no closed-form model; their payload is x and y on
+	// the camera's unit plane of the centre of every pixel, row by row, as
+	// little-endian float32, NaN for pixels the camera cannot map. PV sends no
+	// payload.
+};
+
+static_assert(sizeof(CalibrationHeader) == 112, "Unexpected calibration header size");
+
+// Bits of the Flags of a SubscribeHeader.
+enum class SubscribeFlags : uint32_t
+{
+	// SessionFrameId is set
+	HasSession = 1
+};
+
+// What a client subscribed over UDP has of the session message, e.g. the
+// calibration, so that the device only sends it again if it was lost. Struct
+// format "<II".
+struct SubscribeHeader
+{
+	static const MessageType kType = MessageType::Subscribe;
+
+	// SubscribeFlags
+	uint32_t Flags;
+	// the FrameId of the last message marked DatagramFlags::Session the client
+	// put together
+	uint32_t SessionFrameId;
+};
+
+static_assert(sizeof(SubscribeHeader) == 8, "Unexpected subscribe header size");
+
+// Fields of a StreamControlHeader, as bits of its Fields mask.
+enum class StreamControlField : uint32_t
+{
+	Enabled = 1,
+	Interval = 2,
+	Decimation = 4,
+	PixelFormat = 8
+};
+
+inline uint32_t StreamControlBit(StreamControlField field)
+{
+	return static_cast<uint32_t>(field);
+}
+
+// Runtime configuration of a stream, in the struct format "<IIIIII". A request
+// sets the fields its Fields mask names and leaves the others as they are, so an
+// empty mask only asks for the state. The reply names the fields the stream has
+// and holds their values after the request, which tells the client what a
+// request for a value the stream cannot take came to; a reply with an empty mask
+// means there is no such stream. Streams running under rate control report the
+// best level their controller may step down from.
+struct StreamControlHeader
+{
+	static const MessageType kType = MessageType::StreamControl;
+
+	// StreamControlBit values
+	uint32_t Fields;
+	// 0 stops sending frames, without closing the stream or its connections
+	uint32_t Enabled;
+	// shortest time between two frames in microseconds, see FramePacer; 0 sends
+	// every frame the sensor delivers
+	uint32_t IntervalUs;
+	// video only: the image is decimated to 1/Decimation of its width and height
+	uint32_t Decimation;
+	// video only: the VideoPixelFormat on the wire
+	uint32_t PixelFormat;
+	uint32_t Reserved;
+};
+
+static_assert(sizeof(StreamControlHeader) == 24, "Unexpected stream control header size");
+
+// Pixel layouts of video camera frames. Bgra8 only occurs as a capture format,
+// the others are what the streamer can put on the wire.
+enum class VideoPixelFormat : uint32_t
+{
+	// packed 24 bit BGR
+	Bgr8 = 0,
+	// full resolution Y plane followed by the half resolution interleaved UV plane
+	Nv12 = 1,
+	// Y plane only
+	Luma8 = 2,
+	Bgra8 = 3
+};
+
+// Video camera frame, in the struct format "<Qiiii16f2f", laid out like the
+// research mode frames up to the pose. The payload is the image in the
+// VideoPixelFormat of the message; for the planar formats PixelStride and
+// RowStride describe the Y plane.
+struct VideoFrameHeader
+{
+	static const MessageType kType = MessageType::VideoFrame;
+
+	uint64_t Timestamp;
+	int32_t ImageWidth;
+	int32_t ImageHeight;
+	int32_t PixelStride;
+	int32_t RowStride;
+	Float4x4 PVtoWorld;
+	float Fx;
+	float Fy;
+};
+
+static_assert(sizeof(VideoFrameHeader) == 96, "Unexpected video header size");
+
+// Fused RGB-D message, in the struct format "<QiI": a PV frame and the depth
+// frame nearest to it in time, each as it would be sent on its own stream. The
+// payload is the whole PV message followed by the whole depth message.
+struct FusedFrameHeader
+{
+	static const MessageType kType = MessageType::FusedFrame;
+
+	// timestamp of the PV frame
+	uint64_t Timestamp;
+	// depth timestamp minus PV timestamp, in 100 ns ticks
+	int32_t DepthOffset;
+	uint32_t Reserved;
+};
+
+static_assert(sizeof(FusedFrameHeader) == 16, "Unexpected fused header size");
+
+// Bits of the Flags of a DatagramHeader.
+enum class DatagramFlags : uint16_t
+{
+	// the payload is the XOR of the data fragments of a parity group
+	Parity = 1,
+	// the message is the session message of the stream, see SubscribeHeader
+	Session = 2
+};
+
+// Over UDP every message is split into datagrams, each this header, in the struct
+// format "<IIIHHHHHH", and a fragment of the message: the data fragments hold
+// FragmentSize bytes each in order, the last one the rest. With parity, every
+// ParityGroupSize data fragments are followed by a parity datagram, the XOR of
+// them zero-padded to the first of them, so that the loss of any one of the
+// group can be repaired.
+struct DatagramHeader
+{
+	// "HL2D" read as a little-endian uint32
+	static const uint32_t kMagic = 0x44324C48;
+
+	uint32_t Magic;
+	// messages sent to this subscriber before, wraps around
+	uint32_t FrameId;
+	// bytes of the whole message
+	uint32_t FrameSize;
+	// the StreamId of the message
+	uint16_t StreamId;
+	// DatagramFlags
+	uint16_t Flags;
+	// the data fragment, or for parity the first data fragment of its group
+	uint16_t FragmentIndex;
+	// data fragments of the message
+	uint16_t FragmentCount;
+	// data fragments per parity datagram, 0 without parity
+	uint16_t ParityGroupSize;
+	// bytes of the message in every data fragment but the last
+	uint16_t FragmentSize;
+};
+
+static_assert(sizeof(DatagramHeader) == 24, "Unexpected datagram header size");
@@ -0,0 +1,79 @@
+#include "FrameMessage.h"
+
+void FrameMessage::SetTrace(const FrameTrace& trace)
+{
+    if (m_header.size() < sizeof(MessageHeader) || m_segments.empty())
+    {
+        return;
+    }
+    FrameTraceHeader traceHeader{};
+    traceHeader.Sequence = trace.Sequence;
+    traceHeader.CaptureTime = trace.CaptureTime;
+    traceHeader.DequeueTime = trace.DequeueTime;
+    traceHeader.EncodeTime = MonotonicTicks();
+
+    const size_t offset = m_header.size();
+    m_header.resize(offset + sizeof(traceHeader));
+    memcpy(m_header.data() + offset, &traceHeader, sizeof(traceHeader));
+    MessageHeader* pHeader = reinterpret_cast<MessageHeader*>(m_header.data());
+    pHeader->HeaderSize = static_cast<uint16_t>(m_header.size());
+    pHeader->Flags |= static_cast<uint32_t>(MessageFlags::Trace);
+
+    // the headers are the first segment, and may have moved
+    m_segments.front() = { m_header.data(), m_header.size() };
+    m_size += sizeof(traceHeader);
+}
+
+void FrameMessage::AddPayload(
+    const void* pData,
+    size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    m_segments.push_back({ static_cast<const uint8_t*>(pData), size });
+    m_size += size;
+    if (m_header.size() >= sizeof(MessageHeader))
+    {
+        reinterpret_cast<MessageHeader*>(m_header.data())->PayloadSize += static_cast<uint32_t>(size);
+    }
+}
+
+void FrameMessage::AddPayload(const FrameBufferPtr& buffer)
+{
+    if (!buffer)
+    {
+        return;
+    }
+    m_buffers.push_back(buffer);
+    AddPayload(buffer->data(), buffer->size());
+}
+
+void FrameMessage::Clear()
+{
+    m_segments.clear();
+    m_buffers.clear();
+    m_size = 0;
+}
+
+void FrameMessage::FlattenInto(std::vector<uint8_t>& buffer) const
+{
+    buffer.resize(m_size);
+    uint8_t* pOutput = buffer.data();
+    for (const ConstBuffer& segment : m_segments)
+    {
+        memcpy(pOutput, segment.pData, segment.Size);
+        pOutput += segment.Size;
+    }
+}
+
+FrameBufferPtr FrameMessage::Serialize(FrameBufferPool& pool) const
+{
+    FrameBufferPtr buffer = pool.Acquire(m_size);
+    if (buffer)
+    {
+        FlattenInto(*buffer);
+    }
+    return buffer;
+}
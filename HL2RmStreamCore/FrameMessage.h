@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "FrameBufferPool.h"
+#include "FrameHeaders.h"
+#include "FrameTrace.h"
+
+// A contiguous range of bytes that is only referenced.
+struct ConstBuffer
+{
+	const uint8_t* pData;
+	size_t Size;
+};
+
+// One message as it goes on the wire: a MessageHeader and the type header,
+// followed by any number of payload segments. The headers are copied into the
+// message, payload segments are only referenced: raw segments have to stay valid
+// until the message has been written, pooled buffers are kept alive by the
+// message. Transports that can gather write Segments() directly; the others copy
+// the message into one buffer with FlattenInto(). Messages are meant to be reused
+// for every frame of a stream, so their storage is only allocated once.
+class FrameMessage
+{
+public:
+	FrameMessage() = default;
+
+	FrameMessage(const FrameMessage&) = delete;
+	FrameMessage& operator=(const FrameMessage&) = delete;
+
+	// Starts a new message of the type of header; drops the previous payload. The
+	// PayloadSize of the MessageHeader counts the payload as it is added.
+	template <typename THeader>
+	void SetHeader(
+		StreamId streamId,
+		uint32_t codec,
+		const THeader& header)
+	{
+		static_assert(std::is_trivially_copyable<THeader>::value, "Headers are sent as raw bytes");
+		const MessageHeader messageHeader = MakeMessageHeader(streamId, THeader::kType, codec, sizeof(THeader));
+		m_header.resize(sizeof(MessageHeader) + sizeof(THeader));
+		memcpy(m_header.data(), &messageHeader, sizeof(MessageHeader));
+		memcpy(m_header.data() + sizeof(MessageHeader), &header, sizeof(THeader));
+
+		Clear();
+		m_segments.push_back({ m_header.data(), m_header.size() });
+		m_size = m_header.size();
+	}
+
+	// Appends the sequence number and stage times of the frame to the headers as
+	// a FrameTraceHeader; the encode time is now, so call it once the payload is
+	// encoded. Goes after SetHeader, once per header.
+	void SetTrace(const FrameTrace& trace);
+
+	// Appends a payload segment by reference.
+	void AddPayload(
+		const void* pData,
+		size_t size);
+
+	template <typename TElement>
+	void AddPayload(const std::vector<TElement>& data)
+	{
+		AddPayload(data.data(), data.size() * sizeof(TElement));
+	}
+
+	// Appends a pooled buffer, which stays out of its pool until the message is
+	// cleared or gets a new header.
+	void AddPayload(const FrameBufferPtr& buffer);
+
+	// Drops header and payload, returning pooled buffers.
+	void Clear();
+
+	// headers first, then the payload segments in the order they were added
+	const std::vector<ConstBuffer>& Segments() const { return m_segments; }
+
+	// total number of bytes of the message
+	size_t Size() const { return m_size; }
+
+	// Copies the whole message into buffer, which is resized to Size().
+	void FlattenInto(std::vector<uint8_t>& buffer) const;
+
+	// Copies the whole message into a buffer from pool, which can then be shared
+	// by send queues. Returns nullptr if the pool is exhausted.
+	FrameBufferPtr Serialize(FrameBufferPool& pool) const;
+
+private:
+	std::vector<uint8_t> m_header;
+	std::vector<ConstBuffer> m_segments;
+	std::vector<FrameBufferPtr> m_buffers;
+	size_t m_size = 0;
+};
@@ -0,0 +1,47 @@
+#include "FramePacer.h"
+
+FramePacer::FramePacer(
+    uint64_t interval) :
+    m_interval(interval)
+{
+}
+
+void FramePacer::SetInterval(
+    uint64_t interval)
+{
+    m_interval.store(interval, std::memory_order_relaxed);
+}
+
+bool FramePacer::Accept(
+    uint64_t timestamp)
+{
+    if (m_lastTimestamp != 0 && timestamp > m_lastTimestamp)
+    {
+        m_inputInterval = timestamp - m_lastTimestamp;
+    }
+    m_lastTimestamp = timestamp;
+
+    const uint64_t interval = Interval();
+    if (interval == 0)
+    {
+        m_nextDue = 0;
+        return true;
+    }
+
+    if (m_nextDue == 0 || timestamp >= m_nextDue + interval)
+    {
+        // the first frame, or frames stopped coming for longer than an interval:
+        // start a new grid here rather than sending a burst to catch up
+        m_nextDue = timestamp + interval;
+        return true;
+    }
+
+    // of the frames around the due time, the one at most half an input interval
+    // before it is the nearest
+    if (timestamp + m_inputInterval / 2 >= m_nextDue)
+    {
+        m_nextDue += interval;
+        return true;
+    }
+    return false;
+}
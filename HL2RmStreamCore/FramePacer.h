@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Thins a stream of frames out to a target interval. The frames it lets through
+// are the ones nearest to a fixed grid of due times, one interval apart, so the
+// output is the target rate on average and evenly spaced. Holding every frame to
+// a minimum delta after the previous one instead locks the output to a fraction
+// of the sensor rate that jitters around the target, e.g. 22.5 instead of 30 fps
+// from a 45 fps camera. Timestamps are 100 ns ticks.
+class FramePacer
+{
+public:
+	explicit FramePacer(
+		uint64_t interval = 0);
+
+	// 0 lets every frame through. May be called from any thread; the grid keeps
+	// its phase.
+	void SetInterval(
+		uint64_t interval);
+
+	uint64_t Interval() const { return m_interval.load(std::memory_order_relaxed); }
+
+	// Whether the frame at timestamp is sent. Only called by the thread that
+	// handles the frames, in timestamp order.
+	bool Accept(
+		uint64_t timestamp);
+
+private:
+	std::atomic<uint64_t> m_interval;
+	// timestamp of the last frame offered and the interval before it
+	uint64_t m_lastTimestamp = 0;
+	uint64_t m_inputInterval = 0;
+	// when the next frame is due; 0 until the first frame
+	uint64_t m_nextDue = 0;
+};
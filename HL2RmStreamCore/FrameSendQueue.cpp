@@ -0,0 +1,192 @@
+#include "FrameSendQueue.h"
+
+#include <algorithm>
+
+FrameSendQueue::FrameSendQueue(
+    const SendQueueSettings& settings) :
+    m_settings(settings),
+    m_entries(std::max(1u, settings.Depth))
+{
+}
+
+bool FrameSendQueue::Push(
+    FrameBufferPtr frame,
+    FrameBufferPtr session)
+{
+    const Clock::time_point now = Clock::now();
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_closed)
+        {
+            m_dropped++;
+            return false;
+        }
+
+        DropExpired(now);
+        if (m_count == m_entries.size())
+        {
+            if (m_settings.Policy == SendQueuePolicy::DropNewest)
+            {
+                m_dropped++;
+                return false;
+            }
+            DropFront();
+        }
+
+        Entry& entry = m_entries[(m_head + m_count) % m_entries.size()];
+        entry.Frame = std::move(frame);
+        entry.Session = std::move(session);
+        entry.EnqueueTime = now;
+        m_count++;
+        m_queued++;
+    }
+    m_frameAvailable.notify_one();
+    return true;
+}
+
+bool FrameSendQueue::TryPop(
+    FrameBufferPtr& frame,
+    FrameBufferPtr& session)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    DropExpired(Clock::now());
+    return PopFront(frame, session);
+}
+
+bool FrameSendQueue::PushReply(
+    FrameBufferPtr reply)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (m_closed)
+        {
+            return false;
+        }
+        m_replies.push_back(std::move(reply));
+    }
+    m_frameAvailable.notify_one();
+    return true;
+}
+
+bool FrameSendQueue::TryPopReply(
+    FrameBufferPtr& reply)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (m_replies.empty())
+    {
+        return false;
+    }
+    reply = std::move(m_replies.front());
+    m_replies.pop_front();
+    return true;
+}
+
+bool FrameSendQueue::HasReplies() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return !m_replies.empty();
+}
+
+bool FrameSendQueue::WaitPop(
+    FrameBufferPtr& frame,
+    FrameBufferPtr& session,
+    unsigned int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frameAvailable.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+        [this]() { return m_count > 0 || !m_replies.empty() || m_closed; });
+    if (!m_replies.empty())
+    {
+        return false;
+    }
+    DropExpired(Clock::now());
+    return PopFront(frame, session);
+}
+
+void FrameSendQueue::MarkSent(
+    size_t bytes)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_sent++;
+    m_sentBytes += bytes;
+}
+
+void FrameSendQueue::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    while (m_count > 0)
+    {
+        DropFront();
+    }
+    m_replies.clear();
+}
+
+void FrameSendQueue::Close()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_closed = true;
+        while (m_count > 0)
+        {
+            DropFront();
+        }
+        m_replies.clear();
+    }
+    m_frameAvailable.notify_all();
+}
+
+void FrameSendQueue::Reopen()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_closed = false;
+}
+
+SendQueueStatistics FrameSendQueue::Statistics() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    SendQueueStatistics statistics;
+    statistics.Queued = m_queued;
+    statistics.Sent = m_sent;
+    statistics.SentBytes = m_sentBytes;
+    statistics.Dropped = m_dropped;
+    statistics.Pending = static_cast<uint32_t>(m_count);
+    return statistics;
+}
+
+void FrameSendQueue::DropFront()
+{
+    // releasing the frame returns its buffer to the pool
+    m_entries[m_head].Frame.reset();
+    m_entries[m_head].Session.reset();
+    m_head = (m_head + 1) % m_entries.size();
+    m_count--;
+    m_dropped++;
+}
+
+void FrameSendQueue::DropExpired(Clock::time_point now)
+{
+    if (m_settings.Policy != SendQueuePolicy::MaxAge)
+    {
+        return;
+    }
+    const auto maxAge = std::chrono::milliseconds(m_settings.MaxAgeMs);
+    while (m_count > 0 && now - m_entries[m_head].EnqueueTime > maxAge)
+    {
+        DropFront();
+    }
+}
+
+bool FrameSendQueue::PopFront(
+    FrameBufferPtr& frame,
+    FrameBufferPtr& session)
+{
+    if (m_count == 0)
+    {
+        return false;
+    }
+    frame = std::move(m_entries[m_head].Frame);
+    session = std::move(m_entries[m_head].Session);
+    m_head = (m_head + 1) % m_entries.size();
+    m_count--;
+    return true;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "FrameBufferPool.h"
+
+// What a full send queue does with a new frame.
+enum class SendQueuePolicy
+{
+	// drop the oldest queued frame to make room
+	DropOldest,
+	// drop the new frame
+	DropNewest,
+	// like DropOldest, and frames that waited longer than MaxAgeMs are dropped
+	// instead of sent
+	MaxAge
+};
+
+struct SendQueueSettings
+{
+	// frames waiting behind the one being written
+	uint32_t Depth = 2;
+	SendQueuePolicy Policy = SendQueuePolicy::DropOldest;
+	// only used by SendQueuePolicy::MaxAge
+	uint32_t MaxAgeMs = 100;
+};
+
+// Buffers a pool of serialized frames needs so that it never runs dry while the
+// frames are shared by this many queues: every queue can hold Depth frames plus
+// the one being written, and one more frame is being serialized.
+inline uint32_t SendQueueBufferCount(
+	const SendQueueSettings& settings,
+	uint32_t queues)
+{
+	return queues * (settings.Depth + 1) + 1;
+}
+
+struct SendQueueStatistics
+{
+	// frames accepted by Push
+	uint64_t Queued = 0;
+	// frames whose write completed
+	uint64_t Sent = 0;
+	// bytes of those frames, session messages included
+	uint64_t SentBytes = 0;
+	// frames dropped by the policy, or when the queue was cleared
+	uint64_t Dropped = 0;
+	// frames waiting right now
+	uint32_t Pending = 0;
+};
+
+// Bounded queue of serialized frames between a streamer and one connection. The
+// producer never blocks: when the connection cannot keep up, the policy decides
+// which frames are dropped, so the latency of what is sent stays bounded. The
+// consumer either polls with TryPop from write completions or blocks in
+// WaitPop on a writer thread, and reports finished writes with MarkSent. Every
+// frame carries the session message that was current when it was queued, so that
+// the consumer can send a changed one right ahead of the first frame it is for.
+// Replies to the requests of the client wait apart from the frames: they are never
+// dropped, go out ahead of the next frame and are left out of the statistics, so
+// that rate control only sees the frames.
+class FrameSendQueue
+{
+public:
+	explicit FrameSendQueue(
+		const SendQueueSettings& settings = SendQueueSettings());
+
+	FrameSendQueue(const FrameSendQueue&) = delete;
+	FrameSendQueue& operator=(const FrameSendQueue&) = delete;
+
+	// Returns false if the frame was dropped right away. session is the session
+	// message the frame goes with, or nullptr.
+	bool Push(
+		FrameBufferPtr frame,
+		FrameBufferPtr session = nullptr);
+
+	// Takes the oldest frame that is still fresh enough to send, and its session
+	// message.
+	bool TryPop(
+		FrameBufferPtr& frame,
+		FrameBufferPtr& session);
+
+	// Queues a reply for the consumer to send before the next frame. Returns false
+	// if the queue is closed.
+	bool PushReply(
+		FrameBufferPtr reply);
+
+	// Takes the oldest reply; consumers take all of them before the next frame.
+	bool TryPopReply(
+		FrameBufferPtr& reply);
+
+	bool HasReplies() const;
+
+	// Blocks until a frame is available, Close is called or the timeout elapses.
+	// A reply wakes it up as well, returning false if there is no frame.
+	bool WaitPop(
+		FrameBufferPtr& frame,
+		FrameBufferPtr& session,
+		unsigned int timeoutMs);
+
+	// a frame of bytes bytes on the wire has been written
+	void MarkSent(
+		size_t bytes);
+
+	// Drops all pending frames and replies, e.g. when the connection is lost.
+	void Clear();
+
+	// Wakes up WaitPop; the queue accepts no frames until Reopen.
+	void Close();
+
+	void Reopen();
+
+	SendQueueStatistics Statistics() const;
+
+	const SendQueueSettings& Settings() const { return m_settings; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		FrameBufferPtr Frame;
+		FrameBufferPtr Session;
+		Clock::time_point EnqueueTime;
+	};
+
+	// callers hold m_mutex
+	void DropFront();
+	void DropExpired(Clock::time_point now);
+	bool PopFront(FrameBufferPtr& frame, FrameBufferPtr& session);
+
+	const SendQueueSettings m_settings;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_frameAvailable;
+	// ring buffer of m_settings.Depth entries
+	std::vector<Entry> m_entries;
+	size_t m_head = 0;
+	size_t m_count = 0;
+	std::deque<FrameBufferPtr> m_replies;
+	bool m_closed = false;
+
+	uint64_t m_queued = 0;
+	uint64_t m_sent = 0;
+	uint64_t m_sentBytes = 0;
+	uint64_t m_dropped = 0;
+};
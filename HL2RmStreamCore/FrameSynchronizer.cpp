@@ -0,0 +1,115 @@
+#include "FrameSynchronizer.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+    const uint64_t kHostTicksPerMs = 10'000;
+}
+
+FrameSynchronizer::FrameSynchronizer(
+    std::shared_ptr<IFusedFrameSink> sink,
+    const FrameSyncSettings& settings) :
+    m_pSink(std::move(sink)),
+    m_settings(settings),
+    m_toleranceTicks(settings.ToleranceMs * kHostTicksPerMs)
+{
+    m_settings.BufferedFrames = std::max(1u, std::min(m_settings.BufferedFrames, kMaxBufferedFrames));
+}
+
+bool FrameSynchronizer::IsActive()
+{
+    return m_pSink && m_pSink->IsConnected();
+}
+
+void FrameSynchronizer::AddVideo(
+    uint64_t timestamp,
+    FrameBufferPtr message)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_video.push_back({ timestamp, std::move(message) });
+    if (m_video.size() > m_settings.BufferedFrames)
+    {
+        // no depth frame came after it in time
+        m_video.pop_front();
+        m_statistics.UnmatchedVideo++;
+    }
+    Match();
+}
+
+void FrameSynchronizer::AddDepth(
+    uint64_t timestamp,
+    FrameBufferPtr message)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_depth.push_back({ timestamp, std::move(message) });
+    if (m_depth.size() > m_settings.BufferedFrames)
+    {
+        m_depth.pop_front();
+        m_statistics.UnmatchedDepth++;
+    }
+    Match();
+}
+
+FrameSyncStatistics FrameSynchronizer::Statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void FrameSynchronizer::Match()
+{
+    while (!m_video.empty())
+    {
+        const PendingFrame& video = m_video.front();
+
+        // the first depth frame at or after the PV frame settles which one is nearest
+        auto after = std::find_if(m_depth.begin(), m_depth.end(),
+            [&](const PendingFrame& depth) { return depth.Timestamp >= video.Timestamp; });
+        if (after == m_depth.end())
+        {
+            return;
+        }
+        auto nearest = after;
+        if (after != m_depth.begin() &&
+            video.Timestamp - std::prev(after)->Timestamp < after->Timestamp - video.Timestamp)
+        {
+            nearest = std::prev(after);
+        }
+
+        const uint64_t distance = (nearest->Timestamp > video.Timestamp) ?
+            nearest->Timestamp - video.Timestamp : video.Timestamp - nearest->Timestamp;
+        if (distance <= m_toleranceTicks)
+        {
+            Emit(video, *nearest);
+            // older depth frames are further from every later PV frame as well
+            m_statistics.UnmatchedDepth += std::distance(m_depth.begin(), nearest);
+            m_depth.erase(m_depth.begin(), std::next(nearest));
+        }
+        else
+        {
+            m_statistics.UnmatchedVideo++;
+        }
+        m_video.pop_front();
+    }
+}
+
+void FrameSynchronizer::Emit(
+    const PendingFrame& video,
+    const PendingFrame& depth)
+{
+    FusedFrameHeader header;
+    header.Timestamp = video.Timestamp;
+    header.DepthOffset = static_cast<int32_t>(static_cast<int64_t>(depth.Timestamp - video.Timestamp));
+    header.Reserved = 0;
+    FrameTrace trace;
+    if (const FrameTraceHeader* pVideoTrace = MessageTrace(video.Message->data()))
+    {
+        trace.Sequence = pVideoTrace->Sequence;
+        trace.CaptureTime = pVideoTrace->CaptureTime;
+    }
+    trace.DequeueTime = MonotonicTicks();
+    m_statistics.Fused++;
+    m_pSink->Send(header, trace, video.Message, depth.Message);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "FrameBufferPool.h"
+#include "FrameHeaders.h"
+#include "FrameTrace.h"
+
+// Transport of fused messages, e.g. a stream server of its own.
+class IFusedFrameSink
+{
+public:
+	virtual ~IFusedFrameSink() {};
+	// whether anyone takes fused messages; frames are only paired while it does
+	virtual bool IsConnected() = 0;
+	// video and depth are the serialized frames of the pair; the fused message is
+	// the header followed by both. The pair goes by the sequence number and capture
+	// time of its PV frame and is dequeued when it was paired.
+	virtual void Send(
+		const FusedFrameHeader& header,
+		const FrameTrace& trace,
+		const FrameBufferPtr& video,
+		const FrameBufferPtr& depth) = 0;
+};
+
+struct FrameSyncSettings
+{
+	// largest difference between the PV and the depth timestamp of a pair
+	uint32_t ToleranceMs = 15;
+	// frames held per stream while waiting for a partner, at most kMaxBufferedFrames
+	uint32_t BufferedFrames = 4;
+	// codec of the depth frames in fused messages
+	DepthCodec Codec = DepthCodec::Raw;
+};
+
+struct FrameSyncStatistics
+{
+	// fused messages handed to the sink
+	uint64_t Fused = 0;
+	// PV frames without a depth frame within the tolerance
+	uint64_t UnmatchedVideo = 0;
+	// depth frames that were never paired
+	uint64_t UnmatchedDepth = 0;
+};
+
+// Pairs the serialized frames of the PV and the depth stream by timestamp and
+// hands every pair to a sink as one message. The streamers pass on the messages
+// they serialized for their own subscribers, so pairing copies nothing. Every PV frame is paired with the nearest depth frame, which
+// is only known once a depth frame at or after the PV frame has arrived; until
+// then both streams buffer a few frames. Thread-safe, the streams may deliver
+// from different threads.
+class FrameSynchronizer
+{
+public:
+	// streamers size their pools of serialized frames to allow for this many
+	// frames held here
+	static const uint32_t kMaxBufferedFrames = 8;
+
+	FrameSynchronizer(
+		std::shared_ptr<IFusedFrameSink> sink,
+		const FrameSyncSettings& settings = FrameSyncSettings());
+
+	// true while the sink is connected; streamers skip AddVideo and AddDepth otherwise
+	bool IsActive();
+
+	DepthCodec Codec() const { return m_settings.Codec; }
+
+	// message is a whole video frame message
+	void AddVideo(
+		uint64_t timestamp,
+		FrameBufferPtr message);
+
+	// message is a whole research mode frame message in Codec()
+	void AddDepth(
+		uint64_t timestamp,
+		FrameBufferPtr message);
+
+	FrameSyncStatistics Statistics() const;
+
+private:
+	struct PendingFrame
+	{
+		uint64_t Timestamp;
+		FrameBufferPtr Message;
+	};
+
+	// pairs buffered PV frames whose nearest depth frame is known
+	void Match();
+
+	void Emit(
+		const PendingFrame& video,
+		const PendingFrame& depth);
+
+	std::shared_ptr<IFusedFrameSink> m_pSink;
+	FrameSyncSettings m_settings;
+	uint64_t m_toleranceTicks;
+
+	mutable std::mutex m_mutex;
+	std::deque<PendingFrame> m_video;
+	std::deque<PendingFrame> m_depth;
+	FrameSyncStatistics m_statistics;
+};
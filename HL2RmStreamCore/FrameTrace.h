@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Now in 100 ns ticks of the steady clock, the clock of the stage times in the
+// message headers. On Windows it counts from the same origin as the research
+// mode HostTicks and SystemRelativeTime, so capture times compare directly.
+inline uint64_t MonotonicTicks()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// What the device knows about a frame before it is encoded, handed along with it
+// to the streamer, which puts it into the FrameTraceHeader of each of its messages.
+struct FrameTrace
+{
+	// Frames the sensor delivered on this stream before this one. Frames the
+	// device drops still count, so that every drop is a gap at the client.
+	uint32_t Sequence = 0;
+	// the timestamp of the frame, in MonotonicTicks
+	uint64_t CaptureTime = 0;
+	// MonotonicTicks when the processing stage took the frame
+	uint64_t DequeueTime = 0;
+};
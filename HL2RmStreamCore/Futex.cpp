@@ -0,0 +1,52 @@
+#include "Futex.h"
+
+#include "Platform.h"
+
+#if defined(_WIN32)
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32 bit values");
+
+void FutexWait(
+    std::atomic<uint32_t>* pAddress,
+    uint32_t expected,
+    unsigned int timeoutMs)
+{
+#if defined(_WIN32)
+    WaitOnAddress(pAddress, &expected, sizeof(expected), timeoutMs);
+#elif defined(__linux__)
+    timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(pAddress), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0);
+#else
+    // no futex available, poll with a short sleep
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (pAddress->load() == expected && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+#endif
+}
+
+void FutexWakeAll(
+    std::atomic<uint32_t>* pAddress)
+{
+#if defined(_WIN32)
+    WakeByAddressAll(pAddress);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(pAddress), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)pAddress;
+#endif
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Futex-style waiting on a 32 bit word (futex on Linux, WaitOnAddress on Windows).
+// FutexWait returns once the value differs from expected, on a wake-up, or after
+// the timeout; spurious returns are possible, so callers re-check their condition.
+void FutexWait(
+	std::atomic<uint32_t>* pAddress,
+	uint32_t expected,
+	unsigned int timeoutMs);
+
+void FutexWakeAll(
+	std::atomic<uint32_t>* pAddress);
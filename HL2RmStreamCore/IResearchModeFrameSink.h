@@ -1,10 +1,16 @@
 #pragma once
 
+#include <memory>
+
+#include "FrameTrace.h"
+#include "PortableResearchModeApi.h"
+
 class IResearchModeFrameSink
 {
 public:
 	virtual ~IResearchModeFrameSink() {};
 	virtual void Send(
 		std::shared_ptr<IResearchModeSensorFrame> pSensorFrame,
-		ResearchModeSensorType pSensorType) = 0;
+		ResearchModeSensorType pSensorType,
+		const FrameTrace& trace) = 0;
 };
@@ -0,0 +1,287 @@
+#include "ImageKernels.h"
+
+#include <cstring>
+
+#if defined(HL2_SIMD_X86)
+#include <immintrin.h>
+#endif
+#if defined(HL2_SIMD_NEON)
+#if defined(_MSC_VER) && defined(_M_ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace
+{
+    // Packs outWidth pixels of one row, taking every decimation-th pixel from
+    // firstPixel on. Shared tail handling for all vectorized row kernels.
+    void PackRowScalar(
+        const uint8_t* pBgraRow,
+        int firstPixel,
+        int outWidth,
+        int decimation,
+        uint8_t* pBgrRow)
+    {
+        for (int x = firstPixel; x < outWidth; ++x)
+        {
+            const uint8_t* pPixel = pBgraRow + 4 * x * decimation;
+            pBgrRow[3 * x] = pPixel[0];
+            pBgrRow[3 * x + 1] = pPixel[1];
+            pBgrRow[3 * x + 2] = pPixel[2];
+        }
+    }
+
+#if defined(HL2_SIMD_X86)
+    // Gathers 4 pixels with the given stride into one register: pixels
+    // 0, d, 2d, 3d relative to pSrc.
+    HL2_TARGET_SSSE3 inline __m128i GatherPixelsSse(
+        const uint8_t* pSrc,
+        int decimation)
+    {
+        if (decimation == 1)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+        }
+        if (decimation == 2)
+        {
+            const __m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc)));
+            const __m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 16)));
+            return _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+        // decimation 4: first pixel of each of four consecutive 16 byte blocks
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 16));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 32));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + 48));
+        return _mm_unpacklo_epi64(_mm_unpacklo_epi32(a, b), _mm_unpacklo_epi32(c, d));
+    }
+
+    HL2_TARGET_SSSE3 void PackRowSsse3(
+        const uint8_t* pBgraRow,
+        int outWidth,
+        int decimation,
+        uint8_t* pBgrRow)
+    {
+        const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        int x = 0;
+        // 4 pixels per step; the 16 byte store spills 4 bytes that the next step
+        // overwrites, so stop while at least 6 output pixels are left
+        for (; x + 6 <= outWidth; x += 4)
+        {
+            const __m128i pixels = GatherPixelsSse(pBgraRow + 4 * x * decimation, decimation);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pBgrRow + 3 * x), _mm_shuffle_epi8(pixels, dropAlpha));
+        }
+        PackRowScalar(pBgraRow, x, outWidth, decimation, pBgrRow);
+    }
+
+    HL2_TARGET_AVX2 void PackRowAvx2(
+        const uint8_t* pBgraRow,
+        int outWidth,
+        int decimation,
+        uint8_t* pBgrRow)
+    {
+        const __m256i dropAlpha = _mm256_setr_epi8(
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+            0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        // moves the 12 valid bytes of the upper lane next to those of the lower one
+        const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+        int x = 0;
+        // 8 pixels per step; the 32 byte store spills 8 bytes
+        for (; x + 11 <= outWidth; x += 8)
+        {
+            const uint8_t* pSrc = pBgraRow + 4 * x * decimation;
+            __m256i pixels;
+            if (decimation == 1)
+            {
+                pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc));
+            }
+            else if (decimation == 2)
+            {
+                const __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc)));
+                const __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + 32)));
+                // per lane even pixels: a0 a2 b0 b2 | a4 a6 b4 b6, then restore the order
+                const __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                pixels = _mm256_permutevar8x32_epi32(even, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+            }
+            else
+            {
+                pixels = _mm256_set_m128i(
+                    GatherPixelsSse(pSrc + 64, decimation),
+                    GatherPixelsSse(pSrc, decimation));
+            }
+            const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, dropAlpha), compact);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pBgrRow + 3 * x), packed);
+        }
+        // not PackRowSsse3: mixing in legacy SSE code once per row costs more
+        // than the AVX2 loop saves
+        PackRowScalar(pBgraRow, x, outWidth, decimation, pBgrRow);
+    }
+#endif
+
+#if defined(HL2_SIMD_NEON)
+    void PackRowNeon(
+        const uint8_t* pBgraRow,
+        int outWidth,
+        int decimation,
+        uint8_t* pBgrRow)
+    {
+        int x = 0;
+        // 16 output pixels per step, deinterleaving loads drop alpha for free.
+        // Decimated steps load up to the pixel before the next output pixel, which
+        // the last row lacks if the width is not a multiple of the decimation, so
+        // they stop while at least 17 output pixels are left.
+        const int margin = decimation == 1 ? 16 : 17;
+        for (; x + margin <= outWidth; x += 16)
+        {
+            const uint8_t* pSrc = pBgraRow + 4 * x * decimation;
+            uint8x16x3_t bgr;
+            if (decimation == 1)
+            {
+                const uint8x16x4_t bgra = vld4q_u8(pSrc);
+                bgr.val[0] = bgra.val[0];
+                bgr.val[1] = bgra.val[1];
+                bgr.val[2] = bgra.val[2];
+            }
+            else if (decimation == 2)
+            {
+                const uint8x16x4_t a = vld4q_u8(pSrc);
+                const uint8x16x4_t b = vld4q_u8(pSrc + 64);
+                for (int c = 0; c < 3; ++c)
+                {
+                    bgr.val[c] = vuzpq_u8(a.val[c], b.val[c]).val[0];
+                }
+            }
+            else
+            {
+                const uint8x16x4_t a = vld4q_u8(pSrc);
+                const uint8x16x4_t b = vld4q_u8(pSrc + 64);
+                const uint8x16x4_t c = vld4q_u8(pSrc + 128);
+                const uint8x16x4_t d = vld4q_u8(pSrc + 192);
+                for (int k = 0; k < 3; ++k)
+                {
+                    const uint8x16_t ab = vuzpq_u8(a.val[k], b.val[k]).val[0];
+                    const uint8x16_t cd = vuzpq_u8(c.val[k], d.val[k]).val[0];
+                    bgr.val[k] = vuzpq_u8(ab, cd).val[0];
+                }
+            }
+            vst3q_u8(pBgrRow + 3 * x, bgr);
+        }
+        PackRowScalar(pBgraRow, x, outWidth, decimation, pBgrRow);
+    }
+#endif
+
+    typedef void (*PackRowFunction)(const uint8_t*, int, int, uint8_t*);
+
+    void PackRowScalarFromStart(
+        const uint8_t* pBgraRow,
+        int outWidth,
+        int decimation,
+        uint8_t* pBgrRow)
+    {
+        PackRowScalar(pBgraRow, 0, outWidth, decimation, pBgrRow);
+    }
+
+    PackRowFunction SelectRowKernel(
+        int decimation,
+        SimdLevel level)
+    {
+        if (decimation != 1 && decimation != 2 && decimation != 4)
+        {
+            return PackRowScalarFromStart;
+        }
+        switch (level)
+        {
+#if defined(HL2_SIMD_X86)
+        case SimdLevel::Avx2:
+            return PackRowAvx2;
+        case SimdLevel::Ssse3:
+            return PackRowSsse3;
+#endif
+#if defined(HL2_SIMD_NEON)
+        case SimdLevel::Neon:
+            return PackRowNeon;
+#endif
+        default:
+            return PackRowScalarFromStart;
+        }
+    }
+}
+
+void CopyPlane(
+    const uint8_t* pSrc,
+    int width,
+    int height,
+    int rowStride,
+    int elementSize,
+    int decimation,
+    uint8_t* pDst)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * elementSize;
+    if (decimation == 1)
+    {
+        if (rowStride == static_cast<int>(rowBytes))
+        {
+            memcpy(pDst, pSrc, rowBytes * height);
+            return;
+        }
+        for (int y = 0; y < height; ++y)
+        {
+            memcpy(pDst, pSrc + static_cast<size_t>(y) * rowStride, rowBytes);
+            pDst += rowBytes;
+        }
+        return;
+    }
+
+    const int outWidth = DecimatedSize(width, decimation);
+    for (int y = 0; y < height; y += decimation)
+    {
+        const uint8_t* pRow = pSrc + static_cast<size_t>(y) * rowStride;
+        if (elementSize == 2)
+        {
+            for (int x = 0; x < outWidth; ++x)
+            {
+                memcpy(pDst + 2 * x, pRow + 2 * x * decimation, 2);
+            }
+        }
+        else
+        {
+            for (int x = 0; x < outWidth; ++x)
+            {
+                pDst[x] = pRow[x * decimation];
+            }
+        }
+        pDst += static_cast<size_t>(outWidth) * elementSize;
+    }
+}
+
+void PackBgraToBgr(
+    const uint8_t* pBgra,
+    int width,
+    int height,
+    int rowStride,
+    int decimation,
+    uint8_t* pBgr)
+{
+    PackBgraToBgr(pBgra, width, height, rowStride, decimation, pBgr, DetectSimdLevel());
+}
+
+void PackBgraToBgr(
+    const uint8_t* pBgra,
+    int width,
+    int height,
+    int rowStride,
+    int decimation,
+    uint8_t* pBgr,
+    SimdLevel level)
+{
+    const int outWidth = DecimatedSize(width, decimation);
+    const PackRowFunction packRow = SelectRowKernel(decimation, level);
+
+    for (int y = 0; y < height; y += decimation)
+    {
+        packRow(pBgra + static_cast<size_t>(y) * rowStride, outWidth, decimation, pBgr);
+        pBgr += 3 * static_cast<size_t>(outWidth);
+    }
+}
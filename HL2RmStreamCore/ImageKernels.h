@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SimdSupport.h"
+
+// Size of one dimension after keeping every decimation-th pixel, starting at 0.
+inline int DecimatedSize(
+	int size,
+	int decimation)
+{
+	return (size + decimation - 1) / decimation;
+}
+
+// Copies a plane of width x height elements of elementSize bytes (1 for a Y
+// plane, 2 for an interleaved UV plane), keeping every decimation-th element of
+// every decimation-th row. pDst receives the decimated plane tightly packed.
+void CopyPlane(
+	const uint8_t* pSrc,
+	int width,
+	int height,
+	int rowStride,
+	int elementSize,
+	int decimation,
+	uint8_t* pDst);
+
+// Drops the alpha channel of a BGRA image and keeps every decimation-th pixel of
+// every decimation-th row, in a single pass. pBgr receives
+// DecimatedSize(width) * DecimatedSize(height) tightly packed BGR pixels.
+// Decimation 1, 2 and 4 are vectorized; other factors use the scalar path.
+void PackBgraToBgr(
+	const uint8_t* pBgra,
+	int width,
+	int height,
+	int rowStride,
+	int decimation,
+	uint8_t* pBgr);
+
+// Same, with an explicit instruction set. level must be supported by the CPU.
+void PackBgraToBgr(
+	const uint8_t* pBgra,
+	int width,
+	int height,
+	int rowStride,
+	int decimation,
+	uint8_t* pBgr,
+	SimdLevel level);
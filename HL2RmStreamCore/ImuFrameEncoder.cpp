@@ -0,0 +1,120 @@
+#include "ImuFrameEncoder.h"
+
+#include <memory>
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+
+namespace
+{
+    // the sensor clock counts nanoseconds, host ticks are 100 ns
+    const UINT64 kSensorTicksPerHostTick = 100;
+
+    float TemperatureOf(const AccelDataStruct& sample) { return sample.temperature; }
+    float TemperatureOf(const GyroDataStruct& sample) { return sample.temperature; }
+    float TemperatureOf(const MagDataStruct& /* sample */) { return 0.0f; }
+
+    const float* ValuesOf(const AccelDataStruct& sample) { return sample.AccelValues; }
+    const float* ValuesOf(const GyroDataStruct& sample) { return sample.GyroValues; }
+    const float* ValuesOf(const MagDataStruct& sample) { return sample.MagValues; }
+
+    template <typename TSample>
+    void WriteSamples(
+        const TSample* pSamples,
+        size_t count,
+        UINT64 hostTicks,
+        std::vector<BYTE>& payload)
+    {
+        payload.resize(count * sizeof(ImuSample));
+        ImuSample* pOutput = reinterpret_cast<ImuSample*>(payload.data());
+        const UINT64 firstSensorTicks = pSamples[0].VinylHupTicks;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const TSample& sample = pSamples[i];
+            const float* pValues = ValuesOf(sample);
+            pOutput[i].Timestamp = hostTicks +
+                (sample.VinylHupTicks - firstSensorTicks) / kSensorTicksPerHostTick;
+            pOutput[i].SensorTicks = sample.VinylHupTicks;
+            pOutput[i].Values[0] = pValues[0];
+            pOutput[i].Values[1] = pValues[1];
+            pOutput[i].Values[2] = pValues[2];
+            pOutput[i].Temperature = TemperatureOf(sample);
+        }
+    }
+
+    // Queries TFrame from the frame and hands its samples to WriteSamples.
+    template <typename TFrame, typename TSample, typename TGetSamples>
+    size_t EncodeSamples(
+        IResearchModeSensorFrame* pSensorFrame,
+        TGetSamples getSamples,
+        UINT64 hostTicks,
+        std::vector<BYTE>& payload)
+    {
+        TFrame* pImuFrame = nullptr;
+        HRESULT hr = pSensorFrame->QueryInterface(IID_PPV_ARGS(&pImuFrame));
+        if (!pImuFrame || !SUCCEEDED(hr))
+        {
+#if DBG_ENABLE_VERBOSE_LOGGING
+            OutputDebugStringW(L"ImuFrameEncoder::Encode: Failed to grab IMU frame.\n");
+#endif
+            return 0;
+        }
+
+        std::shared_ptr<TFrame> spImuFrame(pImuFrame, [](TFrame* sf) { sf->Release(); });
+
+        const TSample* pSamples = nullptr;
+        size_t count = 0;
+        if (FAILED(((*spImuFrame).*getSamples)(&pSamples, &count)) || !pSamples || count == 0)
+        {
+            return 0;
+        }
+        WriteSamples(pSamples, count, hostTicks, payload);
+        return count;
+    }
+}
+
+ImuFrameEncoder::ImuFrameEncoder(
+    ResearchModeSensorType sensorType) :
+    m_sensorType(sensorType)
+{
+}
+
+bool ImuFrameEncoder::IsImuSensor(
+    ResearchModeSensorType sensorType)
+{
+    return sensorType == IMU_ACCEL || sensorType == IMU_GYRO || sensorType == IMU_MAG;
+}
+
+bool ImuFrameEncoder::Encode(
+    IResearchModeSensorFrame* pSensorFrame,
+    UINT64 hostTicks,
+    ImuPacketHeader& header,
+    std::vector<BYTE>& payload)
+{
+    size_t count = 0;
+    switch (m_sensorType)
+    {
+    case IMU_ACCEL:
+        count = EncodeSamples<IResearchModeAccelFrame, AccelDataStruct>(
+            pSensorFrame, &IResearchModeAccelFrame::GetCalibratedAccelarationSamples, hostTicks, payload);
+        break;
+    case IMU_GYRO:
+        count = EncodeSamples<IResearchModeGyroFrame, GyroDataStruct>(
+            pSensorFrame, &IResearchModeGyroFrame::GetCalibratedGyroSamples, hostTicks, payload);
+        break;
+    case IMU_MAG:
+        count = EncodeSamples<IResearchModeMagFrame, MagDataStruct>(
+            pSensorFrame, &IResearchModeMagFrame::GetMagnetometerSamples, hostTicks, payload);
+        break;
+    default:
+        break;
+    }
+    if (count == 0)
+    {
+        return false;
+    }
+
+    header.Timestamp = hostTicks;
+    header.SampleCount = static_cast<uint32_t>(count);
+    header.SampleSize = sizeof(ImuSample);
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "PortableResearchModeApi.h"
+#include "FrameHeaders.h"
+
+// Turns the sample batches of the accelerometer, gyroscope and magnetometer into
+// their wire representation, an ImuPacketHeader followed by ImuSample records.
+class ImuFrameEncoder
+{
+public:
+	explicit ImuFrameEncoder(
+		ResearchModeSensorType sensorType);
+
+	// Fills in the header and writes one ImuSample per sample of the batch to
+	// payload, resizing it to fit. hostTicks is the timestamp of the first sample
+	// on the clock the samples should be reported in; the others are offset from
+	// it by their sensor clock. payload is reused across batches, so it only
+	// reallocates when a batch grows. Returns false if the frame is not an IMU
+	// frame of the sensor or carries no samples.
+	bool Encode(
+		IResearchModeSensorFrame* pSensorFrame,
+		UINT64 hostTicks,
+		ImuPacketHeader& header,
+		std::vector<BYTE>& payload);
+
+	ResearchModeSensorType SensorType() const { return m_sensorType; }
+
+	// the stream the packets of the sensor go out on
+	StreamId Stream() const { return static_cast<StreamId>(m_sensorType); }
+
+	// IMU_ACCEL, IMU_GYRO and IMU_MAG
+	static bool IsImuSensor(ResearchModeSensorType sensorType);
+
+private:
+	ResearchModeSensorType m_sensorType;
+};
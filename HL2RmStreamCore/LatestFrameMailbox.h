@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "Futex.h"
+
+struct MailboxStatistics
+{
+	// frames handed to Publish
+	uint64_t Published = 0;
+	// frames taken out by the consumer
+	uint64_t Consumed = 0;
+	// frames replaced by a newer one before the consumer got to them
+	uint64_t Overwritten = 0;
+};
+
+// Single-producer/single-consumer slot that always holds the latest frame.
+// It is a triple buffer: the producer writes into its back slot and swaps it with
+// the shared middle slot, the consumer swaps the middle slot with its front slot.
+// Publish never blocks; the consumer can sleep on a futex until a frame arrives.
+template <typename T>
+class LatestFrameMailbox
+{
+public:
+	explicit LatestFrameMailbox(const T& emptyValue = T()) :
+		m_emptyValue(emptyValue),
+		m_slots{ { emptyValue, emptyValue, emptyValue } }
+	{
+	}
+
+	LatestFrameMailbox(const LatestFrameMailbox&) = delete;
+	LatestFrameMailbox& operator=(const LatestFrameMailbox&) = delete;
+
+	// Producer side: replaces any frame the consumer has not taken yet.
+	void Publish(T frame)
+	{
+		m_slots[m_backIndex] = std::move(frame);
+		const uint32_t previous = m_middle.exchange(m_backIndex | kFreshBit, std::memory_order_acq_rel);
+		m_backIndex = previous & kIndexMask;
+		// the slot we get back may still hold an unconsumed frame
+		m_slots[m_backIndex] = m_emptyValue;
+
+		m_published.fetch_add(1, std::memory_order_relaxed);
+		if (previous & kFreshBit)
+		{
+			m_overwritten.fetch_add(1, std::memory_order_relaxed);
+		}
+		Signal();
+	}
+
+	// Consumer side: whether TryConsume would take a frame.
+	bool HasFrame() const
+	{
+		return (m_middle.load(std::memory_order_seq_cst) & kFreshBit) != 0;
+	}
+
+	// Consumer side: takes the latest frame if there is one the consumer has not seen.
+	bool TryConsume(T& frame)
+	{
+		if (!(m_middle.load(std::memory_order_acquire) & kFreshBit))
+		{
+			return false;
+		}
+		const uint32_t previous = m_middle.exchange(m_frontIndex, std::memory_order_acq_rel);
+		m_frontIndex = previous & kIndexMask;
+		frame = std::move(m_slots[m_frontIndex]);
+		m_slots[m_frontIndex] = m_emptyValue;
+		m_consumed.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Consumer side: blocks until a new frame is published, Close is called or the
+	// timeout elapses. Returns false if no frame was taken.
+	bool WaitForFrame(T& frame, unsigned int timeoutMs)
+	{
+		while (true)
+		{
+			const uint32_t sequence = m_sequence.load(std::memory_order_seq_cst);
+			if (TryConsume(frame))
+			{
+				return true;
+			}
+			if (m_closed.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+
+			m_consumerWaiting.store(true, std::memory_order_seq_cst);
+			if (m_sequence.load(std::memory_order_seq_cst) == sequence)
+			{
+				FutexWait(&m_sequence, sequence, timeoutMs);
+			}
+			m_consumerWaiting.store(false, std::memory_order_relaxed);
+
+			if (m_sequence.load(std::memory_order_acquire) == sequence)
+			{
+				// timed out (or spurious wake-up without a new frame)
+				return TryConsume(frame);
+			}
+		}
+	}
+
+	// Wakes up a waiting consumer and makes further waits return immediately.
+	void Close()
+	{
+		m_closed.store(true, std::memory_order_release);
+		Signal();
+	}
+
+	// Drops any pending frame and reopens the mailbox. Only call this while neither
+	// the producer nor the consumer is running.
+	void Reset()
+	{
+		for (auto& slot : m_slots)
+		{
+			slot = m_emptyValue;
+		}
+		m_backIndex = 0;
+		m_middle.store(1, std::memory_order_relaxed);
+		m_frontIndex = 2;
+		m_closed.store(false, std::memory_order_release);
+	}
+
+	MailboxStatistics Statistics() const
+	{
+		MailboxStatistics statistics;
+		statistics.Published = m_published.load(std::memory_order_relaxed);
+		statistics.Consumed = m_consumed.load(std::memory_order_relaxed);
+		statistics.Overwritten = m_overwritten.load(std::memory_order_relaxed);
+		return statistics;
+	}
+
+private:
+	void Signal()
+	{
+		m_sequence.fetch_add(1, std::memory_order_seq_cst);
+		if (m_consumerWaiting.load(std::memory_order_seq_cst))
+		{
+			FutexWakeAll(&m_sequence);
+		}
+	}
+
+	static const uint32_t kIndexMask = 0x3;
+	static const uint32_t kFreshBit = 0x4;
+
+	T m_emptyValue;
+	std::array<T, 3> m_slots;
+
+	// producer owned
+	uint32_t m_backIndex = 0;
+	// shared slot index, with kFreshBit set while it holds an unconsumed frame
+	std::atomic<uint32_t> m_middle{ 1 };
+	// consumer owned
+	uint32_t m_frontIndex = 2;
+
+	std::atomic<uint32_t> m_sequence{ 0 };
+	std::atomic<bool> m_consumerWaiting{ false };
+	std::atomic<bool> m_closed{ false };
+
+	std::atomic<uint64_t> m_published{ 0 };
+	std::atomic<uint64_t> m_consumed{ 0 };
+	std::atomic<uint64_t> m_overwritten{ 0 };
+};
@@ -0,0 +1,196 @@
+#include "LocalFrameExchange.h"
+
+#include <cstring>
+#include <memory>
+
+#include "ImageKernels.h"
+#include "ResearchModeFrameEncoder.h"
+
+bool LocalFrameExchange::PublishResearchMode(
+    IResearchModeSensorFrame* pSensorFrame,
+    ResearchModeSensorType sensorType,
+    bool includeAb,
+    uint64_t timestamp,
+    const Float4x4& pose,
+    const FrameTrace& trace)
+{
+    ResearchModeSensorResolution resolution;
+    if (FAILED(pSensorFrame->GetResolution(&resolution)))
+    {
+        return false;
+    }
+    const size_t pixelCount = static_cast<size_t>(resolution.Width) * resolution.Height;
+
+    LocalFrame frame;
+    frame.Width = resolution.Width;
+    frame.Height = resolution.Height;
+    frame.Sequence = trace.Sequence;
+    frame.Timestamp = timestamp;
+    frame.Pose = pose;
+
+    if (ResearchModeFrameEncoder::IsVisibleLightCamera(sensorType))
+    {
+        IResearchModeSensorVLCFrame* pVlcFrame = nullptr;
+        if (FAILED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVlcFrame))) || !pVlcFrame)
+        {
+            return false;
+        }
+        std::shared_ptr<IResearchModeSensorVLCFrame> spVlcFrame(pVlcFrame, [](IResearchModeSensorVLCFrame* sf) { sf->Release(); });
+
+        const BYTE* pImage = nullptr;
+        size_t imageSize = 0;
+        if (FAILED(spVlcFrame->GetBuffer(&pImage, &imageSize)) || imageSize < pixelCount)
+        {
+            return false;
+        }
+        uint8_t* pData = BeginWrite(pixelCount);
+        if (!pData)
+        {
+            return false;
+        }
+        memcpy(pData, pImage, pixelCount);
+        frame.Format = LocalFrameFormat::Gray8;
+        frame.RowStride = resolution.Width;
+        EndWrite(frame);
+        return true;
+    }
+
+    IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
+    if (FAILED(pSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame))) || !pDepthFrame)
+    {
+        return false;
+    }
+    std::shared_ptr<IResearchModeSensorDepthFrame> spDepthFrame(pDepthFrame, [](IResearchModeSensorDepthFrame* sf) { sf->Release(); });
+
+    const UINT16* pDepth = nullptr;
+    size_t depthCount = 0;
+    if (FAILED(spDepthFrame->GetBuffer(&pDepth, &depthCount)) || depthCount < pixelCount)
+    {
+        return false;
+    }
+    const UINT16* pAb = nullptr;
+    size_t abCount = 0;
+    if (includeAb && (FAILED(spDepthFrame->GetAbDepthBuffer(&pAb, &abCount)) || abCount < pixelCount))
+    {
+        return false;
+    }
+
+    const size_t planeSize = pixelCount * sizeof(UINT16);
+    uint8_t* pData = BeginWrite(pAb ? 2 * planeSize : planeSize);
+    if (!pData)
+    {
+        return false;
+    }
+    memcpy(pData, pDepth, planeSize);
+    if (pAb)
+    {
+        memcpy(pData + planeSize, pAb, planeSize);
+    }
+    frame.Format = pAb ? LocalFrameFormat::Depth16Ab16 : LocalFrameFormat::Depth16;
+    frame.RowStride = resolution.Width * sizeof(UINT16);
+    EndWrite(frame);
+    return true;
+}
+
+bool LocalFrameExchange::PublishVideo(
+    const VideoFrameView& frame,
+    uint64_t timestamp,
+    const Float4x4& pose)
+{
+    if (!frame.pData || frame.Width <= 0 || frame.Height <= 0)
+    {
+        return false;
+    }
+    const bool nv12 = frame.PixelFormat == VideoPixelFormat::Nv12;
+    const int bytesPerPixel = nv12 ? 1 : 4;
+    const size_t lumaSize = static_cast<size_t>(frame.Width) * bytesPerPixel * frame.Height;
+    // the UV plane has half the rows, each of width bytes
+    const int chromaHeight = nv12 ? frame.Height / 2 : 0;
+    const size_t chromaSize = static_cast<size_t>(frame.Width) * chromaHeight;
+    if (frame.DataLength < static_cast<size_t>(frame.RowStride) * (frame.Height - 1) + frame.Width * bytesPerPixel ||
+        (nv12 && (!frame.pChroma || frame.ChromaDataLength <
+            static_cast<size_t>(frame.ChromaRowStride) * (chromaHeight - 1) + frame.Width)))
+    {
+        return false;
+    }
+
+    uint8_t* pData = BeginWrite(lumaSize + chromaSize);
+    if (!pData)
+    {
+        return false;
+    }
+    CopyPlane(frame.pData, frame.Width, frame.Height, frame.RowStride, bytesPerPixel, 1, pData);
+    if (nv12)
+    {
+        CopyPlane(frame.pChroma, frame.Width / 2, chromaHeight, frame.ChromaRowStride, 2, 1, pData + lumaSize);
+    }
+
+    LocalFrame published;
+    published.Format = nv12 ? LocalFrameFormat::Nv12 : LocalFrameFormat::Bgra8;
+    published.Width = static_cast<uint32_t>(frame.Width);
+    published.Height = static_cast<uint32_t>(frame.Height);
+    published.RowStride = static_cast<uint32_t>(frame.Width * bytesPerPixel);
+    published.Sequence = frame.Trace.Sequence;
+    published.Timestamp = timestamp;
+    published.Pose = pose;
+    EndWrite(published);
+    return true;
+}
+
+bool LocalFrameExchange::Acquire(
+    LocalFrame& frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_latest < 0)
+    {
+        return false;
+    }
+    m_held = m_latest;
+    frame = m_slots[m_held].Frame;
+    frame.pData = m_slots[m_held].Data.data();
+    frame.Size = static_cast<uint32_t>(m_slots[m_held].Data.size());
+    ++m_statistics.Acquired;
+    return true;
+}
+
+void LocalFrameExchange::Release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_held = -1;
+}
+
+LocalFrameStatistics LocalFrameExchange::Statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+uint8_t* LocalFrameExchange::BeginWrite(
+    size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_statistics.Published;
+        const int next = (m_latest == 0) ? 1 : 0;
+        if (next == m_held)
+        {
+            ++m_statistics.Dropped;
+            return nullptr;
+        }
+        m_writing = next;
+    }
+    // the consumer only ever takes the latest slot, so this one is the stream's
+    // until EndWrite; it only reallocates when the frames grow
+    std::vector<uint8_t>& data = m_slots[m_writing].Data;
+    data.resize(size);
+    return data.data();
+}
+
+void LocalFrameExchange::EndWrite(
+    const LocalFrame& frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_slots[m_writing].Frame = frame;
+    m_latest = m_writing;
+    m_writing = -1;
+}
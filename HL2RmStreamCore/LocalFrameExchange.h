@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "FrameHeaders.h"
+#include "FrameTrace.h"
+#include "PortableResearchModeApi.h"
+#include "VideoFrameView.h"
+
+// Layout of the pixels of a LocalFrame.
+enum class LocalFrameFormat : uint32_t
+{
+	// PV: 4 bytes per pixel
+	Bgra8 = 0,
+	// PV: the Y plane, then the interleaved UV plane at half the resolution
+	Nv12 = 1,
+	// visible light cameras: 1 byte per pixel
+	Gray8 = 2,
+	// AHAT and Long Throw: 16 bit depth in millimetres, little-endian, as the
+	// sensor delivers it, i.e. not yet invalidated: AHAT values from
+	// ResearchModeFrameEncoder::kAhatMaxValue on are invalid, Long Throw ones
+	// whose sigma has the most significant bit set
+	Depth16 = 3,
+	// Depth16 followed by the 16 bit active brightness image of the same size
+	Depth16Ab16 = 4
+};
+
+// A frame as an in-process consumer gets it from a LocalFrameExchange, laid out
+// for the exported functions of the plugin: 104 bytes, no padding.
+struct LocalFrame
+{
+	// the pixels, valid until the consumer releases the frame
+	const uint8_t* pData = nullptr;
+	// bytes at pData
+	uint32_t Size = 0;
+	LocalFrameFormat Format = LocalFrameFormat::Bgra8;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	// bytes between the starts of two rows of the first plane; rows are packed
+	uint32_t RowStride = 0;
+	// the number of the frame in its stream, see FrameTrace
+	uint32_t Sequence = 0;
+	// the Timestamp of the frame headers of the stream
+	uint64_t Timestamp = 0;
+	// Rig2World of research mode frames, PVtoWorld of PV frames
+	Float4x4 Pose = Float4x4::Identity();
+};
+
+static_assert(sizeof(LocalFrame) == 104, "LocalFrame is mirrored by the Unity scripts");
+
+struct LocalFrameStatistics
+{
+	// frames the stream handed to the exchange
+	uint64_t Published = 0;
+	// frames dropped because the consumer still held the buffer they needed
+	uint64_t Dropped = 0;
+	// frames taken by the consumer; one taken twice counts twice
+	uint64_t Acquired = 0;
+};
+
+// The latest frame of a stream in native memory, for a consumer in the same
+// process, e.g. a Unity script that copies it into a texture without going
+// through a socket. Double-buffered: the stream copies every frame once into the
+// buffer the consumer does not see and then makes it the latest; the consumer
+// reads the latest in place from Acquire until Release. The stream never waits
+// for the consumer: while the consumer still holds the older buffer, a new frame
+// has nowhere to go and is dropped, so consumers release right after copying.
+// One stream publishes and one consumer acquires; both may be any thread.
+class LocalFrameExchange
+{
+public:
+	// Copies the image of a research mode frame of sensorType, with the AB image
+	// if includeAb and the sensor is a depth sensor. Returns false if the frame
+	// was dropped or has no image.
+	bool PublishResearchMode(
+		IResearchModeSensorFrame* pSensorFrame,
+		ResearchModeSensorType sensorType,
+		bool includeAb,
+		uint64_t timestamp,
+		const Float4x4& pose,
+		const FrameTrace& trace);
+
+	// Copies the pixels of a Bgra8 or Nv12 frame, packing its rows. Returns false if
+	// the frame was dropped or is not complete.
+	bool PublishVideo(
+		const VideoFrameView& frame,
+		uint64_t timestamp,
+		const Float4x4& pose);
+
+	// Consumer side: takes the latest frame, if there is one, and holds its buffer
+	// until Release or the next Acquire.
+	bool Acquire(
+		LocalFrame& frame);
+
+	void Release();
+
+	LocalFrameStatistics Statistics() const;
+
+private:
+	// Returns the buffer of the next frame, resized to size, or nullptr if the
+	// consumer holds it.
+	uint8_t* BeginWrite(
+		size_t size);
+
+	// Makes the buffer of BeginWrite the latest frame.
+	void EndWrite(
+		const LocalFrame& frame);
+
+	struct Slot
+	{
+		std::vector<uint8_t> Data;
+		LocalFrame Frame;
+	};
+
+	mutable std::mutex m_mutex;
+	std::array<Slot, 2> m_slots;
+	// the slot with the latest frame, -1 before the first one
+	int m_latest = -1;
+	// the slot the consumer reads, -1 for none
+	int m_held = -1;
+	// the slot the stream writes between BeginWrite and EndWrite
+	int m_writing = -1;
+	LocalFrameStatistics m_statistics;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+// Minimal platform layer for the streaming core. On Windows the core is compiled
+// into the plugin and uses the real Win32 definitions; everywhere else the handful
+// of types and debug helpers the core relies on are provided here, so that the
+// pipeline can be built and profiled on a desktop machine.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdarg>
+#include <cwchar>
+
+#if defined(_WIN32)
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+#else
+
+typedef int32_t HRESULT;
+typedef uint8_t BYTE;
+typedef uint16_t USHORT;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint32_t ULONG;
+typedef uint64_t UINT64;
+typedef const wchar_t* LPCWSTR;
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_ABORT ((HRESULT)0x80004004L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFFL)
+#define E_ACCESSDENIED ((HRESULT)0x80070005L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+// debug output goes to stderr; only ASCII is expected in our messages
+inline void OutputDebugStringW(LPCWSTR message)
+{
+    char buffer[512];
+    size_t i = 0;
+    for (; message[i] != L'\0' && i < sizeof(buffer) - 1; ++i)
+    {
+        buffer[i] = (message[i] < 0x80) ? static_cast<char>(message[i]) : '?';
+    }
+    buffer[i] = '\0';
+    fputs(buffer, stderr);
+}
+
+template <size_t N>
+inline int swprintf_s(wchar_t(&buffer)[N], const wchar_t* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int result = vswprintf(buffer, N, format, args);
+    va_end(args);
+    return result;
+}
+
+#endif
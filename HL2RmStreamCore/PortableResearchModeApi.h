@@ -0,0 +1,246 @@
+#pragma once
+
+// On the device this simply pulls in the Research Mode API header from the plugin.
+// On other platforms it declares the same types and interfaces with a minimal
+// IUnknown, so that synthetic sensors can stand in for the real ones.
+
+#include "Platform.h"
+
+#if defined(_WIN32)
+
+#include "ResearchModeApi.h"
+
+#define RM_IID_OF(type) __uuidof(type)
+
+#else
+
+#include <type_traits>
+
+#define STDMETHOD(method) virtual HRESULT method
+#define STDMETHOD_(type, method) virtual type method
+#define STDMETHODIMP HRESULT
+#define STDMETHODIMP_(type) type
+
+// Interface ids are only compared within a single process here, so the address of
+// a per-interface static is enough to identify an interface.
+typedef const void* REFIID;
+
+template <typename TInterface>
+REFIID InterfaceIdOf()
+{
+    static const char s_tag = 0;
+    return &s_tag;
+}
+
+#define RM_IID_OF(type) InterfaceIdOf<type>()
+#define IID_PPV_ARGS(ppType) \
+    InterfaceIdOf<std::remove_pointer_t<std::remove_pointer_t<decltype(ppType)>>>(), \
+    reinterpret_cast<void**>(ppType)
+
+struct IUnknown
+{
+    STDMETHOD(QueryInterface)(REFIID riid, void** ppvObject) = 0;
+    STDMETHOD_(ULONG, AddRef)() = 0;
+    STDMETHOD_(ULONG, Release)() = 0;
+};
+
+namespace DirectX
+{
+    struct XMFLOAT3
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    struct XMFLOAT4X4
+    {
+        float m[4][4];
+    };
+}
+
+struct LUID
+{
+    uint32_t LowPart;
+    int32_t HighPart;
+};
+
+struct AccelDataStruct
+{
+    uint64_t VinylHupTicks;
+    uint64_t SocTicks;
+    float AccelValues[3];
+    float temperature;
+};
+
+struct GyroDataStruct
+{
+    uint64_t VinylHupTicks;
+    uint64_t SocTicks;
+    float GyroValues[3];
+    float temperature;
+};
+
+struct MagDataStruct
+{
+    uint64_t VinylHupTicks;
+    uint64_t SocTicks;
+    float MagValues[3];
+};
+
+enum ResearchModeSensorType
+{
+    LEFT_FRONT,
+    LEFT_LEFT,
+    RIGHT_FRONT,
+    RIGHT_RIGHT,
+    DEPTH_AHAT,
+    DEPTH_LONG_THROW,
+    IMU_ACCEL,
+    IMU_GYRO,
+    IMU_MAG
+};
+
+struct ResearchModeSensorDescriptor
+{
+    LUID sensorId;
+    ResearchModeSensorType sensorType;
+};
+
+enum ResearchModeSensorTimestampSource
+{
+    SensorTimestampSource_USB_SOF = 0,
+    SensorTimestampSource_Unknown = 1,
+    SensorTimestampSource_CenterOfExposure = 2,
+    SensorTimestampSource_Count = 3
+};
+
+struct ResearchModeSensorTimestamp {
+    ResearchModeSensorTimestampSource Source;
+    UINT64 SensorTicks;
+    UINT64 SensorTicksPerSecond;
+    UINT64 HostTicks;
+    UINT64 HostTicksPerSecond;
+};
+
+struct ResearchModeSensorResolution {
+    UINT32 Width;
+    UINT32 Height;
+    UINT32 Stride;
+    UINT32 BitsPerPixel;
+    UINT32 BytesPerPixel;
+};
+
+enum ResearchModeSensorConsent {
+    DeniedBySystem = 0,
+    NotDeclaredByApp = 1,
+    DeniedByUser = 2,
+    UserPromptRequired = 3,
+    Allowed = 4
+};
+
+struct IResearchModeSensorFrame;
+
+struct IResearchModeSensor : public IUnknown
+{
+    STDMETHOD(OpenStream()) = 0;
+    STDMETHOD(CloseStream()) = 0;
+    STDMETHOD_(LPCWSTR, GetFriendlyName)() = 0;
+    STDMETHOD_(ResearchModeSensorType, GetSensorType)() = 0;
+
+    STDMETHOD(GetSampleBufferSize(
+        size_t* pSampleBufferSize)) = 0;
+    STDMETHOD(GetNextBuffer(
+        IResearchModeSensorFrame** ppSensorFrame)) = 0;
+};
+
+struct IResearchModeCameraSensor : public IUnknown
+{
+    STDMETHOD(MapImagePointToCameraUnitPlane(
+        float(&uv)[2],
+        float(&xy)[2])) = 0;
+    STDMETHOD(MapCameraSpaceToImagePoint(
+        float(&xy)[2],
+        float(&uv)[2])) = 0;
+    STDMETHOD(GetCameraExtrinsicsMatrix(DirectX::XMFLOAT4X4* pCameraViewMatrix)) = 0;
+};
+
+struct IResearchModeAccelSensor : public IUnknown
+{
+    STDMETHOD(GetExtrinsicsMatrix(DirectX::XMFLOAT4X4* pAccel)) = 0;
+};
+
+struct IResearchModeGyroSensor : public IUnknown
+{
+    STDMETHOD(GetExtrinsicsMatrix(DirectX::XMFLOAT4X4* pGyro)) = 0;
+};
+
+struct IResearchModeMagSensor : public IUnknown
+{
+};
+
+struct IResearchModeDepthSensor : public IUnknown
+{
+};
+
+struct IResearchModeSensorFrame : public IUnknown
+{
+    STDMETHOD(GetResolution(
+        ResearchModeSensorResolution* pResolution)) = 0;
+    // For frames with batched samples this returns the time stamp for the first sample in the frame.
+    STDMETHOD(GetTimeStamp(
+        ResearchModeSensorTimestamp* pTimeStamp)) = 0;
+};
+
+struct IResearchModeSensorVLCFrame : public IUnknown
+{
+    STDMETHOD(GetBuffer(
+        const BYTE** ppBytes,
+        size_t* pBufferOutLength)) = 0;
+    STDMETHOD(GetGain(
+        UINT32* pGain)) = 0;
+    STDMETHOD(GetExposure(
+        UINT64* pExposure)) = 0;
+};
+
+struct IResearchModeSensorDepthFrame : public IUnknown
+{
+    STDMETHOD(GetBuffer(
+        const UINT16** ppBytes,
+        size_t* pBufferOutLength)) = 0;
+    STDMETHOD(GetAbDepthBuffer(
+        const UINT16** ppBytes,
+        size_t* pBufferOutLength)) = 0;
+    STDMETHOD(GetSigmaBuffer(
+        const BYTE** ppBytes,
+        size_t* pBufferOutLength)) = 0;
+};
+
+struct IResearchModeAccelFrame : public IUnknown
+{
+    STDMETHOD(GetCalibratedAccelaration(
+        DirectX::XMFLOAT3* pAccel)) = 0;
+    STDMETHOD(GetCalibratedAccelarationSamples(
+        const AccelDataStruct** ppAccelBuffer,
+        size_t* pBufferOutLength)) = 0;
+};
+
+struct IResearchModeGyroFrame : public IUnknown
+{
+    STDMETHOD(GetCalibratedGyro(
+        DirectX::XMFLOAT3* pGyro)) = 0;
+    STDMETHOD(GetCalibratedGyroSamples(
+        const GyroDataStruct** ppAccelBuffer,
+        size_t* pBufferOutLength)) = 0;
+};
+
+struct IResearchModeMagFrame : public IUnknown
+{
+    STDMETHOD(GetMagnetometer(
+        DirectX::XMFLOAT3* pMag)) = 0;
+    STDMETHOD(GetMagnetometerSamples(
+        const MagDataStruct** ppMagBuffer,
+        size_t* pBufferOutLength)) = 0;
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const uint64_t kTicksPerMs = 10'000;
+}
+
+Float4x4 RigidPose::ToMatrix() const
+{
+    const float x = Orientation[0];
+    const float y = Orientation[1];
+    const float z = Orientation[2];
+    const float w = Orientation[3];
+
+    // same layout as make_float4x4_from_quaternion * make_float4x4_translation
+    return { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f,
+        2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f,
+        2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f,
+        Position[0], Position[1], Position[2], 1.0f };
+}
+
+RigidPose RigidPose::Interpolate(
+    const RigidPose& a,
+    const RigidPose& b,
+    float t)
+{
+    RigidPose pose;
+    for (int i = 0; i < 3; ++i)
+    {
+        pose.Position[i] = a.Position[i] + t * (b.Position[i] - a.Position[i]);
+    }
+
+    // q and -q are the same rotation; take the shorter arc
+    float cosAngle = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        cosAngle += a.Orientation[i] * b.Orientation[i];
+    }
+    const float sign = (cosAngle < 0.0f) ? -1.0f : 1.0f;
+    cosAngle *= sign;
+
+    float weightA = 1.0f - t;
+    float weightB = t;
+    if (cosAngle < 0.9995f)
+    {
+        const float angle = std::acos(cosAngle);
+        const float sinAngle = std::sin(angle);
+        weightA = std::sin((1.0f - t) * angle) / sinAngle;
+        weightB = std::sin(t * angle) / sinAngle;
+    }
+    // else nearly the same rotation, where lerp is exact enough and slerp divides by ~0
+
+    float norm = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        pose.Orientation[i] = weightA * a.Orientation[i] + sign * weightB * b.Orientation[i];
+        norm += pose.Orientation[i] * pose.Orientation[i];
+    }
+    norm = std::sqrt(norm);
+    for (int i = 0; i < 4; ++i)
+    {
+        pose.Orientation[i] /= norm;
+    }
+    return pose;
+}
+
+PoseCache::PoseCache(const PoseCacheSettings& settings) :
+    m_settings(settings),
+    m_maxGapTicks(settings.MaxGapMs * kTicksPerMs),
+    m_maxHoldTicks(settings.MaxHoldMs * kTicksPerMs),
+    m_samples(std::max(2u, settings.Capacity))
+{
+}
+
+void PoseCache::Add(
+    uint64_t timestamp,
+    const RigidPose& pose)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count > 0 && timestamp <= At(m_count - 1).Timestamp)
+    {
+        return;
+    }
+
+    if (m_count == m_samples.size())
+    {
+        // overwrite the oldest sample
+        m_first = (m_first + 1) % m_samples.size();
+        m_count--;
+    }
+    m_samples[(m_first + m_count) % m_samples.size()] = { timestamp, pose };
+    m_count++;
+    m_statistics.Samples++;
+}
+
+bool PoseCache::TryGetPose(
+    uint64_t timestamp,
+    RigidPose& pose,
+    bool allowHold)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count == 0 || timestamp < At(0).Timestamp)
+    {
+        m_statistics.Missed++;
+        return false;
+    }
+
+    const TimedPose& newest = At(m_count - 1);
+    if (timestamp >= newest.Timestamp)
+    {
+        if (timestamp == newest.Timestamp)
+        {
+            pose = newest.Pose;
+            m_statistics.Interpolated++;
+            return true;
+        }
+        if (allowHold && timestamp - newest.Timestamp <= m_maxHoldTicks)
+        {
+            pose = newest.Pose;
+            m_statistics.Held++;
+            return true;
+        }
+        m_statistics.Missed++;
+        return false;
+    }
+
+    // first sample after timestamp; At(0) is at or before it and newest after it
+    size_t low = 1;
+    size_t high = m_count - 1;
+    while (low < high)
+    {
+        const size_t middle = low + (high - low) / 2;
+        if (At(middle).Timestamp <= timestamp)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    const TimedPose& before = At(low - 1);
+    const TimedPose& after = At(low);
+    const uint64_t gap = after.Timestamp - before.Timestamp;
+    if (gap > m_maxGapTicks)
+    {
+        // the pose was unknown for too long to assume smooth motion
+        m_statistics.Missed++;
+        return false;
+    }
+    pose = RigidPose::Interpolate(before.Pose, after.Pose,
+        static_cast<float>(static_cast<double>(timestamp - before.Timestamp) / static_cast<double>(gap)));
+    m_statistics.Interpolated++;
+    return true;
+}
+
+uint64_t PoseCache::NewestTimestamp() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (m_count > 0) ? At(m_count - 1).Timestamp : 0;
+}
+
+PoseCacheStatistics PoseCache::Statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
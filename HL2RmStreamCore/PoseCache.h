@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "FrameHeaders.h"
+
+// Rigid pose: a rotation quaternion (x, y, z, w) followed by a translation.
+struct RigidPose
+{
+	float Orientation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float Position[3] = { 0.0f, 0.0f, 0.0f };
+
+	// the transform in the row vector convention of the frame headers, i.e. the
+	// rotation matrix of Orientation with Position in the last row
+	Float4x4 ToMatrix() const;
+
+	// slerp of the orientation and lerp of the position, t from 0 (a) to 1 (b)
+	static RigidPose Interpolate(
+		const RigidPose& a,
+		const RigidPose& b,
+		float t);
+};
+
+struct PoseCacheSettings
+{
+	// samples kept, enough to cover the latency of the slowest stream
+	uint32_t Capacity = 128;
+	// largest interval between two samples that is interpolated across
+	uint32_t MaxGapMs = 100;
+	// how far past the newest sample its pose may still be reported
+	uint32_t MaxHoldMs = 50;
+};
+
+struct PoseCacheStatistics
+{
+	// samples handed to Add
+	uint64_t Samples = 0;
+	// lookups at or between samples
+	uint64_t Interpolated = 0;
+	// lookups answered with the newest sample
+	uint64_t Held = 0;
+	// lookups without a pose
+	uint64_t Missed = 0;
+};
+
+// Ring buffer of timestamped poses, sampled at a steady rate by one thread and
+// looked up at the frame timestamps of any number of streams. Timestamps are in
+// 100 ns ticks of whatever clock the frames use. Thread-safe.
+class PoseCache
+{
+public:
+	explicit PoseCache(const PoseCacheSettings& settings = PoseCacheSettings());
+
+	// samples must arrive in time order; older ones are ignored
+	void Add(
+		uint64_t timestamp,
+		const RigidPose& pose);
+
+	// Interpolates between the samples around timestamp. Past the newest sample,
+	// reports that sample only if allowHold and it is at most MaxHoldMs older.
+	// Returns false if neither applies, e.g. the timestamp fell out of the buffer.
+	bool TryGetPose(
+		uint64_t timestamp,
+		RigidPose& pose,
+		bool allowHold = true);
+
+	// timestamp of the newest sample, 0 while there is none
+	uint64_t NewestTimestamp() const;
+
+	PoseCacheStatistics Statistics() const;
+
+private:
+	struct TimedPose
+	{
+		uint64_t Timestamp;
+		RigidPose Pose;
+	};
+
+	// i-th oldest sample
+	const TimedPose& At(size_t i) const { return m_samples[(m_first + i) % m_samples.size()]; }
+
+	PoseCacheSettings m_settings;
+	uint64_t m_maxGapTicks;
+	uint64_t m_maxHoldTicks;
+
+	mutable std::mutex m_mutex;
+	std::vector<TimedPose> m_samples;
+	size_t m_first = 0;
+	size_t m_count = 0;
+	PoseCacheStatistics m_statistics;
+};
@@ -0,0 +1,124 @@
+#include "RateControlLoop.h"
+
+#include <algorithm>
+
+#include "FrameTrace.h"
+#include "Platform.h"
+
+#define DBG_ENABLE_INFO_LOGGING 1
+
+size_t RateControlLoop::AddStream(
+    RateControlledStream stream)
+{
+    RateController controller(stream.Settings);
+    if (stream.ApplyLevel)
+    {
+        stream.ApplyLevel(controller.Level());
+    }
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_streams.push_back({ std::move(stream), controller, std::chrono::steady_clock::now() });
+    return m_streams.size() - 1;
+}
+
+void RateControlLoop::SetBestLevel(
+    size_t stream,
+    const RateLevel& level)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (stream >= m_streams.size())
+    {
+        return;
+    }
+    ControlledStream& controlled = m_streams[stream];
+    controlled.Stream.Settings = WithBestLevel(controlled.Stream.Settings, level);
+    controlled.Controller = RateController(controlled.Stream.Settings);
+    if (controlled.Stream.ApplyLevel)
+    {
+        controlled.Stream.ApplyLevel(controlled.Controller.Level());
+    }
+}
+
+RateLevel RateControlLoop::GetBestLevel(
+    size_t stream) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (stream >= m_streams.size())
+    {
+        return RateLevel();
+    }
+    return BestLevel(m_streams[stream].Stream.Settings);
+}
+
+void RateControlLoop::Start()
+{
+    if (isRunning)
+    {
+        return;
+    }
+    m_fExit = false;
+    m_controlThread = std::thread(ControlThread, this);
+    isRunning = true;
+}
+
+void RateControlLoop::Stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_fExit = true;
+    }
+    m_exitRequested.notify_all();
+    if (m_controlThread.joinable())
+    {
+        m_controlThread.join();
+    }
+    isRunning = false;
+}
+
+std::vector<RateControlStatistics> RateControlLoop::Statistics() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::vector<RateControlStatistics> statistics;
+    statistics.reserve(m_streams.size());
+    for (const auto& stream : m_streams)
+    {
+        statistics.push_back(stream.Controller.Statistics());
+    }
+    return statistics;
+}
+
+void RateControlLoop::ControlThread(RateControlLoop* pLoop)
+{
+    std::unique_lock<std::mutex> lock(pLoop->m_mutex);
+    while (!pLoop->m_fExit)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto next = now + std::chrono::seconds(1);
+        for (auto& stream : pLoop->m_streams)
+        {
+            if (stream.NextUpdate <= now)
+            {
+                // a steady period, without drifting by the time the update takes
+                stream.NextUpdate = std::max(stream.NextUpdate +
+                    std::chrono::milliseconds(std::max(1u, stream.Stream.Settings.PeriodMs)), now);
+                if (stream.Stream.GetQueueStatistics &&
+                    stream.Controller.Update(stream.Stream.GetQueueStatistics(), MonotonicTicks()))
+                {
+                    const RateLevel& level = stream.Controller.Level();
+#if DBG_ENABLE_INFO_LOGGING
+                    wchar_t msgBuffer[200];
+                    swprintf_s(msgBuffer, L"RateControlLoop::ControlThread: %ls at %u ms, 1/%u, format %u.\n",
+                        stream.Stream.Name.c_str(), static_cast<uint32_t>(level.MinDelta / 10'000),
+                        level.Decimation, static_cast<uint32_t>(level.PixelFormat));
+                    OutputDebugStringW(msgBuffer);
+#endif
+                    if (stream.Stream.ApplyLevel)
+                    {
+                        stream.Stream.ApplyLevel(level);
+                    }
+                }
+            }
+            next = std::min(next, stream.NextUpdate);
+        }
+        pLoop->m_exitRequested.wait_until(lock, next, [pLoop]() { return pLoop->m_fExit.load(); });
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RateController.h"
+
+// A stream under rate control: where its queue statistics come from and how a
+// level is put into effect, e.g. by SetMinDelta of its processor and SetEncoding
+// of its streamer.
+struct RateControlledStream
+{
+	// for the log, e.g. the port
+	std::wstring Name;
+	RateControlSettings Settings;
+	std::function<SendQueueStatistics()> GetQueueStatistics;
+	std::function<void(const RateLevel&)> ApplyLevel;
+};
+
+// Runs a RateController per stream on a thread of its own, each at the period of
+// its settings.
+class RateControlLoop
+{
+public:
+	~RateControlLoop()
+	{
+		Stop();
+	}
+
+	// Applies the best level of stream right away and returns the index of the
+	// stream. Call before Start.
+	size_t AddStream(
+		RateControlledStream stream);
+
+	// Makes level the best level of a stream, widening its limits where level is
+	// beyond them (see WithBestLevel), and applies it right away; the controller
+	// starts over from there. May be called from any thread, e.g. for a client
+	// that asks for another rate.
+	void SetBestLevel(
+		size_t stream,
+		const RateLevel& level);
+
+	RateLevel GetBestLevel(
+		size_t stream) const;
+
+	void Start();
+
+	void Stop();
+
+	// one entry per stream, in the order they were added
+	std::vector<RateControlStatistics> Statistics() const;
+
+	bool isRunning = false;
+
+private:
+	struct ControlledStream
+	{
+		RateControlledStream Stream;
+		RateController Controller;
+		std::chrono::steady_clock::time_point NextUpdate;
+	};
+
+	static void ControlThread(
+		RateControlLoop* pLoop);
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_exitRequested;
+	std::vector<ControlledStream> m_streams;
+
+	std::atomic<bool> m_fExit{ false };
+	std::thread m_controlThread;
+};
@@ -0,0 +1,224 @@
+#include "RateController.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint64_t kTicksPerMs = 10'000;
+    const double kTicksPerSecond = 10'000'000.0;
+    // share of the capacity estimate a step up may take
+    const double kHeadroom = 0.9;
+    // growth of the capacity estimate per clean period
+    const double kCapacityGrowth = 1.02;
+
+    // position in the order the controller falls back through the wire formats
+    int FormatRank(VideoPixelFormat format)
+    {
+        switch (format)
+        {
+        case VideoPixelFormat::Nv12:
+            return 1;
+        case VideoPixelFormat::Luma8:
+            return 2;
+        default:
+            return 0;
+        }
+    }
+
+    double BytesPerPixel(VideoPixelFormat format)
+    {
+        switch (format)
+        {
+        case VideoPixelFormat::Nv12:
+            return 1.5;
+        case VideoPixelFormat::Luma8:
+            return 1.0;
+        default:
+            return 3.0;
+        }
+    }
+}
+
+RateLevel BestLevel(
+    const RateControlSettings& settings)
+{
+    RateLevel level;
+    level.MinDelta = settings.MinIntervalMs * kTicksPerMs;
+    level.Decimation = std::max(1u, settings.MinDecimation);
+    level.PixelFormat = settings.PixelFormat;
+    return level;
+}
+
+RateControlSettings WithBestLevel(
+    const RateControlSettings& settings,
+    const RateLevel& level)
+{
+    RateControlSettings best = settings;
+    best.MinIntervalMs = static_cast<uint32_t>(level.MinDelta / kTicksPerMs);
+    best.MaxIntervalMs = std::max(best.MaxIntervalMs, best.MinIntervalMs);
+    best.MinDecimation = std::max(1u, level.Decimation);
+    best.MaxDecimation = std::max(best.MaxDecimation, best.MinDecimation);
+    best.PixelFormat = level.PixelFormat;
+    if (FormatRank(best.CheapestPixelFormat) < FormatRank(best.PixelFormat))
+    {
+        best.CheapestPixelFormat = best.PixelFormat;
+    }
+    return best;
+}
+
+RateController::RateController(
+    const RateControlSettings& settings) :
+    m_settings(settings),
+    m_level(BestLevel(settings))
+{
+}
+
+bool RateController::Update(
+    const SendQueueStatistics& statistics,
+    uint64_t now)
+{
+    if (!m_hasLast || now <= m_lastTime || statistics.Queued < m_last.Queued ||
+        statistics.Dropped < m_last.Dropped || statistics.SentBytes < m_last.SentBytes)
+    {
+        m_hasLast = true;
+        m_last = statistics;
+        m_lastTime = now;
+        return false;
+    }
+
+    const uint64_t elapsed = now - m_lastTime;
+    const uint64_t queued = statistics.Queued - m_last.Queued;
+    const uint64_t dropped = statistics.Dropped - m_last.Dropped;
+    const double throughput = static_cast<double>(statistics.SentBytes - m_last.SentBytes) *
+        kTicksPerSecond / static_cast<double>(elapsed);
+    m_last = statistics;
+    m_lastTime = now;
+
+    m_statistics.Throughput = static_cast<uint64_t>(throughput);
+    if (queued == 0 && dropped == 0)
+    {
+        // nobody is listening, which says nothing about the link
+        m_cleanPeriods = 0;
+        return false;
+    }
+    if (m_holdPeriods > 0)
+    {
+        // frames queued before the last step down are still draining
+        m_holdPeriods--;
+        m_cleanPeriods = 0;
+        return false;
+    }
+
+    if (dropped > 0)
+    {
+        // the link is saturated, so this is what it can carry right now; a period
+        // without a single write only says it is less than before
+        m_capacity = (throughput > 0.0) ? throughput : m_capacity / 2.0;
+        m_cleanPeriods = 0;
+        if (!StepDown())
+        {
+            return false;
+        }
+        m_holdPeriods = 1;
+        m_statistics.StepsDown++;
+        return true;
+    }
+
+    m_cleanPeriods++;
+    m_capacity *= kCapacityGrowth;
+    if (m_cleanPeriods < m_settings.StepUpPeriods || m_steps.empty())
+    {
+        return false;
+    }
+
+    const Step& step = m_steps.back();
+    if (m_capacity > 0.0 && throughput * step.Saving > m_capacity * kHeadroom)
+    {
+        return false;
+    }
+    m_level = step.Previous;
+    // the knob just undone is the first to give again
+    m_nextKnob = static_cast<int>(step.Changed);
+    m_steps.pop_back();
+    m_cleanPeriods = 0;
+    m_statistics.StepsUp++;
+    return true;
+}
+
+RateControlStatistics RateController::Statistics() const
+{
+    RateControlStatistics statistics = m_statistics;
+    statistics.Level = m_level;
+    statistics.Capacity = static_cast<uint64_t>(m_capacity);
+    return statistics;
+}
+
+bool RateController::StepDown()
+{
+    const int knobCount = 3;
+    for (int i = 0; i < knobCount; ++i)
+    {
+        const Knob knob = static_cast<Knob>((m_nextKnob + i) % knobCount);
+        RateLevel level;
+        double saving = 1.0;
+        if (NextLevel(knob, level, saving))
+        {
+            m_steps.push_back({ m_level, knob, saving });
+            m_level = level;
+            m_nextKnob = (static_cast<int>(knob) + 1) % knobCount;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RateController::NextLevel(
+    Knob knob,
+    RateLevel& level,
+    double& saving) const
+{
+    level = m_level;
+    switch (knob)
+    {
+    case Knob::Interval:
+    {
+        // sending every frame is sending at the sensor interval
+        const uint64_t interval = m_level.MinDelta ? m_level.MinDelta : m_settings.SensorIntervalMs * kTicksPerMs;
+        const uint64_t maxInterval = m_settings.MaxIntervalMs * kTicksPerMs;
+        if (interval == 0 || interval >= maxInterval)
+        {
+            return false;
+        }
+        level.MinDelta = std::min(maxInterval, interval * m_settings.IntervalStepPercent / 100);
+        if (level.MinDelta <= interval)
+        {
+            return false;
+        }
+        saving = static_cast<double>(level.MinDelta) / static_cast<double>(interval);
+        return true;
+    }
+    case Knob::Decimation:
+    {
+        if (m_level.Decimation >= m_settings.MaxDecimation)
+        {
+            return false;
+        }
+        level.Decimation = m_level.Decimation + 1;
+        const double ratio = static_cast<double>(level.Decimation) / m_level.Decimation;
+        saving = ratio * ratio;
+        return true;
+    }
+    case Knob::PixelFormat:
+    {
+        const int rank = FormatRank(m_level.PixelFormat);
+        if (rank >= FormatRank(m_settings.CheapestPixelFormat))
+        {
+            return false;
+        }
+        level.PixelFormat = (rank == 0) ? VideoPixelFormat::Nv12 : VideoPixelFormat::Luma8;
+        saving = BytesPerPixel(m_level.PixelFormat) / BytesPerPixel(level.PixelFormat);
+        return true;
+    }
+    }
+    return false;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FrameHeaders.h"
+#include "FrameSendQueue.h"
+
+// Limits within which a RateController may change what a stream sends. Knobs
+// whose limits are equal stay where they are.
+struct RateControlSettings
+{
+	// how often the send queues are looked at
+	uint32_t PeriodMs = 500;
+	// Frame interval of the best level, the interval at which the sensor delivers
+	// frames to send all of them; 0 sends every frame.
+	uint32_t MinIntervalMs = 0;
+	// The interval at which the sensor delivers frames, where the first step down
+	// from a best level of 0 starts. Stays put when MinIntervalMs is changed, e.g.
+	// by WithBestLevel; 0 leaves a best level of 0 alone.
+	uint32_t SensorIntervalMs = 0;
+	// longest frame interval the controller falls back to
+	uint32_t MaxIntervalMs = 500;
+	// factor between two interval steps, in percent
+	uint32_t IntervalStepPercent = 150;
+	// decimation of the video image, see VideoFrameEncoder::scaleFactor
+	uint32_t MinDecimation = 1;
+	uint32_t MaxDecimation = 1;
+	// The wire format of the best level and the cheapest one the controller falls
+	// back to, in the order Bgr8, Nv12, Luma8. The frames have to be captured in
+	// the format each of them needs, see VideoFrameEncoder::CaptureFormatFor.
+	VideoPixelFormat PixelFormat = VideoPixelFormat::Bgr8;
+	VideoPixelFormat CheapestPixelFormat = VideoPixelFormat::Bgr8;
+	// periods without drops before the controller tries a better level
+	uint32_t StepUpPeriods = 4;
+};
+
+// What a stream sends at one level of a RateController.
+struct RateLevel
+{
+	// the minDelta of the frame processor, in 100 ns ticks; 0 sends every frame
+	uint64_t MinDelta = 0;
+	uint32_t Decimation = 1;
+	VideoPixelFormat PixelFormat = VideoPixelFormat::Bgr8;
+
+	bool operator==(const RateLevel& other) const
+	{
+		return MinDelta == other.MinDelta && Decimation == other.Decimation && PixelFormat == other.PixelFormat;
+	}
+
+	bool operator!=(const RateLevel& other) const { return !(*this == other); }
+};
+
+// the level of settings that sends the most
+RateLevel BestLevel(
+	const RateControlSettings& settings);
+
+// Settings whose best level is level, with the limits widened where level is
+// beyond them. The interval is kept to whole milliseconds.
+RateControlSettings WithBestLevel(
+	const RateControlSettings& settings,
+	const RateLevel& level);
+
+struct RateControlStatistics
+{
+	RateLevel Level;
+	// level changes for the worse and for the better
+	uint64_t StepsDown = 0;
+	uint64_t StepsUp = 0;
+	// bytes per second written in the last period
+	uint64_t Throughput = 0;
+	// bytes per second the link carried the last time it was saturated, 0 while
+	// it never was
+	uint64_t Capacity = 0;
+};
+
+// Adapts frame interval, decimation and wire format of a stream to the link it is
+// sent over, from the statistics of its send queues. Frames dropped by a queue
+// mean the link is saturated: the controller steps down one knob at a time, round
+// robin, and notes the bytes per second the link carried. After StepUpPeriods
+// clean periods it undoes the last step if the bytes per second that step would
+// take fit below that capacity. The capacity estimate grows a little with every
+// clean period, so that a link that recovered is found again. All subscribers of
+// a stream share its frames, so the slowest one sets the level. Not thread-safe.
+class RateController
+{
+public:
+	explicit RateController(
+		const RateControlSettings& settings = RateControlSettings());
+
+	// Takes the queue statistics of the stream, sampled about every PeriodMs, at
+	// now in 100 ns ticks. Returns true if the level changed.
+	bool Update(
+		const SendQueueStatistics& statistics,
+		uint64_t now);
+
+	const RateLevel& Level() const { return m_level; }
+
+	RateControlStatistics Statistics() const;
+
+	const RateControlSettings& Settings() const { return m_settings; }
+
+private:
+	enum class Knob
+	{
+		Interval,
+		Decimation,
+		PixelFormat
+	};
+
+	// a step down, undone by a step up
+	struct Step
+	{
+		RateLevel Previous;
+		// the knob it turned
+		Knob Changed;
+		// bytes per second before the step over bytes per second after it
+		double Saving;
+	};
+
+	bool StepDown();
+
+	// the next level down on knob with the saving it brings, or false if the knob
+	// is at its limit
+	bool NextLevel(
+		Knob knob,
+		RateLevel& level,
+		double& saving) const;
+
+	RateControlSettings m_settings;
+	RateLevel m_level;
+	std::vector<Step> m_steps;
+	// the knob the next step down tries first
+	int m_nextKnob = 0;
+
+	bool m_hasLast = false;
+	SendQueueStatistics m_last;
+	uint64_t m_lastTime = 0;
+	// periods in a row without drops
+	uint32_t m_cleanPeriods = 0;
+	// periods to wait after a step down for the queues to drain
+	uint32_t m_holdPeriods = 0;
+	double m_capacity = 0.0;
+
+	RateControlStatistics m_statistics;
+};
@@ -0,0 +1,347 @@
+#include "ResearchModeFrameEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "DepthCodec.h"
+#include "DepthKernels.h"
+#include "FrameMessage.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+
+const USHORT ResearchModeFrameEncoder::kAhatMaxValue = 4090;
+
+ResearchModeFrameEncoder::ResearchModeFrameEncoder(
+    ResearchModeSensorType sensorType,
+    bool includeAb) :
+    m_sensorType(sensorType),
+    m_includeAb(includeAb)
+{
+}
+
+bool ResearchModeFrameEncoder::IsVisibleLightCamera(
+    ResearchModeSensorType sensorType)
+{
+    return sensorType == LEFT_FRONT || sensorType == LEFT_LEFT ||
+        sensorType == RIGHT_FRONT || sensorType == RIGHT_RIGHT;
+}
+
+uint32_t ResearchModeFrameEncoder::SupportedCodecs() const
+{
+    // RVL and the point clouds only know depth
+    if (IsVisibleLightCamera(m_sensorType))
+    {
+        return CodecBit(DepthCodec::Raw);
+    }
+    uint32_t codecs = CodecBit(DepthCodec::Raw) | CodecBit(DepthCodec::Rvl);
+    if (m_spCameraSensor)
+    {
+        codecs |= CodecBit(DepthCodec::PointsMm16) | CodecBit(DepthCodec::PointsHalf);
+    }
+    return codecs;
+}
+
+bool ResearchModeFrameEncoder::SetCameraSensor(
+    IResearchModeSensor* pSensor)
+{
+    IResearchModeCameraSensor* pCameraSensor = nullptr;
+    if (!pSensor ||
+        FAILED(pSensor->QueryInterface(IID_PPV_ARGS(&pCameraSensor))) || !pCameraSensor)
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameEncoder::SetCameraSensor: No camera sensor.\n");
+#endif
+        return false;
+    }
+
+    m_spCameraSensor.reset(pCameraSensor, [](IResearchModeCameraSensor* cs) { cs->Release(); });
+    m_rayWidth = 0;
+    m_rayHeight = 0;
+    m_calibration = nullptr;
+    return true;
+}
+
+FrameBufferPtr ResearchModeFrameEncoder::Calibration(
+    UINT32 width,
+    UINT32 height)
+{
+    if (!m_spCameraSensor)
+    {
+        return nullptr;
+    }
+    if (m_calibration && m_rayWidth == width && m_rayHeight == height)
+    {
+        return m_calibration;
+    }
+    if (m_rayWidth != width || m_rayHeight != height)
+    {
+        BuildCameraTables(width, height);
+    }
+
+    CalibrationHeader header{};
+    header.ImageWidth = static_cast<int32_t>(width);
+    header.ImageHeight = static_cast<int32_t>(height);
+    header.Extrinsics = Float4x4::Identity();
+    DirectX::XMFLOAT4X4 extrinsics;
+    if (SUCCEEDED(m_spCameraSensor->GetCameraExtrinsicsMatrix(&extrinsics)))
+    {
+        static_assert(sizeof(extrinsics) == sizeof(header.Extrinsics), "Both are row-major 4x4 floats");
+        memcpy(&header.Extrinsics, &extrinsics, sizeof(extrinsics));
+    }
+
+    FrameMessage message;
+    message.SetHeader(Stream(), 0, header);
+    message.AddPayload(m_unitPlane);
+    m_calibration = std::make_shared<std::vector<uint8_t>>();
+    message.FlattenInto(*m_calibration);
+    return m_calibration;
+}
+
+void ResearchModeFrameEncoder::BuildCameraTables(
+    UINT32 width,
+    UINT32 height)
+{
+    const size_t count = static_cast<size_t>(width) * height;
+    m_unitPlane.assign(2 * count, std::numeric_limits<float>::quiet_NaN());
+    m_rayX.assign(count, 0.0f);
+    m_rayY.assign(count, 0.0f);
+    m_rayZ.assign(count, 0.0f);
+
+    for (UINT32 y = 0; y < height; ++y)
+    {
+        for (UINT32 x = 0; x < width; ++x)
+        {
+            float uv[2] = { x + 0.5f, y + 0.5f };
+            float xy[2] = { 0.0f, 0.0f };
+            if (FAILED(m_spCameraSensor->MapImagePointToCameraUnitPlane(uv, xy)))
+            {
+                continue;
+            }
+            // the depth is the distance along the ray, not z
+            const float norm = std::sqrt(xy[0] * xy[0] + xy[1] * xy[1] + 1.0f);
+            const size_t i = static_cast<size_t>(y) * width + x;
+            m_unitPlane[2 * i] = xy[0];
+            m_unitPlane[2 * i + 1] = xy[1];
+            m_rayX[i] = xy[0] / norm;
+            m_rayY[i] = xy[1] / norm;
+            m_rayZ[i] = 1.0f / norm;
+        }
+    }
+    m_rayWidth = width;
+    m_rayHeight = height;
+    m_calibration = nullptr;
+}
+
+bool ResearchModeFrameEncoder::Encode(
+    IResearchModeSensorFrame* pSensorFrame,
+    ResearchModeFrameHeader& header,
+    std::vector<BYTE>& payload,
+    DepthCodec& codec)
+{
+    ResearchModeSensorResolution resolution;
+    IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
+    size_t outBufferCount = 0;
+    const UINT16* pDepth = nullptr;
+    const BYTE* pSigma = nullptr;
+    const UINT16* pAb = nullptr;
+
+    const USHORT maxValue = kAhatMaxValue;
+
+    pSensorFrame->GetResolution(&resolution);
+    if (IsVisibleLightCamera(m_sensorType))
+    {
+        codec = DepthCodec::Raw;
+        return EncodeVisibleLight(pSensorFrame, resolution, header, payload);
+    }
+
+    HRESULT hr = pSensorFrame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
+
+    if (!pDepthFrame || !SUCCEEDED(hr))
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameEncoder::Encode: Failed to grab depth frame.\n");
+#endif
+        return false;
+    }
+
+    std::shared_ptr<IResearchModeSensorDepthFrame> spDepthFrame(pDepthFrame, [](IResearchModeSensorDepthFrame* sf) { sf->Release(); });
+
+    header.ImageWidth = resolution.Width;
+    header.ImageHeight = resolution.Height;
+    header.PixelStride = resolution.BytesPerPixel;
+    header.RowStride = header.ImageWidth * header.PixelStride;
+
+    hr = spDepthFrame->GetBuffer(&pDepth, &outBufferCount);
+    if (FAILED(hr))
+    {
+        return false;
+    }
+
+    if (m_sensorType == DEPTH_LONG_THROW)
+    {
+        // Long Throw has no range threshold, the sigma buffer marks invalid pixels
+        size_t sigmaCount = 0;
+        hr = spDepthFrame->GetSigmaBuffer(&pSigma, &sigmaCount);
+        if (FAILED(hr) || sigmaCount < outBufferCount)
+        {
+#if DBG_ENABLE_VERBOSE_LOGGING
+            OutputDebugStringW(L"ResearchModeFrameEncoder::Encode: Failed to grab sigma buffer.\n");
+#endif
+            return false;
+        }
+    }
+
+    size_t abCount = 0;
+    if (m_includeAb)
+    {
+        hr = spDepthFrame->GetAbDepthBuffer(&pAb, &abCount);
+        if (FAILED(hr) || abCount < outBufferCount)
+        {
+#if DBG_ENABLE_VERBOSE_LOGGING
+            OutputDebugStringW(L"ResearchModeFrameEncoder::Encode: Failed to grab AB buffer.\n");
+#endif
+            return false;
+        }
+        abCount = outBufferCount;
+    }
+
+    const bool points = codec == DepthCodec::PointsMm16 || codec == DepthCodec::PointsHalf;
+    if (points && !m_spCameraSensor)
+    {
+        codec = DepthCodec::Raw;
+    }
+
+    const size_t abSize = abCount * sizeof(UINT16);
+    size_t depthSize = 0;
+    if (codec == DepthCodec::PointsMm16 || codec == DepthCodec::PointsHalf)
+    {
+        if (m_rayWidth != resolution.Width || m_rayHeight != resolution.Height)
+        {
+            BuildCameraTables(resolution.Width, resolution.Height);
+        }
+        const size_t rayCount = std::min(outBufferCount, m_rayX.size());
+
+        // xyz of every pixel at worst; the AB image goes right behind the points
+        payload.resize(rayCount * 3 * sizeof(int16_t) + abSize);
+        // Long Throw has no range threshold, its sigma decides alone
+        const uint16_t pointMaxValue = pSigma ? 0xFFFF : maxValue;
+        const size_t pointCount = (codec == DepthCodec::PointsMm16) ?
+            DepthToPointsMm16(pDepth, pSigma, m_rayX.data(), m_rayY.data(), m_rayZ.data(), rayCount,
+                pointMaxValue, reinterpret_cast<int16_t*>(payload.data())) :
+            DepthToPointsHalf(pDepth, pSigma, m_rayX.data(), m_rayY.data(), m_rayZ.data(), rayCount,
+                pointMaxValue, reinterpret_cast<uint16_t*>(payload.data()));
+        depthSize = pointCount * 3 * sizeof(int16_t);
+        if (pAb)
+        {
+            if (pSigma)
+            {
+                ValidateDepthAndAbBySigmaBigEndian(pDepth, pAb, pSigma, outBufferCount, nullptr, payload.data() + depthSize);
+            }
+            else
+            {
+                ValidateDepthAndAbBigEndian(pDepth, pAb, outBufferCount, maxValue, nullptr, payload.data() + depthSize);
+            }
+        }
+    }
+    else if (codec == DepthCodec::Rvl)
+    {
+        // validation is folded into the encoder
+        payload.resize(RvlMaxEncodedSize(outBufferCount) + abSize);
+        depthSize = pSigma ?
+            RvlEncodeDepthBySigma(pDepth, pSigma, outBufferCount, payload.data()) :
+            RvlEncodeDepth(pDepth, outBufferCount, maxValue, payload.data());
+        if (pAb)
+        {
+            // only the AB image is left to mask
+            if (pSigma)
+            {
+                ValidateDepthAndAbBySigmaBigEndian(pDepth, pAb, pSigma, outBufferCount, nullptr, payload.data() + depthSize);
+            }
+            else
+            {
+                ValidateDepthAndAbBigEndian(pDepth, pAb, outBufferCount, maxValue, nullptr, payload.data() + depthSize);
+            }
+        }
+    }
+    else
+    {
+        // validate depth (and AB) & convert to big-endian in a single pass
+        depthSize = outBufferCount * sizeof(UINT16);
+        payload.resize(depthSize + abSize);
+        if (pSigma && pAb)
+        {
+            ValidateDepthAndAbBySigmaBigEndian(pDepth, pAb, pSigma, outBufferCount, payload.data(), payload.data() + depthSize);
+        }
+        else if (pSigma)
+        {
+            ValidateDepthBySigmaBigEndian(pDepth, pSigma, outBufferCount, payload.data());
+        }
+        else if (pAb)
+        {
+            ValidateDepthAndAbBigEndian(pDepth, pAb, outBufferCount, maxValue, payload.data(), payload.data() + depthSize);
+        }
+        else
+        {
+            ValidateDepthBigEndian(pDepth, outBufferCount, maxValue, payload.data());
+        }
+        codec = DepthCodec::Raw;
+    }
+    payload.resize(depthSize + abSize);
+
+    header.AbSize = static_cast<uint32_t>(abSize);
+    header.Gain = 0;
+    header.Exposure = 0;
+
+    return true;
+}
+
+bool ResearchModeFrameEncoder::EncodeVisibleLight(
+    IResearchModeSensorFrame* pSensorFrame,
+    const ResearchModeSensorResolution& resolution,
+    ResearchModeFrameHeader& header,
+    std::vector<BYTE>& payload)
+{
+    IResearchModeSensorVLCFrame* pVlcFrame = nullptr;
+    HRESULT hr = pSensorFrame->QueryInterface(IID_PPV_ARGS(&pVlcFrame));
+    if (!pVlcFrame || !SUCCEEDED(hr))
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameEncoder::EncodeVisibleLight: Failed to grab VLC frame.\n");
+#endif
+        return false;
+    }
+
+    std::shared_ptr<IResearchModeSensorVLCFrame> spVlcFrame(pVlcFrame, [](IResearchModeSensorVLCFrame* sf) { sf->Release(); });
+
+    const BYTE* pImage = nullptr;
+    size_t outBufferCount = 0;
+    UINT32 gain = 0;
+    UINT64 exposure = 0;
+    if (FAILED(spVlcFrame->GetBuffer(&pImage, &outBufferCount)) ||
+        FAILED(spVlcFrame->GetGain(&gain)) ||
+        FAILED(spVlcFrame->GetExposure(&exposure)))
+    {
+        return false;
+    }
+
+    header.ImageWidth = resolution.Width;
+    header.ImageHeight = resolution.Height;
+    header.PixelStride = 1;
+    header.RowStride = header.ImageWidth;
+    if (outBufferCount < static_cast<size_t>(header.RowStride) * header.ImageHeight)
+    {
+        return false;
+    }
+
+    // 8 bit grayscale goes out as it is
+    payload.resize(static_cast<size_t>(header.RowStride) * header.ImageHeight);
+    memcpy(payload.data(), pImage, payload.size());
+
+    header.AbSize = 0;
+    header.Gain = gain;
+    header.Exposure = exposure;
+
+    return true;
+}
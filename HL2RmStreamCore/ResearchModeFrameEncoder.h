@@ -0,0 +1,98 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "PortableResearchModeApi.h"
+#include "FrameBufferPool.h"
+#include "FrameHeaders.h"
+
+// Turns research mode depth and visible light camera frames into their wire
+// representation.
+class ResearchModeFrameEncoder
+{
+public:
+	// For depth, sensorType selects the invalidation: AHAT pixels are invalid at or
+	// above kAhatMaxValue, Long Throw pixels when their sigma says so. With
+	// includeAb the active brightness image is appended to every payload, zeroed
+	// wherever the depth is invalid so that both planes share one mask.
+	explicit ResearchModeFrameEncoder(
+		ResearchModeSensorType sensorType = DEPTH_AHAT,
+		bool includeAb = false);
+
+	// Fills in the image layout of the header and writes the validated depth
+	// image in codec, and the AB image if enabled, to payload, resizing it to fit.
+	// codec is set to the one actually used, Raw where the requested one does not
+	// apply. Visible light camera frames are copied as they are, with their
+	// exposure and gain in the header, and always use the Raw codec. The point
+	// cloud codecs need a camera sensor; the AB image that follows the points
+	// stays a dense image. payload is reused across frames, so it only reallocates
+	// when the resolution grows. Returns false if the frame carries no image
+	// buffer, or no sigma or AB buffer where one is needed.
+	bool Encode(
+		IResearchModeSensorFrame* pSensorFrame,
+		ResearchModeFrameHeader& header,
+		std::vector<BYTE>& payload,
+		DepthCodec& codec);
+
+	ResearchModeSensorType SensorType() const { return m_sensorType; }
+
+	// the stream the frames of the sensor go out on
+	StreamId Stream() const { return static_cast<StreamId>(m_sensorType); }
+
+	bool IncludesAb() const { return m_includeAb; }
+
+	// codecs Encode supports for the sensor, as a mask of CodecBit values
+	uint32_t SupportedCodecs() const;
+
+	// Enables the calibration message and, for a depth sensor, the point cloud
+	// codecs. The camera's unit plane mapping is sampled once per pixel into a
+	// table of rays on first use, so that every point cloud frame after that is a
+	// multiply per coordinate. pSensor must implement IResearchModeCameraSensor;
+	// returns false otherwise.
+	bool SetCameraSensor(IResearchModeSensor* pSensor);
+
+	bool HasCameraSensor() const { return m_spCameraSensor != nullptr; }
+
+	// The serialized calibration message, a CalibrationHeader and the unit plane
+	// table, for frames of the given resolution, or nullptr without a camera
+	// sensor. It is built once and returned again until the resolution changes,
+	// so a new pointer means a new calibration.
+	FrameBufferPtr Calibration(
+		UINT32 width,
+		UINT32 height);
+
+	// LEFT_FRONT, LEFT_LEFT, RIGHT_FRONT and RIGHT_RIGHT
+	static bool IsVisibleLightCamera(ResearchModeSensorType sensorType);
+
+	// invalidation value for AHAT
+	static const USHORT kAhatMaxValue;
+
+private:
+	bool EncodeVisibleLight(
+		IResearchModeSensorFrame* pSensorFrame,
+		const ResearchModeSensorResolution& resolution,
+		ResearchModeFrameHeader& header,
+		std::vector<BYTE>& payload);
+
+	// fills the unit plane and ray tables for a resolution; pixels the camera
+	// cannot map get a NaN unit plane point and a zero ray, which the point
+	// kernels skip
+	void BuildCameraTables(
+		UINT32 width,
+		UINT32 height);
+
+	ResearchModeSensorType m_sensorType;
+	bool m_includeAb;
+
+	std::shared_ptr<IResearchModeCameraSensor> m_spCameraSensor;
+	// x and y on the unit plane of the centre of every pixel, interleaved
+	std::vector<float> m_unitPlane;
+	// unit length ray through the centre of every pixel, one plane per coordinate
+	std::vector<float> m_rayX;
+	std::vector<float> m_rayY;
+	std::vector<float> m_rayZ;
+	UINT32 m_rayWidth = 0;
+	UINT32 m_rayHeight = 0;
+	FrameBufferPtr m_calibration;
+};
@@ -0,0 +1,381 @@
+#include "ResearchModeFrameProcessor.h"
+
+#include "ImuFrameEncoder.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+ResearchModeFrameProcessor::ResearchModeFrameProcessor(
+    IResearchModeSensor* pLLSensor,
+    SensorConsent* pCamConsent,
+    const unsigned long long minDelta,
+    std::shared_ptr<IResearchModeFrameSink> frameSink,
+    std::shared_ptr<SensorScheduler> scheduler) :
+    m_pRMSensor(pLLSensor),
+    m_pFrameSink(frameSink),
+    m_pScheduler(std::move(scheduler)),
+    m_pacer(minDelta),
+    m_pCamConsent(pCamConsent)
+{
+    m_pRMSensor->AddRef();
+    m_sensorType = m_pRMSensor->GetSensorType();
+    m_processInline = ImuFrameEncoder::IsImuSensor(m_sensorType);
+    m_fExit = false;
+    if (m_pScheduler)
+    {
+        // the acquisition job blocks on the sensor for as long as a frame takes
+        m_pScheduler->AddSensor();
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"ResearchModeFrameProcessor: Created processor for sensor %ls\n",
+        pLLSensor->GetFriendlyName());
+    OutputDebugStringW(msgBuffer);
+#endif
+}
+
+ResearchModeFrameProcessor::~ResearchModeFrameProcessor()
+{
+    m_fExit = true;
+    m_frameMailbox.Close();
+    if (m_pScheduler)
+    {
+        m_pScheduler->Cancel(this);
+    }
+    if (m_cameraUpdateThread.joinable())
+    {
+        m_cameraUpdateThread.join();
+    }
+    if (m_processThread.joinable())
+    {
+        m_processThread.join();
+    }
+    // release pending frames before the sensor they belong to
+    m_frameMailbox.Reset();
+    if (m_pRMSensor)
+    {
+        m_pRMSensor->CloseStream();
+        m_pRMSensor->Release();
+    }
+}
+
+void ResearchModeFrameProcessor::Stop()
+{
+    m_fExit = true;
+    m_frameMailbox.Close();
+    if (m_pScheduler)
+    {
+        m_pScheduler->Cancel(this);
+        if (m_streamOpen)
+        {
+            CloseSensorStream();
+            m_streamOpen = false;
+        }
+        m_processingPending = false;
+    }
+    if (m_cameraUpdateThread.joinable())
+    {
+        m_cameraUpdateThread.join();
+    }
+    if (m_pRMSensor)
+    {
+        m_pRMSensor->CloseStream();
+    }
+    if (m_processThread.joinable())
+    {
+        m_processThread.join();
+    }
+    m_frameMailbox.Reset();
+    isRunning = false;
+}
+
+void ResearchModeFrameProcessor::Start()
+{
+    m_fExit = false;
+    m_frameMailbox.Reset();
+    if (m_pScheduler)
+    {
+        PostAcquisitionJob();
+    }
+    else
+    {
+        m_cameraUpdateThread = std::thread(CameraUpdateThread, this, m_pCamConsent);
+        if (!m_processInline)
+        {
+            m_processThread = std::thread(FrameProcessingThread, this);
+        }
+    }
+    isRunning = true;
+}
+
+
+void ResearchModeFrameProcessor::CameraUpdateThread(
+    ResearchModeFrameProcessor* pResearchModeFrameProcessor,
+    SensorConsent* /* pCamConsent */)
+{
+    HRESULT hr = S_OK;
+
+    // wait for the consent to be given, but keep honoring stop requests meanwhile
+    bool consentGiven = false;
+    while (!consentGiven && !pResearchModeFrameProcessor->m_fExit)
+    {
+        consentGiven = pResearchModeFrameProcessor->CheckConsent(100, hr);
+    }
+
+    if (consentGiven && SUCCEEDED(hr) && pResearchModeFrameProcessor->OpenSensorStream())
+    {
+        // frame acquisition loop
+        while (!pResearchModeFrameProcessor->m_fExit && pResearchModeFrameProcessor->m_pRMSensor)
+        {
+            pResearchModeFrameProcessor->AcquireFrame();
+        }
+
+        // if thread should exit...
+        pResearchModeFrameProcessor->CloseSensorStream();
+    }
+}
+
+
+void ResearchModeFrameProcessor::FrameProcessingThread(
+    ResearchModeFrameProcessor* pProcessor)
+{
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugStringW(L"ResearchModeFrameProcessor::CameraStreamThread: Starting processing thread.\n");
+#endif
+    while (!pProcessor->m_fExit && pProcessor->m_pFrameSink)
+    {
+        // sleep until the update thread publishes a new frame
+        AcquiredFrame frame;
+        if (!pProcessor->m_frameMailbox.WaitForFrame(frame, 100))
+        {
+            continue;
+        }
+        pProcessor->ProcessFrame(std::move(frame));
+    }
+}
+
+bool ResearchModeFrameProcessor::CheckConsent(
+    unsigned int timeoutMs,
+    HRESULT& hr)
+{
+    ResearchModeSensorConsent camAccessConsent;
+    if (!m_pCamConsent->WaitFor(timeoutMs, &camAccessConsent))
+    {
+        return false;
+    }
+
+    hr = S_OK;
+    switch (camAccessConsent)
+    {
+    case ResearchModeSensorConsent::Allowed:
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Access is granted. \n");
+        break;
+    case ResearchModeSensorConsent::DeniedBySystem:
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Access is denied by the system. \n");
+        hr = E_ACCESSDENIED;
+        break;
+    case ResearchModeSensorConsent::DeniedByUser:
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Access is denied by the user. \n");
+        hr = E_ACCESSDENIED;
+        break;
+    case ResearchModeSensorConsent::NotDeclaredByApp:
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Capability is not declared in the app manifest. \n");
+        hr = E_ACCESSDENIED;
+        break;
+    case ResearchModeSensorConsent::UserPromptRequired:
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Capability user prompt required. \n");
+        hr = E_ACCESSDENIED;
+        break;
+    default:
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Access is denied by the system. \n");
+        hr = E_ACCESSDENIED;
+        break;
+    }
+    return true;
+}
+
+bool ResearchModeFrameProcessor::OpenSensorStream()
+{
+    if (!m_pRMSensor)
+    {
+        return false;
+    }
+    // try to open the camera stream
+    HRESULT hr = m_pRMSensor->OpenStream();
+    if (FAILED(hr))
+    {
+        m_pRMSensor->Release();
+        m_pRMSensor = nullptr;
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Opening the Stream failed.\n");
+#endif
+        return false;
+    }
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Starting acquisition loop!\n");
+#endif
+    return true;
+}
+
+void ResearchModeFrameProcessor::CloseSensorStream()
+{
+    if (m_pRMSensor)
+    {
+#if DBG_ENABLE_INFO_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Closing the stream.\n");
+#endif
+        m_pRMSensor->CloseStream();
+    }
+}
+
+bool ResearchModeFrameProcessor::AcquireFrame()
+{
+    // try to grab the next frame
+    IResearchModeSensorFrame* pSensorFrame = nullptr;
+    HRESULT hr = m_pRMSensor->GetNextBuffer(&pSensorFrame);
+    if (FAILED(hr))
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Failed getting frame.\n");
+#endif
+        return false;
+    }
+
+    AcquiredFrame frame;
+    frame.Frame = std::shared_ptr<IResearchModeSensorFrame>(pSensorFrame, [](IResearchModeSensorFrame* sf) { sf->Release(); });
+    // numbered before anything can drop it
+    frame.Sequence = m_sequence++;
+
+    if (m_processInline)
+    {
+        // a batch of samples is cheap to encode and must not be dropped
+        if (m_pFrameSink)
+        {
+            ProcessFrame(std::move(frame));
+        }
+        return true;
+    }
+
+    // never blocks; a frame the processing thread did not pick up yet is replaced
+    m_frameMailbox.Publish(std::move(frame));
+#if DBG_ENABLE_VERBOSE_LOGGING
+    OutputDebugStringW(L"ResearchModeFrameProcessor::CameraUpdateThread: Updated frame.\n");
+#endif
+    return true;
+}
+
+void ResearchModeFrameProcessor::ProcessFrame(
+    AcquiredFrame frame)
+{
+    if (!m_enabled)
+    {
+        return;
+    }
+
+    FrameTrace trace;
+    trace.DequeueTime = MonotonicTicks();
+    if (IsValidTimestamp(frame.Frame))
+    {
+        trace.Sequence = frame.Sequence;
+        // the HostTicks IsValidTimestamp just accepted
+        trace.CaptureTime = m_prevTimestamp;
+        m_pFrameSink->Send(frame.Frame, m_sensorType, trace);
+    }
+}
+
+void ResearchModeFrameProcessor::PostAcquisitionJob()
+{
+    m_pScheduler->Post(this, [this]() { RunAcquisitionJob(); });
+}
+
+void ResearchModeFrameProcessor::RunAcquisitionJob()
+{
+    if (m_fExit)
+    {
+        return;
+    }
+
+    if (!m_streamOpen)
+    {
+        HRESULT hr = S_OK;
+        if (!CheckConsent(100, hr))
+        {
+            // still waiting for the user; give the worker back in between
+            PostAcquisitionJob();
+            return;
+        }
+        if (FAILED(hr) || !OpenSensorStream())
+        {
+            return;
+        }
+        m_streamOpen = true;
+    }
+
+    if (AcquireFrame() && m_pFrameSink && !m_processInline)
+    {
+        // pairs with the fence in RunProcessingJob: either that job sees the new
+        // frame or this exchange sees the cleared flag and posts a new job
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_processingPending.exchange(true))
+        {
+            m_pScheduler->Post(this, [this]() { RunProcessingJob(); });
+        }
+    }
+    PostAcquisitionJob();
+}
+
+void ResearchModeFrameProcessor::RunProcessingJob()
+{
+    while (true)
+    {
+        AcquiredFrame frame;
+        while (!m_fExit && m_frameMailbox.TryConsume(frame))
+        {
+            ProcessFrame(std::move(frame));
+        }
+
+        m_processingPending.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // a frame published after the last TryConsume but before the flag was
+        // cleared did not post a job, so take care of it here
+        if (m_fExit || !m_frameMailbox.HasFrame() || m_processingPending.exchange(true))
+        {
+            return;
+        }
+    }
+}
+
+MailboxStatistics ResearchModeFrameProcessor::GetFrameStatistics() const
+{
+    return m_frameMailbox.Statistics();
+}
+
+bool ResearchModeFrameProcessor::IsValidTimestamp(
+    std::shared_ptr<IResearchModeSensorFrame> pSensorFrame)
+{
+    ResearchModeSensorTimestamp timestamp;
+    if (pSensorFrame)
+    {
+        if (FAILED(pSensorFrame->GetTimeStamp(&timestamp)))
+        {
+            return false;
+        }
+        if (m_prevTimestamp == timestamp.HostTicks)
+        {
+            return false;
+        }
+        if (!m_pacer.Accept(timestamp.HostTicks))
+        {
+            return false;
+        }
+        m_prevTimestamp = timestamp.HostTicks;
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "PortableResearchModeApi.h"
+#include "FramePacer.h"
+#include "IResearchModeFrameSink.h"
+#include "LatestFrameMailbox.h"
+#include "SensorConsent.h"
+#include "SensorScheduler.h"
+
+// A frame as the acquisition stage got it from the sensor.
+struct AcquiredFrame
+{
+	std::shared_ptr<IResearchModeSensorFrame> Frame;
+	// frames acquired before this one
+	uint32_t Sequence = 0;
+};
+
+class ResearchModeFrameProcessor
+{
+public:
+	// Without a scheduler the processor runs an acquisition and a processing thread
+	// of its own; with one it runs both as jobs on the shared workers. IMU sensors
+	// skip the processing stage: every sample batch is handed to the sink right
+	// where it was acquired, since batches must not replace each other. Frames are
+	// paced to one per minDelta HostTicks, see FramePacer; 0 sends all of them.
+	ResearchModeFrameProcessor(
+		IResearchModeSensor* pLLSensor,
+		SensorConsent* pCamConsent,
+		const unsigned long long minDelta,
+		std::shared_ptr<IResearchModeFrameSink> frameSink,
+		std::shared_ptr<SensorScheduler> scheduler = nullptr);
+
+	~ResearchModeFrameProcessor();
+
+	void Stop();
+
+	void Start();
+
+	MailboxStatistics GetFrameStatistics() const;
+
+	// Changes the pacing of the frames while streaming, e.g. by a RateController.
+	void SetMinDelta(
+		unsigned long long minDelta) { m_pacer.SetInterval(minDelta); }
+
+	unsigned long long MinDelta() const { return m_pacer.Interval(); }
+
+	// Stops handing frames to the sink, or resumes it, from the next frame on.
+	// The sensor keeps streaming, so frames resume right away; the ones in
+	// between still count in the sequence numbers. May be called from any thread.
+	void SetEnabled(
+		bool enabled) { m_enabled = enabled; }
+
+	bool IsEnabled() const { return m_enabled; }
+
+	bool isRunning = false;
+
+protected:
+	static void CameraUpdateThread(
+		ResearchModeFrameProcessor* pProcessor,
+		SensorConsent* pCamConsent);
+
+	static void FrameProcessingThread(
+		ResearchModeFrameProcessor* pProcessor);
+
+	// Waits up to timeoutMs for the consent. Returns false if it is still pending,
+	// otherwise sets hr to whether access was granted.
+	bool CheckConsent(
+		unsigned int timeoutMs,
+		HRESULT& hr);
+
+	// Opens the sensor stream; on failure the sensor is released.
+	bool OpenSensorStream();
+
+	void CloseSensorStream();
+
+	// Fetches the next frame from the sensor and publishes it to the mailbox, or
+	// sends it right away when m_processInline is set.
+	bool AcquireFrame();
+
+	void ProcessFrame(
+		AcquiredFrame frame);
+
+	void PostAcquisitionJob();
+
+	void RunAcquisitionJob();
+
+	void RunProcessingJob();
+
+	bool IsValidTimestamp(
+		std::shared_ptr<IResearchModeSensorFrame> pSensorFrame);
+
+	// latest sensor frame, handed from the update to the processing thread
+	LatestFrameMailbox<AcquiredFrame> m_frameMailbox;
+
+	IResearchModeSensor* m_pRMSensor = nullptr;
+	ResearchModeSensorType m_sensorType;
+	std::shared_ptr<IResearchModeFrameSink> m_pFrameSink = nullptr;
+
+	std::atomic<bool> m_fExit{ false };
+	// thread for reading frames
+	std::thread m_cameraUpdateThread;
+	// thread for processing frames
+	std::thread m_processThread;
+
+	// set for IMU sensors, whose batches are sent from the acquisition stage
+	bool m_processInline = false;
+
+	// shared workers, replacing the two threads when set
+	std::shared_ptr<SensorScheduler> m_pScheduler;
+	// only touched by the acquisition job
+	bool m_streamOpen = false;
+	// set while a processing job is queued or running, so there is at most one
+	std::atomic<bool> m_processingPending{ false };
+
+	// frames acquired so far, only touched by the acquisition stage
+	uint32_t m_sequence = 0;
+
+	std::atomic<bool> m_enabled{ true };
+
+	UINT64 m_prevTimestamp = 0;
+	// only Accept is restricted to the processing stage
+	FramePacer m_pacer;
+	SensorConsent* m_pCamConsent;
+};
@@ -0,0 +1,33 @@
+#include "SensorConsent.h"
+
+#include <chrono>
+
+void SensorConsent::Set(ResearchModeSensorConsent consent)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_consent = consent;
+        m_isSet = true;
+    }
+    m_consentGiven.notify_all();
+}
+
+ResearchModeSensorConsent SensorConsent::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_consentGiven.wait(lock, [this] { return m_isSet; });
+    return m_consent;
+}
+
+bool SensorConsent::WaitFor(
+    unsigned int timeoutMs,
+    ResearchModeSensorConsent* pConsent)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_consentGiven.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return m_isSet; }))
+    {
+        return false;
+    }
+    *pConsent = m_consent;
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#include "PortableResearchModeApi.h"
+
+// Holds the result of a Research Mode consent request. The consent callbacks set it
+// once, and the acquisition threads block on it before opening their sensor streams.
+class SensorConsent
+{
+public:
+	void Set(ResearchModeSensorConsent consent);
+
+	ResearchModeSensorConsent Wait();
+
+	bool WaitFor(
+		unsigned int timeoutMs,
+		ResearchModeSensorConsent* pConsent);
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_consentGiven;
+	bool m_isSet = false;
+	ResearchModeSensorConsent m_consent = DeniedBySystem;
+};
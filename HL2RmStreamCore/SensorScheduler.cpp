@@ -0,0 +1,122 @@
+#include "SensorScheduler.h"
+
+#include <algorithm>
+
+#include "Platform.h"
+
+#define DBG_ENABLE_INFO_LOGGING 1
+
+SensorScheduler::SensorScheduler(
+    unsigned int workerCount)
+{
+    m_autoWorkers = workerCount == kAutoWorkerCount;
+    workerCount = std::max(1u, workerCount);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        StartWorker();
+    }
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"SensorScheduler: Started %u workers%ls.\n", workerCount,
+        m_autoWorkers ? L", one more per sensor" : L"");
+    OutputDebugStringW(msgBuffer);
+#endif
+}
+
+SensorScheduler::~SensorScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+        m_jobs.clear();
+    }
+    m_jobPosted.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void SensorScheduler::AddSensor()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_autoWorkers && !m_exit)
+    {
+        StartWorker();
+    }
+}
+
+unsigned int SensorScheduler::WorkerCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<unsigned int>(m_workers.size());
+}
+
+void SensorScheduler::StartWorker()
+{
+    // the new worker waits for m_mutex, which the caller holds
+    m_workers.emplace_back(&SensorScheduler::WorkerThread, this);
+}
+
+void SensorScheduler::Post(
+    const void* owner,
+    std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_exit)
+        {
+            return;
+        }
+        m_jobs.push_back({ owner, std::move(job) });
+    }
+    m_jobPosted.notify_one();
+}
+
+void SensorScheduler::Cancel(
+    const void* owner)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    RemoveQueuedJobs(owner);
+    m_jobDone.wait(lock, [this, owner]()
+    {
+        return std::find(m_running.begin(), m_running.end(), owner) == m_running.end();
+    });
+    // the jobs that were running may have posted follow-ups
+    RemoveQueuedJobs(owner);
+}
+
+void SensorScheduler::RemoveQueuedJobs(
+    const void* owner)
+{
+    m_jobs.erase(
+        std::remove_if(m_jobs.begin(), m_jobs.end(), [owner](const Job& job) { return job.Owner == owner; }),
+        m_jobs.end());
+}
+
+void SensorScheduler::WorkerThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_jobPosted.wait(lock, [this]() { return m_exit || !m_jobs.empty(); });
+        if (m_exit)
+        {
+            return;
+        }
+
+        Job job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        m_running.push_back(job.Owner);
+
+        lock.unlock();
+        job.Run();
+        // release whatever the job captured before its owner may go away
+        job.Run = nullptr;
+        lock.lock();
+
+        m_running.erase(std::find(m_running.begin(), m_running.end(), job.Owner));
+        m_jobDone.notify_all();
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed set of worker threads shared by the research mode processors, so
+// that each enabled sensor does not cost an acquisition and a processing thread
+// of its own. Processors post short jobs (fetch one frame, send the latest frame)
+// tagged with an owner; jobs run in the order they were posted.
+//
+// A job blocked in IResearchModeSensor::GetNextBuffer occupies its worker until
+// the sensor delivers, so with fewer workers than sensors the fast sensors wait
+// behind the slow ones and lose frames. By default the scheduler therefore keeps
+// one worker per sensor that was added, plus one for the processing jobs; a fixed
+// count trades that for fewer threads.
+class SensorScheduler
+{
+public:
+	// workerCount kAutoWorkerCount starts one worker and adds one per AddSensor.
+	explicit SensorScheduler(
+		unsigned int workerCount = kAutoWorkerCount);
+
+	~SensorScheduler();
+
+	SensorScheduler(const SensorScheduler&) = delete;
+	SensorScheduler& operator=(const SensorScheduler&) = delete;
+
+	// Queues job to run on one of the workers.
+	void Post(
+		const void* owner,
+		std::function<void()> job);
+
+	// Tells the scheduler that one more sensor posts jobs that block while waiting
+	// for its frames; starts a worker for it unless the worker count is fixed.
+	void AddSensor();
+
+	// Drops the queued jobs of owner and waits for the running ones to return,
+	// including jobs they post meanwhile. Must not be called from a job of owner.
+	void Cancel(
+		const void* owner);
+
+	unsigned int WorkerCount() const;
+
+	static const unsigned int kAutoWorkerCount = 0;
+
+private:
+	struct Job
+	{
+		const void* Owner;
+		std::function<void()> Run;
+	};
+
+	void WorkerThread();
+
+	void RemoveQueuedJobs(
+		const void* owner);
+
+	void StartWorker();
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_jobPosted;
+	std::condition_variable m_jobDone;
+	std::deque<Job> m_jobs;
+	// owners of the jobs that are running, one entry per busy worker
+	std::vector<const void*> m_running;
+	bool m_exit = false;
+	// whether AddSensor starts workers
+	bool m_autoWorkers = false;
+
+	std::vector<std::thread> m_workers;
+};
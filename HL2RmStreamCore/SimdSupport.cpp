@@ -0,0 +1,98 @@
+#include "SimdSupport.h"
+
+#if defined(HL2_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    bool CpuHasSsse3()
+    {
+#if defined(HL2_SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#elif defined(HL2_SIMD_X86)
+        return __builtin_cpu_supports("ssse3");
+#else
+        return false;
+#endif
+    }
+
+    bool CpuHasAvx2()
+    {
+#if defined(HL2_SIMD_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x6) == 0x6);
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5));
+#elif defined(HL2_SIMD_X86)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+}
+
+SimdLevel DetectSimdLevel()
+{
+    static const SimdLevel s_level = []()
+    {
+#if defined(HL2_SIMD_NEON)
+        return SimdLevel::Neon;
+#elif defined(HL2_SIMD_X86)
+        if (CpuHasAvx2())
+        {
+            return SimdLevel::Avx2;
+        }
+        return CpuHasSsse3() ? SimdLevel::Ssse3 : SimdLevel::Sse2;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }();
+    return s_level;
+}
+
+bool IsSimdLevelSupported(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return true;
+#if defined(HL2_SIMD_X86)
+    case SimdLevel::Sse2:
+    case SimdLevel::Ssse3:
+    case SimdLevel::Avx2:
+        return static_cast<int>(level) <= static_cast<int>(DetectSimdLevel());
+#endif
+#if defined(HL2_SIMD_NEON)
+    case SimdLevel::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Sse2:
+        return "SSE2";
+    case SimdLevel::Ssse3:
+        return "SSSE3";
+    case SimdLevel::Avx2:
+        return "AVX2";
+    case SimdLevel::Neon:
+        return "NEON";
+    default:
+        return "scalar";
+    }
+}
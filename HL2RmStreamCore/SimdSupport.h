@@ -0,0 +1,36 @@
+#pragma once
+
+// Instruction sets the pixel kernels are specialized for. The best level supported
+// by the CPU is picked at runtime; the others stay callable for benchmarking.
+enum class SimdLevel
+{
+	Scalar,
+	Sse2,
+	Ssse3,
+	Avx2,
+	Neon
+};
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HL2_SIMD_X86 1
+#endif
+
+#if defined(_M_ARM64) || defined(_M_ARM) || defined(__ARM_NEON) || defined(__aarch64__)
+#define HL2_SIMD_NEON 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define HL2_TARGET_SSSE3
+#define HL2_TARGET_AVX2
+#else
+#define HL2_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define HL2_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// best level supported by this CPU; levels are ordered, so a CPU supporting
+// Avx2 also supports Ssse3 and Sse2
+SimdLevel DetectSimdLevel();
+
+bool IsSimdLevelSupported(SimdLevel level);
+
+const char* SimdLevelName(SimdLevel level);
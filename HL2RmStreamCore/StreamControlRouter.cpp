@@ -0,0 +1,133 @@
+#include "StreamControlRouter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Platform.h"
+
+#define DBG_ENABLE_INFO_LOGGING 1
+
+namespace
+{
+    const uint64_t kTicksPerUs = 10;
+
+    bool HasField(uint32_t fields, StreamControlField field)
+    {
+        return (fields & StreamControlBit(field)) != 0;
+    }
+}
+
+void StreamControlRouter::Register(
+    StreamId streamId,
+    StreamControlTarget target)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_targets[static_cast<uint16_t>(streamId)] = std::move(target);
+}
+
+void StreamControlRouter::Unregister(
+    StreamId streamId)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_targets.erase(static_cast<uint16_t>(streamId));
+}
+
+void StreamControlRouter::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_targets.clear();
+}
+
+FrameBufferPtr StreamControlRouter::Apply(
+    uint16_t streamId,
+    const StreamControlHeader& request)
+{
+    StreamControlHeader state{};
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto target = m_targets.find(streamId);
+    if (target == m_targets.end())
+    {
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamControlRouter::Apply: No stream 0x%x.\n", (unsigned int)streamId);
+        OutputDebugStringW(msgBuffer);
+#endif
+        return Serialize(streamId, state);
+    }
+    const StreamControlTarget& stream = target->second;
+
+    if (stream.SetEnabled && stream.IsEnabled)
+    {
+        if (HasField(request.Fields, StreamControlField::Enabled))
+        {
+            stream.SetEnabled(request.Enabled != 0);
+        }
+        state.Fields |= StreamControlBit(StreamControlField::Enabled);
+        state.Enabled = stream.IsEnabled() ? 1 : 0;
+    }
+
+    if (stream.SetLevel && stream.GetLevel)
+    {
+        // what the request leaves out stays as it is
+        RateLevel level = stream.GetLevel();
+        const uint32_t fields = request.Fields & stream.LevelFields;
+        if (HasField(fields, StreamControlField::Interval))
+        {
+            level.MinDelta = request.IntervalUs * kTicksPerUs;
+        }
+        if (HasField(fields, StreamControlField::Decimation))
+        {
+            level.Decimation = std::min(std::max(1u, request.Decimation), std::max(1u, stream.MaxDecimation));
+        }
+        // a format the stream cannot switch to is left out
+        if (HasField(fields, StreamControlField::PixelFormat) && request.PixelFormat < 32 &&
+            (stream.PixelFormats & (1u << request.PixelFormat)))
+        {
+            level.PixelFormat = static_cast<VideoPixelFormat>(request.PixelFormat);
+        }
+        if (fields != 0)
+        {
+            stream.SetLevel(level);
+            level = stream.GetLevel();
+        }
+
+        state.Fields |= stream.LevelFields;
+        if (HasField(stream.LevelFields, StreamControlField::Interval))
+        {
+            state.IntervalUs = static_cast<uint32_t>(std::min<uint64_t>(level.MinDelta / kTicksPerUs, UINT32_MAX));
+        }
+        if (HasField(stream.LevelFields, StreamControlField::Decimation))
+        {
+            state.Decimation = level.Decimation;
+        }
+        if (HasField(stream.LevelFields, StreamControlField::PixelFormat))
+        {
+            state.PixelFormat = static_cast<uint32_t>(level.PixelFormat);
+        }
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    if (request.Fields != 0)
+    {
+        // fields the stream does not have are 0
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamControlRouter::Apply: %ls enabled %u, at %u us, 1/%u, format %u.\n",
+            stream.Name.c_str(), state.Enabled, state.IntervalUs, state.Decimation, state.PixelFormat);
+        OutputDebugStringW(msgBuffer);
+    }
+#endif
+    return Serialize(streamId, state);
+}
+
+FrameBufferPtr StreamControlRouter::Serialize(
+    uint16_t streamId,
+    const StreamControlHeader& state)
+{
+    // replies are rare, so they are not worth a pool
+    const MessageHeader header = MakeMessageHeader(
+        static_cast<StreamId>(streamId), MessageType::StreamControl, 0, sizeof(state));
+    auto message = std::make_shared<std::vector<uint8_t>>(sizeof(header) + sizeof(state));
+    memcpy(message->data(), &header, sizeof(header));
+    memcpy(message->data() + sizeof(header), &state, sizeof(state));
+    return message;
+}
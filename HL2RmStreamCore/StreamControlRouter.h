@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "FrameBufferPool.h"
+#include "FrameHeaders.h"
+#include "RateController.h"
+
+// What of a stream clients can change at runtime and how. Knobs whose callbacks
+// are empty are ones the stream does not have.
+struct StreamControlTarget
+{
+	// for the log, e.g. the port
+	std::wstring Name;
+	// Stops and resumes the frames of the stream at the processing stage, e.g. by
+	// SetEnabled of its processor.
+	std::function<void(bool)> SetEnabled;
+	std::function<bool()> IsEnabled;
+	// Puts a level into effect, e.g. by SetMinDelta of the processor and
+	// SetEncoding of the streamer, or by SetBestLevel of the RateControlLoop the
+	// stream runs under. GetLevel returns the level requests start from.
+	std::function<void(const RateLevel&)> SetLevel;
+	std::function<RateLevel()> GetLevel;
+	// StreamControlBit values of the fields of RateLevel SetLevel takes
+	uint32_t LevelFields = 0;
+	// decimations above are sent as this one
+	uint32_t MaxDecimation = 1;
+	// wire formats the stream can switch to, as a mask of 1 << VideoPixelFormat
+	uint32_t PixelFormats = 0;
+};
+
+// Applies the MessageType::StreamControl requests clients send on the connection
+// of any stream to the stream they name, so that e.g. a client that only reads
+// depth can turn PV off. Every streamer of a process shares one router; streams
+// register with it once they are set up, and requests for streams that did not
+// are answered with an empty state. Thread-safe, requests are applied one at a
+// time.
+class StreamControlRouter
+{
+public:
+	void Register(
+		StreamId streamId,
+		StreamControlTarget target);
+
+	void Unregister(
+		StreamId streamId);
+
+	// Unregisters every stream, e.g. before they are released.
+	void Clear();
+
+	// Applies request to the stream streamId names and returns the serialized
+	// reply with its state.
+	FrameBufferPtr Apply(
+		uint16_t streamId,
+		const StreamControlHeader& request);
+
+	// A serialized StreamControl message, e.g. the reply of a streamer that has
+	// no router.
+	static FrameBufferPtr Serialize(
+		uint16_t streamId,
+		const StreamControlHeader& state);
+
+private:
+	std::mutex m_mutex;
+	std::map<uint16_t, StreamControlTarget> m_targets;
+};
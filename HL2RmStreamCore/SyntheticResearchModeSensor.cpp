@@ -0,0 +1,808 @@
+#include "SyntheticResearchModeSensor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    const UINT64 kHostTicksPerSecond = 10'000'000;
+
+    // radius of the valid circle of the depth patterns and the camera model, in
+    // image widths
+    const float kFovRadius = 0.55f;
+
+    UINT64 HostTicksOf(std::chrono::steady_clock::time_point time)
+    {
+        return static_cast<UINT64>(std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10'000'000>>>(
+            time.time_since_epoch()).count());
+    }
+
+    // deterministic noise source so that generated frames are reproducible
+    class Lcg
+    {
+    public:
+        explicit Lcg(uint32_t seed) : m_state(seed) {}
+
+        uint32_t Next()
+        {
+            m_state = m_state * 1664525u + 1013904223u;
+            return m_state >> 8;
+        }
+
+    private:
+        uint32_t m_state;
+    };
+
+    class SyntheticDepthFrame :
+        public IResearchModeSensorFrame,
+        public IResearchModeSensorDepthFrame
+    {
+    public:
+        SyntheticDepthFrame(
+            const ResearchModeSensorResolution& resolution,
+            const ResearchModeSensorTimestamp& timestamp,
+            std::shared_ptr<const SyntheticResearchModeSensor::FramePattern> pattern) :
+            m_resolution(resolution),
+            m_timestamp(timestamp),
+            m_pattern(std::move(pattern))
+        {
+        }
+
+        STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (!ppvObject)
+            {
+                return E_POINTER;
+            }
+            if (riid == RM_IID_OF(IResearchModeSensorFrame))
+            {
+                *ppvObject = static_cast<IResearchModeSensorFrame*>(this);
+            }
+            else if (riid == RM_IID_OF(IResearchModeSensorDepthFrame))
+            {
+                *ppvObject = static_cast<IResearchModeSensorDepthFrame*>(this);
+            }
+            else
+            {
+                *ppvObject = nullptr;
+                return E_NOINTERFACE;
+            }
+            AddRef();
+            return S_OK;
+        }
+
+        STDMETHODIMP_(ULONG) AddRef() override
+        {
+            return ++m_refCount;
+        }
+
+        STDMETHODIMP_(ULONG) Release() override
+        {
+            ULONG refCount = --m_refCount;
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        STDMETHODIMP GetResolution(ResearchModeSensorResolution* pResolution) override
+        {
+            *pResolution = m_resolution;
+            return S_OK;
+        }
+
+        STDMETHODIMP GetTimeStamp(ResearchModeSensorTimestamp* pTimeStamp) override
+        {
+            *pTimeStamp = m_timestamp;
+            return S_OK;
+        }
+
+        STDMETHODIMP GetBuffer(const UINT16** ppBytes, size_t* pBufferOutLength) override
+        {
+            *ppBytes = m_pattern->Depth.data();
+            *pBufferOutLength = m_pattern->Depth.size();
+            return S_OK;
+        }
+
+        STDMETHODIMP GetAbDepthBuffer(const UINT16** ppBytes, size_t* pBufferOutLength) override
+        {
+            *ppBytes = m_pattern->Ab.data();
+            *pBufferOutLength = m_pattern->Ab.size();
+            return S_OK;
+        }
+
+        STDMETHODIMP GetSigmaBuffer(const BYTE** ppBytes, size_t* pBufferOutLength) override
+        {
+            if (m_pattern->Sigma.empty())
+            {
+                *ppBytes = nullptr;
+                *pBufferOutLength = 0;
+                return E_NOTIMPL;
+            }
+            *ppBytes = m_pattern->Sigma.data();
+            *pBufferOutLength = m_pattern->Sigma.size();
+            return S_OK;
+        }
+
+    private:
+        virtual ~SyntheticDepthFrame() = default;
+
+        std::atomic<ULONG> m_refCount{ 1 };
+        ResearchModeSensorResolution m_resolution;
+        ResearchModeSensorTimestamp m_timestamp;
+        std::shared_ptr<const SyntheticResearchModeSensor::FramePattern> m_pattern;
+    };
+
+    class SyntheticVlcFrame :
+        public IResearchModeSensorFrame,
+        public IResearchModeSensorVLCFrame
+    {
+    public:
+        SyntheticVlcFrame(
+            const ResearchModeSensorResolution& resolution,
+            const ResearchModeSensorTimestamp& timestamp,
+            const SyntheticSensorSettings& settings,
+            std::shared_ptr<const SyntheticResearchModeSensor::FramePattern> pattern) :
+            m_resolution(resolution),
+            m_timestamp(timestamp),
+            m_exposure(settings.Exposure),
+            m_gain(settings.Gain),
+            m_pattern(std::move(pattern))
+        {
+        }
+
+        STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (!ppvObject)
+            {
+                return E_POINTER;
+            }
+            if (riid == RM_IID_OF(IResearchModeSensorFrame))
+            {
+                *ppvObject = static_cast<IResearchModeSensorFrame*>(this);
+            }
+            else if (riid == RM_IID_OF(IResearchModeSensorVLCFrame))
+            {
+                *ppvObject = static_cast<IResearchModeSensorVLCFrame*>(this);
+            }
+            else
+            {
+                *ppvObject = nullptr;
+                return E_NOINTERFACE;
+            }
+            AddRef();
+            return S_OK;
+        }
+
+        STDMETHODIMP_(ULONG) AddRef() override
+        {
+            return ++m_refCount;
+        }
+
+        STDMETHODIMP_(ULONG) Release() override
+        {
+            ULONG refCount = --m_refCount;
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        STDMETHODIMP GetResolution(ResearchModeSensorResolution* pResolution) override
+        {
+            *pResolution = m_resolution;
+            return S_OK;
+        }
+
+        STDMETHODIMP GetTimeStamp(ResearchModeSensorTimestamp* pTimeStamp) override
+        {
+            *pTimeStamp = m_timestamp;
+            return S_OK;
+        }
+
+        STDMETHODIMP GetBuffer(const BYTE** ppBytes, size_t* pBufferOutLength) override
+        {
+            *ppBytes = m_pattern->Image.data();
+            *pBufferOutLength = m_pattern->Image.size();
+            return S_OK;
+        }
+
+        STDMETHODIMP GetGain(UINT32* pGain) override
+        {
+            *pGain = m_gain;
+            return S_OK;
+        }
+
+        STDMETHODIMP GetExposure(UINT64* pExposure) override
+        {
+            *pExposure = m_exposure;
+            return S_OK;
+        }
+
+    private:
+        virtual ~SyntheticVlcFrame() = default;
+
+        std::atomic<ULONG> m_refCount{ 1 };
+        ResearchModeSensorResolution m_resolution;
+        ResearchModeSensorTimestamp m_timestamp;
+        UINT64 m_exposure;
+        UINT32 m_gain;
+        std::shared_ptr<const SyntheticResearchModeSensor::FramePattern> m_pattern;
+    };
+
+    // One batch of accelerometer, gyroscope or magnetometer samples; only the
+    // frame interface of its sensor type is exposed.
+    class SyntheticImuFrame :
+        public IResearchModeSensorFrame,
+        public IResearchModeAccelFrame,
+        public IResearchModeGyroFrame,
+        public IResearchModeMagFrame
+    {
+    public:
+        SyntheticImuFrame(
+            ResearchModeSensorType sensorType,
+            const ResearchModeSensorTimestamp& timestamp,
+            UINT64 firstSampleNs,
+            UINT64 samplePeriodNs,
+            unsigned int sampleCount) :
+            m_sensorType(sensorType),
+            m_timestamp(timestamp)
+        {
+            // slow motion plus sensor noise, so that clients see changing values
+            Lcg noise(static_cast<uint32_t>(firstSampleNs / 1000));
+            for (unsigned int i = 0; i < sampleCount; ++i)
+            {
+                const UINT64 sensorTicks = firstSampleNs + i * samplePeriodNs;
+                const float t = static_cast<float>(sensorTicks % 60'000'000'000ull) * 1.0e-9f;
+                const float jitter = static_cast<float>(noise.Next() % 101) * 1.0e-4f - 0.005f;
+                const UINT64 socTicks = sensorTicks / 100;
+                switch (sensorType)
+                {
+                case IMU_ACCEL:
+                    m_accel.push_back({ sensorTicks, socTicks,
+                        { 0.3f * std::sin(t) + jitter, -9.81f + jitter, 0.2f * std::cos(t) + jitter }, 35.0f });
+                    break;
+                case IMU_GYRO:
+                    m_gyro.push_back({ sensorTicks, socTicks,
+                        { 0.1f * std::cos(t) + jitter, 0.05f * std::sin(2.0f * t) + jitter, jitter }, 35.0f });
+                    break;
+                default:
+                    m_mag.push_back({ sensorTicks, socTicks,
+                        { 0.2f + jitter, -0.4f + jitter, 0.1f * std::sin(t) + jitter } });
+                    break;
+                }
+            }
+        }
+
+        STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (!ppvObject)
+            {
+                return E_POINTER;
+            }
+            if (riid == RM_IID_OF(IResearchModeSensorFrame))
+            {
+                *ppvObject = static_cast<IResearchModeSensorFrame*>(this);
+            }
+            else if (riid == RM_IID_OF(IResearchModeAccelFrame) && m_sensorType == IMU_ACCEL)
+            {
+                *ppvObject = static_cast<IResearchModeAccelFrame*>(this);
+            }
+            else if (riid == RM_IID_OF(IResearchModeGyroFrame) && m_sensorType == IMU_GYRO)
+            {
+                *ppvObject = static_cast<IResearchModeGyroFrame*>(this);
+            }
+            else if (riid == RM_IID_OF(IResearchModeMagFrame) && m_sensorType == IMU_MAG)
+            {
+                *ppvObject = static_cast<IResearchModeMagFrame*>(this);
+            }
+            else
+            {
+                *ppvObject = nullptr;
+                return E_NOINTERFACE;
+            }
+            AddRef();
+            return S_OK;
+        }
+
+        STDMETHODIMP_(ULONG) AddRef() override
+        {
+            return ++m_refCount;
+        }
+
+        STDMETHODIMP_(ULONG) Release() override
+        {
+            ULONG refCount = --m_refCount;
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        STDMETHODIMP GetResolution(ResearchModeSensorResolution* pResolution) override
+        {
+            *pResolution = ResearchModeSensorResolution{};
+            return S_OK;
+        }
+
+        STDMETHODIMP GetTimeStamp(ResearchModeSensorTimestamp* pTimeStamp) override
+        {
+            *pTimeStamp = m_timestamp;
+            return S_OK;
+        }
+
+        STDMETHODIMP GetCalibratedAccelaration(DirectX::XMFLOAT3* pAccel) override
+        {
+            return FirstValues(m_accel, pAccel);
+        }
+
+        STDMETHODIMP GetCalibratedAccelarationSamples(
+            const AccelDataStruct** ppAccelBuffer,
+            size_t* pBufferOutLength) override
+        {
+            return Samples(m_accel, ppAccelBuffer, pBufferOutLength);
+        }
+
+        STDMETHODIMP GetCalibratedGyro(DirectX::XMFLOAT3* pGyro) override
+        {
+            return FirstValues(m_gyro, pGyro);
+        }
+
+        STDMETHODIMP GetCalibratedGyroSamples(
+            const GyroDataStruct** ppGyroBuffer,
+            size_t* pBufferOutLength) override
+        {
+            return Samples(m_gyro, ppGyroBuffer, pBufferOutLength);
+        }
+
+        STDMETHODIMP GetMagnetometer(DirectX::XMFLOAT3* pMag) override
+        {
+            return FirstValues(m_mag, pMag);
+        }
+
+        STDMETHODIMP GetMagnetometerSamples(
+            const MagDataStruct** ppMagBuffer,
+            size_t* pBufferOutLength) override
+        {
+            return Samples(m_mag, ppMagBuffer, pBufferOutLength);
+        }
+
+    private:
+        virtual ~SyntheticImuFrame() = default;
+
+        template <typename TSample>
+        static HRESULT Samples(const std::vector<TSample>& samples, const TSample** ppBuffer, size_t* pBufferOutLength)
+        {
+            *ppBuffer = samples.data();
+            *pBufferOutLength = samples.size();
+            return samples.empty() ? E_NOTIMPL : S_OK;
+        }
+
+        static HRESULT FirstValues(const std::vector<AccelDataStruct>& samples, DirectX::XMFLOAT3* pValues)
+        {
+            return samples.empty() ? E_NOTIMPL : Copy(samples[0].AccelValues, pValues);
+        }
+
+        static HRESULT FirstValues(const std::vector<GyroDataStruct>& samples, DirectX::XMFLOAT3* pValues)
+        {
+            return samples.empty() ? E_NOTIMPL : Copy(samples[0].GyroValues, pValues);
+        }
+
+        static HRESULT FirstValues(const std::vector<MagDataStruct>& samples, DirectX::XMFLOAT3* pValues)
+        {
+            return samples.empty() ? E_NOTIMPL : Copy(samples[0].MagValues, pValues);
+        }
+
+        static HRESULT Copy(const float (&values)[3], DirectX::XMFLOAT3* pValues)
+        {
+            *pValues = { values[0], values[1], values[2] };
+            return S_OK;
+        }
+
+        std::atomic<ULONG> m_refCount{ 1 };
+        ResearchModeSensorType m_sensorType;
+        ResearchModeSensorTimestamp m_timestamp;
+        std::vector<AccelDataStruct> m_accel;
+        std::vector<GyroDataStruct> m_gyro;
+        std::vector<MagDataStruct> m_mag;
+    };
+
+    bool IsVisibleLightCamera(ResearchModeSensorType sensorType)
+    {
+        return sensorType == LEFT_FRONT || sensorType == LEFT_LEFT ||
+            sensorType == RIGHT_FRONT || sensorType == RIGHT_RIGHT;
+    }
+
+    bool IsImuSensor(ResearchModeSensorType sensorType)
+    {
+        return sensorType == IMU_ACCEL || sensorType == IMU_GYRO || sensorType == IMU_MAG;
+    }
+}
+
+HRESULT SyntheticResearchModeSensor::Create(
+    const SyntheticSensorSettings& settings,
+    IResearchModeSensor** ppSensor)
+{
+    if (!ppSensor)
+    {
+        return E_POINTER;
+    }
+    if (settings.FrameRate <= 0.0 ||
+        (settings.SensorType != DEPTH_AHAT && settings.SensorType != DEPTH_LONG_THROW &&
+            !IsVisibleLightCamera(settings.SensorType) && !IsImuSensor(settings.SensorType)))
+    {
+        *ppSensor = nullptr;
+        return E_INVALIDARG;
+    }
+    *ppSensor = new SyntheticResearchModeSensor(settings);
+    return S_OK;
+}
+
+SyntheticResearchModeSensor::SyntheticResearchModeSensor(
+    const SyntheticSensorSettings& settings) :
+    m_settings(settings)
+{
+    m_resolution = ResolutionOf(settings.SensorType);
+    m_framePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / settings.FrameRate));
+
+    if (IsImuSensor(settings.SensorType))
+    {
+        // samples are generated per batch, there is no pattern to replay
+        m_samplesPerFrame = settings.SamplesPerFrame ?
+            settings.SamplesPerFrame : DefaultSamplesPerFrame(settings.SensorType);
+        return;
+    }
+
+    for (unsigned int i = 0; i < std::max(1u, settings.PatternCount); ++i)
+    {
+        m_patterns.push_back(GeneratePattern(settings.SensorType, i));
+    }
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::QueryInterface(REFIID riid, void** ppvObject)
+{
+    if (!ppvObject)
+    {
+        return E_POINTER;
+    }
+    if (riid == RM_IID_OF(IResearchModeSensor))
+    {
+        *ppvObject = static_cast<IResearchModeSensor*>(this);
+    }
+    else if (riid == RM_IID_OF(IResearchModeCameraSensor) && !IsImuSensor(m_settings.SensorType))
+    {
+        *ppvObject = static_cast<IResearchModeCameraSensor*>(this);
+    }
+    else
+    {
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+    AddRef();
+    return S_OK;
+}
+
+STDMETHODIMP_(ULONG) SyntheticResearchModeSensor::AddRef()
+{
+    return ++m_refCount;
+}
+
+STDMETHODIMP_(ULONG) SyntheticResearchModeSensor::Release()
+{
+    ULONG refCount = --m_refCount;
+    if (refCount == 0)
+    {
+        delete this;
+    }
+    return refCount;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::OpenStream()
+{
+    m_nextFrameTime = std::chrono::steady_clock::now() + m_framePeriod;
+    m_streamOpen = true;
+    return S_OK;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::CloseStream()
+{
+    m_streamOpen = false;
+    return S_OK;
+}
+
+STDMETHODIMP_(LPCWSTR) SyntheticResearchModeSensor::GetFriendlyName()
+{
+    switch (m_settings.SensorType)
+    {
+    case DEPTH_AHAT:
+        return L"Synthetic Depth AHAT";
+    case DEPTH_LONG_THROW:
+        return L"Synthetic Depth Long Throw";
+    case LEFT_FRONT:
+        return L"Synthetic Left Front";
+    case LEFT_LEFT:
+        return L"Synthetic Left Left";
+    case RIGHT_FRONT:
+        return L"Synthetic Right Front";
+    case IMU_ACCEL:
+        return L"Synthetic Accelerometer";
+    case IMU_GYRO:
+        return L"Synthetic Gyroscope";
+    case IMU_MAG:
+        return L"Synthetic Magnetometer";
+    default:
+        return L"Synthetic Right Right";
+    }
+}
+
+STDMETHODIMP_(ResearchModeSensorType) SyntheticResearchModeSensor::GetSensorType()
+{
+    return m_settings.SensorType;
+}
+
+float SyntheticResearchModeSensor::FocalLength() const
+{
+    // tan(60 degrees)
+    return m_resolution.Width * 0.5f / 1.7320508f;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::MapImagePointToCameraUnitPlane(float(&uv)[2], float(&xy)[2])
+{
+    const float dx = uv[0] - m_resolution.Width * 0.5f;
+    const float dy = uv[1] - m_resolution.Height * 0.5f;
+    const float fovRadius = m_resolution.Width * kFovRadius;
+    if (dx * dx + dy * dy > fovRadius * fovRadius)
+    {
+        return E_FAIL;
+    }
+    xy[0] = dx / FocalLength();
+    xy[1] = dy / FocalLength();
+    return S_OK;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::MapCameraSpaceToImagePoint(float(&xy)[2], float(&uv)[2])
+{
+    const float dx = xy[0] * FocalLength();
+    const float dy = xy[1] * FocalLength();
+    const float fovRadius = m_resolution.Width * kFovRadius;
+    if (dx * dx + dy * dy > fovRadius * fovRadius)
+    {
+        return E_FAIL;
+    }
+    uv[0] = dx + m_resolution.Width * 0.5f;
+    uv[1] = dy + m_resolution.Height * 0.5f;
+    return S_OK;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::GetCameraExtrinsicsMatrix(DirectX::XMFLOAT4X4* pCameraViewMatrix)
+{
+    if (!pCameraViewMatrix)
+    {
+        return E_POINTER;
+    }
+    *pCameraViewMatrix = { { { 1.0f, 0.0f, 0.0f, 0.0f },
+        { 0.0f, 1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 1.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f, 1.0f } } };
+    return S_OK;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::GetSampleBufferSize(size_t* pSampleBufferSize)
+{
+    switch (m_settings.SensorType)
+    {
+    case IMU_ACCEL:
+        *pSampleBufferSize = m_samplesPerFrame * sizeof(AccelDataStruct);
+        break;
+    case IMU_GYRO:
+        *pSampleBufferSize = m_samplesPerFrame * sizeof(GyroDataStruct);
+        break;
+    case IMU_MAG:
+        *pSampleBufferSize = m_samplesPerFrame * sizeof(MagDataStruct);
+        break;
+    default:
+        *pSampleBufferSize = static_cast<size_t>(m_resolution.Width) * m_resolution.Height * m_resolution.BytesPerPixel;
+        break;
+    }
+    return S_OK;
+}
+
+STDMETHODIMP SyntheticResearchModeSensor::GetNextBuffer(IResearchModeSensorFrame** ppSensorFrame)
+{
+    if (!ppSensorFrame)
+    {
+        return E_POINTER;
+    }
+    *ppSensorFrame = nullptr;
+    if (!m_streamOpen)
+    {
+        return E_ABORT;
+    }
+
+    std::this_thread::sleep_until(m_nextFrameTime);
+    auto now = std::chrono::steady_clock::now();
+    // do not try to catch up on frames we were too slow to fetch
+    m_nextFrameTime = std::max(m_nextFrameTime + m_framePeriod, now);
+
+    ResearchModeSensorTimestamp timestamp{};
+    timestamp.Source = SensorTimestampSource_CenterOfExposure;
+    timestamp.HostTicks = HostTicksOf(now);
+    timestamp.HostTicksPerSecond = kHostTicksPerSecond;
+    timestamp.SensorTicks = timestamp.HostTicks;
+    timestamp.SensorTicksPerSecond = kHostTicksPerSecond;
+
+    if (IsImuSensor(m_settings.SensorType))
+    {
+        // the batch ends now; its first sample is at the frame timestamp
+        const UINT64 samplePeriodNs = static_cast<UINT64>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(m_framePeriod).count()) / m_samplesPerFrame;
+        const UINT64 lastSampleNs = static_cast<UINT64>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+        const UINT64 firstSampleNs = lastSampleNs - (m_samplesPerFrame - 1) * samplePeriodNs;
+        timestamp.Source = SensorTimestampSource_Unknown;
+        timestamp.HostTicks = firstSampleNs / 100;
+        timestamp.SensorTicks = timestamp.HostTicks;
+        ++m_frameIndex;
+
+        auto pFrame = new SyntheticImuFrame(
+            m_settings.SensorType, timestamp, firstSampleNs, samplePeriodNs, m_samplesPerFrame);
+        *ppSensorFrame = static_cast<IResearchModeSensorFrame*>(pFrame);
+        return S_OK;
+    }
+
+    auto pattern = m_patterns[m_frameIndex++ % m_patterns.size()];
+    if (IsVisibleLightCamera(m_settings.SensorType))
+    {
+        auto pFrame = new SyntheticVlcFrame(m_resolution, timestamp, m_settings, pattern);
+        *ppSensorFrame = static_cast<IResearchModeSensorFrame*>(pFrame);
+        return S_OK;
+    }
+    auto pFrame = new SyntheticDepthFrame(m_resolution, timestamp, pattern);
+    *ppSensorFrame = static_cast<IResearchModeSensorFrame*>(pFrame);
+    return S_OK;
+}
+
+ResearchModeSensorResolution SyntheticResearchModeSensor::ResolutionOf(ResearchModeSensorType sensorType)
+{
+    ResearchModeSensorResolution resolution{};
+    if (IsVisibleLightCamera(sensorType))
+    {
+        resolution.Width = 640;
+        resolution.Height = 480;
+        resolution.BitsPerPixel = 8;
+        resolution.BytesPerPixel = 1;
+        resolution.Stride = resolution.Width;
+        return resolution;
+    }
+    if (sensorType == DEPTH_LONG_THROW)
+    {
+        resolution.Width = 320;
+        resolution.Height = 288;
+    }
+    else
+    {
+        resolution.Width = 512;
+        resolution.Height = 512;
+    }
+    resolution.BitsPerPixel = 16;
+    resolution.BytesPerPixel = 2;
+    resolution.Stride = resolution.Width * resolution.BytesPerPixel;
+    return resolution;
+}
+
+unsigned int SyntheticResearchModeSensor::DefaultSamplesPerFrame(ResearchModeSensorType sensorType)
+{
+    switch (sensorType)
+    {
+    case IMU_ACCEL:
+        return 93;
+    case IMU_GYRO:
+        return 32;
+    default:
+        return 1;
+    }
+}
+
+std::shared_ptr<const SyntheticResearchModeSensor::FramePattern> SyntheticResearchModeSensor::GeneratePattern(
+    ResearchModeSensorType sensorType,
+    unsigned int index)
+{
+    const ResearchModeSensorResolution resolution = ResolutionOf(sensorType);
+    if (IsVisibleLightCamera(sensorType))
+    {
+        return GenerateVisibleLightPattern(resolution, index);
+    }
+    const bool isLongThrow = (sensorType == DEPTH_LONG_THROW);
+    const int width = resolution.Width;
+    const int height = resolution.Height;
+
+    auto pattern = std::make_shared<FramePattern>();
+    pattern->Depth.resize(static_cast<size_t>(width) * height);
+    pattern->Ab.resize(pattern->Depth.size());
+    if (isLongThrow)
+    {
+        pattern->Sigma.resize(pattern->Depth.size());
+    }
+
+    // A tilted floor plane and a sphere in front of it, seen through a circular
+    // field of view; everything outside of it is invalid, like on the device.
+    const float scale = isLongThrow ? 4.0f : 1.0f;
+    const float phase = 0.2f * index;
+    const float sphereX = width * (0.4f + 0.1f * std::sin(phase));
+    const float sphereY = height * 0.5f;
+    const float sphereRadius = width * 0.18f;
+    const float fovRadius = width * kFovRadius;
+    // AHAT marks invalid pixels in the depth itself, Long Throw only in sigma
+    const UINT16 invalidDepth = 4095;
+
+    Lcg noise(0x9e3779b9u + index);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const size_t i = static_cast<size_t>(y) * width + x;
+            const float dx = x - width * 0.5f;
+            const float dy = y - height * 0.5f;
+            const bool outsideFov = (dx * dx + dy * dy) > fovRadius * fovRadius;
+
+            float depth = scale * (450.0f + 1.1f * y + 0.15f * x);
+            const float sx = x - sphereX;
+            const float sy = y - sphereY;
+            const float r2 = sx * sx + sy * sy;
+            if (r2 < sphereRadius * sphereRadius)
+            {
+                depth = scale * (300.0f - std::sqrt(sphereRadius * sphereRadius - r2));
+            }
+            depth += static_cast<float>(noise.Next() % 5) - 2.0f;
+
+            // far, dark surfaces come back without a valid measurement
+            const bool dropout = (noise.Next() % 97) == 0;
+            const bool invalid = outsideFov || dropout || depth >= scale * 1000.0f;
+
+            pattern->Depth[i] = (invalid && !isLongThrow) ? invalidDepth :
+                static_cast<UINT16>(std::min(depth, 65535.0f));
+            pattern->Ab[i] = invalid ? static_cast<UINT16>(noise.Next() % 16) :
+                static_cast<UINT16>(std::min(65535.0f, 4.0e7f / (depth * depth / (scale * scale)) + noise.Next() % 32));
+            if (isLongThrow)
+            {
+                // the most significant bit of sigma marks invalid pixels
+                pattern->Sigma[i] = invalid ? 0x80 : static_cast<BYTE>(noise.Next() % 32);
+            }
+        }
+    }
+    return pattern;
+}
+
+std::shared_ptr<const SyntheticResearchModeSensor::FramePattern> SyntheticResearchModeSensor::GenerateVisibleLightPattern(
+    const ResearchModeSensorResolution& resolution,
+    unsigned int index)
+{
+    const int width = resolution.Width;
+    const int height = resolution.Height;
+
+    auto pattern = std::make_shared<FramePattern>();
+    pattern->Image.resize(static_cast<size_t>(width) * height);
+
+    // a vignetted, slowly panning checkerboard with sensor noise
+    const int offset = static_cast<int>(index) * 3;
+    Lcg noise(0x85ebca6bu + index);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const float dx = (x - width * 0.5f) / width;
+            const float dy = (y - height * 0.5f) / height;
+            const float vignette = 1.0f - 1.5f * (dx * dx + dy * dy);
+            const bool light = (((x + offset) / 40) + (y / 40)) % 2 == 0;
+            const float value = (light ? 170.0f : 60.0f) * vignette + static_cast<float>(noise.Next() % 9);
+            pattern->Image[static_cast<size_t>(y) * width + x] =
+                static_cast<BYTE>(std::max(0.0f, std::min(255.0f, value)));
+        }
+    }
+    return pattern;
+}
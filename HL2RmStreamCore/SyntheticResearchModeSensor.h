@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "PortableResearchModeApi.h"
+
+struct SyntheticSensorSettings
+{
+	ResearchModeSensorType SensorType = DEPTH_AHAT;
+	double FrameRate = 45.0;
+	// number of distinct frames generated up front and replayed in a loop
+	unsigned int PatternCount = 8;
+	// reported by visible light camera frames
+	UINT64 Exposure = 10000;
+	UINT32 Gain = 1000;
+	// IMU sensors only, samples per batch; 0 picks the batch size of the device
+	unsigned int SamplesPerFrame = 0;
+};
+
+// Research mode sensor that synthesizes frames with the shape of the real device
+// streams (AHAT: 512x512 uint16, Long Throw: 320x288 uint16, visible light
+// cameras: 640x480 uint8) at a fixed rate. IMU sensors deliver batches of
+// evenly spaced samples, with the first sample at the frame timestamp.
+// GetNextBuffer blocks until the next frame is due, like the real sensor does.
+// The cameras implement IResearchModeCameraSensor with an ideal pinhole model.
+class SyntheticResearchModeSensor :
+	public IResearchModeSensor,
+	public IResearchModeCameraSensor
+{
+public:
+	static HRESULT Create(
+		const SyntheticSensorSettings& settings,
+		IResearchModeSensor** ppSensor);
+
+	// IUnknown
+	STDMETHOD(QueryInterface)(REFIID riid, void** ppvObject) override;
+	STDMETHOD_(ULONG, AddRef)() override;
+	STDMETHOD_(ULONG, Release)() override;
+
+	// IResearchModeSensor
+	STDMETHOD(OpenStream)() override;
+	STDMETHOD(CloseStream)() override;
+	STDMETHOD_(LPCWSTR, GetFriendlyName)() override;
+	STDMETHOD_(ResearchModeSensorType, GetSensorType)() override;
+	STDMETHOD(GetSampleBufferSize)(size_t* pSampleBufferSize) override;
+	STDMETHOD(GetNextBuffer)(IResearchModeSensorFrame** ppSensorFrame) override;
+
+	// IResearchModeCameraSensor: principal point in the image centre, a 120 degree
+	// horizontal field of view, and no mapping outside the circle the depth
+	// patterns are valid in. The camera sits at the rig origin.
+	STDMETHOD(MapImagePointToCameraUnitPlane)(float(&uv)[2], float(&xy)[2]) override;
+	STDMETHOD(MapCameraSpaceToImagePoint)(float(&xy)[2], float(&uv)[2]) override;
+	STDMETHOD(GetCameraExtrinsicsMatrix)(DirectX::XMFLOAT4X4* pCameraViewMatrix) override;
+
+	// Pixel buffers of the replayed frames, shared with the frames handed out.
+	struct FramePattern
+	{
+		std::vector<UINT16> Depth;
+		std::vector<UINT16> Ab;
+		std::vector<BYTE> Sigma;
+		// visible light cameras only
+		std::vector<BYTE> Image;
+	};
+
+	static ResearchModeSensorResolution ResolutionOf(ResearchModeSensorType sensorType);
+
+	// samples per batch of the IMU sensors on the device
+	static unsigned int DefaultSamplesPerFrame(ResearchModeSensorType sensorType);
+
+	static std::shared_ptr<const FramePattern> GeneratePattern(
+		ResearchModeSensorType sensorType,
+		unsigned int index);
+
+private:
+	explicit SyntheticResearchModeSensor(const SyntheticSensorSettings& settings);
+
+	static std::shared_ptr<const FramePattern> GenerateVisibleLightPattern(
+		const ResearchModeSensorResolution& resolution,
+		unsigned int index);
+	virtual ~SyntheticResearchModeSensor() = default;
+
+	float FocalLength() const;
+
+	std::atomic<ULONG> m_refCount{ 1 };
+	SyntheticSensorSettings m_settings;
+	ResearchModeSensorResolution m_resolution;
+	std::vector<std::shared_ptr<const FramePattern>> m_patterns;
+
+	std::atomic<bool> m_streamOpen{ false };
+	std::chrono::steady_clock::duration m_framePeriod;
+	std::chrono::steady_clock::time_point m_nextFrameTime;
+	unsigned long long m_frameIndex = 0;
+	unsigned int m_samplesPerFrame = 0;
+};
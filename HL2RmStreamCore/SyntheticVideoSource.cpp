@@ -0,0 +1,147 @@
+#include "SyntheticVideoSource.h"
+
+#include <algorithm>
+#include <chrono>
+
+SyntheticVideoSource::SyntheticVideoSource(
+    const SyntheticVideoSettings& settings,
+    std::shared_ptr<IVideoFrameViewSink> frameSink) :
+    m_settings(settings),
+    m_pFrameSink(frameSink),
+    m_pacer(settings.MinDelta)
+{
+    for (unsigned int i = 0; i < std::max(1u, settings.PatternCount); ++i)
+    {
+        m_patterns.push_back((settings.PixelFormat == VideoPixelFormat::Nv12) ?
+            GenerateNv12Pattern(settings.Width, settings.Height, i) :
+            GenerateBgraPattern(settings.Width, settings.Height, i));
+    }
+}
+
+SyntheticVideoSource::~SyntheticVideoSource()
+{
+    Stop();
+}
+
+void SyntheticVideoSource::Start()
+{
+    m_fExit = false;
+    m_frameThread = std::thread(FrameThread, this);
+    isRunning = true;
+}
+
+void SyntheticVideoSource::Stop()
+{
+    m_fExit = true;
+    if (m_frameThread.joinable())
+    {
+        m_frameThread.join();
+    }
+    isRunning = false;
+}
+
+void SyntheticVideoSource::FrameThread(SyntheticVideoSource* pSource)
+{
+    const auto framePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / pSource->m_settings.FrameRate));
+    auto nextFrameTime = std::chrono::steady_clock::now();
+    size_t frameIndex = 0;
+
+    while (!pSource->m_fExit)
+    {
+        std::this_thread::sleep_until(nextFrameTime);
+        auto now = std::chrono::steady_clock::now();
+        nextFrameTime = std::max(nextFrameTime + framePeriod, now);
+
+        const std::vector<uint8_t>& pattern = pSource->m_patterns[frameIndex % pSource->m_patterns.size()];
+
+        VideoFrameView frame;
+        frame.PixelFormat = pSource->m_settings.PixelFormat;
+        frame.pData = pattern.data();
+        frame.DataLength = static_cast<uint32_t>(pattern.size());
+        frame.Width = pSource->m_settings.Width;
+        frame.Height = pSource->m_settings.Height;
+        frame.RowStride = pSource->m_settings.Width * 4;
+        if (frame.PixelFormat == VideoPixelFormat::Nv12)
+        {
+            const size_t lumaSize = static_cast<size_t>(frame.Width) * frame.Height;
+            frame.DataLength = static_cast<uint32_t>(lumaSize);
+            frame.RowStride = frame.Width;
+            frame.pChroma = pattern.data() + lumaSize;
+            frame.ChromaDataLength = static_cast<uint32_t>(pattern.size() - lumaSize);
+            frame.ChromaRowStride = 2 * ((frame.Width + 1) / 2);
+        }
+        frame.Timestamp = std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10'000'000>>>(
+            now.time_since_epoch()).count();
+        if (!pSource->m_enabled || !pSource->m_pacer.Accept(static_cast<uint64_t>(frame.Timestamp)))
+        {
+            // still counts, like a frame the camera delivered and the device dropped
+            frameIndex++;
+            continue;
+        }
+        // roughly the intrinsics of the 640x360 PV profile
+        frame.Fx = 0.82f * frame.Width;
+        frame.Fy = 0.82f * frame.Width;
+        // an ideal camera, without distortion
+        frame.Cx = 0.5f * frame.Width;
+        frame.Cy = 0.5f * frame.Height;
+        // handed over right away, there is no queue to wait in
+        frame.Trace.Sequence = static_cast<uint32_t>(frameIndex++);
+        frame.Trace.CaptureTime = static_cast<uint64_t>(frame.Timestamp);
+        frame.Trace.DequeueTime = MonotonicTicks();
+
+        pSource->m_pFrameSink->Send(frame);
+    }
+}
+
+std::vector<uint8_t> SyntheticVideoSource::GenerateBgraPattern(
+    int width,
+    int height,
+    unsigned int index)
+{
+    std::vector<uint8_t> pattern(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; ++y)
+    {
+        uint8_t* pRow = pattern.data() + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; ++x)
+        {
+            pRow[4 * x + 0] = static_cast<uint8_t>(x + 4 * index);
+            pRow[4 * x + 1] = static_cast<uint8_t>(y + 2 * index);
+            pRow[4 * x + 2] = static_cast<uint8_t>(((x / 32) + (y / 32) + index) % 2 ? 200 : 40);
+            pRow[4 * x + 3] = 255;
+        }
+    }
+    return pattern;
+}
+
+std::vector<uint8_t> SyntheticVideoSource::GenerateNv12Pattern(
+    int width,
+    int height,
+    unsigned int index)
+{
+    const std::vector<uint8_t> bgra = GenerateBgraPattern(width, height, index);
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    const size_t lumaSize = static_cast<size_t>(width) * height;
+
+    std::vector<uint8_t> pattern(lumaSize + 2 * static_cast<size_t>(chromaWidth) * chromaHeight);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const uint8_t* pPixel = bgra.data() + 4 * (static_cast<size_t>(y) * width + x);
+            const int b = pPixel[0];
+            const int g = pPixel[1];
+            const int r = pPixel[2];
+            pattern[static_cast<size_t>(y) * width + x] =
+                static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            if ((x % 2) == 0 && (y % 2) == 0)
+            {
+                uint8_t* pChroma = pattern.data() + lumaSize + 2 * (static_cast<size_t>(y / 2) * chromaWidth + x / 2);
+                pChroma[0] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                pChroma[1] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+    }
+    return pattern;
+}
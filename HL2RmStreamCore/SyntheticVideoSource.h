@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "FramePacer.h"
+#include "VideoFrameView.h"
+
+struct SyntheticVideoSettings
+{
+	int Width = 640;
+	int Height = 360;
+	double FrameRate = 30.0;
+	unsigned int PatternCount = 4;
+	// Bgra8, or Nv12 as the PV camera delivers natively
+	VideoPixelFormat PixelFormat = VideoPixelFormat::Bgra8;
+	// frames are paced to one per MinDelta ticks like VideoCameraFrameProcessor
+	// paces them; 0 hands over all of them
+	uint64_t MinDelta = 0;
+};
+
+// Produces BGRA or NV12 frames shaped like the PV camera stream at a fixed rate and
+// hands them to a sink from its own thread, like MediaFrameReader and
+// VideoCameraFrameProcessor do.
+class SyntheticVideoSource
+{
+public:
+	SyntheticVideoSource(
+		const SyntheticVideoSettings& settings,
+		std::shared_ptr<IVideoFrameViewSink> frameSink);
+
+	~SyntheticVideoSource();
+
+	void Start();
+
+	void Stop();
+
+	// Changes the pacing of the frames while running, e.g. by a RateController.
+	void SetMinDelta(
+		uint64_t minDelta) { m_pacer.SetInterval(minDelta); }
+
+	uint64_t MinDelta() const { return m_pacer.Interval(); }
+
+	// Stops handing frames to the sink, or resumes it, like
+	// VideoCameraFrameProcessor::SetEnabled.
+	void SetEnabled(
+		bool enabled) { m_enabled = enabled; }
+
+	bool IsEnabled() const { return m_enabled; }
+
+	bool isRunning = false;
+
+	static std::vector<uint8_t> GenerateBgraPattern(
+		int width,
+		int height,
+		unsigned int index);
+
+	// the BGRA pattern converted to NV12 (BT.601, limited range)
+	static std::vector<uint8_t> GenerateNv12Pattern(
+		int width,
+		int height,
+		unsigned int index);
+
+private:
+	static void FrameThread(
+		SyntheticVideoSource* pSource);
+
+	SyntheticVideoSettings m_settings;
+	std::shared_ptr<IVideoFrameViewSink> m_pFrameSink;
+	std::vector<std::vector<uint8_t>> m_patterns;
+	// only Accept is restricted to the frame thread
+	FramePacer m_pacer;
+	std::atomic<bool> m_enabled{ true };
+
+	std::atomic<bool> m_fExit{ false };
+	std::thread m_frameThread;
+};
@@ -0,0 +1,30 @@
+#include "TcpFusedFrameStreamer.h"
+
+TcpFusedFrameStreamer::TcpFusedFrameStreamer(
+    uint16_t port,
+    const SendQueueSettings& queueSettings) :
+    m_server(port, queueSettings),
+    // fused messages are shared by the queues of all subscribers
+    m_wireBuffers(SendQueueBufferCount(queueSettings, TcpStreamServer::kMaxSubscribers))
+{
+    m_server.Start();
+}
+
+void TcpFusedFrameStreamer::Send(
+    const FusedFrameHeader& header,
+    const FrameTrace& trace,
+    const FrameBufferPtr& video,
+    const FrameBufferPtr& depth)
+{
+    // both frames go out as they were serialized for their own streams
+    m_message.SetHeader(StreamId::Fused, 0, header);
+    m_message.SetTrace(trace);
+    m_message.AddPayload(video->data(), video->size());
+    m_message.AddPayload(depth->data(), depth->size());
+    FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+    m_message.Clear();
+    if (wire)
+    {
+        m_server.Send(std::move(wire));
+    }
+}
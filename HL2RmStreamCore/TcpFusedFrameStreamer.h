@@ -0,0 +1,41 @@
+#pragma once
+
+#include "FrameSynchronizer.h"
+#include "TcpStreamServer.h"
+
+// Desktop counterpart of FusedFrameStreamer: sends the RGB-D pairs of a
+// FrameSynchronizer through a TcpStreamServer.
+class TcpFusedFrameStreamer : public IFusedFrameSink
+{
+public:
+	explicit TcpFusedFrameStreamer(
+		uint16_t port,
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	bool IsConnected() override { return m_server.IsConnected(); }
+
+	void Send(
+		const FusedFrameHeader& header,
+		const FrameTrace& trace,
+		const FrameBufferPtr& video,
+		const FrameBufferPtr& depth) override;
+
+	// Answers the StreamControl requests of the subscribers through router.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_server.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers over UDP, see DatagramSettings. Call before
+	// subscribers arrive.
+	void EnableDatagrams(const DatagramSettings& settings) { m_server.EnableDatagrams(settings); }
+
+	uint16_t Port() const { return m_server.Port(); }
+
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	std::vector<SendQueueStatistics> GetSubscriberStatistics() const { return m_server.SubscriberStatistics(); }
+
+private:
+	TcpStreamServer m_server;
+	FrameMessage m_message;
+	// fused messages, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+};
@@ -0,0 +1,53 @@
+#include "TcpImuStreamer.h"
+
+TcpImuStreamer::TcpImuStreamer(
+    uint16_t port,
+    ResearchModeSensorType sensorType,
+    const SendQueueSettings& queueSettings) :
+    m_server(port, queueSettings),
+    m_encoder(sensorType),
+    // serialized packets are shared by the queues of all subscribers
+    m_wireBuffers(SendQueueBufferCount(queueSettings, TcpStreamServer::kMaxSubscribers))
+{
+    m_server.Start();
+}
+
+void TcpImuStreamer::Send(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    ResearchModeSensorType /* pSensorType */,
+    const FrameTrace& trace)
+{
+    if (!m_server.IsConnected())
+    {
+        return;
+    }
+
+    ResearchModeSensorTimestamp rmTimestamp;
+    if (FAILED(frame->GetTimeStamp(&rmTimestamp)))
+    {
+        return;
+    }
+
+    FrameBufferPtr payload = m_bufferPool.Acquire();
+    if (!payload)
+    {
+        return;
+    }
+
+    ImuPacketHeader header;
+    if (!m_encoder.Encode(frame.get(), rmTimestamp.HostTicks, header, *payload))
+    {
+        return;
+    }
+
+    // the whole batch goes out as one message
+    m_message.SetHeader(m_encoder.Stream(), 0, header);
+    m_message.SetTrace(trace);
+    m_message.AddPayload(payload);
+    FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+    m_message.Clear();
+    if (wire)
+    {
+        m_server.Send(std::move(wire));
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "IResearchModeFrameSink.h"
+#include "ImuFrameEncoder.h"
+#include "TcpStreamServer.h"
+
+// Desktop counterpart of ImuStreamer: sends every sample batch of an IMU sensor
+// as one packet through a TcpStreamServer.
+class TcpImuStreamer : public IResearchModeFrameSink
+{
+public:
+	explicit TcpImuStreamer(
+		uint16_t port,
+		ResearchModeSensorType sensorType,
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	void Send(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		ResearchModeSensorType pSensorType,
+		const FrameTrace& trace);
+
+	// Answers the StreamControl requests of the subscribers through router.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_server.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers over UDP, see DatagramSettings. Call before
+	// subscribers arrive.
+	void EnableDatagrams(const DatagramSettings& settings) { m_server.EnableDatagrams(settings); }
+
+	uint16_t Port() const { return m_server.Port(); }
+
+	bool isConnected() const { return m_server.IsConnected(); }
+
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	SendQueueStatistics GetQueueStatistics() const { return m_server.QueueStatistics(); }
+
+	std::vector<SendQueueStatistics> GetSubscriberStatistics() const { return m_server.SubscriberStatistics(); }
+
+private:
+	TcpStreamServer m_server;
+	ImuFrameEncoder m_encoder;
+	// samples of one batch, only held until the message is serialized
+	FrameBufferPool m_bufferPool;
+	FrameMessage m_message;
+	// serialized packets, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+};
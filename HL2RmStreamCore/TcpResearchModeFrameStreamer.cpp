@@ -0,0 +1,113 @@
+#include "TcpResearchModeFrameStreamer.h"
+
+TcpResearchModeFrameStreamer::TcpResearchModeFrameStreamer(
+    uint16_t port,
+    const SendQueueSettings& queueSettings,
+    ResearchModeSensorType sensorType,
+    bool includeAb) :
+    m_server(port, queueSettings),
+    m_encoder(sensorType, includeAb),
+    // serialized frames are shared by the queues of all subscribers and may be
+    // held by a synchronizer
+    m_wireBuffers(SendQueueBufferCount(queueSettings, TcpStreamServer::kMaxSubscribers) +
+        FrameSynchronizer::kMaxBufferedFrames)
+{
+    m_server.SetSupportedCodecs(m_encoder.SupportedCodecs());
+    m_server.Start();
+}
+
+bool TcpResearchModeFrameStreamer::SetCameraSensor(
+    IResearchModeSensor* pSensor)
+{
+    if (!m_encoder.SetCameraSensor(pSensor))
+    {
+        return false;
+    }
+    m_server.SetSupportedCodecs(m_encoder.SupportedCodecs());
+    return true;
+}
+
+void TcpResearchModeFrameStreamer::Send(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    ResearchModeSensorType /* pSensorType */,
+    const FrameTrace& trace)
+{
+    const bool synchronizing = m_pSynchronizer && m_pSynchronizer->IsActive();
+    if (!m_server.IsConnected() && !synchronizing && !m_pLocalFrames)
+    {
+        return;
+    }
+
+    ResearchModeSensorTimestamp rmTimestamp;
+    if (FAILED(frame->GetTimeStamp(&rmTimestamp)))
+    {
+        return;
+    }
+    RigidPose rigPose;
+    if (m_pPoses && !m_pPoses->TryGetPose(rmTimestamp.HostTicks, rigPose))
+    {
+        return;
+    }
+    if (m_pLocalFrames)
+    {
+        m_pLocalFrames->PublishResearchMode(frame.get(), m_encoder.SensorType(), m_encoder.IncludesAb(),
+            rmTimestamp.HostTicks, m_pPoses ? rigPose.ToMatrix() : Float4x4::Identity(), trace);
+    }
+
+    // a new calibration goes with this frame and the ones after it
+    ResearchModeSensorResolution resolution;
+    if (m_encoder.HasCameraSensor() && SUCCEEDED(frame->GetResolution(&resolution)))
+    {
+        FrameBufferPtr calibration = m_encoder.Calibration(resolution.Width, resolution.Height);
+        if (calibration != m_calibration)
+        {
+            m_calibration = calibration;
+            m_server.SetSessionMessage(calibration);
+        }
+    }
+
+    // encode once per codec the subscribers asked for
+    uint32_t codecs = m_server.RequestedCodecs();
+    if (synchronizing)
+    {
+        codecs |= CodecBit(m_pSynchronizer->Codec());
+    }
+    for (DepthCodec codec : kDepthCodecs)
+    {
+        if (!(codecs & CodecBit(codec)))
+        {
+            continue;
+        }
+
+        // the previous payload went back to the pool once it was serialized
+        FrameBufferPtr payload = m_bufferPool.Acquire();
+        if (!payload)
+        {
+            return;
+        }
+
+        ResearchModeFrameHeader header;
+        DepthCodec encodedCodec = codec;
+        if (!m_encoder.Encode(frame.get(), header, *payload, encodedCodec))
+        {
+            return;
+        }
+        header.Timestamp = rmTimestamp.HostTicks;
+        header.Rig2World = m_pPoses ? rigPose.ToMatrix() : Float4x4::Identity();
+
+        m_message.SetHeader(m_encoder.Stream(), static_cast<uint32_t>(encodedCodec), header);
+        m_message.SetTrace(trace);
+        m_message.AddPayload(payload);
+        FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+        m_message.Clear();
+        if (!wire)
+        {
+            continue;
+        }
+        if (synchronizing && codec == m_pSynchronizer->Codec())
+        {
+            m_pSynchronizer->AddDepth(header.Timestamp, wire);
+        }
+        m_server.Send(std::move(wire), codec);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "FrameSynchronizer.h"
+#include "IResearchModeFrameSink.h"
+#include "LocalFrameExchange.h"
+#include "PoseCache.h"
+#include "ResearchModeFrameEncoder.h"
+#include "TcpStreamServer.h"
+
+// Desktop counterpart of ResearchModeFrameStreamer: encodes research mode frames
+// exactly like the device does and streams them through a TcpStreamServer.
+// Without a spatial locator the rig pose is reported as identity, unless a pose
+// cache is set.
+class TcpResearchModeFrameStreamer : public IResearchModeFrameSink
+{
+public:
+	// sensorType and includeAb are passed on to the ResearchModeFrameEncoder.
+	explicit TcpResearchModeFrameStreamer(
+		uint16_t port,
+		const SendQueueSettings& queueSettings = SendQueueSettings(),
+		ResearchModeSensorType sensorType = DEPTH_AHAT,
+		bool includeAb = false);
+
+	void Send(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		ResearchModeSensorType pSensorType,
+		const FrameTrace& trace);
+
+	// Also hands every serialized frame to synchronizer while it is active, to be
+	// paired with the frames of the other stream in the codec it asks for. Call before frames arrive.
+	void SetSynchronizer(std::shared_ptr<FrameSynchronizer> synchronizer) { m_pSynchronizer = std::move(synchronizer); }
+
+	// Takes the rig pose of every frame from poses, like the device does, and
+	// drops frames it has no pose for. Call before frames arrive.
+	void SetPoseCache(std::shared_ptr<PoseCache> poses) { m_pPoses = std::move(poses); }
+
+	// Also publishes the image of every frame to frames, for a consumer in this
+	// process, whether or not anyone is connected. Call before frames arrive.
+	void SetLocalFrames(std::shared_ptr<LocalFrameExchange> frames) { m_pLocalFrames = std::move(frames); }
+
+	// Sends the calibration of pSensor to every subscriber ahead of its first
+	// frame and, for depth, offers the point cloud codecs. Returns false if pSensor
+	// is no camera. Call before frames arrive.
+	bool SetCameraSensor(IResearchModeSensor* pSensor);
+
+	// Answers the StreamControl requests of the subscribers through router.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_server.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers over UDP, see DatagramSettings. Call before
+	// subscribers arrive.
+	void EnableDatagrams(const DatagramSettings& settings) { m_server.EnableDatagrams(settings); }
+
+	uint16_t Port() const { return m_server.Port(); }
+
+	bool isConnected() const { return m_server.IsConnected(); }
+
+	FrameBufferPoolStatistics GetBufferStatistics() const { return m_bufferPool.Statistics(); }
+
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	SendQueueStatistics GetQueueStatistics() const { return m_server.QueueStatistics(); }
+
+	std::vector<SendQueueStatistics> GetSubscriberStatistics() const { return m_server.SubscriberStatistics(); }
+
+private:
+	TcpStreamServer m_server;
+	ResearchModeFrameEncoder m_encoder;
+	// payloads, only held until the message is serialized
+	FrameBufferPool m_bufferPool;
+	FrameMessage m_message;
+	// serialized messages, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+	std::shared_ptr<FrameSynchronizer> m_pSynchronizer;
+	std::shared_ptr<PoseCache> m_pPoses;
+	std::shared_ptr<LocalFrameExchange> m_pLocalFrames;
+	// the session message of the server
+	FrameBufferPtr m_calibration;
+};
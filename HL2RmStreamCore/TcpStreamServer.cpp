@@ -0,0 +1,989 @@
+#include "TcpStreamServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Platform.h"
+
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+namespace
+{
+    const uint64_t kTicksPerMs = 10000;
+
+    uint64_t ToAddress(
+        const sockaddr_in& address)
+    {
+        return (static_cast<uint64_t>(ntohl(address.sin_addr.s_addr)) << 16) | ntohs(address.sin_port);
+    }
+
+    sockaddr_in ToSocketAddress(
+        uint64_t address)
+    {
+        sockaddr_in socketAddress{};
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_addr.s_addr = htonl(static_cast<uint32_t>(address >> 16));
+        socketAddress.sin_port = htons(static_cast<uint16_t>(address & 0xffff));
+        return socketAddress;
+    }
+}
+
+TcpStreamServer::TcpStreamServer(
+    uint16_t port,
+    const SendQueueSettings& queueSettings) :
+    m_port(port),
+    m_queueSettings(queueSettings)
+{
+}
+
+TcpStreamServer::~TcpStreamServer()
+{
+    Stop();
+}
+
+void TcpStreamServer::EnableDatagrams(
+    const DatagramSettings& settings)
+{
+    m_datagramsEnabled = true;
+    m_datagramSettings = settings;
+    if (m_listenSocket >= 0)
+    {
+        OpenDatagramSocket();
+    }
+}
+
+bool TcpStreamServer::OpenDatagramSocket()
+{
+    const int datagramSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (datagramSocket < 0)
+    {
+        return false;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(m_port);
+    if (bind(datagramSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"TcpStreamServer::OpenDatagramSocket: Failed to open datagram socket on %u with %d.\n",
+            (unsigned int)m_port, errno);
+        OutputDebugStringW(msgBuffer);
+#endif
+        close(datagramSocket);
+        return false;
+    }
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"TcpStreamServer::OpenDatagramSocket: Taking datagram subscribers at %u.\n",
+        (unsigned int)m_port);
+    OutputDebugStringW(msgBuffer);
+#endif
+    m_datagramSocket = datagramSocket;
+    return true;
+}
+
+bool TcpStreamServer::Start()
+{
+    m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenSocket < 0)
+    {
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(m_port);
+
+    if (bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(m_listenSocket, kMaxSubscribers) < 0)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"TcpStreamServer::Start: Failed to open listener on %u with %d.\n",
+            (unsigned int)m_port, errno);
+        OutputDebugStringW(msgBuffer);
+#endif
+        close(m_listenSocket);
+        m_listenSocket = -1;
+        return false;
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+
+    if (m_datagramsEnabled)
+    {
+        OpenDatagramSocket();
+    }
+
+    m_fExit = false;
+    m_acceptThread = std::thread(AcceptThread, this);
+
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"TcpStreamServer::Start: Server is listening at %u.\n",
+        (unsigned int)m_port);
+    OutputDebugStringW(msgBuffer);
+#endif
+    return true;
+}
+
+void TcpStreamServer::Stop()
+{
+    m_fExit = true;
+    if (m_acceptThread.joinable())
+    {
+        m_acceptThread.join();
+    }
+    if (m_listenSocket >= 0)
+    {
+        close(m_listenSocket);
+        m_listenSocket = -1;
+    }
+    RemoveSubscribers(true);
+    if (m_datagramSocket >= 0)
+    {
+        close(m_datagramSocket.exchange(-1));
+    }
+}
+
+bool TcpStreamServer::IsConnected() const
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    for (const auto& subscriber : m_subscribers)
+    {
+        if (!subscriber->Disconnected)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t TcpStreamServer::SubscriberCount() const
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    return static_cast<uint32_t>(m_subscribers.size());
+}
+
+void TcpStreamServer::SetSupportedCodecs(
+    uint32_t codecs)
+{
+    m_supportedCodecs = codecs | CodecBit(DepthCodec::Raw);
+}
+
+uint32_t TcpStreamServer::RequestedCodecs() const
+{
+    uint32_t codecs = 0;
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    for (const auto& subscriber : m_subscribers)
+    {
+        if (!subscriber->Disconnected)
+        {
+            codecs |= CodecBit(subscriber->Codec);
+        }
+    }
+    return codecs;
+}
+
+void TcpStreamServer::SetStreamControl(
+    std::shared_ptr<StreamControlRouter> router)
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    m_pStreamControl = std::move(router);
+}
+
+void TcpStreamServer::SetSessionMessage(
+    FrameBufferPtr message)
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    m_sessionMessage = std::move(message);
+}
+
+bool TcpStreamServer::Send(
+    FrameBufferPtr frame,
+    DepthCodec codec)
+{
+    bool queued = false;
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    for (const auto& subscriber : m_subscribers)
+    {
+        // every queue holds a reference to the same buffer
+        if (!subscriber->Disconnected && subscriber->Codec == codec &&
+            subscriber->Queue.Push(frame, m_sessionMessage))
+        {
+            queued = true;
+        }
+    }
+    return queued;
+}
+
+SendQueueStatistics TcpStreamServer::QueueStatistics() const
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    SendQueueStatistics total = m_removedStatistics;
+    for (const auto& subscriber : m_subscribers)
+    {
+        const SendQueueStatistics statistics = subscriber->Queue.Statistics();
+        total.Queued += statistics.Queued;
+        total.Sent += statistics.Sent;
+        total.SentBytes += statistics.SentBytes;
+        total.Dropped += statistics.Dropped;
+        total.Pending += statistics.Pending;
+    }
+    return total;
+}
+
+std::vector<SendQueueStatistics> TcpStreamServer::SubscriberStatistics() const
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    std::vector<SendQueueStatistics> statistics;
+    statistics.reserve(m_subscribers.size());
+    for (const auto& subscriber : m_subscribers)
+    {
+        statistics.push_back(subscriber->Queue.Statistics());
+    }
+    return statistics;
+}
+
+bool TcpStreamServer::SendAll(
+    int clientSocket,
+    const ConstBuffer* pSegments,
+    size_t segmentCount)
+{
+    if (clientSocket < 0)
+    {
+        return false;
+    }
+
+    // first segment not yet fully sent and how much of it is
+    size_t segment = 0;
+    size_t offset = 0;
+    while (segment < segmentCount)
+    {
+        iovec vectors[16];
+        int vectorCount = 0;
+        for (size_t i = segment; i < segmentCount && vectorCount < 16; ++i)
+        {
+            const size_t skip = (i == segment) ? offset : 0;
+            vectors[vectorCount].iov_base = const_cast<uint8_t*>(pSegments[i].pData) + skip;
+            vectors[vectorCount].iov_len = pSegments[i].Size - skip;
+            ++vectorCount;
+        }
+
+        msghdr header{};
+        header.msg_iov = vectors;
+        header.msg_iovlen = vectorCount;
+        ssize_t written = sendmsg(clientSocket, &header, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+#if DBG_ENABLE_INFO_LOGGING
+            OutputDebugStringW(L"TcpStreamServer::SendAll: Client disconnected.\n");
+#endif
+            return false;
+        }
+
+        size_t remaining = static_cast<size_t>(written);
+        while (segment < segmentCount && remaining >= pSegments[segment].Size - offset)
+        {
+            remaining -= pSegments[segment].Size - offset;
+            offset = 0;
+            ++segment;
+        }
+        offset += remaining;
+    }
+    return true;
+}
+
+void TcpStreamServer::AcceptThread(TcpStreamServer* pServer)
+{
+    while (!pServer->m_fExit)
+    {
+        pServer->RemoveSubscribers(false);
+
+        // only this thread adds or removes subscribers, so the pointers stay valid;
+        // -1 is ignored by poll
+        std::vector<pollfd> polls{
+            { pServer->m_listenSocket, POLLIN, 0 },
+            { pServer->m_datagramSocket, POLLIN, 0 } };
+        const size_t firstSubscriber = polls.size();
+        std::vector<Subscriber*> subscribers;
+        {
+            const uint64_t now = MonotonicTicks();
+            std::lock_guard<std::mutex> guard(pServer->m_subscribersMutex);
+            for (const auto& subscriber : pServer->m_subscribers)
+            {
+                if (subscriber->Socket < 0)
+                {
+                    if (!subscriber->Disconnected &&
+                        now - subscriber->LastHeard > pServer->m_datagramSettings.SubscriptionTimeoutMs * kTicksPerMs)
+                    {
+#if DBG_ENABLE_INFO_LOGGING
+                        wchar_t msgBuffer[200];
+                        swprintf_s(msgBuffer, L"TcpStreamServer::AcceptThread: Datagram subscriber at %u timed out.\n",
+                            (unsigned int)pServer->m_port);
+                        OutputDebugStringW(msgBuffer);
+#endif
+                        subscriber->Disconnected = true;
+                        subscriber->Queue.Close();
+                    }
+                    continue;
+                }
+                polls.push_back({ subscriber->Socket, POLLIN, 0 });
+                subscribers.push_back(subscriber.get());
+            }
+        }
+        if (poll(polls.data(), polls.size(), 100) <= 0)
+        {
+            continue;
+        }
+
+        if (polls[1].revents & POLLIN)
+        {
+            pServer->ReceiveDatagrams();
+        }
+        for (size_t i = 0; i < subscribers.size(); ++i)
+        {
+            if ((polls[firstSubscriber + i].revents & (POLLIN | POLLHUP | POLLERR)) &&
+                !pServer->ReceiveRequest(subscribers[i]))
+            {
+                // stops the writer; the subscriber is removed on the next round
+                subscribers[i]->Disconnected = true;
+                subscribers[i]->Queue.Close();
+            }
+        }
+        if (!(polls[0].revents & POLLIN))
+        {
+            continue;
+        }
+
+        int clientSocket = accept(pServer->m_listenSocket, nullptr, nullptr);
+        if (clientSocket < 0)
+        {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> guard(pServer->m_subscribersMutex);
+        if (pServer->m_subscribers.size() >= kMaxSubscribers)
+        {
+#if DBG_ENABLE_ERROR_LOGGING
+            wchar_t msgBuffer[200];
+            swprintf_s(msgBuffer, L"TcpStreamServer::AcceptThread: Refused connection at %u, %u subscribers.\n",
+                (unsigned int)pServer->m_port, kMaxSubscribers);
+            OutputDebugStringW(msgBuffer);
+#endif
+            close(clientSocket);
+            continue;
+        }
+
+        int noDelay = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        auto subscriber = std::make_unique<Subscriber>(clientSocket, pServer->m_queueSettings);
+        subscriber->Writer = std::thread(WriterThread, subscriber.get());
+        pServer->m_subscribers.push_back(std::move(subscriber));
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"TcpStreamServer::AcceptThread: Received connection at %u, %u subscribers.\n",
+            (unsigned int)pServer->m_port, (unsigned int)pServer->m_subscribers.size());
+        OutputDebugStringW(msgBuffer);
+#endif
+    }
+}
+
+bool TcpStreamServer::ReceiveRequest(Subscriber* pSubscriber)
+{
+    // the rest of the last message, which is of a type the server does not take
+    // or longer than the server knows
+    uint8_t discarded[256];
+    uint8_t* pTarget = discarded;
+    size_t wanted = std::min(pSubscriber->SkipBytes, sizeof(discarded));
+    if (wanted == 0)
+    {
+        pTarget = pSubscriber->Request + pSubscriber->RequestBytes;
+        wanted = pSubscriber->RequestSize - pSubscriber->RequestBytes;
+    }
+    const ssize_t received = recv(pSubscriber->Socket, pTarget, wanted, MSG_DONTWAIT);
+    if (received < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (received == 0)
+    {
+        return false;
+    }
+    if (pTarget == discarded)
+    {
+        pSubscriber->SkipBytes -= static_cast<size_t>(received);
+        return true;
+    }
+
+    pSubscriber->RequestBytes += static_cast<size_t>(received);
+    if (pSubscriber->RequestBytes < pSubscriber->RequestSize)
+    {
+        return true;
+    }
+
+    MessageHeader request;
+    memcpy(&request, pSubscriber->Request, sizeof(request));
+    if (pSubscriber->RequestBytes == sizeof(MessageHeader))
+    {
+        if (!request.IsValid())
+        {
+            // there is no telling where the next message starts
+#if DBG_ENABLE_ERROR_LOGGING
+            OutputDebugStringW(L"TcpStreamServer::ReceiveRequest: Malformed message, closing connection.\n");
+#endif
+            return false;
+        }
+        if (request.MessageType == static_cast<uint16_t>(MessageType::StreamControl) &&
+            request.HeaderSize >= sizeof(MessageHeader) + sizeof(StreamControlHeader))
+        {
+            // its type header comes next
+            pSubscriber->RequestSize = sizeof(MessageHeader) + sizeof(StreamControlHeader);
+            return true;
+        }
+    }
+    // a StreamControl message too short for its type header only asks for the state
+    StreamControlHeader control{};
+    if (pSubscriber->RequestBytes > sizeof(MessageHeader))
+    {
+        memcpy(&control, pSubscriber->Request + sizeof(MessageHeader), sizeof(control));
+    }
+    pSubscriber->SkipBytes = request.Size() - pSubscriber->RequestBytes;
+    pSubscriber->RequestBytes = 0;
+    pSubscriber->RequestSize = sizeof(MessageHeader);
+
+    HandleRequest(pSubscriber, request, control);
+    return true;
+}
+
+void TcpStreamServer::ReceiveDatagrams()
+{
+    // a datagram is a whole message, so only as much of it as the server reads
+    uint8_t datagram[sizeof(MessageHeader) + sizeof(StreamControlHeader)];
+    while (true)
+    {
+        sockaddr_in from{};
+        socklen_t fromLength = sizeof(from);
+        const ssize_t received = recvfrom(m_datagramSocket, datagram, sizeof(datagram), MSG_DONTWAIT | MSG_TRUNC,
+            reinterpret_cast<sockaddr*>(&from), &fromLength);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+
+        MessageHeader request;
+        if (static_cast<size_t>(received) < sizeof(request))
+        {
+            continue;
+        }
+        memcpy(&request, datagram, sizeof(request));
+        if (!request.IsValid())
+        {
+            continue;
+        }
+        StreamControlHeader control{};
+        if (request.HeaderSize >= sizeof(MessageHeader) + sizeof(StreamControlHeader) &&
+            static_cast<size_t>(received) >= sizeof(datagram))
+        {
+            memcpy(&control, datagram + sizeof(MessageHeader), sizeof(control));
+        }
+        const bool subscribe = request.MessageType == static_cast<uint16_t>(MessageType::Subscribe);
+        SubscribeHeader subscription{};
+        const bool hasSubscription = subscribe &&
+            request.HeaderSize >= sizeof(MessageHeader) + sizeof(SubscribeHeader) &&
+            static_cast<size_t>(received) >= sizeof(MessageHeader) + sizeof(SubscribeHeader);
+        if (hasSubscription)
+        {
+            memcpy(&subscription, datagram + sizeof(MessageHeader), sizeof(subscription));
+        }
+
+        const uint64_t address = ToAddress(from);
+        const uint64_t now = MonotonicTicks();
+        Subscriber* pSubscriber = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(m_subscribersMutex);
+            for (const auto& subscriber : m_subscribers)
+            {
+                if (subscriber->Socket < 0 && subscriber->Address == address && !subscriber->Disconnected)
+                {
+                    pSubscriber = subscriber.get();
+                    break;
+                }
+            }
+            if (!pSubscriber)
+            {
+                // anything else from an unknown sender, e.g. a stray or spoofed
+                // datagram, would hold a subscriber slot until it times out
+                if (!subscribe)
+                {
+                    continue;
+                }
+                if (m_subscribers.size() >= kMaxSubscribers)
+                {
+#if DBG_ENABLE_ERROR_LOGGING
+                    wchar_t msgBuffer[200];
+                    swprintf_s(msgBuffer, L"TcpStreamServer::ReceiveDatagrams: Refused subscriber at %u, %u subscribers.\n",
+                        (unsigned int)m_port, kMaxSubscribers);
+                    OutputDebugStringW(msgBuffer);
+#endif
+                    continue;
+                }
+                auto subscriber = std::make_unique<Subscriber>(-1, m_queueSettings, m_datagramSettings);
+                subscriber->Address = address;
+                subscriber->Writer = std::thread(DatagramWriterThread, this, subscriber.get());
+                pSubscriber = subscriber.get();
+                m_subscribers.push_back(std::move(subscriber));
+#if DBG_ENABLE_INFO_LOGGING
+                wchar_t msgBuffer[200];
+                swprintf_s(msgBuffer, L"TcpStreamServer::ReceiveDatagrams: Datagram subscriber at %u, %u subscribers.\n",
+                    (unsigned int)m_port, (unsigned int)m_subscribers.size());
+                OutputDebugStringW(msgBuffer);
+#endif
+            }
+            pSubscriber->LastHeard = now;
+        }
+        if (hasSubscription)
+        {
+            pSubscriber->Sessions.OnSubscribe(subscription, now);
+        }
+        HandleRequest(pSubscriber, request, control);
+    }
+}
+
+void TcpStreamServer::HandleRequest(
+    Subscriber* pSubscriber,
+    const MessageHeader& request,
+    const StreamControlHeader& control)
+{
+    if (request.MessageType == static_cast<uint16_t>(MessageType::StreamControl))
+    {
+        std::shared_ptr<StreamControlRouter> router;
+        {
+            std::lock_guard<std::mutex> guard(m_subscribersMutex);
+            router = m_pStreamControl;
+        }
+        FrameBufferPtr reply = router ?
+            router->Apply(request.StreamId, control) :
+            StreamControlRouter::Serialize(request.StreamId, StreamControlHeader{});
+        // goes out ahead of the next frame, past a full queue
+        pSubscriber->Queue.PushReply(std::move(reply));
+        return;
+    }
+    if (request.MessageType != static_cast<uint16_t>(MessageType::CodecRequest))
+    {
+        return;
+    }
+
+    const bool supported = request.Codec < 32 &&
+        (m_supportedCodecs & CodecBit(static_cast<DepthCodec>(request.Codec)));
+    pSubscriber->Codec = supported ? static_cast<DepthCodec>(request.Codec) : DepthCodec::Raw;
+#if DBG_ENABLE_INFO_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"TcpStreamServer::HandleRequest: Codec %u requested at %u, sending %u.\n",
+        request.Codec, (unsigned int)m_port, static_cast<uint32_t>(pSubscriber->Codec.load()));
+    OutputDebugStringW(msgBuffer);
+#endif
+}
+
+void TcpStreamServer::WriterThread(Subscriber* pSubscriber)
+{
+    // the session message this subscriber got last
+    FrameBufferPtr sentSession;
+    // the headers of the frame being written, with the write time of this subscriber
+    std::vector<uint8_t> headers;
+    while (true)
+    {
+        FrameBufferPtr reply;
+        bool replied = true;
+        while (replied && pSubscriber->Queue.TryPopReply(reply))
+        {
+            const ConstBuffer segment = { reply->data(), reply->size() };
+            replied = SendAll(pSubscriber->Socket, &segment, 1);
+        }
+        if (!replied)
+        {
+            break;
+        }
+
+        FrameBufferPtr frame;
+        FrameBufferPtr session;
+        if (!pSubscriber->Queue.WaitPop(frame, session, 100))
+        {
+            if (pSubscriber->Disconnected)
+            {
+                break;
+            }
+            continue;
+        }
+
+        ConstBuffer segments[3];
+        size_t segmentCount = 0;
+        // The session message goes out with the first frame and again with the
+        // first frame after it changed, so that the subscriber always has the one
+        // that was current when the frame was encoded.
+        if (session && session != sentSession)
+        {
+            segments[segmentCount++] = { session->data(), session->size() };
+        }
+        // The frame is shared with the other subscribers, so the write time goes
+        // into a copy of its headers, sent in their place.
+        size_t headerSize = 0;
+        if (frame->size() >= sizeof(MessageHeader))
+        {
+            headerSize = std::min<size_t>(reinterpret_cast<const MessageHeader*>(frame->data())->HeaderSize, frame->size());
+            headers.assign(frame->data(), frame->data() + headerSize);
+            SetWriteTime(headers.data(), headerSize, MonotonicTicks());
+            segments[segmentCount++] = { headers.data(), headerSize };
+        }
+        segments[segmentCount++] = { frame->data() + headerSize, frame->size() - headerSize };
+        if (!SendAll(pSubscriber->Socket, segments, segmentCount))
+        {
+            break;
+        }
+        size_t bytes = 0;
+        for (size_t i = 0; i < segmentCount; ++i)
+        {
+            bytes += segments[i].Size;
+        }
+        if (session)
+        {
+            sentSession = std::move(session);
+        }
+        pSubscriber->Queue.MarkSent(bytes);
+    }
+
+    // the accept thread removes the subscriber; until then it takes no frames
+    pSubscriber->Disconnected = true;
+    pSubscriber->Queue.Close();
+}
+
+void TcpStreamServer::DatagramWriterThread(TcpStreamServer* pServer, Subscriber* pSubscriber)
+{
+    FrameFragmenter fragmenter(pServer->m_datagramSettings);
+    const sockaddr_in address = ToSocketAddress(pSubscriber->Address);
+    auto sendDatagram = [&](const DatagramHeader& header, const uint8_t* pFragment, size_t size)
+    {
+        iovec vectors[2] = {
+            { const_cast<DatagramHeader*>(&header), sizeof(header) },
+            { const_cast<uint8_t*>(pFragment), size } };
+        msghdr message{};
+        message.msg_name = const_cast<sockaddr_in*>(&address);
+        message.msg_namelen = sizeof(address);
+        message.msg_iov = vectors;
+        message.msg_iovlen = 2;
+        while (sendmsg(pServer->m_datagramSocket, &message, MSG_NOSIGNAL) < 0 && errno == EINTR)
+        {
+        }
+        // a datagram that could not be sent is lost like one the network drops
+        return !pSubscriber->Disconnected;
+    };
+
+    // messages sent to this subscriber before
+    uint32_t frameId = 0;
+    while (true)
+    {
+        FrameBufferPtr reply;
+        while (pSubscriber->Queue.TryPopReply(reply))
+        {
+            fragmenter.Fragment(frameId++, reply->data(), reply->size(), 0, false, sendDatagram);
+        }
+
+        FrameBufferPtr frame;
+        FrameBufferPtr session;
+        if (!pSubscriber->Queue.WaitPop(frame, session, 100))
+        {
+            if (pSubscriber->Disconnected)
+            {
+                break;
+            }
+            continue;
+        }
+
+        // The session message is left out of the statistics: it took no time on
+        // the link yet, and would make the link look faster than it is.
+        if (pSubscriber->Sessions.NeedsSending(session))
+        {
+            pSubscriber->Sessions.Sent(session, frameId, MonotonicTicks());
+            fragmenter.Fragment(frameId++, session->data(), session->size(), 0, true, sendDatagram);
+        }
+        const size_t bytes = fragmenter.Fragment(frameId++, frame->data(), frame->size(), MonotonicTicks(), false, sendDatagram);
+        pSubscriber->Queue.MarkSent(bytes);
+    }
+
+    pSubscriber->Disconnected = true;
+    pSubscriber->Queue.Close();
+}
+
+void TcpStreamServer::RemoveSubscribers(bool all)
+{
+    std::vector<std::unique_ptr<Subscriber>> removed;
+    {
+        std::lock_guard<std::mutex> guard(m_subscribersMutex);
+        auto keep = m_subscribers.begin();
+        for (auto& subscriber : m_subscribers)
+        {
+            if (all || subscriber->Disconnected)
+            {
+                removed.push_back(std::move(subscriber));
+            }
+            else
+            {
+                *keep++ = std::move(subscriber);
+            }
+        }
+        m_subscribers.erase(keep, m_subscribers.end());
+    }
+
+    for (auto& subscriber : removed)
+    {
+        // unblocks the writer if it is waiting for a frame or stuck in send
+        subscriber->Disconnected = true;
+        subscriber->Queue.Close();
+        if (subscriber->Socket >= 0)
+        {
+            shutdown(subscriber->Socket, SHUT_RDWR);
+        }
+        subscriber->Writer.join();
+        if (subscriber->Socket >= 0)
+        {
+            close(subscriber->Socket);
+        }
+
+        const SendQueueStatistics statistics = subscriber->Queue.Statistics();
+        std::lock_guard<std::mutex> guard(m_subscribersMutex);
+        m_removedStatistics.Queued += statistics.Queued;
+        m_removedStatistics.Sent += statistics.Sent;
+        m_removedStatistics.SentBytes += statistics.SentBytes;
+        m_removedStatistics.Dropped += statistics.Dropped;
+    }
+}
+
+TcpStreamClient::~TcpStreamClient()
+{
+    Close();
+}
+
+bool TcpStreamClient::Connect(
+    const std::string& host,
+    uint16_t port)
+{
+    Close();
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_socket < 0)
+    {
+        return false;
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        connect(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void TcpStreamClient::Close()
+{
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool TcpStreamClient::ReadExactly(
+    void* pData,
+    size_t size)
+{
+    uint8_t* pBytes = static_cast<uint8_t*>(pData);
+    while (size > 0)
+    {
+        ssize_t received = recv(m_socket, pBytes, size, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        pBytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+bool TcpStreamClient::WaitReadable(
+    int timeoutMs)
+{
+    pollfd readable{ m_socket, POLLIN, 0 };
+    return poll(&readable, 1, timeoutMs) != 0;
+}
+
+bool TcpStreamClient::WriteAll(
+    const void* pData,
+    size_t size)
+{
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    while (size > 0)
+    {
+        ssize_t written = send(m_socket, pBytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        pBytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+UdpStreamClient::UdpStreamClient(
+    uint32_t deadlineMs) :
+    m_reassembler(deadlineMs),
+    m_datagram(65536)
+{
+}
+
+UdpStreamClient::~UdpStreamClient()
+{
+    Close();
+}
+
+bool UdpStreamClient::Open(
+    const std::string& host,
+    uint16_t port)
+{
+    Close();
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0)
+    {
+        return false;
+    }
+
+    // a frame arrives as a burst of datagrams
+    int receiveBuffer = 8 * 1024 * 1024;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        connect(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void UdpStreamClient::Close()
+{
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+    }
+}
+
+bool UdpStreamClient::Send(
+    const void* pData,
+    size_t size)
+{
+    ssize_t written;
+    while ((written = send(m_socket, pData, size, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+    {
+    }
+    return written == static_cast<ssize_t>(size);
+}
+
+bool UdpStreamClient::Subscribe(
+    StreamId streamId)
+{
+    FrameMessage message;
+    message.SetHeader(streamId, 0, m_reassembler.Subscription());
+    std::vector<uint8_t> datagram;
+    message.FlattenInto(datagram);
+    return Send(datagram.data(), datagram.size());
+}
+
+bool UdpStreamClient::Receive(
+    std::vector<uint8_t>& message,
+    int timeoutMs)
+{
+    const uint64_t deadline = MonotonicTicks() + static_cast<uint64_t>(timeoutMs) * kTicksPerMs;
+    while (true)
+    {
+        const uint64_t now = MonotonicTicks();
+        if (now >= deadline)
+        {
+            m_reassembler.Expire(now);
+            return false;
+        }
+        pollfd readable{ m_socket, POLLIN, 0 };
+        if (poll(&readable, 1, static_cast<int>((deadline - now + kTicksPerMs - 1) / kTicksPerMs)) <= 0)
+        {
+            continue;
+        }
+        const ssize_t received = recv(m_socket, m_datagram.data(), m_datagram.size(), MSG_DONTWAIT);
+        if (received < 0)
+        {
+            // e.g. ECONNREFUSED while the server is not up yet
+            continue;
+        }
+        if (m_lossRate > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_random) < m_lossRate)
+        {
+            m_dropped++;
+            continue;
+        }
+        if (m_reassembler.Add(m_datagram.data(), static_cast<size_t>(received), MonotonicTicks(), message))
+        {
+            return true;
+        }
+    }
+}
+
+void UdpStreamClient::SetLossRate(
+    double rate,
+    uint32_t seed)
+{
+    m_lossRate = rate;
+    m_random.seed(seed);
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DatagramFraming.h"
+#include "FrameHeaders.h"
+#include "FrameMessage.h"
+#include "FrameSendQueue.h"
+#include "StreamControlRouter.h"
+
+// Blocking TCP listener for desktop builds of the core. Like the
+// StreamSocketListener based streamers it accepts several subscribers per stream,
+// e.g. a recorder and a live viewer. Every subscriber has its own send queue and
+// writer thread, so a slow one only loses its own frames; the frame buffers
+// themselves are shared, so a frame is serialized once however many subscribers
+// there are. Subscribers can ask for a codec with a MessageType::CodecRequest;
+// frames are then encoded once per codec in use. MessageType::StreamControl
+// requests go to the StreamControlRouter, and its reply back to the subscriber
+// ahead of the next frame, however full its queue is. With EnableDatagrams
+// clients can subscribe over UDP as well, see DatagramSettings; they count
+// against the same limit.
+class TcpStreamServer
+{
+public:
+	// subscribers beyond this are refused
+	static const uint32_t kMaxSubscribers = 4;
+
+	explicit TcpStreamServer(
+		uint16_t port,
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	~TcpStreamServer();
+
+	// Also takes subscribers on the UDP port of the same number, from now on or
+	// once started. Call once, before subscribers arrive.
+	void EnableDatagrams(
+		const DatagramSettings& settings = DatagramSettings());
+
+	// Binds and starts accepting connections. Port 0 picks an ephemeral port. If
+	// the UDP port cannot be bound, the stream goes over TCP only.
+	bool Start();
+
+	void Stop();
+
+	// true while at least one subscriber is connected or subscribed
+	bool IsConnected() const;
+
+	uint32_t SubscriberCount() const;
+
+	// Codecs subscribers may request, as a mask of CodecBit values. Raw is always
+	// supported.
+	void SetSupportedCodecs(
+		uint32_t codecs);
+
+	// codecs requested by the connected subscribers, as a mask of CodecBit values
+	uint32_t RequestedCodecs() const;
+
+	// Where StreamControl requests go; without a router they are answered with an
+	// empty state.
+	void SetStreamControl(
+		std::shared_ptr<StreamControlRouter> router);
+
+	// Message every subscriber gets ahead of its first frame, e.g. the calibration
+	// of the camera. Frames sent from now on go with this message; subscribers
+	// that had another one get it again ahead of the first of them. nullptr sends
+	// none.
+	void SetSessionMessage(
+		FrameBufferPtr message);
+
+	// Queues a serialized frame for every subscriber that uses codec. Returns false
+	// if no subscriber took it.
+	bool Send(
+		FrameBufferPtr frame,
+		DepthCodec codec = DepthCodec::Raw);
+
+	// totals over all subscribers, including ones that have disconnected
+	SendQueueStatistics QueueStatistics() const;
+
+	// one entry per connected subscriber, oldest connection first
+	std::vector<SendQueueStatistics> SubscriberStatistics() const;
+
+	const SendQueueSettings& QueueSettings() const { return m_queueSettings; }
+
+	uint16_t Port() const { return m_port; }
+
+private:
+	struct Subscriber
+	{
+		Subscriber(
+			int socket,
+			const SendQueueSettings& settings,
+			const DatagramSettings& datagramSettings = DatagramSettings()) :
+			Socket(socket),
+			Queue(settings),
+			Sessions(datagramSettings)
+		{
+		}
+
+		// -1 for a datagram subscriber
+		int Socket;
+		FrameSendQueue Queue;
+		std::thread Writer;
+		std::atomic<bool> Disconnected{ false };
+		std::atomic<DepthCodec> Codec{ DepthCodec::Raw };
+		// where a datagram subscriber subscribed from, as IPv4 address << 16 | port,
+		// and when it was heard from last
+		uint64_t Address = 0;
+		uint64_t LastHeard = 0;
+		// when a datagram subscriber gets the session message
+		DatagramSessionTracker Sessions;
+		// Partially received message header, followed by the type header of the
+		// messages the server reads one of; only touched by the accept thread.
+		uint8_t Request[sizeof(MessageHeader) + sizeof(StreamControlHeader)] = {};
+		size_t RequestBytes = 0;
+		// bytes of Request the current message fills
+		size_t RequestSize = sizeof(MessageHeader);
+		// bytes left of the last message that are not read
+		size_t SkipBytes = 0;
+	};
+
+	// Accepts connections and reads the messages of the subscribers.
+	static void AcceptThread(
+		TcpStreamServer* pServer);
+
+	// Reads what the subscriber sent; returns false if it closed the connection or
+	// sent something that is no message.
+	bool ReceiveRequest(
+		Subscriber* pSubscriber);
+
+	// Binds the UDP port; returns false if it cannot.
+	bool OpenDatagramSocket();
+
+	// Reads the datagrams waiting on the UDP socket, subscribing the senders of
+	// MessageType::Subscribe.
+	void ReceiveDatagrams();
+
+	// Acts on a message of a subscriber, over either transport. control is only
+	// read for StreamControl requests.
+	void HandleRequest(
+		Subscriber* pSubscriber,
+		const MessageHeader& request,
+		const StreamControlHeader& control);
+
+	static void WriterThread(
+		Subscriber* pSubscriber);
+
+	static void DatagramWriterThread(
+		TcpStreamServer* pServer,
+		Subscriber* pSubscriber);
+
+	static bool SendAll(
+		int clientSocket,
+		const ConstBuffer* pSegments,
+		size_t segmentCount);
+
+	// Joins and closes subscribers whose connection was lost, or all of them.
+	void RemoveSubscribers(
+		bool all);
+
+	uint16_t m_port;
+	const SendQueueSettings m_queueSettings;
+	std::atomic<uint32_t> m_supportedCodecs{ CodecBit(DepthCodec::Raw) };
+	int m_listenSocket = -1;
+	bool m_datagramsEnabled = false;
+	DatagramSettings m_datagramSettings;
+	// -1 until EnableDatagrams, which writes the settings first
+	std::atomic<int> m_datagramSocket{ -1 };
+	std::atomic<bool> m_fExit{ false };
+
+	mutable std::mutex m_subscribersMutex;
+	std::vector<std::unique_ptr<Subscriber>> m_subscribers;
+	FrameBufferPtr m_sessionMessage;
+	std::shared_ptr<StreamControlRouter> m_pStreamControl;
+	// counters of subscribers that are gone
+	SendQueueStatistics m_removedStatistics;
+	std::thread m_acceptThread;
+};
+
+// Connects to a TcpStreamServer; used by tools and benchmarks.
+class TcpStreamClient
+{
+public:
+	~TcpStreamClient();
+
+	bool Connect(
+		const std::string& host,
+		uint16_t port);
+
+	void Close();
+
+	// Reads exactly size bytes, returns false when the connection is closed.
+	bool ReadExactly(
+		void* pData,
+		size_t size);
+
+	// Waits up to timeoutMs for something to read; returns false if there is
+	// nothing yet.
+	bool WaitReadable(
+		int timeoutMs);
+
+	// Writes all size bytes, returns false when the connection is closed.
+	bool WriteAll(
+		const void* pData,
+		size_t size);
+
+private:
+	int m_socket = -1;
+};
+
+// Subscribes to the UDP transport of a TcpStreamServer and puts its messages back
+// together; used by tools.
+class UdpStreamClient
+{
+public:
+	explicit UdpStreamClient(
+		uint32_t deadlineMs = 100);
+
+	~UdpStreamClient();
+
+	// Sets up the socket; nothing is sent until the first Send subscribes.
+	bool Open(
+		const std::string& host,
+		uint16_t port);
+
+	void Close();
+
+	// Sends data as one datagram, e.g. a CodecRequest or StreamControl message.
+	bool Send(
+		const void* pData,
+		size_t size);
+
+	// Subscribes to streamId, or keeps the subscription alive, telling the server
+	// which session message arrived last; call it about once a second.
+	bool Subscribe(
+		StreamId streamId);
+
+	// Waits up to timeoutMs for the next complete message; returns false if there
+	// is none yet.
+	bool Receive(
+		std::vector<uint8_t>& message,
+		int timeoutMs);
+
+	// Drops this share of the datagrams that arrive, at random, as a lossy link
+	// would.
+	void SetLossRate(
+		double rate,
+		uint32_t seed = 1);
+
+	ReassemblyStatistics Statistics() const { return m_reassembler.Statistics(); }
+
+	// datagrams SetLossRate dropped
+	uint64_t DroppedDatagrams() const { return m_dropped; }
+
+private:
+	int m_socket = -1;
+	FrameReassembler m_reassembler;
+	std::vector<uint8_t> m_datagram;
+	double m_lossRate = 0.0;
+	std::minstd_rand m_random;
+	uint64_t m_dropped = 0;
+};
@@ -0,0 +1,91 @@
+#include "TcpVideoFrameStreamer.h"
+
+TcpVideoFrameStreamer::TcpVideoFrameStreamer(
+    uint16_t port,
+    int scaleFactor,
+    VideoPixelFormat pixelFormat,
+    const SendQueueSettings& queueSettings) :
+    m_server(port, queueSettings),
+    m_scaleFactor(scaleFactor),
+    m_pixelFormat(pixelFormat),
+    // serialized frames are shared by the queues of all subscribers and may be
+    // held by a synchronizer
+    m_wireBuffers(SendQueueBufferCount(queueSettings, TcpStreamServer::kMaxSubscribers) +
+        FrameSynchronizer::kMaxBufferedFrames)
+{
+    m_server.Start();
+}
+
+void TcpVideoFrameStreamer::SetEncoding(
+    int scaleFactor,
+    VideoPixelFormat pixelFormat)
+{
+    m_scaleFactor = scaleFactor;
+    m_pixelFormat = pixelFormat;
+}
+
+void TcpVideoFrameStreamer::Send(const VideoFrameView& frame)
+{
+    const bool synchronizing = m_pSynchronizer && m_pSynchronizer->IsActive();
+    if (!m_server.IsConnected() && !synchronizing && !m_pLocalFrames)
+    {
+        return;
+    }
+
+    RigidPose rigPose;
+    if (m_pPoses && !m_pPoses->TryGetPose(static_cast<uint64_t>(frame.Timestamp), rigPose))
+    {
+        return;
+    }
+    if (m_pLocalFrames)
+    {
+        m_pLocalFrames->PublishVideo(frame, static_cast<uint64_t>(frame.Timestamp),
+            m_pPoses ? rigPose.ToMatrix() : frame.PVtoWorld);
+        if (!m_server.IsConnected() && !synchronizing)
+        {
+            return;
+        }
+    }
+
+    // the previous payload went back to the pool once it was serialized
+    FrameBufferPtr payload = m_bufferPool.Acquire();
+    if (!payload)
+    {
+        return;
+    }
+
+    m_encoder.scaleFactor = m_scaleFactor;
+    m_encoder.pixelFormat = m_pixelFormat;
+    VideoFrameHeader header;
+    if (!m_encoder.Encode(frame, header, *payload))
+    {
+        return;
+    }
+    if (m_pPoses)
+    {
+        header.PVtoWorld = rigPose.ToMatrix();
+    }
+
+    // a new calibration goes with this frame and the ones after it
+    FrameBufferPtr calibration = m_encoder.Calibration(frame);
+    if (calibration != m_calibration)
+    {
+        m_calibration = calibration;
+        m_server.SetSessionMessage(calibration);
+    }
+
+    m_message.SetHeader(StreamId::PhotoVideo, static_cast<uint32_t>(m_encoder.pixelFormat), header);
+    m_message.SetTrace(frame.Trace);
+    m_message.AddPayload(payload);
+    FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+    m_message.Clear();
+    if (!wire)
+    {
+        return;
+    }
+    if (synchronizing)
+    {
+        m_pSynchronizer->AddVideo(header.Timestamp, wire);
+    }
+    m_server.Send(std::move(wire));
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "FrameSynchronizer.h"
+#include "LocalFrameExchange.h"
+#include "PoseCache.h"
+#include "VideoFrameEncoder.h"
+#include "TcpStreamServer.h"
+
+// Desktop counterpart of VideoCameraStreamer. Like it, it sends the calibration
+// of the camera to every subscriber ahead of its first frame and again when the
+// decimation changes it.
+class TcpVideoFrameStreamer : public IVideoFrameViewSink
+{
+public:
+	// scaleFactor and pixelFormat select what is sent, see VideoFrameEncoder
+	explicit TcpVideoFrameStreamer(
+		uint16_t port,
+		int scaleFactor = 1,
+		VideoPixelFormat pixelFormat = VideoPixelFormat::Bgr8,
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	void Send(const VideoFrameView& frame);
+
+	// Changes decimation and wire format from the next frame on, e.g. by a
+	// RateController. May be called from any thread.
+	void SetEncoding(
+		int scaleFactor,
+		VideoPixelFormat pixelFormat);
+
+	int ScaleFactor() const { return m_scaleFactor; }
+
+	VideoPixelFormat PixelFormat() const { return m_pixelFormat; }
+
+	// Also hands every serialized frame to synchronizer while it is active, to be
+	// paired with the frames of the other stream. Call before frames arrive.
+	void SetSynchronizer(std::shared_ptr<FrameSynchronizer> synchronizer) { m_pSynchronizer = std::move(synchronizer); }
+
+	// Takes PVtoWorld of every frame from poses, with the PV camera at the rig
+	// origin, and drops frames it has no pose for. Call before frames arrive.
+	void SetPoseCache(std::shared_ptr<PoseCache> poses) { m_pPoses = std::move(poses); }
+
+	// Also publishes the pixels of every frame to frames, as captured, for a
+	// consumer in this process, whether or not anyone is connected. Call before
+	// frames arrive.
+	void SetLocalFrames(std::shared_ptr<LocalFrameExchange> frames) { m_pLocalFrames = std::move(frames); }
+
+	// Answers the StreamControl requests of the subscribers through router.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_server.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers over UDP, see DatagramSettings. Call before
+	// subscribers arrive.
+	void EnableDatagrams(const DatagramSettings& settings) { m_server.EnableDatagrams(settings); }
+
+	uint16_t Port() const { return m_server.Port(); }
+
+	bool isConnected() const { return m_server.IsConnected(); }
+
+	FrameBufferPoolStatistics GetBufferStatistics() const { return m_bufferPool.Statistics(); }
+
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	SendQueueStatistics GetQueueStatistics() const { return m_server.QueueStatistics(); }
+
+	std::vector<SendQueueStatistics> GetSubscriberStatistics() const { return m_server.SubscriberStatistics(); }
+
+private:
+	TcpStreamServer m_server;
+	VideoFrameEncoder m_encoder;
+	// what SetEncoding asked for, handed to m_encoder by Send
+	std::atomic<int> m_scaleFactor;
+	std::atomic<VideoPixelFormat> m_pixelFormat;
+	// payloads, only held until the message is serialized
+	FrameBufferPool m_bufferPool;
+	FrameMessage m_message;
+	// serialized messages, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+	std::shared_ptr<FrameSynchronizer> m_pSynchronizer;
+	std::shared_ptr<PoseCache> m_pPoses;
+	std::shared_ptr<LocalFrameExchange> m_pLocalFrames;
+	// the session message of the server
+	FrameBufferPtr m_calibration;
+};
@@ -0,0 +1,1857 @@
+// Runs the streaming pipeline on synthetic depth and PV sources and receives both
+// streams over loopback, reporting achieved frame rate, throughput and latency.
+//
+// usage: HL2RmStreamLoopback [--seconds N] [--ahat-fps F] [--pv-fps F]
+//                            [--long-throw] [--lt-fps F] [--ab]
+//                            [--vlc N] [--vlc-fps F] [--workers N] [--imu]
+//                            [--pv-width W] [--pv-height H] [--pv-profile WxH[@F]]
+//                            [--pv-decimation D]
+//                            [--pv-format bgr|nv12|luma] [--depth-codec C]
+//                            [--queue-depth N] [--queue-policy drop-oldest|drop-newest|max-age]
+//                            [--max-age-ms T] [--client-mbps R] [--subscribers N]
+//                            [--ahat-port P] [--lt-port P] [--vlc-port P] [--imu-port P]
+//                            [--pv-port P] [--fuse] [--fuse-tolerance-ms T] [--fuse-port P]
+//                            [--pose-rate R] [--adaptive] [--adaptive-period-ms T]
+//                            [--max-interval-ms T] [--pv-max-decimation D]
+//                            [--pv-cheapest-format bgr|nv12|luma] [--serve-only]
+//                            [--control T:STREAM:SETTING[,SETTING...]]...
+//                            [--udp] [--udp-loss P] [--udp-parity N] [--udp-datagram B]
+//                            [--udp-deadline-ms T] [--local] [--local-rate R]
+//
+// --subscribers connects N receivers to each stream. --client-mbps limits how
+// fast the first receiver of each stream reads, to see how the send queues behave
+// on a link that cannot keep up and that the other receivers are not held back.
+// --depth-codec makes the depth receivers request that codec (raw, rvl, points-mm
+// or points-half) and decode it; the point clouds are checked for their layout.
+// --long-throw streams Long Throw depth instead of AHAT, as the device cannot run
+// both depth modes at once; --ab appends the AB image to every depth frame.
+// --vlc streams the first N of the four visible light cameras on consecutive
+// ports. The research mode sensors share --workers acquisition threads (0 gives
+// every sensor its own acquisition and processing thread; by default there is one
+// per sensor plus one). --imu streams the
+// accelerometer, gyroscope and magnetometer on consecutive ports; their receivers
+// check that every packet holds its samples in timestamp order and latency is
+// measured from the first sample of a batch. --fuse pairs PV and depth frames on
+// the device side and streams the pairs on their own port, with the depth in the
+// --depth-codec; the receivers report how far apart the frames of a pair are.
+// --pose-rate samples a synthetic head motion R times per second into a pose cache
+// shared by the depth, VLC and PV streams, which take the pose of every frame from
+// it; the receivers report how far the poses are off the true motion.
+// --adaptive puts the depth, VLC and PV streams under rate control: every
+// --adaptive-period-ms a controller per stream looks at its send queues and paces
+// the frames out to at most --max-interval-ms apart, decimates PV down to
+// --pv-max-decimation and falls back to --pv-cheapest-format (by default the
+// cheapest the synthetic PV capture format allows) while frames are dropped, and
+// steps back up once the link keeps up again. Combine it with --client-mbps.
+// --pv-profile picks the HoloLens 2 PV profile closest to W x H at F fps (0 leaves
+// a value open) the way the plugin picks among the profiles of the camera, and
+// has the synthetic PV source capture that instead of --pv-width, --pv-height and
+// --pv-fps.
+// --control makes the first depth receiver send a StreamControl request T seconds
+// after it connected, like a client that only reads depth and turns the other
+// streams down: STREAM is ahat, lt, lf, ll, rf, rr, acc, gyr, mag or pv, the
+// settings are on, off, interval-ms=N, decimation=N and format=bgr|nv12|luma
+// (the last two PV only), or state to only ask. The replies are reported.
+// --udp has the receivers subscribe over UDP instead of connecting, with
+// datagrams of --udp-datagram bytes and a parity datagram after every
+// --udp-parity of them (0 for none). Every receiver drops a share --udp-loss of
+// the datagrams that arrive, at random, and gives up messages that are not
+// complete --udp-deadline-ms after their first datagram; the reports add what
+// parity repaired and what was given up.
+// --local also publishes the depth and PV frames to a LocalFrameExchange each, the
+// way the plugin hands them to Unity, and polls them --local-rate times per second
+// (60 by default, like a render loop) from a consumer thread that copies every new
+// frame and checks its layout. It reports the frames it got, the ones newer frames
+// replaced between polls, the ones dropped while it held the buffer, and their age.
+// The receivers read whole messages and check that they name their stream; the
+// receivers of the camera streams also check the calibration message every
+// connection starts with, and any that replaces it, against the frames that
+// follow. Every receiver counts
+// the frames lost on the way from the gaps in the sequence numbers and splits
+// the latency into the stages the message headers time: waiting for the
+// processing stage, encoding, the send queue and the socket up to the receiver.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "CaptureProfileSelector.h"
+#include "DepthCodec.h"
+#include "FrameHeaders.h"
+#include "ImuFrameEncoder.h"
+#include "LocalFrameExchange.h"
+#include "PoseCache.h"
+#include "RateControlLoop.h"
+#include "ResearchModeFrameProcessor.h"
+#include "SyntheticResearchModeSensor.h"
+#include "StreamControlRouter.h"
+#include "SyntheticVideoSource.h"
+#include "TcpFusedFrameStreamer.h"
+#include "TcpImuStreamer.h"
+#include "TcpResearchModeFrameStreamer.h"
+#include "TcpVideoFrameStreamer.h"
+
+namespace
+{
+    // how the receivers read over UDP
+    struct DatagramOptions
+    {
+        double LossRate = 0.0;
+        uint32_t DeadlineMs = 100;
+    };
+
+    // a StreamControl request the first depth receiver sends
+    struct ControlCommand
+    {
+        // after the receiver connected
+        double Seconds = 0.0;
+        StreamId Stream = StreamId::PhotoVideo;
+        StreamControlHeader Request{};
+    };
+
+    struct ControlReply
+    {
+        // after the receiver connected
+        double Seconds = 0.0;
+        uint16_t Stream = 0;
+        StreamControlHeader State{};
+    };
+
+    // what a consumer of a LocalFrameExchange got
+    struct LocalStatistics
+    {
+        unsigned long long frames = 0;
+        unsigned long long bytes = 0;
+        // frames replaced by newer ones between two polls
+        unsigned long long skipped = 0;
+        // frames whose size does not match their format and resolution
+        unsigned long long layoutErrors = 0;
+        double ageSumMs = 0.0;
+        double ageMaxMs = 0.0;
+    };
+
+    struct StreamStatistics
+    {
+        unsigned long long frames = 0;
+        // IMU streams only
+        unsigned long long samples = 0;
+        // fused streams only, distance between the PV and the depth frame of a pair
+        double pairOffsetSumMs = 0.0;
+        double pairOffsetMaxMs = 0.0;
+        // with --pose-rate, distance of the frame poses from the true motion
+        unsigned long long poses = 0;
+        double poseErrorSumMm = 0.0;
+        double poseErrorMaxMm = 0.0;
+        double poseErrorMaxDeg = 0.0;
+        // camera streams only, the calibration message and the frames it did not match
+        unsigned long long calibrationBytes = 0;
+        unsigned long long calibrations = 0;
+        unsigned long long calibrationErrors = 0;
+        unsigned long long bytes = 0;
+        double latencySumMs = 0.0;
+        double latencyMaxMs = 0.0;
+        // gaps between sequence numbers; for fused pairs that includes PV frames
+        // that were not paired
+        unsigned long long lost = 0;
+        // time per stage, from the stage times of the message headers
+        double dequeueSumMs = 0.0;
+        double encodeSumMs = 0.0;
+        double queueSumMs = 0.0;
+        double socketSumMs = 0.0;
+        // stage times missing or out of order
+        unsigned long long traceErrors = 0;
+        unsigned long long decodeErrors = 0;
+        // replies to the control requests of this receiver
+        std::vector<ControlReply> controlReplies;
+        // with --udp
+        ReassemblyStatistics datagrams;
+        unsigned long long injectedLosses = 0;
+    };
+
+    enum class ReadResult
+    {
+        Message,
+        // nothing within the timeout
+        Nothing,
+        // not a message; over TCP the next one cannot be found either
+        Malformed,
+        Closed
+    };
+
+    // Reads the whole messages of a stream from its connection, or from its UDP
+    // transport when pDatagrams is set.
+    class StreamConnection
+    {
+    public:
+        explicit StreamConnection(
+            const DatagramOptions* pDatagrams) :
+            m_pDatagrams(pDatagrams),
+            m_udp(pDatagrams ? pDatagrams->DeadlineMs : 100)
+        {
+            if (pDatagrams)
+            {
+                m_udp.SetLossRate(pDatagrams->LossRate);
+            }
+        }
+
+        bool IsReliable() const { return m_pDatagrams == nullptr; }
+
+        // Connects, or subscribes with the Subscribe message that also keeps the
+        // subscription alive and gets a lost calibration sent again.
+        bool Open(
+            uint16_t port,
+            StreamId streamId,
+            std::atomic<bool>* pExit)
+        {
+            m_streamId = streamId;
+            if (m_pDatagrams)
+            {
+                if (!m_udp.Open("127.0.0.1", port))
+                {
+                    return false;
+                }
+                KeepAlive();
+                return true;
+            }
+            while (!*pExit && !m_tcp.Connect("127.0.0.1", port))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return !*pExit;
+        }
+
+        // one message, e.g. a request
+        void Write(
+            const void* pData,
+            size_t size)
+        {
+            if (m_pDatagrams)
+            {
+                m_udp.Send(pData, size);
+            }
+            else
+            {
+                m_tcp.WriteAll(pData, size);
+            }
+        }
+
+        // timeoutMs < 0 waits for a message however long it takes
+        ReadResult Read(
+            std::vector<uint8_t>& buffer,
+            int timeoutMs)
+        {
+            MessageHeader message;
+            if (m_pDatagrams)
+            {
+                KeepAlive();
+                if (!m_udp.Receive(buffer, timeoutMs < 0 ? 100 : timeoutMs))
+                {
+                    return ReadResult::Nothing;
+                }
+                if (buffer.size() < sizeof(message))
+                {
+                    return ReadResult::Malformed;
+                }
+                memcpy(&message, buffer.data(), sizeof(message));
+                return (message.IsValid() && message.Size() == buffer.size()) ? ReadResult::Message : ReadResult::Malformed;
+            }
+
+            if (timeoutMs >= 0 && !m_tcp.WaitReadable(timeoutMs))
+            {
+                return ReadResult::Nothing;
+            }
+            if (!m_tcp.ReadExactly(&message, sizeof(message)))
+            {
+                return ReadResult::Closed;
+            }
+            if (!message.IsValid())
+            {
+                return ReadResult::Malformed;
+            }
+            buffer.resize(message.Size());
+            memcpy(buffer.data(), &message, sizeof(message));
+            return m_tcp.ReadExactly(buffer.data() + sizeof(message), buffer.size() - sizeof(message)) ?
+                ReadResult::Message : ReadResult::Closed;
+        }
+
+        void ReportDatagrams(
+            StreamStatistics* pStatistics) const
+        {
+            pStatistics->datagrams = m_udp.Statistics();
+            pStatistics->injectedLosses = m_udp.DroppedDatagrams();
+        }
+
+    private:
+        // once a second, well within DatagramSettings::SubscriptionTimeoutMs
+        void KeepAlive()
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (now - m_lastKeepAlive >= std::chrono::seconds(1))
+            {
+                m_udp.Subscribe(m_streamId);
+                m_lastKeepAlive = now;
+            }
+        }
+
+        const DatagramOptions* m_pDatagrams;
+        StreamId m_streamId = StreamId::PhotoVideo;
+        TcpStreamClient m_tcp;
+        UdpStreamClient m_udp;
+        std::chrono::steady_clock::time_point m_lastKeepAlive{};
+    };
+
+    // the stream names of --control, as the reports label the streams
+    const struct
+    {
+        const char* Name;
+        StreamId Stream;
+    } kStreamNames[] = {
+        { "ahat", StreamId::DepthAhat }, { "lt", StreamId::DepthLongThrow },
+        { "lf", StreamId::LeftFront }, { "ll", StreamId::LeftLeft },
+        { "rf", StreamId::RightFront }, { "rr", StreamId::RightRight },
+        { "acc", StreamId::ImuAccel }, { "gyr", StreamId::ImuGyro }, { "mag", StreamId::ImuMag },
+        { "pv", StreamId::PhotoVideo }, { "rgbd", StreamId::Fused }
+    };
+
+    // turns the payload back into pixels where the codec needs it
+    bool DecodePayload(
+        const MessageHeader& message,
+        const ResearchModeFrameHeader& header,
+        const ConstBuffer& payload,
+        std::vector<uint16_t>& depth)
+    {
+        const size_t imageSize = static_cast<size_t>(header.ImageHeight) * header.RowStride;
+        if (header.AbSize != 0 && header.AbSize != imageSize)
+        {
+            return false;
+        }
+        if (header.AbSize > payload.Size)
+        {
+            return false;
+        }
+        const size_t depthSize = payload.Size - header.AbSize;
+        const size_t pixelCount = static_cast<size_t>(header.ImageWidth) * header.ImageHeight;
+        const DepthCodec codec = static_cast<DepthCodec>(message.Codec);
+        if (codec == DepthCodec::PointsMm16 || codec == DepthCodec::PointsHalf)
+        {
+            // whole xyz triplets, at most one per pixel, all in front of the camera
+            const size_t pointCount = depthSize / (3 * sizeof(uint16_t));
+            if (depthSize % (3 * sizeof(uint16_t)) != 0 || pointCount > pixelCount)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < pointCount; ++i)
+            {
+                uint16_t z;
+                memcpy(&z, payload.pData + (3 * i + 2) * sizeof(z), sizeof(z));
+                // the sign bit is the top bit in both encodings
+                if (z == 0 || (z & 0x8000))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (codec != DepthCodec::Rvl)
+        {
+            return depthSize == imageSize;
+        }
+        depth.resize(pixelCount);
+        return RvlDecodeDepth(payload.pData, depthSize, depth.data(), depth.size());
+    }
+
+    bool DecodePayload(
+        const MessageHeader& /* message */,
+        const VideoFrameHeader& /* header */,
+        const ConstBuffer& /* payload */,
+        std::vector<uint16_t>& /* depth */)
+    {
+        return true;
+    }
+
+    // a packet holds SampleCount records of SampleSize bytes in timestamp order
+    bool DecodePayload(
+        const MessageHeader& /* message */,
+        const ImuPacketHeader& header,
+        const ConstBuffer& payload,
+        std::vector<uint16_t>& /* depth */)
+    {
+        if (header.SampleSize != sizeof(ImuSample) ||
+            payload.Size != static_cast<size_t>(header.SampleCount) * header.SampleSize ||
+            header.SampleCount == 0)
+        {
+            return false;
+        }
+        // the headers keep the samples aligned in the message buffer
+        const ImuSample* pSamples = reinterpret_cast<const ImuSample*>(payload.pData);
+        if (pSamples[0].Timestamp != header.Timestamp)
+        {
+            return false;
+        }
+        for (uint32_t i = 1; i < header.SampleCount; ++i)
+        {
+            if (pSamples[i].Timestamp < pSamples[i - 1].Timestamp ||
+                pSamples[i].SensorTicks <= pSamples[i - 1].SensorTicks)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Headers of a message nested in the payload at offset, copied out since it
+    // need not be aligned. Returns false if it is not a whole message of THeader.
+    template <typename THeader>
+    bool ReadNestedMessage(
+        const ConstBuffer& payload,
+        size_t offset,
+        MessageHeader& message,
+        THeader& header)
+    {
+        if (payload.Size < offset + sizeof(message) + sizeof(header))
+        {
+            return false;
+        }
+        memcpy(&message, payload.pData + offset, sizeof(message));
+        memcpy(&header, payload.pData + offset + sizeof(message), sizeof(header));
+        return message.IsValid() &&
+            message.MessageType == static_cast<uint16_t>(THeader::kType) &&
+            message.HeaderSize >= sizeof(message) + sizeof(header) &&
+            payload.Size >= offset + message.Size();
+    }
+
+    // a fused message holds a whole PV and a whole depth message
+    bool DecodePayload(
+        const MessageHeader& /* message */,
+        const FusedFrameHeader& header,
+        const ConstBuffer& payload,
+        std::vector<uint16_t>& /* depth */)
+    {
+        MessageHeader videoMessage;
+        VideoFrameHeader videoHeader;
+        MessageHeader depthMessage;
+        ResearchModeFrameHeader depthHeader;
+        if (!ReadNestedMessage(payload, 0, videoMessage, videoHeader) ||
+            !ReadNestedMessage(payload, videoMessage.Size(), depthMessage, depthHeader))
+        {
+            return false;
+        }
+        return payload.Size == videoMessage.Size() + depthMessage.Size() &&
+            videoMessage.StreamId == static_cast<uint16_t>(StreamId::PhotoVideo) &&
+            videoHeader.Timestamp == header.Timestamp &&
+            static_cast<int64_t>(depthHeader.Timestamp - videoHeader.Timestamp) == header.DepthOffset;
+    }
+
+    uint32_t SampleCountOf(const ImuPacketHeader& header) { return header.SampleCount; }
+    uint32_t SampleCountOf(const ResearchModeFrameHeader& /* header */) { return 0; }
+    uint32_t SampleCountOf(const VideoFrameHeader& /* header */) { return 0; }
+    uint32_t SampleCountOf(const FusedFrameHeader& /* header */) { return 0; }
+
+    template <typename THeader>
+    bool PairOffsetMsOf(const THeader& /* header */, double& /* offsetMs */) { return false; }
+
+    bool PairOffsetMsOf(const FusedFrameHeader& header, double& offsetMs)
+    {
+        offsetMs = std::abs(header.DepthOffset) * 1e-4;
+        return true;
+    }
+
+    bool PoseOf(const ResearchModeFrameHeader& header, Float4x4& pose) { pose = header.Rig2World; return true; }
+    bool PoseOf(const VideoFrameHeader& header, Float4x4& pose) { pose = header.PVtoWorld; return true; }
+
+    template <typename THeader>
+    bool PoseOf(const THeader& /* header */, Float4x4& /* pose */) { return false; }
+
+    // the camera streams start with a calibration message
+    bool SendsCalibration(const ResearchModeFrameHeader& /* header */) { return true; }
+    bool SendsCalibration(const VideoFrameHeader& /* header */) { return true; }
+
+    template <typename THeader>
+    bool SendsCalibration(const THeader& /* header */) { return false; }
+
+    bool MatchesCalibration(const CalibrationHeader& calibration, size_t tableSize, const ResearchModeFrameHeader& header)
+    {
+        return calibration.ImageWidth == header.ImageWidth &&
+            calibration.ImageHeight == header.ImageHeight &&
+            tableSize == static_cast<size_t>(header.ImageWidth) * header.ImageHeight * 2 * sizeof(float);
+    }
+
+    bool MatchesCalibration(const CalibrationHeader& calibration, size_t tableSize, const VideoFrameHeader& header)
+    {
+        return calibration.ImageWidth == header.ImageWidth &&
+            calibration.ImageHeight == header.ImageHeight &&
+            calibration.FocalLength[0] == header.Fx &&
+            calibration.FocalLength[1] == header.Fy &&
+            tableSize == 0;
+    }
+
+    template <typename THeader>
+    bool MatchesCalibration(const CalibrationHeader& /* calibration */, size_t /* tableSize */, const THeader& /* header */) { return true; }
+
+    // brisk head motion: turning at up to 110 degrees per second, nodding and swaying
+    RigidPose SyntheticRigPoseAt(uint64_t timestamp)
+    {
+        const double kTwoPi = 6.283185307179586;
+        const double t = static_cast<double>(timestamp) * 1e-7;
+        const double yaw = 0.6 * std::sin(kTwoPi * 0.5 * t);
+        const double pitch = 0.2 * std::sin(kTwoPi * 0.3 * t);
+
+        // rotation about y followed by rotation about x
+        const double cy = std::cos(0.5 * yaw);
+        const double sy = std::sin(0.5 * yaw);
+        const double cp = std::cos(0.5 * pitch);
+        const double sp = std::sin(0.5 * pitch);
+        RigidPose pose;
+        pose.Orientation[0] = static_cast<float>(cy * sp);
+        pose.Orientation[1] = static_cast<float>(sy * cp);
+        pose.Orientation[2] = static_cast<float>(-sy * sp);
+        pose.Orientation[3] = static_cast<float>(cy * cp);
+        pose.Position[0] = static_cast<float>(0.1 * std::sin(kTwoPi * 0.25 * t));
+        pose.Position[1] = static_cast<float>(1.6 + 0.02 * std::sin(kTwoPi * t));
+        pose.Position[2] = static_cast<float>(0.05 * std::cos(kTwoPi * 0.25 * t));
+        return pose;
+    }
+
+    long long NowTicks()
+    {
+        return std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10'000'000>>>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void SamplePoses(
+        double rate,
+        std::atomic<bool>* pExit,
+        PoseCache* pPoses)
+    {
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / rate));
+        // Device frames arrive tens of milliseconds after their timestamp, past the
+        // next pose sample; the synthetic ones arrive right away. Sampling one period
+        // ahead keeps them between samples as well.
+        const uint64_t lead = static_cast<uint64_t>(1e7 / rate);
+        auto next = std::chrono::steady_clock::now();
+        while (!*pExit)
+        {
+            const uint64_t timestamp = static_cast<uint64_t>(NowTicks()) + lead;
+            pPoses->Add(timestamp, SyntheticRigPoseAt(timestamp));
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    size_t LocalFrameSize(
+        const LocalFrame& frame)
+    {
+        const size_t pixels = static_cast<size_t>(frame.Width) * frame.Height;
+        switch (frame.Format)
+        {
+        case LocalFrameFormat::Bgra8: return 4 * pixels;
+        case LocalFrameFormat::Nv12: return pixels + static_cast<size_t>(frame.Width) * (frame.Height / 2);
+        case LocalFrameFormat::Gray8: return pixels;
+        case LocalFrameFormat::Depth16: return 2 * pixels;
+        case LocalFrameFormat::Depth16Ab16: return 4 * pixels;
+        }
+        return 0;
+    }
+
+    // Polls pFrames rate times per second, like a script once per rendered frame,
+    // and copies every new frame out of it as a texture upload would.
+    void ConsumeLocalFrames(
+        LocalFrameExchange* pFrames,
+        double rate,
+        std::atomic<bool>* pExit,
+        LocalStatistics* pStatistics)
+    {
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / rate));
+        std::vector<uint8_t> texture;
+        bool hasLast = false;
+        uint32_t lastSequence = 0;
+        auto next = std::chrono::steady_clock::now();
+        while (!*pExit)
+        {
+            LocalFrame frame;
+            if (pFrames->Acquire(frame) && (!hasLast || frame.Sequence != lastSequence))
+            {
+                texture.assign(frame.pData, frame.pData + frame.Size);
+                const double ageMs = (NowTicks() - static_cast<long long>(frame.Timestamp)) / 1e4;
+                pFrames->Release();
+
+                if (hasLast && frame.Sequence - lastSequence > 1)
+                {
+                    pStatistics->skipped += frame.Sequence - lastSequence - 1;
+                }
+                hasLast = true;
+                lastSequence = frame.Sequence;
+                if (frame.Size != LocalFrameSize(frame) || frame.RowStride * frame.Height > frame.Size)
+                {
+                    ++pStatistics->layoutErrors;
+                }
+                ++pStatistics->frames;
+                pStatistics->bytes += frame.Size;
+                pStatistics->ageSumMs += ageMs;
+                pStatistics->ageMaxMs = std::max(pStatistics->ageMaxMs, ageMs);
+            }
+            else
+            {
+                pFrames->Release();
+            }
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    // translation error in mm and rotation error in degrees
+    void PoseError(
+        const Float4x4& pose,
+        const Float4x4& truth,
+        double& errorMm,
+        double& errorDeg)
+    {
+        const float* a = &pose.m11;
+        const float* b = &truth.m11;
+        double dot = 0.0;
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 3; ++column)
+            {
+                dot += a[4 * row + column] * b[4 * row + column];
+            }
+        }
+        errorDeg = std::acos(std::max(-1.0, std::min(1.0, (dot - 1.0) / 2.0))) * 57.29577951308232;
+        const double dx = a[12] - b[12];
+        const double dy = a[13] - b[13];
+        const double dz = a[14] - b[14];
+        errorMm = 1000.0 * std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    template <typename THeader>
+    void ReceiveStream(
+        uint16_t port,
+        StreamId streamId,
+        double clientMbps,
+        DepthCodec codec,
+        bool checkPoses,
+        const std::vector<ControlCommand>* pCommands,
+        const DatagramOptions* pDatagrams,
+        std::atomic<bool>* pExit,
+        StreamStatistics* pStatistics)
+    {
+        StreamConnection connection(pDatagrams);
+        if (!connection.Open(port, streamId, pExit))
+        {
+            return;
+        }
+        if (codec != DepthCodec::Raw)
+        {
+            const MessageHeader request = MakeMessageHeader(streamId, MessageType::CodecRequest, static_cast<uint32_t>(codec));
+            connection.Write(&request, sizeof(request));
+        }
+        // Datagrams may be lost: a lost calibration is sent again once the
+        // keep-alive reports it, and frames may come before it.
+        const bool reliable = connection.IsReliable();
+
+        const auto start = std::chrono::steady_clock::now();
+        const bool expectsCalibration = SendsCalibration(THeader{});
+        CalibrationHeader calibration{};
+        size_t tableSize = 0;
+        bool calibrated = false;
+        bool sequenced = false;
+        uint32_t nextSequence = 0;
+        MessageHeader message;
+        // whole messages, read in place
+        std::vector<uint8_t> buffer;
+        std::vector<uint16_t> depth;
+        size_t nextCommand = 0;
+        while (!*pExit)
+        {
+            int timeoutMs = -1;
+            if (pCommands && nextCommand < pCommands->size())
+            {
+                // sent between messages, and while none come, e.g. when the
+                // stream was turned off
+                const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if ((*pCommands)[nextCommand].Seconds <= elapsed)
+                {
+                    const ControlCommand& command = (*pCommands)[nextCommand++];
+                    // one message, so that it is one datagram over UDP
+                    uint8_t request[sizeof(MessageHeader) + sizeof(StreamControlHeader)];
+                    const MessageHeader header = MakeMessageHeader(
+                        command.Stream, MessageType::StreamControl, 0, sizeof(command.Request));
+                    memcpy(request, &header, sizeof(header));
+                    memcpy(request + sizeof(header), &command.Request, sizeof(command.Request));
+                    connection.Write(request, sizeof(request));
+                }
+                timeoutMs = 10;
+            }
+            const ReadResult result = connection.Read(buffer, timeoutMs);
+            if (result == ReadResult::Closed)
+            {
+                break;
+            }
+            if (result == ReadResult::Malformed)
+            {
+                pStatistics->decodeErrors++;
+                if (reliable)
+                {
+                    break;
+                }
+                continue;
+            }
+            if (result == ReadResult::Nothing)
+            {
+                continue;
+            }
+            memcpy(&message, buffer.data(), sizeof(message));
+            if (const StreamControlHeader* pState = MessageBody<StreamControlHeader>(buffer.data()))
+            {
+                // names the stream it is about, which need not be this one
+                ControlReply reply;
+                reply.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                reply.Stream = message.StreamId;
+                reply.State = *pState;
+                pStatistics->controlReplies.push_back(reply);
+                continue;
+            }
+            if (message.StreamId != static_cast<uint16_t>(streamId))
+            {
+                pStatistics->decodeErrors++;
+            }
+            const ConstBuffer payload{ MessagePayload(buffer.data()), message.PayloadSize };
+
+            if (const CalibrationHeader* pCalibration = MessageBody<CalibrationHeader>(buffer.data()))
+            {
+                // ahead of the first frame, and again only when it changes
+                if (!expectsCalibration || (reliable &&
+                    (calibrated ? memcmp(&calibration, pCalibration, sizeof(calibration)) == 0 : pStatistics->frames != 0)))
+                {
+                    pStatistics->calibrationErrors++;
+                }
+                calibration = *pCalibration;
+                tableSize = payload.Size;
+                calibrated = true;
+                pStatistics->calibrationBytes = buffer.size();
+                pStatistics->calibrations++;
+                continue;
+            }
+            const THeader* pHeader = MessageBody<THeader>(buffer.data());
+            if (!pHeader)
+            {
+                // a message type this receiver does not know
+                continue;
+            }
+            const THeader& header = *pHeader;
+            if (expectsCalibration && (calibrated ? !MatchesCalibration(calibration, tableSize, header) : reliable))
+            {
+                pStatistics->calibrationErrors++;
+            }
+            if (!DecodePayload(message, header, payload, depth))
+            {
+                pStatistics->decodeErrors++;
+            }
+            const long long now = NowTicks();
+            const double latencyMs = (now - static_cast<long long>(header.Timestamp)) * 1e-4;
+            const FrameTraceHeader* pTrace = MessageTrace(buffer.data());
+            if (!pTrace)
+            {
+                // every frame message carries one
+                pStatistics->traceErrors++;
+            }
+            else
+            {
+                const FrameTraceHeader& trace = *pTrace;
+                if (sequenced)
+                {
+                    pStatistics->lost += trace.Sequence - nextSequence;
+                }
+                nextSequence = trace.Sequence + 1;
+                sequenced = true;
+                // the device clock is this one, so the socket time can be measured as well
+                if (trace.CaptureTime == 0 || trace.CaptureTime > trace.DequeueTime ||
+                    trace.DequeueTime > trace.EncodeTime || trace.EncodeTime > trace.WriteTime ||
+                    trace.WriteTime > static_cast<uint64_t>(now))
+                {
+                    pStatistics->traceErrors++;
+                }
+                pStatistics->dequeueSumMs += (trace.DequeueTime - trace.CaptureTime) * 1e-4;
+                pStatistics->encodeSumMs += (trace.EncodeTime - trace.DequeueTime) * 1e-4;
+                pStatistics->queueSumMs += (trace.WriteTime - trace.EncodeTime) * 1e-4;
+                pStatistics->socketSumMs += (now - static_cast<long long>(trace.WriteTime)) * 1e-4;
+            }
+            pStatistics->frames++;
+            pStatistics->samples += SampleCountOf(header);
+            double offsetMs = 0.0;
+            if (PairOffsetMsOf(header, offsetMs))
+            {
+                pStatistics->pairOffsetSumMs += offsetMs;
+                pStatistics->pairOffsetMaxMs = std::max(pStatistics->pairOffsetMaxMs, offsetMs);
+            }
+            Float4x4 pose;
+            if (checkPoses && PoseOf(header, pose))
+            {
+                double errorMm = 0.0;
+                double errorDeg = 0.0;
+                PoseError(pose, SyntheticRigPoseAt(header.Timestamp).ToMatrix(), errorMm, errorDeg);
+                pStatistics->poses++;
+                pStatistics->poseErrorSumMm += errorMm;
+                pStatistics->poseErrorMaxMm = std::max(pStatistics->poseErrorMaxMm, errorMm);
+                pStatistics->poseErrorMaxDeg = std::max(pStatistics->poseErrorMaxDeg, errorDeg);
+            }
+            pStatistics->bytes += buffer.size();
+            pStatistics->latencySumMs += latencyMs;
+            pStatistics->latencyMaxMs = std::max(pStatistics->latencyMaxMs, latencyMs);
+
+            if (clientMbps > 0.0)
+            {
+                // hold back until the bytes read so far fit the simulated link rate
+                std::this_thread::sleep_until(start + std::chrono::duration<double>(
+                    pStatistics->bytes * 8.0 / (clientMbps * 1e6)));
+            }
+        }
+        connection.ReportDatagrams(pStatistics);
+    }
+
+    // in steady state the pools allocate once per buffer, so allocations should
+    // not exceed the number of buffers
+    void ReportBuffers(
+        const char* name,
+        const FrameBufferPoolStatistics& statistics)
+    {
+        printf("%s buffers: %u created, %llu allocations for %llu frames, %llu exhausted\n",
+            name,
+            statistics.Buffers,
+            (unsigned long long)statistics.Allocations,
+            (unsigned long long)statistics.Acquired,
+            (unsigned long long)statistics.Exhausted);
+    }
+
+    void ReportLocal(
+        const char* name,
+        const LocalStatistics& statistics,
+        const LocalFrameStatistics& exchange,
+        double seconds)
+    {
+        printf("%s local: %llu frames %.2f fps %.2f MB/s, %llu skipped, %llu dropped of %llu published, age mean %.3f ms max %.3f ms",
+            name,
+            statistics.frames,
+            statistics.frames / seconds,
+            statistics.bytes / seconds / 1e6,
+            statistics.skipped,
+            (unsigned long long)exchange.Dropped,
+            (unsigned long long)exchange.Published,
+            statistics.frames ? statistics.ageSumMs / statistics.frames : 0.0,
+            statistics.ageMaxMs);
+        if (statistics.layoutErrors)
+        {
+            printf("  %llu layout errors", statistics.layoutErrors);
+        }
+        printf("\n");
+    }
+
+    void ReportQueue(
+        const char* name,
+        size_t subscriber,
+        const SendQueueStatistics& statistics)
+    {
+        printf("%s#%zu send queue: %llu queued, %llu sent (%.2f MB), %llu dropped\n",
+            name,
+            subscriber,
+            (unsigned long long)statistics.Queued,
+            (unsigned long long)statistics.Sent,
+            statistics.SentBytes / 1e6,
+            (unsigned long long)statistics.Dropped);
+    }
+
+    void ReportRateControl(
+        const char* name,
+        const RateControlStatistics& statistics)
+    {
+        printf("%s rate control: %llu steps down, %llu up, at %.1f ms 1/%u format %u, %.2f MB/s, capacity %.2f MB/s\n",
+            name,
+            (unsigned long long)statistics.StepsDown,
+            (unsigned long long)statistics.StepsUp,
+            statistics.Level.MinDelta * 1e-4,
+            statistics.Level.Decimation,
+            static_cast<uint32_t>(statistics.Level.PixelFormat),
+            statistics.Throughput / 1e6,
+            statistics.Capacity / 1e6);
+    }
+
+    bool ParseQueuePolicy(
+        const std::string& name,
+        SendQueuePolicy& policy)
+    {
+        if (name == "drop-oldest") policy = SendQueuePolicy::DropOldest;
+        else if (name == "drop-newest") policy = SendQueuePolicy::DropNewest;
+        else if (name == "max-age") policy = SendQueuePolicy::MaxAge;
+        else return false;
+        return true;
+    }
+
+    bool ParseDepthCodec(
+        const std::string& name,
+        DepthCodec& codec)
+    {
+        if (name == "raw") codec = DepthCodec::Raw;
+        else if (name == "rvl") codec = DepthCodec::Rvl;
+        else if (name == "points-mm") codec = DepthCodec::PointsMm16;
+        else if (name == "points-half") codec = DepthCodec::PointsHalf;
+        else return false;
+        return true;
+    }
+
+    bool ParsePixelFormat(
+        const std::string& name,
+        VideoPixelFormat& format)
+    {
+        if (name == "bgr") format = VideoPixelFormat::Bgr8;
+        else if (name == "nv12") format = VideoPixelFormat::Nv12;
+        else if (name == "luma") format = VideoPixelFormat::Luma8;
+        else return false;
+        return true;
+    }
+
+    // WxH[@F], see the usage above
+    bool ParseProfileRequest(
+        const std::string& spec,
+        CaptureProfileRequest& request)
+    {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        double frameRate = 0.0;
+        const int fields = sscanf(spec.c_str(), "%ux%u@%lf", &width, &height, &frameRate);
+        if (fields < 2 || frameRate < 0.0)
+        {
+            return false;
+        }
+        request.Width = width;
+        request.Height = height;
+        request.FrameRate = frameRate;
+        return true;
+    }
+
+    // T:STREAM:SETTING[,SETTING...], see the usage above
+    bool ParseControl(
+        const std::string& spec,
+        ControlCommand& command)
+    {
+        const size_t streamStart = spec.find(':');
+        const size_t settingsStart = (streamStart == std::string::npos) ? streamStart : spec.find(':', streamStart + 1);
+        if (settingsStart == std::string::npos)
+        {
+            return false;
+        }
+        command.Seconds = atof(spec.substr(0, streamStart).c_str());
+        const std::string stream = spec.substr(streamStart + 1, settingsStart - streamStart - 1);
+        bool found = false;
+        for (const auto& name : kStreamNames)
+        {
+            if (stream == name.Name)
+            {
+                command.Stream = name.Stream;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+
+        StreamControlHeader& request = command.Request;
+        size_t start = settingsStart + 1;
+        while (start <= spec.size())
+        {
+            const size_t end = std::min(spec.find(',', start), spec.size());
+            const std::string setting = spec.substr(start, end - start);
+            const size_t equals = setting.find('=');
+            const std::string key = setting.substr(0, equals);
+            const std::string value = (equals == std::string::npos) ? std::string() : setting.substr(equals + 1);
+            if (key == "on" || key == "off")
+            {
+                request.Fields |= StreamControlBit(StreamControlField::Enabled);
+                request.Enabled = (key == "on") ? 1 : 0;
+            }
+            else if (key == "interval-ms" && !value.empty())
+            {
+                request.Fields |= StreamControlBit(StreamControlField::Interval);
+                request.IntervalUs = static_cast<uint32_t>(atof(value.c_str()) * 1000.0);
+            }
+            else if (key == "decimation" && !value.empty())
+            {
+                request.Fields |= StreamControlBit(StreamControlField::Decimation);
+                request.Decimation = static_cast<uint32_t>(atoi(value.c_str()));
+            }
+            else if (key == "format")
+            {
+                VideoPixelFormat format;
+                if (!ParsePixelFormat(value, format))
+                {
+                    return false;
+                }
+                request.Fields |= StreamControlBit(StreamControlField::PixelFormat);
+                request.PixelFormat = static_cast<uint32_t>(format);
+            }
+            else if (key != "state")
+            {
+                return false;
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    void ReportControl(
+        const ControlReply& reply)
+    {
+        const char* name = "unknown stream";
+        for (const auto& streamName : kStreamNames)
+        {
+            if (reply.Stream == static_cast<uint16_t>(streamName.Stream))
+            {
+                name = streamName.Name;
+            }
+        }
+        const StreamControlHeader& state = reply.State;
+        printf("Control reply after %.2f s: %s", reply.Seconds, name);
+        if (state.Fields == 0)
+        {
+            printf(" cannot be controlled");
+        }
+        if (state.Fields & StreamControlBit(StreamControlField::Enabled))
+        {
+            printf(" %s", state.Enabled ? "on" : "off");
+        }
+        if (state.Fields & StreamControlBit(StreamControlField::Interval))
+        {
+            printf(" at %.1f ms", state.IntervalUs / 1000.0);
+        }
+        if (state.Fields & StreamControlBit(StreamControlField::Decimation))
+        {
+            printf(" 1/%u", state.Decimation);
+        }
+        if (state.Fields & StreamControlBit(StreamControlField::PixelFormat))
+        {
+            printf(" format %u", state.PixelFormat);
+        }
+        printf("\n");
+    }
+
+    // threads of this process, including the receivers
+    int ThreadCount()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 8, "Threads:") == 0)
+            {
+                return atoi(line.c_str() + 8);
+            }
+        }
+        return 0;
+    }
+
+    void Report(
+        const char* name,
+        size_t subscriber,
+        const StreamStatistics& statistics,
+        double seconds)
+    {
+        char label[32];
+        snprintf(label, sizeof(label), "%s#%zu", name, subscriber);
+        printf("%-7s %8llu frames %8.2f fps %9.2f MB/s  latency mean %7.3f ms max %7.3f ms",
+            label,
+            statistics.frames,
+            statistics.frames / seconds,
+            statistics.bytes / seconds / 1e6,
+            statistics.frames ? statistics.latencySumMs / statistics.frames : 0.0,
+            statistics.latencyMaxMs);
+        if (statistics.frames)
+        {
+            printf("  lost %llu  wait %.3f encode %.3f queue %.3f socket %.3f ms",
+                statistics.lost,
+                statistics.dequeueSumMs / statistics.frames,
+                statistics.encodeSumMs / statistics.frames,
+                statistics.queueSumMs / statistics.frames,
+                statistics.socketSumMs / statistics.frames);
+        }
+        if (statistics.pairOffsetMaxMs > 0.0)
+        {
+            printf("  pair offset mean %.3f ms max %.3f ms",
+                statistics.pairOffsetSumMs / statistics.frames,
+                statistics.pairOffsetMaxMs);
+        }
+        if (statistics.poses)
+        {
+            printf("  pose error mean %.2f mm max %.2f mm %.2f deg",
+                statistics.poseErrorSumMm / statistics.poses,
+                statistics.poseErrorMaxMm,
+                statistics.poseErrorMaxDeg);
+        }
+        if (statistics.samples)
+        {
+            printf("  %8.1f samples/s", statistics.samples / seconds);
+        }
+        if (statistics.calibrationBytes)
+        {
+            printf("  calibration %llu bytes", statistics.calibrationBytes);
+        }
+        if (statistics.calibrations > 1)
+        {
+            printf(" x%llu", statistics.calibrations);
+        }
+        if (statistics.calibrationErrors)
+        {
+            printf("  %llu calibration errors", statistics.calibrationErrors);
+        }
+        if (statistics.traceErrors)
+        {
+            printf("  %llu trace errors", statistics.traceErrors);
+        }
+        if (statistics.decodeErrors)
+        {
+            printf("  %llu decode errors", statistics.decodeErrors);
+        }
+        if (statistics.datagrams.Datagrams)
+        {
+            printf("  %llu datagrams, %llu dropped, %llu repaired, %llu given up",
+                (unsigned long long)statistics.datagrams.Datagrams,
+                statistics.injectedLosses,
+                (unsigned long long)statistics.datagrams.Repaired,
+                (unsigned long long)statistics.datagrams.Expired);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = 5.0;
+    double ahatFps = 45.0;
+    double longThrowFps = 5.0;
+    bool longThrow = false;
+    bool includeAb = false;
+    size_t vlcCameras = 0;
+    double vlcFps = 30.0;
+    unsigned int workers = SensorScheduler::kAutoWorkerCount;
+    bool sharedWorkers = true;
+    bool imu = false;
+    bool fuse = false;
+    FrameSyncSettings syncSettings;
+    double poseRate = 0.0;
+    double pvFps = 30.0;
+    int pvWidth = 640;
+    int pvHeight = 360;
+    int pvDecimation = 1;
+    VideoPixelFormat pvFormat = VideoPixelFormat::Bgr8;
+    bool hasPvProfile = false;
+    CaptureProfileRequest pvProfileRequest;
+    DepthCodec depthCodec = DepthCodec::Raw;
+    SendQueueSettings queueSettings;
+    double clientMbps = 0.0;
+    size_t subscribers = 1;
+    uint16_t ahatPort = 23941;
+    uint16_t longThrowPort = 23942;
+    uint16_t vlcPort = 23943;
+    uint16_t imuPort = 23947;
+    uint16_t fusePort = 23950;
+    uint16_t pvPort = 23940;
+    bool serveOnly = false;
+    bool local = false;
+    double localRate = 60.0;
+    bool adaptive = false;
+    uint32_t adaptivePeriodMs = RateControlSettings().PeriodMs;
+    uint32_t maxIntervalMs = RateControlSettings().MaxIntervalMs;
+    int pvMaxDecimation = 4;
+    bool hasPvCheapestFormat = false;
+    VideoPixelFormat pvCheapestFormat = VideoPixelFormat::Bgr8;
+    std::vector<ControlCommand> controlCommands;
+    bool udp = false;
+    DatagramOptions datagramOptions;
+    DatagramSettings datagramSettings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--seconds" && hasValue) seconds = atof(argv[++i]);
+        else if (arg == "--ahat-fps" && hasValue) ahatFps = atof(argv[++i]);
+        else if (arg == "--lt-fps" && hasValue) longThrowFps = atof(argv[++i]);
+        else if (arg == "--long-throw") longThrow = true;
+        else if (arg == "--ab") includeAb = true;
+        else if (arg == "--vlc" && hasValue) vlcCameras = std::min<size_t>(4, static_cast<size_t>(atoi(argv[++i])));
+        else if (arg == "--vlc-fps" && hasValue) vlcFps = atof(argv[++i]);
+        else if (arg == "--workers" && hasValue) { workers = static_cast<unsigned int>(atoi(argv[++i])); sharedWorkers = workers > 0; }
+        else if (arg == "--imu") imu = true;
+        else if (arg == "--fuse") fuse = true;
+        else if (arg == "--fuse-tolerance-ms" && hasValue) syncSettings.ToleranceMs = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--pose-rate" && hasValue) poseRate = atof(argv[++i]);
+        else if (arg == "--pv-fps" && hasValue) pvFps = atof(argv[++i]);
+        else if (arg == "--pv-width" && hasValue) pvWidth = atoi(argv[++i]);
+        else if (arg == "--pv-height" && hasValue) pvHeight = atoi(argv[++i]);
+        else if (arg == "--pv-decimation" && hasValue) pvDecimation = atoi(argv[++i]);
+        else if (arg == "--pv-profile" && hasValue)
+        {
+            if (!ParseProfileRequest(argv[++i], pvProfileRequest))
+            {
+                fprintf(stderr, "invalid profile %s\n", argv[i]);
+                return 1;
+            }
+            hasPvProfile = true;
+        }
+        else if (arg == "--pv-format" && hasValue)
+        {
+            if (!ParsePixelFormat(argv[++i], pvFormat))
+            {
+                fprintf(stderr, "unknown pixel format %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "--queue-depth" && hasValue) queueSettings.Depth = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--queue-policy" && hasValue)
+        {
+            if (!ParseQueuePolicy(argv[++i], queueSettings.Policy))
+            {
+                fprintf(stderr, "unknown queue policy %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "--max-age-ms" && hasValue) queueSettings.MaxAgeMs = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--client-mbps" && hasValue) clientMbps = atof(argv[++i]);
+        else if (arg == "--subscribers" && hasValue) subscribers = static_cast<size_t>(atoi(argv[++i]));
+        else if (arg == "--depth-codec" && hasValue)
+        {
+            if (!ParseDepthCodec(argv[++i], depthCodec))
+            {
+                fprintf(stderr, "unknown depth codec %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (arg == "--ahat-port" && hasValue) ahatPort = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--lt-port" && hasValue) longThrowPort = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--vlc-port" && hasValue) vlcPort = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--imu-port" && hasValue) imuPort = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--fuse-port" && hasValue) fusePort = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--pv-port" && hasValue) pvPort = static_cast<uint16_t>(atoi(argv[++i]));
+        else if (arg == "--adaptive") adaptive = true;
+        else if (arg == "--adaptive-period-ms" && hasValue) adaptivePeriodMs = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--max-interval-ms" && hasValue) maxIntervalMs = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--pv-max-decimation" && hasValue) pvMaxDecimation = atoi(argv[++i]);
+        else if (arg == "--pv-cheapest-format" && hasValue)
+        {
+            if (!ParsePixelFormat(argv[++i], pvCheapestFormat))
+            {
+                fprintf(stderr, "unknown pixel format %s\n", argv[i]);
+                return 1;
+            }
+            hasPvCheapestFormat = true;
+        }
+        else if (arg == "--control" && hasValue)
+        {
+            ControlCommand command;
+            if (!ParseControl(argv[++i], command))
+            {
+                fprintf(stderr, "invalid control %s\n", argv[i]);
+                return 1;
+            }
+            controlCommands.push_back(command);
+        }
+        else if (arg == "--udp") udp = true;
+        else if (arg == "--udp-loss" && hasValue) datagramOptions.LossRate = atof(argv[++i]);
+        else if (arg == "--udp-parity" && hasValue) datagramSettings.ParityGroupSize = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--udp-datagram" && hasValue) datagramSettings.DatagramSize = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--udp-deadline-ms" && hasValue) datagramOptions.DeadlineMs = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (arg == "--serve-only") serveOnly = true;
+        else if (arg == "--local") local = true;
+        else if (arg == "--local-rate" && hasValue) localRate = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    // sent in time order
+    std::stable_sort(controlCommands.begin(), controlCommands.end(),
+        [](const ControlCommand& a, const ControlCommand& b) { return a.Seconds < b.Seconds; });
+
+    SensorConsent camConsent;
+    camConsent.Set(ResearchModeSensorConsent::Allowed);
+    SensorConsent imuConsent;
+    imuConsent.Set(ResearchModeSensorConsent::Allowed);
+
+    std::shared_ptr<SensorScheduler> scheduler;
+    if (sharedWorkers)
+    {
+        scheduler = std::make_shared<SensorScheduler>(workers);
+    }
+
+    const ResearchModeSensorType depthSensorType = longThrow ? DEPTH_LONG_THROW : DEPTH_AHAT;
+    const char* depthName = longThrow ? "LT" : "AHAT";
+    SyntheticSensorSettings depthSettings;
+    depthSettings.SensorType = depthSensorType;
+    depthSettings.FrameRate = longThrow ? longThrowFps : ahatFps;
+    IResearchModeSensor* pDepthSensor = nullptr;
+    if (FAILED(SyntheticResearchModeSensor::Create(depthSettings, &pDepthSensor)))
+    {
+        return 1;
+    }
+
+    auto depthStreamer = std::make_shared<TcpResearchModeFrameStreamer>(
+        longThrow ? longThrowPort : ahatPort, queueSettings, depthSensorType, includeAb);
+    depthStreamer->SetCameraSensor(pDepthSensor);
+    auto depthProcessor = std::make_shared<ResearchModeFrameProcessor>(
+        pDepthSensor, &camConsent, 0, depthStreamer, scheduler);
+
+    const ResearchModeSensorType vlcSensorTypes[] = { LEFT_FRONT, LEFT_LEFT, RIGHT_FRONT, RIGHT_RIGHT };
+    const char* vlcNames[] = { "LF", "LL", "RF", "RR" };
+    std::vector<IResearchModeSensor*> vlcSensors(vlcCameras, nullptr);
+    std::vector<std::shared_ptr<TcpResearchModeFrameStreamer>> vlcStreamers;
+    std::vector<std::shared_ptr<ResearchModeFrameProcessor>> vlcProcessors;
+    for (size_t i = 0; i < vlcCameras; ++i)
+    {
+        SyntheticSensorSettings vlcSettings;
+        vlcSettings.SensorType = vlcSensorTypes[i];
+        vlcSettings.FrameRate = vlcFps;
+        if (FAILED(SyntheticResearchModeSensor::Create(vlcSettings, &vlcSensors[i])))
+        {
+            return 1;
+        }
+        vlcStreamers.push_back(std::make_shared<TcpResearchModeFrameStreamer>(
+            static_cast<uint16_t>(vlcPort + i), queueSettings, vlcSensorTypes[i]));
+        vlcStreamers[i]->SetCameraSensor(vlcSensors[i]);
+        vlcProcessors.push_back(std::make_shared<ResearchModeFrameProcessor>(
+            vlcSensors[i], &camConsent, 0, vlcStreamers[i], scheduler));
+    }
+
+    // batch rates of the device; the batch sizes are the synthetic sensor's defaults
+    const ResearchModeSensorType imuSensorTypes[] = { IMU_ACCEL, IMU_GYRO, IMU_MAG };
+    const double imuFps[] = { 12.0, 24.0, 50.0 };
+    const char* imuNames[] = { "ACC", "GYR", "MAG" };
+    const size_t imuSensorCount = imu ? 3 : 0;
+    std::vector<IResearchModeSensor*> imuSensors(imuSensorCount, nullptr);
+    std::vector<std::shared_ptr<TcpImuStreamer>> imuStreamers;
+    std::vector<std::shared_ptr<ResearchModeFrameProcessor>> imuProcessors;
+    for (size_t i = 0; i < imuSensorCount; ++i)
+    {
+        SyntheticSensorSettings imuSettings;
+        imuSettings.SensorType = imuSensorTypes[i];
+        imuSettings.FrameRate = imuFps[i];
+        if (FAILED(SyntheticResearchModeSensor::Create(imuSettings, &imuSensors[i])))
+        {
+            return 1;
+        }
+        imuStreamers.push_back(std::make_shared<TcpImuStreamer>(
+            static_cast<uint16_t>(imuPort + i), imuSensorTypes[i], queueSettings));
+        imuProcessors.push_back(std::make_shared<ResearchModeFrameProcessor>(
+            imuSensors[i], &imuConsent, 0, imuStreamers[i], scheduler));
+    }
+
+    if (hasPvProfile)
+    {
+        pvProfileRequest.PixelFormat = pvFormat;
+        const CaptureProfile& profile =
+            HoloLens2PvProfiles()[SelectCaptureProfile(pvProfileRequest, HoloLens2PvProfiles())];
+        printf("PV profile: asked for %ux%u at %.1f fps, capturing %ux%u at %.1f fps\n",
+            pvProfileRequest.Width, pvProfileRequest.Height, pvProfileRequest.FrameRate,
+            profile.Width, profile.Height, profile.FrameRate);
+        pvWidth = static_cast<int>(profile.Width);
+        pvHeight = static_cast<int>(profile.Height);
+        pvFps = profile.FrameRate;
+    }
+
+    SyntheticVideoSettings pvSettings;
+    pvSettings.Width = pvWidth;
+    pvSettings.Height = pvHeight;
+    pvSettings.FrameRate = pvFps;
+    pvSettings.PixelFormat = VideoFrameEncoder::CaptureFormatFor(pvFormat);
+    auto pvStreamer = std::make_shared<TcpVideoFrameStreamer>(pvPort, pvDecimation, pvFormat, queueSettings);
+    auto pvSource = std::make_unique<SyntheticVideoSource>(pvSettings, pvStreamer);
+
+    std::shared_ptr<TcpFusedFrameStreamer> fusedStreamer;
+    std::shared_ptr<FrameSynchronizer> synchronizer;
+    if (fuse)
+    {
+        syncSettings.Codec = depthCodec;
+        fusedStreamer = std::make_shared<TcpFusedFrameStreamer>(fusePort, queueSettings);
+        synchronizer = std::make_shared<FrameSynchronizer>(fusedStreamer, syncSettings);
+        pvStreamer->SetSynchronizer(synchronizer);
+        depthStreamer->SetSynchronizer(synchronizer);
+    }
+
+    // one pose cache for all rig-mounted cameras, as on the device
+    std::shared_ptr<PoseCache> poses;
+    if (poseRate > 0.0)
+    {
+        poses = std::make_shared<PoseCache>();
+        depthStreamer->SetPoseCache(poses);
+        for (auto& vlcStreamer : vlcStreamers)
+        {
+            vlcStreamer->SetPoseCache(poses);
+        }
+        pvStreamer->SetPoseCache(poses);
+    }
+
+    // in-process consumers, next to the ones on the sockets
+    std::shared_ptr<LocalFrameExchange> localDepthFrames;
+    std::shared_ptr<LocalFrameExchange> localPvFrames;
+    if (local)
+    {
+        localDepthFrames = std::make_shared<LocalFrameExchange>();
+        localPvFrames = std::make_shared<LocalFrameExchange>();
+        depthStreamer->SetLocalFrames(localDepthFrames);
+        pvStreamer->SetLocalFrames(localPvFrames);
+    }
+
+    auto wideName = [](const char* name) { return std::wstring(name, name + strlen(name)); };
+
+    // the controllers only hold raw pointers; they are stopped before the streams go
+    RateControlLoop rateControl;
+    std::vector<std::string> rateControlNames;
+    // index of each stream in rateControl
+    const size_t kNoRateControl = SIZE_MAX;
+    size_t depthRateStream = kNoRateControl;
+    std::vector<size_t> vlcRateStreams(vlcCameras, kNoRateControl);
+    size_t pvRateStream = kNoRateControl;
+    if (adaptive)
+    {
+        // the synthetic source delivers one capture format, which not every wire
+        // format can be made of
+        if (!hasPvCheapestFormat)
+        {
+            pvCheapestFormat = (pvFormat == VideoPixelFormat::Bgr8) ? VideoPixelFormat::Bgr8 : VideoPixelFormat::Luma8;
+        }
+        if (VideoFrameEncoder::CaptureFormatFor(pvCheapestFormat) != VideoFrameEncoder::CaptureFormatFor(pvFormat))
+        {
+            fprintf(stderr, "--pv-cheapest-format needs another capture format than --pv-format\n");
+            return 1;
+        }
+
+        auto intervalSettings = [&](double fps)
+        {
+            RateControlSettings settings;
+            settings.PeriodMs = adaptivePeriodMs;
+            // at most the sensor interval, so that the best level sends every frame
+            settings.MinIntervalMs = static_cast<uint32_t>(1000.0 / fps);
+            settings.SensorIntervalMs = settings.MinIntervalMs;
+            settings.MaxIntervalMs = std::max(settings.MinIntervalMs, maxIntervalMs);
+            return settings;
+        };
+
+        ResearchModeFrameProcessor* pDepthProcessor = depthProcessor.get();
+        TcpResearchModeFrameStreamer* pDepthStreamer = depthStreamer.get();
+        depthRateStream = rateControl.AddStream({ wideName(depthName), intervalSettings(depthSettings.FrameRate),
+            [pDepthStreamer]() { return pDepthStreamer->GetQueueStatistics(); },
+            [pDepthProcessor](const RateLevel& level) { pDepthProcessor->SetMinDelta(level.MinDelta); } });
+        rateControlNames.push_back(depthName);
+
+        for (size_t i = 0; i < vlcCameras; ++i)
+        {
+            ResearchModeFrameProcessor* pVlcProcessor = vlcProcessors[i].get();
+            TcpResearchModeFrameStreamer* pVlcStreamer = vlcStreamers[i].get();
+            vlcRateStreams[i] = rateControl.AddStream({ wideName(vlcNames[i]), intervalSettings(vlcFps),
+                [pVlcStreamer]() { return pVlcStreamer->GetQueueStatistics(); },
+                [pVlcProcessor](const RateLevel& level) { pVlcProcessor->SetMinDelta(level.MinDelta); } });
+            rateControlNames.push_back(vlcNames[i]);
+        }
+
+        RateControlSettings pvRateSettings = intervalSettings(pvFps);
+        pvRateSettings.MinDecimation = static_cast<uint32_t>(std::max(1, pvDecimation));
+        pvRateSettings.MaxDecimation = std::max(pvRateSettings.MinDecimation, static_cast<uint32_t>(std::max(1, pvMaxDecimation)));
+        pvRateSettings.PixelFormat = pvFormat;
+        pvRateSettings.CheapestPixelFormat = pvCheapestFormat;
+        SyntheticVideoSource* pPvSource = pvSource.get();
+        TcpVideoFrameStreamer* pPvStreamer = pvStreamer.get();
+        pvRateStream = rateControl.AddStream({ L"PV", pvRateSettings,
+            [pPvStreamer]() { return pPvStreamer->GetQueueStatistics(); },
+            [pPvSource, pPvStreamer](const RateLevel& level)
+            {
+                pPvSource->SetMinDelta(level.MinDelta);
+                pPvStreamer->SetEncoding(static_cast<int>(level.Decimation), level.PixelFormat);
+            } });
+        rateControlNames.push_back("PV");
+    }
+
+    // Every stream answers control requests for all of them. Like the rate
+    // controllers the router only holds raw pointers and is cleared before the
+    // streams go. Streams under rate control have their best level changed.
+    auto streamControl = std::make_shared<StreamControlRouter>();
+    auto registerResearchModeStream = [&](StreamId streamId, const char* name,
+        ResearchModeFrameProcessor* pProcessor, size_t rateStream)
+    {
+        StreamControlTarget target;
+        target.Name = wideName(name);
+        target.SetEnabled = [pProcessor](bool enabled) { pProcessor->SetEnabled(enabled); };
+        target.IsEnabled = [pProcessor]() { return pProcessor->IsEnabled(); };
+        target.LevelFields = StreamControlBit(StreamControlField::Interval);
+        if (rateStream != kNoRateControl)
+        {
+            RateControlLoop* pRateControl = &rateControl;
+            target.SetLevel = [pRateControl, rateStream](const RateLevel& level) { pRateControl->SetBestLevel(rateStream, level); };
+            target.GetLevel = [pRateControl, rateStream]() { return pRateControl->GetBestLevel(rateStream); };
+        }
+        else
+        {
+            target.SetLevel = [pProcessor](const RateLevel& level) { pProcessor->SetMinDelta(level.MinDelta); };
+            target.GetLevel = [pProcessor]()
+            {
+                RateLevel level;
+                level.MinDelta = pProcessor->MinDelta();
+                return level;
+            };
+        }
+        streamControl->Register(streamId, std::move(target));
+    };
+    registerResearchModeStream(static_cast<StreamId>(depthSensorType), depthName, depthProcessor.get(), depthRateStream);
+    depthStreamer->SetStreamControl(streamControl);
+    for (size_t i = 0; i < vlcCameras; ++i)
+    {
+        registerResearchModeStream(static_cast<StreamId>(vlcSensorTypes[i]), vlcNames[i], vlcProcessors[i].get(), vlcRateStreams[i]);
+        vlcStreamers[i]->SetStreamControl(streamControl);
+    }
+    for (size_t i = 0; i < imuSensorCount; ++i)
+    {
+        registerResearchModeStream(static_cast<StreamId>(imuSensorTypes[i]), imuNames[i], imuProcessors[i].get(), kNoRateControl);
+        imuStreamers[i]->SetStreamControl(streamControl);
+    }
+    {
+        SyntheticVideoSource* pPvSource = pvSource.get();
+        TcpVideoFrameStreamer* pPvStreamer = pvStreamer.get();
+        StreamControlTarget target;
+        target.Name = L"PV";
+        target.SetEnabled = [pPvSource](bool enabled) { pPvSource->SetEnabled(enabled); };
+        target.IsEnabled = [pPvSource]() { return pPvSource->IsEnabled(); };
+        target.LevelFields = StreamControlBit(StreamControlField::Interval) |
+            StreamControlBit(StreamControlField::Decimation) | StreamControlBit(StreamControlField::PixelFormat);
+        target.MaxDecimation = 8;
+        // the synthetic source delivers one capture format, which not every wire
+        // format can be made of
+        for (VideoPixelFormat format : { VideoPixelFormat::Bgr8, VideoPixelFormat::Nv12, VideoPixelFormat::Luma8 })
+        {
+            if (VideoFrameEncoder::CaptureFormatFor(format) == VideoFrameEncoder::CaptureFormatFor(pvFormat))
+            {
+                target.PixelFormats |= 1u << static_cast<uint32_t>(format);
+            }
+        }
+        if (pvRateStream != kNoRateControl)
+        {
+            RateControlLoop* pRateControl = &rateControl;
+            target.SetLevel = [pRateControl, pvRateStream](const RateLevel& level) { pRateControl->SetBestLevel(pvRateStream, level); };
+            target.GetLevel = [pRateControl, pvRateStream]() { return pRateControl->GetBestLevel(pvRateStream); };
+        }
+        else
+        {
+            target.SetLevel = [pPvSource, pPvStreamer](const RateLevel& level)
+            {
+                pPvSource->SetMinDelta(level.MinDelta);
+                pPvStreamer->SetEncoding(static_cast<int>(level.Decimation), level.PixelFormat);
+            };
+            target.GetLevel = [pPvSource, pPvStreamer]()
+            {
+                RateLevel level;
+                level.MinDelta = pPvSource->MinDelta();
+                level.Decimation = static_cast<uint32_t>(pPvStreamer->ScaleFactor());
+                level.PixelFormat = pPvStreamer->PixelFormat();
+                return level;
+            };
+        }
+        streamControl->Register(StreamId::PhotoVideo, std::move(target));
+        pvStreamer->SetStreamControl(streamControl);
+    }
+    if (fusedStreamer)
+    {
+        // the pairs follow their PV and depth streams; requests for them get an
+        // empty state
+        fusedStreamer->SetStreamControl(streamControl);
+    }
+
+    // every stream takes UDP subscribers as well, so that --serve-only serves
+    // both transports
+    depthStreamer->EnableDatagrams(datagramSettings);
+    for (auto& vlcStreamer : vlcStreamers)
+    {
+        vlcStreamer->EnableDatagrams(datagramSettings);
+    }
+    for (auto& imuStreamer : imuStreamers)
+    {
+        imuStreamer->EnableDatagrams(datagramSettings);
+    }
+    pvStreamer->EnableDatagrams(datagramSettings);
+    if (fusedStreamer)
+    {
+        fusedStreamer->EnableDatagrams(datagramSettings);
+    }
+
+    std::atomic<bool> fExit{ false };
+    const bool checkPoses = poses != nullptr;
+    const DatagramOptions* pDatagrams = udp ? &datagramOptions : nullptr;
+    std::vector<StreamStatistics> depthStatistics(subscribers);
+    std::vector<StreamStatistics> pvStatistics(subscribers);
+    std::vector<StreamStatistics> fusedStatistics(fuse ? subscribers : 0);
+    std::vector<std::vector<StreamStatistics>> vlcStatistics(vlcCameras, std::vector<StreamStatistics>(subscribers));
+    std::vector<std::vector<StreamStatistics>> imuStatistics(imuSensorCount, std::vector<StreamStatistics>(subscribers));
+    std::vector<std::thread> receivers;
+    if (!serveOnly)
+    {
+        for (size_t i = 0; i < subscribers; ++i)
+        {
+            // only the first receiver of each stream is throttled
+            const double mbps = (i == 0) ? clientMbps : 0.0;
+            // the first depth receiver sends the control requests
+            const std::vector<ControlCommand>* pCommands = (i == 0 && !controlCommands.empty()) ? &controlCommands : nullptr;
+            receivers.emplace_back(ReceiveStream<ResearchModeFrameHeader>, depthStreamer->Port(), static_cast<StreamId>(depthSensorType), mbps, depthCodec, checkPoses, pCommands, pDatagrams, &fExit, &depthStatistics[i]);
+            receivers.emplace_back(ReceiveStream<VideoFrameHeader>, pvStreamer->Port(), StreamId::PhotoVideo, mbps, DepthCodec::Raw, checkPoses, nullptr, pDatagrams, &fExit, &pvStatistics[i]);
+            if (fusedStreamer)
+            {
+                receivers.emplace_back(ReceiveStream<FusedFrameHeader>, fusedStreamer->Port(), StreamId::Fused, mbps, DepthCodec::Raw, false, nullptr, pDatagrams, &fExit, &fusedStatistics[i]);
+            }
+            for (size_t v = 0; v < vlcCameras; ++v)
+            {
+                receivers.emplace_back(ReceiveStream<ResearchModeFrameHeader>, vlcStreamers[v]->Port(), static_cast<StreamId>(vlcSensorTypes[v]), mbps, DepthCodec::Raw, checkPoses, nullptr, pDatagrams, &fExit, &vlcStatistics[v][i]);
+            }
+            for (size_t m = 0; m < imuSensorCount; ++m)
+            {
+                receivers.emplace_back(ReceiveStream<ImuPacketHeader>, imuStreamers[m]->Port(), static_cast<StreamId>(imuSensorTypes[m]), mbps, DepthCodec::Raw, false, nullptr, pDatagrams, &fExit, &imuStatistics[m][i]);
+            }
+        }
+        auto allConnected = [&]()
+        {
+            for (const auto& vlcStreamer : vlcStreamers)
+            {
+                if (vlcStreamer->GetSubscriberStatistics().size() < subscribers)
+                {
+                    return false;
+                }
+            }
+            for (const auto& imuStreamer : imuStreamers)
+            {
+                if (imuStreamer->GetSubscriberStatistics().size() < subscribers)
+                {
+                    return false;
+                }
+            }
+            if (fusedStreamer && fusedStreamer->GetSubscriberStatistics().size() < subscribers)
+            {
+                return false;
+            }
+            return depthStreamer->GetSubscriberStatistics().size() >= subscribers &&
+                pvStreamer->GetSubscriberStatistics().size() >= subscribers;
+        };
+        while (!allConnected())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    LocalStatistics localDepthStatistics;
+    LocalStatistics localPvStatistics;
+    std::vector<std::thread> localConsumers;
+    if (local)
+    {
+        localConsumers.emplace_back(ConsumeLocalFrames, localDepthFrames.get(), localRate, &fExit, &localDepthStatistics);
+        localConsumers.emplace_back(ConsumeLocalFrames, localPvFrames.get(), localRate, &fExit, &localPvStatistics);
+    }
+
+    std::atomic<bool> fStopSampling{ false };
+    std::thread poseSampler;
+    if (poses)
+    {
+        // a few samples ahead of the first frames
+        poseSampler = std::thread(SamplePoses, poseRate, &fStopSampling, poses.get());
+        std::this_thread::sleep_for(std::chrono::duration<double>(2.0 / poseRate));
+    }
+
+    depthProcessor->Start();
+    for (auto& vlcProcessor : vlcProcessors)
+    {
+        vlcProcessor->Start();
+    }
+    for (auto& imuProcessor : imuProcessors)
+    {
+        imuProcessor->Start();
+    }
+    pvSource->Start();
+    if (adaptive)
+    {
+        rateControl.Start();
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    const int threads = ThreadCount();
+
+    rateControl.Stop();
+    streamControl->Clear();
+
+    depthProcessor->Stop();
+    for (auto& vlcProcessor : vlcProcessors)
+    {
+        vlcProcessor->Stop();
+    }
+    for (auto& imuProcessor : imuProcessors)
+    {
+        imuProcessor->Stop();
+    }
+    pvSource->Stop();
+    fStopSampling = true;
+    if (poseSampler.joinable())
+    {
+        poseSampler.join();
+    }
+    const MailboxStatistics depthFrames = depthProcessor->GetFrameStatistics();
+    const FrameBufferPoolStatistics depthBuffers = depthStreamer->GetBufferStatistics();
+    const FrameBufferPoolStatistics pvBuffers = pvStreamer->GetBufferStatistics();
+    const FrameBufferPoolStatistics depthWireBuffers = depthStreamer->GetWireBufferStatistics();
+    const FrameBufferPoolStatistics pvWireBuffers = pvStreamer->GetWireBufferStatistics();
+    const std::vector<SendQueueStatistics> depthQueues = depthStreamer->GetSubscriberStatistics();
+    const std::vector<SendQueueStatistics> pvQueues = pvStreamer->GetSubscriberStatistics();
+    const PoseCacheStatistics poseStatistics = poses ? poses->Statistics() : PoseCacheStatistics();
+    const FrameSyncStatistics syncStatistics = synchronizer ? synchronizer->Statistics() : FrameSyncStatistics();
+    const std::vector<SendQueueStatistics> fusedQueues = fusedStreamer ?
+        fusedStreamer->GetSubscriberStatistics() : std::vector<SendQueueStatistics>();
+    std::vector<std::vector<SendQueueStatistics>> vlcQueues;
+    for (const auto& vlcStreamer : vlcStreamers)
+    {
+        vlcQueues.push_back(vlcStreamer->GetSubscriberStatistics());
+    }
+    std::vector<std::vector<SendQueueStatistics>> imuQueues;
+    for (const auto& imuStreamer : imuStreamers)
+    {
+        imuQueues.push_back(imuStreamer->GetSubscriberStatistics());
+    }
+    fExit = true;
+    for (auto& consumer : localConsumers)
+    {
+        consumer.join();
+    }
+    // the streamers close their connections once the last producer lets go of them
+    depthProcessor.reset();
+    vlcProcessors.clear();
+    imuProcessors.clear();
+    pvSource.reset();
+    depthStreamer.reset();
+    vlcStreamers.clear();
+    imuStreamers.clear();
+    pvStreamer.reset();
+    synchronizer.reset();
+    fusedStreamer.reset();
+    pDepthSensor->Release();
+    for (auto pVlcSensor : vlcSensors)
+    {
+        pVlcSensor->Release();
+    }
+    for (auto pImuSensor : imuSensors)
+    {
+        pImuSensor->Release();
+    }
+
+    if (!serveOnly)
+    {
+        for (auto& receiver : receivers)
+        {
+            receiver.join();
+        }
+        for (size_t i = 0; i < subscribers; ++i)
+        {
+            Report(depthName, i, depthStatistics[i], seconds);
+            Report("PV", i, pvStatistics[i], seconds);
+            if (fuse)
+            {
+                Report("RGBD", i, fusedStatistics[i], seconds);
+            }
+            for (size_t v = 0; v < vlcCameras; ++v)
+            {
+                Report(vlcNames[v], i, vlcStatistics[v][i], seconds);
+            }
+            for (size_t m = 0; m < imuSensorCount; ++m)
+            {
+                Report(imuNames[m], i, imuStatistics[m][i], seconds);
+            }
+        }
+    }
+    printf("%s mailbox: %llu published, %llu consumed, %llu overwritten\n",
+        depthName,
+        (unsigned long long)depthFrames.Published,
+        (unsigned long long)depthFrames.Consumed,
+        (unsigned long long)depthFrames.Overwritten);
+    if (local)
+    {
+        ReportLocal(depthName, localDepthStatistics, localDepthFrames->Statistics(), seconds);
+        ReportLocal("PV", localPvStatistics, localPvFrames->Statistics(), seconds);
+    }
+    ReportBuffers(depthName, depthBuffers);
+    ReportBuffers("PV", pvBuffers);
+    ReportBuffers((std::string(depthName) + " wire").c_str(), depthWireBuffers);
+    ReportBuffers("PV wire", pvWireBuffers);
+    for (size_t i = 0; i < depthQueues.size(); ++i)
+    {
+        ReportQueue(depthName, i, depthQueues[i]);
+    }
+    for (size_t i = 0; i < pvQueues.size(); ++i)
+    {
+        ReportQueue("PV", i, pvQueues[i]);
+    }
+    for (size_t v = 0; v < vlcQueues.size(); ++v)
+    {
+        for (size_t i = 0; i < vlcQueues[v].size(); ++i)
+        {
+            ReportQueue(vlcNames[v], i, vlcQueues[v][i]);
+        }
+    }
+    for (size_t i = 0; i < fusedQueues.size(); ++i)
+    {
+        ReportQueue("RGBD", i, fusedQueues[i]);
+    }
+    if (fuse)
+    {
+        printf("RGBD pairs: %llu fused, %llu PV and %llu depth frames unmatched\n",
+            (unsigned long long)syncStatistics.Fused,
+            (unsigned long long)syncStatistics.UnmatchedVideo,
+            (unsigned long long)syncStatistics.UnmatchedDepth);
+    }
+    if (poses)
+    {
+        printf("Poses: %llu samples, %llu lookups interpolated, %llu held, %llu missed\n",
+            (unsigned long long)poseStatistics.Samples,
+            (unsigned long long)poseStatistics.Interpolated,
+            (unsigned long long)poseStatistics.Held,
+            (unsigned long long)poseStatistics.Missed);
+    }
+    for (size_t m = 0; m < imuQueues.size(); ++m)
+    {
+        for (size_t i = 0; i < imuQueues[m].size(); ++i)
+        {
+            ReportQueue(imuNames[m], i, imuQueues[m][i]);
+        }
+    }
+    if (!depthStatistics.empty())
+    {
+        for (const ControlReply& reply : depthStatistics[0].controlReplies)
+        {
+            ReportControl(reply);
+        }
+    }
+    const std::vector<RateControlStatistics> rateStatistics = rateControl.Statistics();
+    for (size_t i = 0; i < rateStatistics.size(); ++i)
+    {
+        ReportRateControl(rateControlNames[i].c_str(), rateStatistics[i]);
+    }
+    printf("%d threads with %u sensor workers, %zu of them receivers\n",
+        threads, scheduler ? scheduler->WorkerCount() : 0u, serveOnly ? size_t(0) : receivers.size());
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    const double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+    printf("CPU time %.3f s (%.1f%% of one core)\n", cpuSeconds, 100.0 * cpuSeconds / seconds);
+    return 0;
+}
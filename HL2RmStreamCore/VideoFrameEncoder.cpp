@@ -0,0 +1,147 @@
+#include "VideoFrameEncoder.h"
+#include "FrameMessage.h"
+#include "ImageKernels.h"
+
+#include <cstring>
+
+bool VideoFrameEncoder::Encode(
+    const VideoFrameView& frame,
+    VideoFrameHeader& header,
+    std::vector<uint8_t>& payload)
+{
+    if (!frame.pData || scaleFactor < 1 || frame.Width <= 0 || frame.Height <= 0 ||
+        frame.PixelFormat != CaptureFormatFor(pixelFormat))
+    {
+        return false;
+    }
+
+    int imageWidth = DecimatedSize(frame.Width, scaleFactor);
+    int imageHeight = DecimatedSize(frame.Height, scaleFactor);
+    int pixelStride = 0;
+
+    switch (pixelFormat)
+    {
+    case VideoPixelFormat::Bgr8:
+        if (!EncodeBgr(frame, payload))
+        {
+            return false;
+        }
+        pixelStride = 3;
+        break;
+    case VideoPixelFormat::Nv12:
+    case VideoPixelFormat::Luma8:
+        if (!EncodeNv12(frame, pixelFormat == VideoPixelFormat::Nv12, payload))
+        {
+            return false;
+        }
+        pixelStride = 1;
+        break;
+    default:
+        return false;
+    }
+
+    header.Timestamp = frame.Timestamp;
+    header.ImageWidth = imageWidth;
+    header.ImageHeight = imageHeight;
+    header.PixelStride = pixelStride;
+    header.RowStride = imageWidth * pixelStride; // adapted row stride
+    header.Fx = frame.Fx / scaleFactor;
+    header.Fy = frame.Fy / scaleFactor;
+    header.PVtoWorld = frame.PVtoWorld;
+
+    return true;
+}
+
+FrameBufferPtr VideoFrameEncoder::Calibration(
+    const VideoFrameView& frame)
+{
+    if (scaleFactor < 1)
+    {
+        return nullptr;
+    }
+
+    // decimation keeps every scaleFactor-th pixel starting at 0, which scales
+    // focal length and principal point; distortion is on the unit plane
+    CalibrationHeader header{};
+    header.ImageWidth = DecimatedSize(frame.Width, scaleFactor);
+    header.ImageHeight = DecimatedSize(frame.Height, scaleFactor);
+    header.Extrinsics = frame.PVtoRig;
+    header.FocalLength[0] = frame.Fx / scaleFactor;
+    header.FocalLength[1] = frame.Fy / scaleFactor;
+    header.PrincipalPoint[0] = frame.Cx / scaleFactor;
+    header.PrincipalPoint[1] = frame.Cy / scaleFactor;
+    memcpy(header.RadialDistortion, frame.RadialDistortion, sizeof(header.RadialDistortion));
+    memcpy(header.TangentialDistortion, frame.TangentialDistortion, sizeof(header.TangentialDistortion));
+
+    // the header has no padding, so comparing bytes compares the values
+    if (!m_calibration ||
+        memcmp(m_calibration->data() + sizeof(MessageHeader), &header, sizeof(header)) != 0)
+    {
+        FrameMessage message;
+        message.SetHeader(StreamId::PhotoVideo, 0, header);
+        m_calibration = std::make_shared<std::vector<uint8_t>>();
+        message.FlattenInto(*m_calibration);
+    }
+    return m_calibration;
+}
+
+VideoPixelFormat VideoFrameEncoder::CaptureFormatFor(
+    VideoPixelFormat wireFormat)
+{
+    return (wireFormat == VideoPixelFormat::Bgr8) ? VideoPixelFormat::Bgra8 : VideoPixelFormat::Nv12;
+}
+
+bool VideoFrameEncoder::EncodeBgr(
+    const VideoFrameView& frame,
+    std::vector<uint8_t>& payload)
+{
+    const int pixelStride = 4;
+    if (frame.RowStride < frame.Width * pixelStride ||
+        frame.DataLength < static_cast<size_t>(frame.RowStride) * (frame.Height - 1) + frame.Width * pixelStride)
+    {
+        return false;
+    }
+
+    payload.resize(static_cast<size_t>(DecimatedSize(frame.Width, scaleFactor)) *
+        DecimatedSize(frame.Height, scaleFactor) * (pixelStride - 1));
+    PackBgraToBgr(frame.pData, frame.Width, frame.Height, frame.RowStride, scaleFactor, payload.data());
+    return true;
+}
+
+bool VideoFrameEncoder::EncodeNv12(
+    const VideoFrameView& frame,
+    bool includeChroma,
+    std::vector<uint8_t>& payload)
+{
+    if (frame.RowStride < frame.Width ||
+        frame.DataLength < static_cast<size_t>(frame.RowStride) * (frame.Height - 1) + frame.Width)
+    {
+        return false;
+    }
+
+    // one UV pair per 2x2 block of Y
+    const int chromaWidth = (frame.Width + 1) / 2;
+    const int chromaHeight = (frame.Height + 1) / 2;
+    if (includeChroma && (!frame.pChroma || frame.ChromaRowStride < 2 * chromaWidth ||
+        frame.ChromaDataLength < static_cast<size_t>(frame.ChromaRowStride) * (chromaHeight - 1) + 2 * chromaWidth))
+    {
+        return false;
+    }
+
+    const int imageWidth = DecimatedSize(frame.Width, scaleFactor);
+    const int imageHeight = DecimatedSize(frame.Height, scaleFactor);
+    const size_t lumaSize = static_cast<size_t>(imageWidth) * imageHeight;
+    // output pixel (2j, 2i) comes from input pixel (2j * s, 2i * s), whose UV
+    // pair is (j * s, i * s): the chroma plane decimates by the same factor
+    const size_t chromaSize = includeChroma ?
+        2 * static_cast<size_t>((imageWidth + 1) / 2) * ((imageHeight + 1) / 2) : 0;
+
+    payload.resize(lumaSize + chromaSize);
+    CopyPlane(frame.pData, frame.Width, frame.Height, frame.RowStride, 1, scaleFactor, payload.data());
+    if (includeChroma)
+    {
+        CopyPlane(frame.pChroma, chromaWidth, chromaHeight, frame.ChromaRowStride, 2, scaleFactor,
+            payload.data() + lumaSize);
+    }
+    return true;
+}
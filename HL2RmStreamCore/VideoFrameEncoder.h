@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include "FrameBufferPool.h"
+#include "VideoFrameView.h"
+
+// Turns video camera frames into their wire representation: packed BGR from
+// BGRA frames, or the native NV12 planes (all of them or just Y) of NV12 frames.
+class VideoFrameEncoder
+{
+public:
+	// Fills in the header and writes the pixels of the frame to payload in
+	// pixelFormat, the codec of the message. payload is resized, not cleared, so
+	// a buffer reused across frames is only reallocated when the resolution
+	// grows. Fails if the frame is not in the capture format pixelFormat needs
+	// (see CaptureFormatFor).
+	bool Encode(
+		const VideoFrameView& frame,
+		VideoFrameHeader& header,
+		std::vector<uint8_t>& payload);
+
+	// The serialized calibration message (a CalibrationHeader without payload) for
+	// frames like frame, scaled like Encode scales the image. It is only rebuilt
+	// when the calibration changes, so a new pointer means a new calibration.
+	FrameBufferPtr Calibration(
+		const VideoFrameView& frame);
+
+	// format the frames have to be captured in to be sent as wireFormat
+	static VideoPixelFormat CaptureFormatFor(
+		VideoPixelFormat wireFormat);
+
+	// keep every scaleFactor-th pixel and row; the header describes the
+	// decimated image and intrinsics
+	int scaleFactor = 1;
+
+	// format put on the wire
+	VideoPixelFormat pixelFormat = VideoPixelFormat::Bgr8;
+
+private:
+	bool EncodeBgr(
+		const VideoFrameView& frame,
+		std::vector<uint8_t>& payload);
+
+	bool EncodeNv12(
+		const VideoFrameView& frame,
+		bool includeChroma,
+		std::vector<uint8_t>& payload);
+
+	FrameBufferPtr m_calibration;
+};
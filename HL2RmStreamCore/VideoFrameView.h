@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FrameHeaders.h"
+#include "FrameTrace.h"
+
+// Platform-neutral view of a locked video camera frame. The pixel data is
+// only borrowed for the duration of the call it is passed to.
+struct VideoFrameView
+{
+	// Bgra8 or Nv12
+	VideoPixelFormat PixelFormat = VideoPixelFormat::Bgra8;
+	// pixels, or the Y plane for Nv12
+	const uint8_t* pData = nullptr;
+	uint32_t DataLength = 0;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	// bytes between the starts of two consecutive rows
+	int32_t RowStride = 0;
+	// interleaved UV plane of Nv12 frames
+	const uint8_t* pChroma = nullptr;
+	uint32_t ChromaDataLength = 0;
+	int32_t ChromaRowStride = 0;
+	long long Timestamp = 0;
+	float Fx = 0.0f;
+	float Fy = 0.0f;
+	// the rest of the CameraIntrinsics, for the calibration message
+	float Cx = 0.0f;
+	float Cy = 0.0f;
+	float RadialDistortion[3] = { 0.0f, 0.0f, 0.0f };
+	float TangentialDistortion[2] = { 0.0f, 0.0f };
+	Float4x4 PVtoWorld = Float4x4::Identity();
+	Float4x4 PVtoRig = Float4x4::Identity();
+	FrameTrace Trace;
+};
+
+class IVideoFrameViewSink
+{
+public:
+	virtual ~IVideoFrameViewSink() {};
+	virtual void Send(const VideoFrameView& frame) = 0;
+};
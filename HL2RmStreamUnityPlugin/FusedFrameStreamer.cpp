@@ -0,0 +1,97 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+
+using namespace winrt::Windows::Networking::Sockets;
+using namespace winrt::Windows::Storage::Streams;
+
+FusedFrameStreamer::FusedFrameStreamer(
+    std::wstring portName,
+    const SendQueueSettings& queueSettings) :
+    m_sender(queueSettings),
+    // fused messages are shared by the queues of all subscribers
+    m_wireBuffers(SendQueueBufferCount(queueSettings, StreamSocketSender::kMaxSubscribers))
+{
+    m_portName = portName;
+    StartServer();
+}
+
+winrt::Windows::Foundation::IAsyncAction FusedFrameStreamer::StartServer()
+{
+    try
+    {
+        m_streamSocketListener.ConnectionReceived({ this, &FusedFrameStreamer::OnConnectionReceived });
+        co_await m_streamSocketListener.BindServiceNameAsync(m_portName);
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"FusedFrameStreamer::StartServer: Server is listening at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"FusedFrameStreamer::StartServer: Failed to open listener with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void FusedFrameStreamer::OnConnectionReceived(
+    StreamSocketListener /* sender */,
+    StreamSocketListenerConnectionReceivedEventArgs args)
+{
+    try
+    {
+        if (!m_sender.AddSubscriber(args.Socket()))
+        {
+            return;
+        }
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"FusedFrameStreamer::OnConnectionReceived: Received connection at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"FusedFrameStreamer::OnConnectionReceived: Failed to establish connection with error ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void FusedFrameStreamer::Send(
+    const FusedFrameHeader& header,
+    const FrameTrace& trace,
+    const FrameBufferPtr& video,
+    const FrameBufferPtr& depth)
+{
+    // both frames go out as they were serialized for their own streams
+    m_message.SetHeader(StreamId::Fused, 0, header);
+    m_message.SetTrace(trace);
+    m_message.AddPayload(video->data(), video->size());
+    m_message.AddPayload(depth->data(), depth->size());
+    FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+    m_message.Clear();
+    if (!wire || !m_sender.Send(std::move(wire)))
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"FusedFrameStreamer::Send: Fused frame dropped.\n");
+#endif
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+// Streams the RGB-D pairs of a FrameSynchronizer: a FusedFrameHeader followed by
+// the PV and the depth frame as they are sent on their own streams.
+class FusedFrameStreamer : public IFusedFrameSink
+{
+public:
+	FusedFrameStreamer(
+		std::wstring portName,
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	bool IsConnected() override { return m_sender.IsConnected(); }
+
+	void Send(
+		const FusedFrameHeader& header,
+		const FrameTrace& trace,
+		const FrameBufferPtr& video,
+		const FrameBufferPtr& depth) override;
+
+public:
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	// Answers the StreamControl requests of the subscribers through router. Call
+	// before the first client connects.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_sender.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers on the UDP port of the same number, see
+	// DatagramSettings. Call before the first client subscribes.
+	void EnableDatagrams(const DatagramSettings& settings) { m_sender.EnableDatagrams(m_portName, settings); }
+
+	SendQueueStatistics GetQueueStatistics() const { return m_sender.GetQueueStatistics(); }
+
+private:
+	winrt::Windows::Foundation::IAsyncAction StartServer();
+
+	void OnConnectionReceived(
+		winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
+		winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
+
+	winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
+	StreamSocketSender m_sender;
+	FrameMessage m_message;
+
+	std::wstring m_portName;
+
+	// fused messages, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+};
@@ -9,10 +9,8 @@ HMODULE LoadLibraryA(
 	LPCSTR lpLibFileName
 );
 
-static ResearchModeSensorConsent camAccessCheck;
-static HANDLE camConsentGiven;
-static ResearchModeSensorConsent imuAccessCheck;
-static HANDLE imuConsentGiven;
+static SensorConsent camConsent;
+static SensorConsent imuConsent;
 
 using namespace winrt::Windows::Perception::Spatial;
 
@@ -30,6 +28,9 @@ void __stdcall HL2Stream::Initialize()
 	InitializeResearchModeProcessing();
 	auto processOp{ InitializeVideoFrameProcessorAsync() };
 	processOp.get();
+	InitializeFrameSynchronizer();
+	InitializeRateControl();
+	InitializeStreamControl();
 
 #if DBG_ENABLE_INFO_LOGGING
 	OutputDebugStringW(L"HL2Stream::StartStreaming: Done.\n");
@@ -50,29 +51,280 @@ void HL2Stream::StreamingToggle()
 	}
 }
 
+void HL2Stream::SetVideoPixelFormat(int pixelFormat)
+{
+	switch (static_cast<VideoPixelFormat>(pixelFormat))
+	{
+	case VideoPixelFormat::Bgr8:
+	case VideoPixelFormat::Nv12:
+	case VideoPixelFormat::Luma8:
+		m_videoPixelFormat = static_cast<VideoPixelFormat>(pixelFormat);
+		break;
+	default:
+		OutputDebugStringW(L"HL2Stream::SetVideoPixelFormat: Unsupported pixel format.\n");
+		break;
+	}
+}
+
+void HL2Stream::SetVideoCaptureProfile(int width, int height, int frameRate, int profileKind)
+{
+	using winrt::Windows::Media::Capture::KnownVideoProfile;
+	if (width < 0 || height < 0 || frameRate < 0 ||
+		profileKind < static_cast<int>(KnownVideoProfile::VideoRecording) ||
+		profileKind > static_cast<int>(KnownVideoProfile::HdrWithWcgPhoto))
+	{
+		OutputDebugStringW(L"HL2Stream::SetVideoCaptureProfile: Invalid profile.\n");
+		return;
+	}
+	m_videoProfileRequest.Width = static_cast<uint32_t>(width);
+	m_videoProfileRequest.Height = static_cast<uint32_t>(height);
+	m_videoProfileRequest.FrameRate = frameRate;
+	m_videoProfileKind = static_cast<KnownVideoProfile>(profileKind);
+}
+
+int HL2Stream::GetVideoCaptureProfile(int* width, int* height, float* frameRate)
+{
+	if (!m_pVideoFrameProcessor || !width || !height || !frameRate)
+	{
+		return 0;
+	}
+	const CaptureProfile profile = m_pVideoFrameProcessor->SelectedProfile();
+	*width = static_cast<int>(profile.Width);
+	*height = static_cast<int>(profile.Height);
+	*frameRate = static_cast<float>(profile.FrameRate);
+	return 1;
+}
+
+void HL2Stream::SetSendQueue(int depth, int policy, int maxAgeMs)
+{
+	if (depth < 1 || maxAgeMs < 0)
+	{
+		OutputDebugStringW(L"HL2Stream::SetSendQueue: Invalid queue settings.\n");
+		return;
+	}
+	switch (static_cast<SendQueuePolicy>(policy))
+	{
+	case SendQueuePolicy::DropOldest:
+	case SendQueuePolicy::DropNewest:
+	case SendQueuePolicy::MaxAge:
+		m_sendQueueSettings.Depth = static_cast<uint32_t>(depth);
+		m_sendQueueSettings.Policy = static_cast<SendQueuePolicy>(policy);
+		m_sendQueueSettings.MaxAgeMs = static_cast<uint32_t>(maxAgeMs);
+		break;
+	default:
+		OutputDebugStringW(L"HL2Stream::SetSendQueue: Unsupported queue policy.\n");
+		break;
+	}
+}
+
+void HL2Stream::SetDepthSensor(int sensorType, int includeAb)
+{
+	switch (static_cast<ResearchModeSensorType>(sensorType))
+	{
+	case DEPTH_AHAT:
+	case DEPTH_LONG_THROW:
+		m_depthSensorType = static_cast<ResearchModeSensorType>(sensorType);
+		m_includeAb = includeAb != 0;
+		break;
+	default:
+		OutputDebugStringW(L"HL2Stream::SetDepthSensor: Unsupported depth sensor.\n");
+		break;
+	}
+}
+
+void HL2Stream::SetVisibleLightCameras(int cameraMask)
+{
+	m_vlcCameraMask = cameraMask & 0xF;
+}
+
+void HL2Stream::SetSensorWorkers(int workerCount)
+{
+	// 0 keeps one worker per enabled sensor plus one
+	if (workerCount < 0)
+	{
+		OutputDebugStringW(L"HL2Stream::SetSensorWorkers: Invalid worker count.\n");
+		return;
+	}
+	m_sensorWorkerCount = static_cast<unsigned int>(workerCount);
+}
+
+void HL2Stream::SetImuSensors(int sensorMask)
+{
+	m_imuSensorMask = sensorMask & 0x7;
+}
+
+void HL2Stream::SetFrameSync(int enabled, int toleranceMs, int codec)
+{
+	if (toleranceMs < 0 || codec < 0 || codec > static_cast<int>(DepthCodec::PointsHalf))
+	{
+		OutputDebugStringW(L"HL2Stream::SetFrameSync: Invalid settings.\n");
+		return;
+	}
+	m_frameSyncEnabled = enabled != 0;
+	m_frameSyncSettings.ToleranceMs = static_cast<uint32_t>(toleranceMs);
+	m_frameSyncSettings.Codec = static_cast<DepthCodec>(codec);
+}
+
+void HL2Stream::SetRateControl(int enabled, int periodMs, int maxIntervalMs,
+	int maxDecimation, int cheapestPixelFormat)
+{
+	if (periodMs < 1 || maxIntervalMs < 0 || maxDecimation < 1)
+	{
+		OutputDebugStringW(L"HL2Stream::SetRateControl: Invalid settings.\n");
+		return;
+	}
+	switch (static_cast<VideoPixelFormat>(cheapestPixelFormat))
+	{
+	case VideoPixelFormat::Bgr8:
+	case VideoPixelFormat::Nv12:
+	case VideoPixelFormat::Luma8:
+		m_rateControlEnabled = enabled != 0;
+		m_rateControlSettings.PeriodMs = static_cast<uint32_t>(periodMs);
+		m_rateControlSettings.MaxIntervalMs = static_cast<uint32_t>(maxIntervalMs);
+		m_rateControlSettings.MaxDecimation = static_cast<uint32_t>(maxDecimation);
+		m_rateControlSettings.CheapestPixelFormat = static_cast<VideoPixelFormat>(cheapestPixelFormat);
+		break;
+	default:
+		OutputDebugStringW(L"HL2Stream::SetRateControl: Unsupported pixel format.\n");
+		break;
+	}
+}
+
+void HL2Stream::SetDatagramTransport(int enabled, int datagramSize, int parityGroupSize)
+{
+	// one datagram holds at least a DatagramHeader and a MessageHeader, and fits
+	// the largest UDP payload
+	if (datagramSize < 128 || datagramSize > 65507 || parityGroupSize < 0 || parityGroupSize > 0xffff)
+	{
+		OutputDebugStringW(L"HL2Stream::SetDatagramTransport: Invalid settings.\n");
+		return;
+	}
+	m_datagramsEnabled = enabled != 0;
+	m_datagramSettings.DatagramSize = static_cast<uint32_t>(datagramSize);
+	m_datagramSettings.ParityGroupSize = static_cast<uint32_t>(parityGroupSize);
+}
+
+void HL2Stream::SetLocalFrameAccess(int streamMask)
+{
+	auto exchangeIf = [streamMask](int bit)
+	{
+		return (streamMask & bit) ? std::make_shared<LocalFrameExchange>() : nullptr;
+	};
+	m_pLocalVideoFrames = exchangeIf(0x1);
+	m_pLocalDepthFrames = exchangeIf(0x2);
+	for (int camera = LEFT_FRONT; camera <= RIGHT_RIGHT; ++camera)
+	{
+		m_localVlcFrames[camera] = exchangeIf(0x4 << camera);
+	}
+}
+
+std::shared_ptr<LocalFrameExchange> HL2Stream::LocalFramesOf(int streamId)
+{
+	if (streamId == static_cast<int>(StreamId::PhotoVideo))
+	{
+		return m_pLocalVideoFrames;
+	}
+	if (streamId == static_cast<int>(m_depthSensorType))
+	{
+		return m_pLocalDepthFrames;
+	}
+	if (streamId >= LEFT_FRONT && streamId <= RIGHT_RIGHT)
+	{
+		return m_localVlcFrames[streamId];
+	}
+	return nullptr;
+}
+
+int HL2Stream::AcquireLocalFrame(int streamId, LocalFrame* frame)
+{
+	std::shared_ptr<LocalFrameExchange> frames = LocalFramesOf(streamId);
+	if (!frames || !frame)
+	{
+		return 0;
+	}
+	return frames->Acquire(*frame) ? 1 : 0;
+}
+
+void HL2Stream::ReleaseLocalFrame(int streamId)
+{
+	std::shared_ptr<LocalFrameExchange> frames = LocalFramesOf(streamId);
+	if (frames)
+	{
+		frames->Release();
+	}
+}
+
 void HL2Stream::StartStreaming()
 {
 #if DBG_ENABLE_INFO_LOGGING
 	OutputDebugStringW(L"HL2Stream::StartStreaming: Starting streaming!\n");
 #endif
-	// start the AHAT processor
-	m_pAHATProcessor->Start();
+	// rig poses for all streams
+	if (m_pPoseSampler)
+	{
+		m_pPoseSampler->Start();
+	}
+
+	// start the depth processor
+	if (m_pAHATProcessor)
+	{
+		m_pAHATProcessor->Start();
+	}
+	if (m_pLongThrowProcessor)
+	{
+		m_pLongThrowProcessor->Start();
+	}
+
+	// start the visible light cameras and the IMU
+	for (auto& processor : { m_pLFProcessor, m_pLLProcessor, m_pRFProcessor, m_pRRProcessor,
+		m_pAccelProcessor, m_pGyroProcessor, m_pMagProcessor })
+	{
+		if (processor)
+		{
+			processor->Start();
+		}
+	}
 
 	// start the Video video processor
 	m_pVideoFrameProcessor->StartAsync();
+
+	if (m_pRateControl)
+	{
+		m_pRateControl->Start();
+	}
 	isStreaming = true;
 }
 
 void HL2Stream::StopStreaming()
 {
+	if (m_pRateControl && m_pRateControl->isRunning)
+	{
+		m_pRateControl->Stop();
+	}
 	if (m_pAHATProcessor && m_pAHATProcessor->isRunning)
 	{
 		m_pAHATProcessor->Stop();
 	}
+	if (m_pLongThrowProcessor && m_pLongThrowProcessor->isRunning)
+	{
+		m_pLongThrowProcessor->Stop();
+	}
+	for (auto& processor : { m_pLFProcessor, m_pLLProcessor, m_pRFProcessor, m_pRRProcessor,
+		m_pAccelProcessor, m_pGyroProcessor, m_pMagProcessor })
+	{
+		if (processor && processor->isRunning)
+		{
+			processor->Stop();
+		}
+	}
 	if (m_pVideoFrameStreamer && m_pVideoFrameProcessor->isRunning)
 	{
 		m_pVideoFrameProcessor->Stop();
 	}
+	if (m_pPoseSampler && m_pPoseSampler->isRunning)
+	{
+		m_pPoseSampler->Stop();
+	}
 	isStreaming = false;
 }
 
@@ -87,13 +339,26 @@ winrt::Windows::Foundation::IAsyncAction HL2Stream::InitializeVideoFrameProcesso
 
 	// the frame processor
 	m_pVideoFrameProcessor = std::make_unique<VideoCameraFrameProcessor>();
-	m_pVideoFrameStreamer = std::make_shared<VideoCameraStreamer>(m_worldOrigin, L"23940");
+	m_pVideoFrameStreamer = std::make_shared<VideoCameraStreamer>(
+		m_worldOrigin, L"23940", 1, m_videoPixelFormat, m_sendQueueSettings, m_pPoseSampler);
 	if (!m_pVideoFrameStreamer.get())
 	{
 		throw winrt::hresult(E_POINTER);
 	}
-	// initialize the frame processor with a streamer sink
-	co_await m_pVideoFrameProcessor->InitializeAsync(m_pVideoFrameStreamer);
+	m_pVideoFrameStreamer->SetStreamControl(m_pStreamControl);
+	if (m_datagramsEnabled)
+	{
+		m_pVideoFrameStreamer->EnableDatagrams(m_datagramSettings);
+	}
+	if (m_pLocalVideoFrames)
+	{
+		m_pVideoFrameStreamer->SetLocalFrames(m_pLocalVideoFrames);
+	}
+	// initialize the frame processor with a streamer sink, capturing in the format
+	// the wire format needs
+	CaptureProfileRequest profileRequest = m_videoProfileRequest;
+	profileRequest.PixelFormat = m_videoPixelFormat;
+	co_await m_pVideoFrameProcessor->InitializeAsync(m_pVideoFrameStreamer, profileRequest, m_videoProfileKind);
 }
 
 
@@ -101,7 +366,6 @@ void HL2Stream::InitializeResearchModeSensors()
 {
 	HRESULT hr = S_OK;
 	size_t sensorCount = 0;
-	camConsentGiven = CreateEvent(nullptr, true, false, nullptr);
 
 	// Load research mode library
 	HMODULE hrResearchMode = LoadLibraryA("ResearchModeAPI");
@@ -139,15 +403,46 @@ void HL2Stream::InitializeResearchModeSensors()
 
 	for (const auto& sensorDescriptor : m_sensorDescriptors)
 	{
-		wchar_t msgBuffer[200];
-		if (sensorDescriptor.sensorType == DEPTH_AHAT)
+		IResearchModeSensor** ppSensor = nullptr;
+		switch (sensorDescriptor.sensorType)
 		{
-			winrt::check_hresult(m_pSensorDevice->GetSensor(
-				sensorDescriptor.sensorType, &m_pAHATSensor));
-			swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
-				m_pAHATSensor->GetFriendlyName());
-			OutputDebugStringW(msgBuffer);
+		case DEPTH_AHAT:
+			ppSensor = &m_pAHATSensor;
+			break;
+		case DEPTH_LONG_THROW:
+			ppSensor = &m_pLongThrowSensor;
+			break;
+		case LEFT_FRONT:
+			ppSensor = &m_pLFCameraSensor;
+			break;
+		case LEFT_LEFT:
+			ppSensor = &m_pLLCameraSensor;
+			break;
+		case RIGHT_FRONT:
+			ppSensor = &m_pRFCameraSensor;
+			break;
+		case RIGHT_RIGHT:
+			ppSensor = &m_pRRCameraSensor;
+			break;
+		case IMU_ACCEL:
+			ppSensor = &m_pAccelSensor;
+			break;
+		case IMU_GYRO:
+			ppSensor = &m_pGyroSensor;
+			break;
+		case IMU_MAG:
+			ppSensor = &m_pMagSensor;
+			break;
+		default:
+			continue;
 		}
+
+		wchar_t msgBuffer[200];
+		winrt::check_hresult(m_pSensorDevice->GetSensor(
+			sensorDescriptor.sensorType, ppSensor));
+		swprintf_s(msgBuffer, L"HL2Stream::InitializeResearchModeSensors: Sensor %ls\n",
+			(*ppSensor)->GetFriendlyName());
+		OutputDebugStringW(msgBuffer);
 	}
 	OutputDebugStringW(L"HL2Stream::InitializeResearchModeSensors: Done.\n");
 	return;
@@ -160,29 +455,346 @@ void HL2Stream::InitializeResearchModeProcessing()
 	GUID guid;
 	GetRigNodeId(guid);
 
-	// initialize the depth streamer
-	auto ahatStreamer = std::make_shared<ResearchModeFrameStreamer>(L"23941", guid, m_worldOrigin);
+	// one locator query per sample instead of one per frame and stream
+	m_pPoseSampler = std::make_shared<RigPoseSampler>(guid, m_worldOrigin);
+
+	// all research mode sensors share these workers instead of two threads each
+	m_pSensorScheduler = std::make_shared<SensorScheduler>(m_sensorWorkerCount);
+
+	if (m_vlcCameraMask & 0x1)
+	{
+		InitializeVisibleLightCamera(m_pLFCameraSensor, LEFT_FRONT, L"23943", m_pLFProcessor, m_pLFStreamer);
+	}
+	if (m_vlcCameraMask & 0x2)
+	{
+		InitializeVisibleLightCamera(m_pLLCameraSensor, LEFT_LEFT, L"23944", m_pLLProcessor, m_pLLStreamer);
+	}
+	if (m_vlcCameraMask & 0x4)
+	{
+		InitializeVisibleLightCamera(m_pRFCameraSensor, RIGHT_FRONT, L"23945", m_pRFProcessor, m_pRFStreamer);
+	}
+	if (m_vlcCameraMask & 0x8)
+	{
+		InitializeVisibleLightCamera(m_pRRCameraSensor, RIGHT_RIGHT, L"23946", m_pRRProcessor, m_pRRStreamer);
+	}
+
+	if (m_imuSensorMask & 0x1)
+	{
+		InitializeImuSensor(m_pAccelSensor, IMU_ACCEL, L"23947", m_pAccelProcessor, m_pAccelStreamer);
+	}
+	if (m_imuSensorMask & 0x2)
+	{
+		InitializeImuSensor(m_pGyroSensor, IMU_GYRO, L"23948", m_pGyroProcessor, m_pGyroStreamer);
+	}
+	if (m_imuSensorMask & 0x4)
+	{
+		InitializeImuSensor(m_pMagSensor, IMU_MAG, L"23949", m_pMagProcessor, m_pMagStreamer);
+	}
+
+	// initialize the depth streamer; AHAT and Long Throw are exclusive modes
+	// of the same camera, so only the selected one is streamed
+	if (m_depthSensorType == DEPTH_LONG_THROW)
+	{
+		auto longThrowStreamer = std::make_shared<ResearchModeFrameStreamer>(
+			L"23942", m_pPoseSampler, m_sendQueueSettings, DEPTH_LONG_THROW, m_includeAb);
+		m_pLongThrowStreamer = longThrowStreamer;
+		longThrowStreamer->SetStreamControl(m_pStreamControl);
+		if (m_datagramsEnabled)
+		{
+			longThrowStreamer->EnableDatagrams(m_datagramSettings);
+		}
+		if (m_pLocalDepthFrames)
+		{
+			longThrowStreamer->SetLocalFrames(m_pLocalDepthFrames);
+		}
+
+		if (m_pLongThrowSensor)
+		{
+			// calibration for every client, and the depth as points for those that ask
+			longThrowStreamer->SetCameraSensor(m_pLongThrowSensor);
+			auto processor = std::make_shared<ResearchModeFrameProcessor>(
+				m_pLongThrowSensor, &camConsent, 0, m_pLongThrowStreamer, m_pSensorScheduler);
+
+			m_pLongThrowProcessor = processor;
+		}
+		return;
+	}
+
+	auto ahatStreamer = std::make_shared<ResearchModeFrameStreamer>(
+		L"23941", m_pPoseSampler, m_sendQueueSettings, DEPTH_AHAT, m_includeAb);
 	m_pAHATStreamer = ahatStreamer;
+	ahatStreamer->SetStreamControl(m_pStreamControl);
+	if (m_datagramsEnabled)
+	{
+		ahatStreamer->EnableDatagrams(m_datagramSettings);
+	}
+	if (m_pLocalDepthFrames)
+	{
+		ahatStreamer->SetLocalFrames(m_pLocalDepthFrames);
+	}
 
 	if (m_pAHATSensor)
 	{
+		ahatStreamer->SetCameraSensor(m_pAHATSensor);
 		auto processor = std::make_shared<ResearchModeFrameProcessor>(
-			m_pAHATSensor, camConsentGiven, &camAccessCheck, 0, m_pAHATStreamer);
+			m_pAHATSensor, &camConsent, 0, m_pAHATStreamer, m_pSensorScheduler);
 
 		m_pAHATProcessor = processor;
 	}
 }
 
+void HL2Stream::InitializeVisibleLightCamera(
+	IResearchModeSensor* pSensor,
+	ResearchModeSensorType sensorType,
+	const wchar_t* portName,
+	std::shared_ptr<ResearchModeFrameProcessor>& processor,
+	std::shared_ptr<ResearchModeFrameStreamer>& streamer)
+{
+	// 8 bit images go out as they are, with exposure and gain in the header
+	streamer = std::make_shared<ResearchModeFrameStreamer>(
+		portName, m_pPoseSampler, m_sendQueueSettings, sensorType);
+	streamer->SetStreamControl(m_pStreamControl);
+	if (m_datagramsEnabled)
+	{
+		streamer->EnableDatagrams(m_datagramSettings);
+	}
+	if (m_localVlcFrames[sensorType])
+	{
+		streamer->SetLocalFrames(m_localVlcFrames[sensorType]);
+	}
+
+	if (pSensor)
+	{
+		streamer->SetCameraSensor(pSensor);
+		processor = std::make_shared<ResearchModeFrameProcessor>(
+			pSensor, &camConsent, 0, streamer, m_pSensorScheduler);
+	}
+}
+
+void HL2Stream::InitializeFrameSynchronizer()
+{
+	if (!m_frameSyncEnabled || !m_pVideoFrameStreamer)
+	{
+		return;
+	}
+	auto depthStreamer = (m_depthSensorType == DEPTH_LONG_THROW) ? m_pLongThrowStreamer : m_pAHATStreamer;
+	if (!depthStreamer)
+	{
+		return;
+	}
+
+	m_pFusedStreamer = std::make_shared<FusedFrameStreamer>(L"23950", m_sendQueueSettings);
+	// requests on the fused connection go to the PV and the depth stream
+	m_pFusedStreamer->SetStreamControl(m_pStreamControl);
+	if (m_datagramsEnabled)
+	{
+		m_pFusedStreamer->EnableDatagrams(m_datagramSettings);
+	}
+	m_pFrameSynchronizer = std::make_shared<FrameSynchronizer>(m_pFusedStreamer, m_frameSyncSettings);
+	// both streams only start delivering frames in StartStreaming
+	m_pVideoFrameStreamer->SetSynchronizer(m_pFrameSynchronizer);
+	depthStreamer->SetSynchronizer(m_pFrameSynchronizer);
+}
+
+void HL2Stream::InitializeRateControl()
+{
+	if (!m_rateControlEnabled)
+	{
+		return;
+	}
+	m_pRateControl = std::make_unique<RateControlLoop>();
+
+	// the best level sends every frame at the interval the sensor delivers them
+	auto intervalSettings = [](uint32_t sensorIntervalMs)
+	{
+		RateControlSettings settings = m_rateControlSettings;
+		settings.MinIntervalMs = sensorIntervalMs;
+		settings.SensorIntervalMs = sensorIntervalMs;
+		settings.MaxIntervalMs = std::max(sensorIntervalMs, settings.MaxIntervalMs);
+		settings.MinDecimation = 1;
+		settings.MaxDecimation = 1;
+		settings.PixelFormat = VideoPixelFormat::Bgr8;
+		settings.CheapestPixelFormat = VideoPixelFormat::Bgr8;
+		return settings;
+	};
+	// research mode streams only have their interval to give
+	auto addResearchModeStream = [&](StreamId streamId, const wchar_t* name, uint32_t sensorIntervalMs,
+		const std::shared_ptr<ResearchModeFrameProcessor>& processor,
+		const std::shared_ptr<ResearchModeFrameStreamer>& streamer)
+	{
+		if (!processor || !streamer)
+		{
+			return;
+		}
+		// the loop is stopped before the streams are released
+		ResearchModeFrameProcessor* pProcessor = processor.get();
+		ResearchModeFrameStreamer* pStreamer = streamer.get();
+		m_rateControlStreams[streamId] = m_pRateControl->AddStream({ name, intervalSettings(sensorIntervalMs),
+			[pStreamer]() { return pStreamer->GetQueueStatistics(); },
+			[pProcessor](const RateLevel& level) { pProcessor->SetMinDelta(level.MinDelta); } });
+	};
+
+	// AHAT runs at 45 fps, Long Throw at 5, the visible light cameras at 30
+	addResearchModeStream(static_cast<StreamId>(DEPTH_AHAT), L"AHAT", 22, m_pAHATProcessor, m_pAHATStreamer);
+	addResearchModeStream(static_cast<StreamId>(DEPTH_LONG_THROW), L"LT", 200, m_pLongThrowProcessor, m_pLongThrowStreamer);
+	addResearchModeStream(static_cast<StreamId>(LEFT_FRONT), L"LF", 33, m_pLFProcessor, m_pLFStreamer);
+	addResearchModeStream(static_cast<StreamId>(LEFT_LEFT), L"LL", 33, m_pLLProcessor, m_pLLStreamer);
+	addResearchModeStream(static_cast<StreamId>(RIGHT_FRONT), L"RF", 33, m_pRFProcessor, m_pRFStreamer);
+	addResearchModeStream(static_cast<StreamId>(RIGHT_RIGHT), L"RR", 33, m_pRRProcessor, m_pRRStreamer);
+
+	if (m_pVideoFrameProcessor && m_pVideoFrameStreamer)
+	{
+		// every frame is converted to what its wire format needs, so PV can fall
+		// back to any format
+		RateControlSettings pvSettings = intervalSettings(33);
+		pvSettings.MaxDecimation = std::max(1u, m_rateControlSettings.MaxDecimation);
+		pvSettings.PixelFormat = m_videoPixelFormat;
+		pvSettings.CheapestPixelFormat = m_rateControlSettings.CheapestPixelFormat;
+		VideoCameraFrameProcessor* pProcessor = m_pVideoFrameProcessor.get();
+		VideoCameraStreamer* pStreamer = m_pVideoFrameStreamer.get();
+		m_rateControlStreams[StreamId::PhotoVideo] = m_pRateControl->AddStream({ L"PV", pvSettings,
+			[pStreamer]() { return pStreamer->GetQueueStatistics(); },
+			[pProcessor, pStreamer](const RateLevel& level)
+			{
+				pProcessor->SetMinDelta(static_cast<long long>(level.MinDelta));
+				pStreamer->SetEncoding(static_cast<int>(level.Decimation), level.PixelFormat);
+			} });
+	}
+}
+
+void HL2Stream::InitializeStreamControl()
+{
+	// streams adapted to the link take requests as their best level, the others
+	// directly
+	auto rateControlStream = [](StreamId streamId, size_t& stream)
+	{
+		auto entry = m_rateControlStreams.find(streamId);
+		if (!m_pRateControl || entry == m_rateControlStreams.end())
+		{
+			return false;
+		}
+		stream = entry->second;
+		return true;
+	};
+
+	// research mode streams can be paused and paced
+	auto registerResearchModeStream = [&](ResearchModeSensorType sensorType, const wchar_t* name,
+		const std::shared_ptr<ResearchModeFrameProcessor>& processor)
+	{
+		if (!processor)
+		{
+			return;
+		}
+		const StreamId streamId = static_cast<StreamId>(sensorType);
+		ResearchModeFrameProcessor* pProcessor = processor.get();
+		StreamControlTarget target;
+		target.Name = name;
+		target.SetEnabled = [pProcessor](bool enabled) { pProcessor->SetEnabled(enabled); };
+		target.IsEnabled = [pProcessor]() { return pProcessor->IsEnabled(); };
+		target.LevelFields = StreamControlBit(StreamControlField::Interval);
+		size_t stream;
+		if (rateControlStream(streamId, stream))
+		{
+			RateControlLoop* pRateControl = m_pRateControl.get();
+			target.SetLevel = [pRateControl, stream](const RateLevel& level) { pRateControl->SetBestLevel(stream, level); };
+			target.GetLevel = [pRateControl, stream]() { return pRateControl->GetBestLevel(stream); };
+		}
+		else
+		{
+			target.SetLevel = [pProcessor](const RateLevel& level) { pProcessor->SetMinDelta(level.MinDelta); };
+			target.GetLevel = [pProcessor]()
+			{
+				RateLevel level;
+				level.MinDelta = pProcessor->MinDelta();
+				return level;
+			};
+		}
+		m_pStreamControl->Register(streamId, std::move(target));
+	};
+
+	registerResearchModeStream(DEPTH_AHAT, L"AHAT", m_pAHATProcessor);
+	registerResearchModeStream(DEPTH_LONG_THROW, L"LT", m_pLongThrowProcessor);
+	registerResearchModeStream(LEFT_FRONT, L"LF", m_pLFProcessor);
+	registerResearchModeStream(LEFT_LEFT, L"LL", m_pLLProcessor);
+	registerResearchModeStream(RIGHT_FRONT, L"RF", m_pRFProcessor);
+	registerResearchModeStream(RIGHT_RIGHT, L"RR", m_pRRProcessor);
+	registerResearchModeStream(IMU_ACCEL, L"Accel", m_pAccelProcessor);
+	registerResearchModeStream(IMU_GYRO, L"Gyro", m_pGyroProcessor);
+	registerResearchModeStream(IMU_MAG, L"Mag", m_pMagProcessor);
+
+	if (!m_pVideoFrameProcessor || !m_pVideoFrameStreamer)
+	{
+		return;
+	}
+	VideoCameraFrameProcessor* pProcessor = m_pVideoFrameProcessor.get();
+	VideoCameraStreamer* pStreamer = m_pVideoFrameStreamer.get();
+	StreamControlTarget target;
+	target.Name = L"PV";
+	target.SetEnabled = [pProcessor](bool enabled) { pProcessor->SetEnabled(enabled); };
+	target.IsEnabled = [pProcessor]() { return pProcessor->IsEnabled(); };
+	target.LevelFields = StreamControlBit(StreamControlField::Interval) |
+		StreamControlBit(StreamControlField::Decimation) | StreamControlBit(StreamControlField::PixelFormat);
+	target.MaxDecimation = 8;
+	// every frame is converted to what its wire format needs
+	target.PixelFormats = (1u << static_cast<uint32_t>(VideoPixelFormat::Bgr8)) |
+		(1u << static_cast<uint32_t>(VideoPixelFormat::Nv12)) |
+		(1u << static_cast<uint32_t>(VideoPixelFormat::Luma8));
+	size_t stream;
+	if (rateControlStream(StreamId::PhotoVideo, stream))
+	{
+		RateControlLoop* pRateControl = m_pRateControl.get();
+		target.SetLevel = [pRateControl, stream](const RateLevel& level) { pRateControl->SetBestLevel(stream, level); };
+		target.GetLevel = [pRateControl, stream]() { return pRateControl->GetBestLevel(stream); };
+	}
+	else
+	{
+		target.SetLevel = [pProcessor, pStreamer](const RateLevel& level)
+		{
+			pProcessor->SetMinDelta(static_cast<long long>(level.MinDelta));
+			pStreamer->SetEncoding(static_cast<int>(level.Decimation), level.PixelFormat);
+		};
+		target.GetLevel = [pProcessor, pStreamer]()
+		{
+			RateLevel level;
+			level.MinDelta = static_cast<uint64_t>(pProcessor->MinDelta());
+			level.Decimation = static_cast<uint32_t>(pStreamer->ScaleFactor());
+			level.PixelFormat = pStreamer->PixelFormat();
+			return level;
+		};
+	}
+	m_pStreamControl->Register(StreamId::PhotoVideo, std::move(target));
+}
+
+void HL2Stream::InitializeImuSensor(
+	IResearchModeSensor* pSensor,
+	ResearchModeSensorType sensorType,
+	const wchar_t* portName,
+	std::shared_ptr<ResearchModeFrameProcessor>& processor,
+	std::shared_ptr<ImuStreamer>& streamer)
+{
+	streamer = std::make_shared<ImuStreamer>(portName, sensorType, m_sendQueueSettings);
+	streamer->SetStreamControl(m_pStreamControl);
+	if (m_datagramsEnabled)
+	{
+		streamer->EnableDatagrams(m_datagramSettings);
+	}
+
+	if (pSensor)
+	{
+		// IMU access has a consent of its own
+		processor = std::make_shared<ResearchModeFrameProcessor>(
+			pSensor, &imuConsent, 0, streamer, m_pSensorScheduler);
+	}
+}
+
 void HL2Stream::CamAccessOnComplete(ResearchModeSensorConsent consent)
 {
-	camAccessCheck = consent;
-	SetEvent(camConsentGiven);
+	camConsent.Set(consent);
 }
 
 void HL2Stream::ImuAccessOnComplete(ResearchModeSensorConsent consent)
 {
-	imuAccessCheck = consent;
-	SetEvent(imuConsentGiven);
+	imuConsent.Set(consent);
 }
 
 void HL2Stream::DisableSensors()
@@ -194,14 +806,33 @@ void HL2Stream::DisableSensors()
 	{
 		m_pAHATSensor->Release();
 	}
+	if (m_pLongThrowSensor)
+	{
+		m_pLongThrowSensor->Release();
+	}
 	if (m_pLFCameraSensor)
 	{
 		m_pLFCameraSensor->Release();
 	}
+	if (m_pLLCameraSensor)
+	{
+		m_pLLCameraSensor->Release();
+	}
 	if (m_pRFCameraSensor)
 	{
 		m_pRFCameraSensor->Release();
 	}
+	if (m_pRRCameraSensor)
+	{
+		m_pRRCameraSensor->Release();
+	}
+	for (auto pImuSensor : { m_pAccelSensor, m_pGyroSensor, m_pMagSensor })
+	{
+		if (pImuSensor)
+		{
+			pImuSensor->Release();
+		}
+	}
 	if (m_pSensorDevice)
 	{
 		m_pSensorDevice->EnableEyeSelection();
@@ -12,6 +12,79 @@ namespace HL2Stream
 
 	FUNCTIONS_EXPORTS_API void StreamingToggle();
 
+	// Selects the PV wire format (a VideoPixelFormat: 0 BGR, 1 NV12, 2 luma only).
+	// Takes effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetVideoPixelFormat(int pixelFormat);
+
+	// Asks the PV camera for width x height at frameRate fps (0 leaves a value to
+	// the camera) from its profiles of kind profileKind (a KnownVideoProfile, 3 for
+	// video conferencing); the closest one is captured, see SelectCaptureProfile.
+	// Takes effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetVideoCaptureProfile(int width, int height, int frameRate, int profileKind);
+
+	// The format the PV camera captures in. Returns 0 before Initialize.
+	FUNCTIONS_EXPORTS_API int GetVideoCaptureProfile(int* width, int* height, float* frameRate);
+
+	// Configures the send queue of every stream (policy is a SendQueuePolicy:
+	// 0 drop oldest, 1 drop newest, 2 max age). Takes effect when called before
+	// Initialize.
+	FUNCTIONS_EXPORTS_API void SetSendQueue(int depth, int policy, int maxAgeMs);
+
+	// Selects the depth stream (a ResearchModeSensorType: 4 AHAT on port 23941,
+	// 5 Long Throw on port 23942; the device cannot run both) and whether its
+	// frames carry the AB image. Takes effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetDepthSensor(int sensorType, int includeAb);
+
+	// Enables the visible light cameras, one bit each: 1 left front (port 23943),
+	// 2 left left (23944), 4 right front (23945), 8 right right (23946). Takes
+	// effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetVisibleLightCameras(int cameraMask);
+
+	// Number of worker threads shared by all research mode sensors. Takes effect
+	// when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetSensorWorkers(int workerCount);
+
+	// Enables the IMU sensors, one bit each: 1 accelerometer (port 23947),
+	// 2 gyroscope (23948), 4 magnetometer (23949). Every sample batch is sent as
+	// one packet. Takes effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetImuSensors(int sensorMask);
+
+	// Pairs every PV frame with the depth frame nearest in time, if they are at
+	// most toleranceMs apart, and streams the pairs on port 23950 with the depth
+	// in codec (a DepthCodec). Takes effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetFrameSync(int enabled, int toleranceMs, int codec);
+
+	// Adapts the camera streams to the link every periodMs: while their send
+	// queues drop frames they are paced down to one frame per maxIntervalMs, and PV
+	// is decimated down to 1/maxDecimation and falls back to cheapestPixelFormat
+	// (a VideoPixelFormat); once the link keeps up they step back. Takes effect
+	// when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetRateControl(int enabled, int periodMs, int maxIntervalMs,
+		int maxDecimation, int cheapestPixelFormat);
+
+	// Also streams over UDP: clients subscribe by sending a message to the UDP port
+	// of the same number as the TCP port of a stream, and get its messages split
+	// into datagrams of datagramSize bytes, with a parity datagram after every
+	// parityGroupSize of them (0 for none) that repairs the loss of any one. Takes
+	// effect when called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetDatagramTransport(int enabled, int datagramSize, int parityGroupSize);
+
+	// Also keeps the latest frame of streams in native memory for scripts in this
+	// process, one bit per stream: 1 PV, 2 the depth sensor, 4 left front, 8 left
+	// left, 16 right front, 32 right right visible light camera. Takes effect when
+	// called before Initialize.
+	FUNCTIONS_EXPORTS_API void SetLocalFrameAccess(int streamMask);
+
+	// Takes the latest frame of the stream streamId (a StreamId: 256 PV, else the
+	// ResearchModeSensorType) into frame, whose pData stays valid until
+	// ReleaseLocalFrame. The stream drops the frames that arrive while the older
+	// of its two buffers is held, so copy the pixels out, e.g. into a texture, and
+	// release right away. Returns 0 if the stream has no frame yet or no local
+	// access; compare Sequence to see whether the frame is new.
+	FUNCTIONS_EXPORTS_API int AcquireLocalFrame(int streamId, LocalFrame* frame);
+
+	FUNCTIONS_EXPORTS_API void ReleaseLocalFrame(int streamId);
+
 	void StartStreaming();
 	
 	void StopStreaming();
@@ -25,8 +98,31 @@ namespace HL2Stream
 
 	void InitializeResearchModeProcessing();
 
+	void InitializeVisibleLightCamera(
+		IResearchModeSensor* pSensor,
+		ResearchModeSensorType sensorType,
+		const wchar_t* portName,
+		std::shared_ptr<ResearchModeFrameProcessor>& processor,
+		std::shared_ptr<ResearchModeFrameStreamer>& streamer);
+
+	void InitializeFrameSynchronizer();
+
+	void InitializeRateControl();
+
+	void InitializeStreamControl();
+
+	void InitializeImuSensor(
+		IResearchModeSensor* pSensor,
+		ResearchModeSensorType sensorType,
+		const wchar_t* portName,
+		std::shared_ptr<ResearchModeFrameProcessor>& processor,
+		std::shared_ptr<ImuStreamer>& streamer);
+
 	void GetRigNodeId(GUID& outGuid);
 
+	// the local frames of a stream, or nullptr without local access
+	std::shared_ptr<LocalFrameExchange> LocalFramesOf(int streamId);
+
 	static void CamAccessOnComplete(ResearchModeSensorConsent consent);
 	static void ImuAccessOnComplete(ResearchModeSensorConsent consent);
 
@@ -34,6 +130,8 @@ namespace HL2Stream
 
 	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem
 		m_worldOrigin{ nullptr };
+	// rig poses shared by the PV and all research mode camera streams
+	std::shared_ptr<RigPoseSampler> m_pPoseSampler;
 
 	IResearchModeSensorDevice* m_pSensorDevice;
 	IResearchModeSensorDeviceConsent* m_pSensorDeviceConsent;
@@ -43,15 +141,74 @@ namespace HL2Stream
 	std::unique_ptr<VideoCameraFrameProcessor> m_pVideoFrameProcessor = nullptr;
 	std::shared_ptr<VideoCameraStreamer> m_pVideoFrameStreamer = nullptr;
 	winrt::Windows::Foundation::IAsyncAction m_videoFrameProcessorOperation = nullptr;
+	VideoPixelFormat m_videoPixelFormat = VideoPixelFormat::Bgr8;
+	CaptureProfileRequest m_videoProfileRequest;
+	winrt::Windows::Media::Capture::KnownVideoProfile m_videoProfileKind =
+		winrt::Windows::Media::Capture::KnownVideoProfile::VideoConferencing;
+	SendQueueSettings m_sendQueueSettings;
+
+	// RGB-D pairing of the PV and the depth stream
+	bool m_frameSyncEnabled = false;
+	FrameSyncSettings m_frameSyncSettings;
+	std::shared_ptr<FusedFrameStreamer> m_pFusedStreamer = nullptr;
+	std::shared_ptr<FrameSynchronizer> m_pFrameSynchronizer = nullptr;
+
+	// adaptation of the camera streams to the link
+	bool m_rateControlEnabled = false;
+	RateControlSettings m_rateControlSettings;
+	std::unique_ptr<RateControlLoop> m_pRateControl = nullptr;
+	// the RateControlLoop stream of each stream it adapts
+	std::map<StreamId, size_t> m_rateControlStreams;
+
+	// UDP subscribers, for every streamer
+	bool m_datagramsEnabled = false;
+	DatagramSettings m_datagramSettings;
+
+	// frames for scripts in this process; only set before Initialize, so the
+	// exported functions may read them from any thread
+	std::shared_ptr<LocalFrameExchange> m_pLocalVideoFrames;
+	std::shared_ptr<LocalFrameExchange> m_pLocalDepthFrames;
+	// by ResearchModeSensorType, LEFT_FRONT to RIGHT_RIGHT
+	std::shared_ptr<LocalFrameExchange> m_localVlcFrames[4];
+
+	// StreamControl requests of the clients, shared by every streamer
+	std::shared_ptr<StreamControlRouter> m_pStreamControl = std::make_shared<StreamControlRouter>();
 
 	// rm sensors processing & streaming
+	ResearchModeSensorType m_depthSensorType = DEPTH_AHAT;
+	bool m_includeAb = false;
+	int m_vlcCameraMask = 0;
+	int m_imuSensorMask = 0;
+	unsigned int m_sensorWorkerCount = SensorScheduler::kAutoWorkerCount;
+	std::shared_ptr<SensorScheduler> m_pSensorScheduler;
+
 	IResearchModeSensor* m_pAHATSensor = nullptr;
+	IResearchModeSensor* m_pLongThrowSensor = nullptr;
 	IResearchModeSensor* m_pLFCameraSensor = nullptr;
+	IResearchModeSensor* m_pLLCameraSensor = nullptr;
 	IResearchModeSensor* m_pRFCameraSensor = nullptr;
+	IResearchModeSensor* m_pRRCameraSensor = nullptr;
+	IResearchModeSensor* m_pAccelSensor = nullptr;
+	IResearchModeSensor* m_pGyroSensor = nullptr;
+	IResearchModeSensor* m_pMagSensor = nullptr;
 
 	std::shared_ptr<ResearchModeFrameProcessor> m_pAHATProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pLongThrowProcessor;
 	std::shared_ptr<ResearchModeFrameProcessor> m_pLFProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pLLProcessor;
 	std::shared_ptr<ResearchModeFrameProcessor> m_pRFProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pRRProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pAccelProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pGyroProcessor;
+	std::shared_ptr<ResearchModeFrameProcessor> m_pMagProcessor;
 
 	std::shared_ptr<ResearchModeFrameStreamer> m_pAHATStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pLongThrowStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pLFStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pLLStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pRFStreamer = nullptr;
+	std::shared_ptr<ResearchModeFrameStreamer> m_pRRStreamer = nullptr;
+	std::shared_ptr<ImuStreamer> m_pAccelStreamer = nullptr;
+	std::shared_ptr<ImuStreamer> m_pGyroStreamer = nullptr;
+	std::shared_ptr<ImuStreamer> m_pMagStreamer = nullptr;
 }
\ No newline at end of file
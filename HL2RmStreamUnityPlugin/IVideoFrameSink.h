@@ -6,5 +6,6 @@ public:
 	virtual ~IVideoFrameSink() {};
 	virtual void Send(
 		winrt::Windows::Media::Capture::Frames::MediaFrameReference frame,
-		long long pTimestamp) = 0;
+		long long pTimestamp,
+		const FrameTrace& trace) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+
+using namespace winrt::Windows::Networking::Sockets;
+using namespace winrt::Windows::Storage::Streams;
+
+ImuStreamer::ImuStreamer(
+    std::wstring portName,
+    ResearchModeSensorType sensorType,
+    const SendQueueSettings& queueSettings) :
+    m_sender(queueSettings),
+    m_encoder(sensorType),
+    // serialized packets are shared by the queues of all subscribers
+    m_wireBuffers(SendQueueBufferCount(queueSettings, StreamSocketSender::kMaxSubscribers))
+{
+    m_portName = portName;
+    StartServer();
+}
+
+winrt::Windows::Foundation::IAsyncAction ImuStreamer::StartServer()
+{
+    try
+    {
+        m_streamSocketListener.ConnectionReceived({ this, &ImuStreamer::OnConnectionReceived });
+        co_await m_streamSocketListener.BindServiceNameAsync(m_portName);
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"ImuStreamer::StartServer: Server is listening at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"ImuStreamer::StartServer: Failed to open listener with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void ImuStreamer::OnConnectionReceived(
+    StreamSocketListener /* sender */,
+    StreamSocketListenerConnectionReceivedEventArgs args)
+{
+    try
+    {
+        if (!m_sender.AddSubscriber(args.Socket()))
+        {
+            return;
+        }
+        isConnected = true;
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"ImuStreamer::OnConnectionReceived: Received connection at %ls. \n",
+            m_portName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif // DBG_ENABLE_INFO_LOGGING
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
+        winrt::hstring message = webErrorStatus != SocketErrorStatus::Unknown ?
+            winrt::to_hstring((int32_t)webErrorStatus) : winrt::to_hstring(ex.to_abi());
+        OutputDebugStringW(L"ImuStreamer::OnConnectionReceived: Failed to establish connection with error ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+}
+
+void ImuStreamer::Send(
+    std::shared_ptr<IResearchModeSensorFrame> frame,
+    ResearchModeSensorType /* pSensorType */,
+    const FrameTrace& trace)
+{
+    if (!m_sender.IsConnected())
+    {
+        return;
+    }
+
+    // the frame timestamp is the one of the first sample in the batch
+    ResearchModeSensorTimestamp rmTimestamp;
+    winrt::check_hresult(frame->GetTimeStamp(&rmTimestamp));
+    auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(
+        HundredsOfNanoseconds((long long)rmTimestamp.HostTicks)).count();
+
+    FrameBufferPtr payload = m_bufferPool.Acquire();
+    if (!payload)
+    {
+        return;
+    }
+    ImuPacketHeader header;
+    if (!m_encoder.Encode(frame.get(), absoluteTimestamp, header, *payload))
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ImuStreamer::Send: Failed to grab IMU samples.\n");
+#endif
+        return;
+    }
+
+    // the whole batch goes out in a single write
+    m_message.SetHeader(m_encoder.Stream(), 0, header);
+    m_message.SetTrace(trace);
+    m_message.AddPayload(payload);
+    FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+    m_message.Clear();
+    if (!wire || !m_sender.Send(std::move(wire)))
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(L"ImuStreamer::Send: Packet dropped.\n");
+#endif
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+// Streams the sample batches of one IMU sensor, one packet per batch: an
+// ImuPacketHeader followed by the samples, with absolute timestamps. IMU packets
+// carry no pose, so unlike ResearchModeFrameStreamer there is no locator.
+class ImuStreamer : public IResearchModeFrameSink
+{
+public:
+	ImuStreamer(
+		std::wstring portName,
+		ResearchModeSensorType sensorType,
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	void Send(
+		std::shared_ptr<IResearchModeSensorFrame> frame,
+		ResearchModeSensorType pSensorType,
+		const FrameTrace& trace);
+
+public:
+	bool isConnected = false;
+
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	// Answers the StreamControl requests of the subscribers through router. Call
+	// before the first client connects.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_sender.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers on the UDP port of the same number, see
+	// DatagramSettings. Call before the first client subscribes.
+	void EnableDatagrams(const DatagramSettings& settings) { m_sender.EnableDatagrams(m_portName, settings); }
+
+	SendQueueStatistics GetQueueStatistics() const { return m_sender.GetQueueStatistics(); }
+
+private:
+	winrt::Windows::Foundation::IAsyncAction StartServer();
+
+	void OnConnectionReceived(
+		winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
+		winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
+
+	winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
+	StreamSocketSender m_sender;
+	FrameMessage m_message;
+
+	std::wstring m_portName;
+
+	TimeConverter m_converter;
+	ImuFrameEncoder m_encoder;
+	// samples of one batch, only held until the message is serialized
+	FrameBufferPool m_bufferPool;
+	// serialized packets, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+};
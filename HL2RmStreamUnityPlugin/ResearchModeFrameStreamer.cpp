@@ -13,19 +13,38 @@ using namespace winrt::Windows::Foundation::Numerics;
 
 ResearchModeFrameStreamer::ResearchModeFrameStreamer(
     std::wstring portName,
-    const GUID& guid,
-    const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem)
+    std::shared_ptr<RigPoseSampler> poseSampler,
+    const SendQueueSettings& queueSettings,
+    ResearchModeSensorType sensorType,
+    bool includeAb) :
+    m_pPoseSampler(std::move(poseSampler)),
+    m_sender(queueSettings),
+    m_encoder(sensorType, includeAb),
+    // serialized frames are shared by the queues of all subscribers and may be
+    // held by a synchronizer
+    m_wireBuffers(SendQueueBufferCount(queueSettings, StreamSocketSender::kMaxSubscribers) +
+        FrameSynchronizer::kMaxBufferedFrames)
 {
     m_portName = portName;
-    m_worldCoordSystem = coordSystem;
-
-    // Get GUID identifying the rigNode to
-    // initialize the SpatialLocator
-    SetLocator(guid);
 
+    m_sender.SetSupportedCodecs(m_encoder.SupportedCodecs());
     StartServer();
 }
 
+bool ResearchModeFrameStreamer::SetCameraSensor(
+    IResearchModeSensor* pSensor)
+{
+    if (!m_encoder.SetCameraSensor(pSensor))
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"ResearchModeFrameStreamer::SetCameraSensor: Sensor is no camera.\n");
+#endif
+        return false;
+    }
+    m_sender.SetSupportedCodecs(m_encoder.SupportedCodecs());
+    return true;
+}
+
 
 // https://docs.microsoft.com/en-us/windows/uwp/networking/sockets
 winrt::Windows::Foundation::IAsyncAction ResearchModeFrameStreamer::StartServer()
@@ -66,12 +85,10 @@ void ResearchModeFrameStreamer::OnConnectionReceived(
 {
     try
     {
-        m_streamSocket = args.Socket();
-        m_writer = DataWriter(args.Socket().OutputStream());
-        m_writer.UnicodeEncoding(UnicodeEncoding::Utf8);
-        m_writer.ByteOrder(ByteOrder::LittleEndian);
-
-        m_writeInProgress = false;
+        if (!m_sender.AddSubscriber(args.Socket()))
+        {
+            return;
+        }
         isConnected = true;
         //m_streamingEnabled = true;
 #if DBG_ENABLE_INFO_LOGGING
@@ -97,13 +114,15 @@ void ResearchModeFrameStreamer::OnConnectionReceived(
 
 void ResearchModeFrameStreamer::Send(
     std::shared_ptr<IResearchModeSensorFrame> frame,
-    ResearchModeSensorType pSensorType)
+    ResearchModeSensorType pSensorType,
+    const FrameTrace& trace)
 {
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Received frame for sending!\n");
 #endif
 
-    if (!m_streamSocket || !m_writer)
+    const bool synchronizing = m_pSynchronizer && m_pSynchronizer->IsActive();
+    if (!m_sender.IsConnected() && !synchronizing && !m_pLocalFrames)
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: No connection.\n");
@@ -116,147 +135,87 @@ void ResearchModeFrameStreamer::Send(
     winrt::check_hresult(frame->GetTimeStamp(&rmTimestamp));
     auto prevTimestamp = rmTimestamp.HostTicks;
 
-    auto timestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(checkAndConvertUnsigned(prevTimestamp)));
-    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
-    if (!location)
+    float4x4 rig2worldTransform;
+    if (!m_pPoseSampler->TryGetRigToWorld(checkAndConvertUnsigned(prevTimestamp), rig2worldTransform))
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Can't locate frame.\n");
 #endif
         return;
     }
-    const float4x4 rig2worldTransform = make_float4x4_from_quaternion(location.Orientation()) * make_float4x4_translation(location.Position());
-    auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)prevTimestamp)).count();
-
-    // grab the frame data
+    // a new calibration goes with this frame and the ones after it
     ResearchModeSensorResolution resolution;
-    IResearchModeSensorDepthFrame* pDepthFrame = nullptr;
-    size_t outBufferCount;
-    const UINT16* pDepth = nullptr;
-
-    // invalidation value for AHAT 
-    USHORT maxValue = 4090;
-
-    frame->GetResolution(&resolution);
-    HRESULT hr = frame->QueryInterface(IID_PPV_ARGS(&pDepthFrame));
-
-    if (!pDepthFrame || !SUCCEEDED(hr))
+    if (m_encoder.HasCameraSensor() && SUCCEEDED(frame->GetResolution(&resolution)))
     {
-#if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Failed to grab depth frame.\n");
-#endif
-        return;
+        FrameBufferPtr calibration = m_encoder.Calibration(resolution.Width, resolution.Height);
+        if (calibration != m_calibration)
+        {
+            m_calibration = calibration;
+            m_sender.SetSessionMessage(calibration);
+        }
     }
 
-    std::shared_ptr<IResearchModeSensorDepthFrame> spDepthFrame(pDepthFrame, [](IResearchModeSensorDepthFrame* sf) { sf->Release(); });
-
-    int imageWidth = resolution.Width;
-    int imageHeight = resolution.Height;
-    int pixelStride = resolution.BytesPerPixel;
-
-    int rowStride = imageWidth * pixelStride;
+    auto absoluteTimestamp = m_converter.RelativeTicksToAbsoluteTicks(HundredsOfNanoseconds((long long)prevTimestamp)).count();
 
-    hr = spDepthFrame->GetBuffer(&pDepth, &outBufferCount);
-    std::vector<BYTE> depthByteData;
-    depthByteData.reserve(outBufferCount * sizeof(UINT16));
+    if (m_pLocalFrames)
+    {
+        m_pLocalFrames->PublishResearchMode(frame.get(), m_encoder.SensorType(), m_encoder.IncludesAb(),
+            absoluteTimestamp, Float4x4::From(rig2worldTransform), trace);
+    }
 
-    // validate depth & append to vector
-    for (size_t i = 0; i < outBufferCount; ++i)
+    // encode once per codec the subscribers asked for
+    uint32_t codecs = m_sender.RequestedCodecs();
+    if (synchronizing)
+    {
+        codecs |= CodecBit(m_pSynchronizer->Codec());
+    }
+    for (DepthCodec codec : kDepthCodecs)
     {
-        // use a different invalidation condition for Long Throw and AHAT 
-        const bool invalid = (pDepth[i] >= maxValue);
-        UINT16 d;
-        if (invalid)
+        if (!(codecs & CodecBit(codec)))
         {
-            d = 0;
+            continue;
         }
-        else
+
+        // grab the frame data and validate the depth
+        FrameBufferPtr payload = m_bufferPool.Acquire();
+        if (!payload)
         {
-            d = pDepth[i];
+            return;
         }
-        depthByteData.push_back((BYTE)(d >> 8));
-        depthByteData.push_back((BYTE)d);
-    }
-
-    if (m_writeInProgress)
-    {
+        ResearchModeFrameHeader header;
+        DepthCodec encodedCodec = codec;
+        if (!m_encoder.Encode(frame.get(), header, *payload, encodedCodec))
+        {
 #if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Write already in progress.\n");
+            OutputDebugStringW(L"ResearchModeFrameStreamer::Send: Failed to grab depth frame.\n");
 #endif
-        return;
-    }
-
-    m_writeInProgress = true;
-
-    try
-    {
-        // Write header
-        m_writer.WriteUInt64(absoluteTimestamp);
-        m_writer.WriteInt32(imageWidth);
-        m_writer.WriteInt32(imageHeight);
-        m_writer.WriteInt32(pixelStride);
-        m_writer.WriteInt32(rowStride);
-
-        WriteMatrix4x4(rig2worldTransform);
+            return;
+        }
 
-        m_writer.WriteBytes(depthByteData);
+        header.Timestamp = absoluteTimestamp;
+        header.Rig2World = Float4x4::From(rig2worldTransform);
 
+        // header and depth go out as one buffer in a single write
+        m_message.SetHeader(m_encoder.Stream(), static_cast<uint32_t>(encodedCodec), header);
+        m_message.SetTrace(trace);
+        m_message.AddPayload(payload);
+        FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+        m_message.Clear();
+        if (wire && synchronizing && codec == m_pSynchronizer->Codec())
+        {
+            m_pSynchronizer->AddDepth(header.Timestamp, wire);
+        }
+        if (!wire || !m_sender.Send(std::move(wire), codec))
+        {
 #if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Trying to store writer...\n");
+            OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame dropped.\n");
 #endif
-        m_writer.StoreAsync();
-    }
-    catch (winrt::hresult_error const& ex)
-    {
-        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
-        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
-        {
-            // the client disconnected!
-            m_writer == nullptr;
-            m_streamSocket == nullptr;
-            m_writeInProgress = false;
+            continue;
         }
-#if DBG_ENABLE_ERROR_LOGGING
-        winrt::hstring message = ex.message();
-        OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Sending failed with ");
-        OutputDebugStringW(message.c_str());
-        OutputDebugStringW(L"\n");
-#endif // DBG_ENABLE_ERROR_LOGGING
     }
 
-    m_writeInProgress = false;
-
 #if DBG_ENABLE_VERBOSE_LOGGING
-    OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame sent!\n");
+    OutputDebugStringW(L"ResearchModeFrameStreamer::SendFrame: Frame queued!\n");
 #endif
 }
 
-
-void ResearchModeFrameStreamer::WriteMatrix4x4(
-    _In_ winrt::Windows::Foundation::Numerics::float4x4 matrix)
-{
-    m_writer.WriteSingle(matrix.m11);
-    m_writer.WriteSingle(matrix.m12);
-    m_writer.WriteSingle(matrix.m13);
-    m_writer.WriteSingle(matrix.m14);
-
-    m_writer.WriteSingle(matrix.m21);
-    m_writer.WriteSingle(matrix.m22);
-    m_writer.WriteSingle(matrix.m23);
-    m_writer.WriteSingle(matrix.m24);
-
-    m_writer.WriteSingle(matrix.m31);
-    m_writer.WriteSingle(matrix.m32);
-    m_writer.WriteSingle(matrix.m33);
-    m_writer.WriteSingle(matrix.m34);
-
-    m_writer.WriteSingle(matrix.m41);
-    m_writer.WriteSingle(matrix.m42);
-    m_writer.WriteSingle(matrix.m43);
-    m_writer.WriteSingle(matrix.m44);
-}
-
-void ResearchModeFrameStreamer::SetLocator(const GUID& guid)
-{
-    m_locator = Preview::SpatialGraphInteropPreview::CreateLocatorForNode(guid);
-}
@@ -4,18 +4,49 @@ class ResearchModeFrameStreamer : public IResearchModeFrameSink
 public:
 	ResearchModeFrameStreamer(
 		std::wstring portName,
-		const GUID& guid,
-		const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem);
+		std::shared_ptr<RigPoseSampler> poseSampler,
+		const SendQueueSettings& queueSettings = SendQueueSettings(),
+		ResearchModeSensorType sensorType = DEPTH_AHAT,
+		bool includeAb = false);
 
 	void Send(
 		std::shared_ptr<IResearchModeSensorFrame> frame,
-		ResearchModeSensorType pSensorType);
+		ResearchModeSensorType pSensorType,
+		const FrameTrace& trace);
+
+	// Also hands every serialized frame to synchronizer while it is active, to be
+	// paired with the PV frames in the codec it asks for. Call before frames arrive.
+	void SetSynchronizer(std::shared_ptr<FrameSynchronizer> synchronizer) { m_pSynchronizer = std::move(synchronizer); }
+
+	// Also publishes the image of every frame to frames, for scripts in this
+	// process, whether or not anyone is connected. Call before frames arrive.
+	void SetLocalFrames(std::shared_ptr<LocalFrameExchange> frames) { m_pLocalFrames = std::move(frames); }
+
+	// Sends the calibration of pSensor to every subscriber ahead of its first
+	// frame and, for depth, offers the point cloud codecs. Returns false if pSensor
+	// is no camera. Call before frames arrive.
+	bool SetCameraSensor(IResearchModeSensor* pSensor);
 
 	//void StreamingToggle();
 
 public:
 	bool isConnected = false;
 
+	// allocations of payload buffers, constant in steady state
+	FrameBufferPoolStatistics GetBufferStatistics() const { return m_bufferPool.Statistics(); }
+
+	FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+	// Answers the StreamControl requests of the subscribers through router. Call
+	// before the first client connects.
+	void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_sender.SetStreamControl(std::move(router)); }
+
+	// Also takes subscribers on the UDP port of the same number, see
+	// DatagramSettings. Call before the first client subscribes.
+	void EnableDatagrams(const DatagramSettings& settings) { m_sender.EnableDatagrams(m_portName, settings); }
+
+	SendQueueStatistics GetQueueStatistics() const { return m_sender.GetQueueStatistics(); }
+
 private:
 	winrt::Windows::Foundation::IAsyncAction StartServer();
 
@@ -23,23 +54,25 @@ private:
 		winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
 		winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
 
-	void WriteMatrix4x4(
-		_In_ winrt::Windows::Foundation::Numerics::float4x4 matrix);
-
-	void SetLocator(const GUID& guid);
-
-	// spatial locators
-	winrt::Windows::Perception::Spatial::SpatialLocator m_locator = nullptr;
-	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
+	// rig poses, shared with the other rig-mounted cameras
+	std::shared_ptr<RigPoseSampler> m_pPoseSampler;
 
 	// socket, listener and writer
 	winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
-	winrt::Windows::Networking::Sockets::StreamSocket m_streamSocket = nullptr;
-	winrt::Windows::Storage::Streams::DataWriter m_writer = nullptr;
-	bool m_writeInProgress = false;
+	StreamSocketSender m_sender;
+	FrameMessage m_message;
 
 	std::wstring m_portName;
 
 	TimeConverter m_converter;
+	ResearchModeFrameEncoder m_encoder;
+	// validated depth; buffers grow only when the resolution does
+	FrameBufferPool m_bufferPool;
+	// serialized frames, held by the subscriber queues until they are written
+	FrameBufferPool m_wireBuffers;
+	std::shared_ptr<FrameSynchronizer> m_pSynchronizer;
+	std::shared_ptr<LocalFrameExchange> m_pLocalFrames;
+	// the session message of the sender
+	FrameBufferPtr m_calibration;
 };
 
@@ -0,0 +1,119 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+
+using namespace winrt::Windows::Perception;
+using namespace winrt::Windows::Perception::Spatial;
+using namespace winrt::Windows::Foundation::Numerics;
+
+RigPoseSampler::RigPoseSampler(
+    const GUID& rigNodeId,
+    const SpatialCoordinateSystem& worldCoordSystem,
+    uint32_t sampleRate,
+    const PoseCacheSettings& cacheSettings) :
+    m_cache(cacheSettings),
+    m_samplePeriod(1'000'000 / std::max(1u, sampleRate))
+{
+    m_locator = Preview::SpatialGraphInteropPreview::CreateLocatorForNode(rigNodeId);
+    m_rigCoordSystem = Preview::SpatialGraphInteropPreview::CreateCoordinateSystemForNode(rigNodeId);
+    m_worldCoordSystem = worldCoordSystem;
+}
+
+void RigPoseSampler::Start()
+{
+    if (isRunning)
+    {
+        return;
+    }
+    m_fExit = false;
+    m_samplingThread = std::thread(SamplingThread, this);
+    isRunning = true;
+}
+
+void RigPoseSampler::Stop()
+{
+    m_fExit = true;
+    if (m_samplingThread.joinable())
+    {
+        m_samplingThread.join();
+    }
+    isRunning = false;
+}
+
+bool RigPoseSampler::TryGetRigToWorld(
+    long long timestamp,
+    float4x4& rig2world)
+{
+    RigidPose pose;
+    if (!m_cache.TryGetPose(static_cast<uint64_t>(timestamp), pose, false))
+    {
+        // newer than the last sample: ask the locator, which also keeps the
+        // cache current for the next frames
+        auto perceptionTimestamp = PerceptionTimestampHelper::FromSystemRelativeTargetTime(HundredsOfNanoseconds(timestamp));
+        if (TryLocate(perceptionTimestamp, pose))
+        {
+            m_cache.Add(static_cast<uint64_t>(timestamp), pose);
+        }
+        else if (!m_cache.TryGetPose(static_cast<uint64_t>(timestamp), pose))
+        {
+#if DBG_ENABLE_VERBOSE_LOGGING
+            OutputDebugStringW(L"RigPoseSampler::TryGetRigToWorld: No pose.\n");
+#endif
+            return false;
+        }
+    }
+
+    rig2world = make_float4x4_from_quaternion(
+        quaternion(pose.Orientation[0], pose.Orientation[1], pose.Orientation[2], pose.Orientation[3])) *
+        make_float4x4_translation(pose.Position[0], pose.Position[1], pose.Position[2]);
+    return true;
+}
+
+bool RigPoseSampler::TryLocate(
+    const PerceptionTimestamp& timestamp,
+    RigidPose& pose)
+{
+    auto location = m_locator.TryLocateAtTimestamp(timestamp, m_worldCoordSystem);
+    if (!location)
+    {
+        return false;
+    }
+    const quaternion orientation = location.Orientation();
+    const float3 position = location.Position();
+    pose.Orientation[0] = orientation.x;
+    pose.Orientation[1] = orientation.y;
+    pose.Orientation[2] = orientation.z;
+    pose.Orientation[3] = orientation.w;
+    pose.Position[0] = position.x;
+    pose.Position[1] = position.y;
+    pose.Position[2] = position.z;
+    return true;
+}
+
+void RigPoseSampler::SamplingThread(RigPoseSampler* pSampler)
+{
+#if DBG_ENABLE_INFO_LOGGING
+    OutputDebugString(L"RigPoseSampler::SamplingThread: Starting sampling thread.\n");
+#endif
+    auto next = std::chrono::steady_clock::now();
+    while (!pSampler->m_fExit)
+    {
+        auto timestamp = PerceptionTimestampHelper::FromHistoricalTargetTime(winrt::clock::now());
+        RigidPose pose;
+        if (pSampler->TryLocate(timestamp, pose))
+        {
+            pSampler->m_cache.Add(static_cast<uint64_t>(timestamp.SystemRelativeTargetTime().count()), pose);
+        }
+#if DBG_ENABLE_VERBOSE_LOGGING
+        else
+        {
+            OutputDebugStringW(L"RigPoseSampler::SamplingThread: Can't locate rig.\n");
+        }
+#endif
+
+        // a steady rate, without drifting by the time the query takes
+        next += pSampler->m_samplePeriod;
+        std::this_thread::sleep_until(next);
+    }
+}
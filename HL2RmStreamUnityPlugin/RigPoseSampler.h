@@ -0,0 +1,56 @@
+#pragma once
+// Samples the pose of the rig node at a steady rate into a PoseCache, so that
+// the streams of all rig-mounted cameras look their poses up there instead of
+// querying the locator for every frame. Timestamps are system relative 100 ns
+// ticks, the time base of the research mode HostTicks.
+class RigPoseSampler
+{
+public:
+	static const uint32_t kDefaultSampleRate = 60;
+
+	RigPoseSampler(
+		const GUID& rigNodeId,
+		const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& worldCoordSystem,
+		uint32_t sampleRate = kDefaultSampleRate,
+		const PoseCacheSettings& cacheSettings = PoseCacheSettings());
+
+	virtual ~RigPoseSampler()
+	{
+		Stop();
+	}
+
+	void Start();
+
+	void Stop();
+
+	// Rig to world at timestamp. Interpolates the cached samples; past the newest
+	// sample the locator is asked directly and, if it cannot answer, the newest
+	// sample is held for a short while. Returns false if there is no pose.
+	bool TryGetRigToWorld(
+		long long timestamp,
+		winrt::Windows::Foundation::Numerics::float4x4& rig2world);
+
+	// coordinate system of the rig node, for extrinsics of other cameras
+	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem RigCoordinateSystem() const { return m_rigCoordSystem; }
+
+	PoseCacheStatistics GetStatistics() const { return m_cache.Statistics(); }
+
+	bool isRunning = false;
+
+private:
+	static void SamplingThread(RigPoseSampler* pSampler);
+
+	bool TryLocate(
+		const winrt::Windows::Perception::PerceptionTimestamp& timestamp,
+		RigidPose& pose);
+
+	winrt::Windows::Perception::Spatial::SpatialLocator m_locator = nullptr;
+	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_rigCoordSystem = nullptr;
+	winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
+
+	PoseCache m_cache;
+	std::chrono::microseconds m_samplePeriod;
+
+	std::atomic<bool> m_fExit{ false };
+	std::thread m_samplingThread;
+};
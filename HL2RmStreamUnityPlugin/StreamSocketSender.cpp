@@ -0,0 +1,558 @@
+#include "pch.h"
+
+#define DBG_ENABLE_VERBOSE_LOGGING 0
+#define DBG_ENABLE_INFO_LOGGING 1
+#define DBG_ENABLE_ERROR_LOGGING 1
+
+using namespace winrt::Windows::Foundation;
+using namespace winrt::Windows::Networking::Sockets;
+using namespace winrt::Windows::Storage::Streams;
+
+StreamSocketSender::StreamSocketSender(
+    const SendQueueSettings& queueSettings) :
+    m_queueSettings(queueSettings)
+{
+}
+
+bool StreamSocketSender::AddSubscriber(StreamSocket socket)
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    RemoveLostSubscribers();
+    if (m_subscribers.size() >= kMaxSubscribers)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        OutputDebugStringW(L"StreamSocketSender::AddSubscriber: Too many subscribers.\n");
+#endif
+        return false;
+    }
+    auto subscriber = std::make_shared<Subscriber>(socket, m_queueSettings);
+    subscriber->ReceiveRequests(m_supportedCodecs, m_pStreamControl);
+    m_subscribers.push_back(subscriber);
+    return true;
+}
+
+winrt::Windows::Foundation::IAsyncAction StreamSocketSender::EnableDatagrams(
+    std::wstring serviceName,
+    DatagramSettings settings)
+{
+    try
+    {
+        m_datagramSettings = settings;
+        m_datagramSocket = DatagramSocket();
+        m_datagramSocket.MessageReceived({ this, &StreamSocketSender::OnDatagramReceived });
+        co_await m_datagramSocket.BindServiceNameAsync(serviceName);
+#if DBG_ENABLE_INFO_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamSocketSender::EnableDatagrams: Taking datagram subscribers at %ls.\n",
+            serviceName.c_str());
+        OutputDebugStringW(msgBuffer);
+#endif
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamSocketSender::EnableDatagrams: Failed to open datagram socket at %ls with %d.\n",
+            serviceName.c_str(), (int)SocketError::GetStatus(ex.to_abi()));
+        OutputDebugStringW(msgBuffer);
+#endif
+    }
+}
+
+winrt::fire_and_forget StreamSocketSender::OnDatagramReceived(
+    DatagramSocket /* sender */,
+    DatagramSocketMessageReceivedEventArgs args)
+{
+    try
+    {
+        // a datagram is a whole message, so only as much of it as the sender reads
+        DataReader reader = args.GetDataReader();
+        uint8_t datagram[sizeof(MessageHeader) + sizeof(StreamControlHeader)] = {};
+        const uint32_t size = std::min<uint32_t>(reader.UnconsumedBufferLength(), sizeof(datagram));
+        if (size < sizeof(MessageHeader))
+        {
+            return;
+        }
+        reader.ReadBytes(winrt::array_view<uint8_t>(datagram, size));
+        MessageHeader request;
+        memcpy(&request, datagram, sizeof(request));
+        if (!request.IsValid())
+        {
+            return;
+        }
+        StreamControlHeader control{};
+        if (request.HeaderSize >= sizeof(MessageHeader) + sizeof(StreamControlHeader) && size == sizeof(datagram))
+        {
+            memcpy(&control, datagram + sizeof(MessageHeader), sizeof(control));
+        }
+        const bool subscribe = request.MessageType == static_cast<uint16_t>(MessageType::Subscribe);
+        SubscribeHeader subscription{};
+        const bool hasSubscription = subscribe &&
+            request.HeaderSize >= sizeof(MessageHeader) + sizeof(SubscribeHeader) &&
+            size >= sizeof(MessageHeader) + sizeof(SubscribeHeader);
+        if (hasSubscription)
+        {
+            memcpy(&subscription, datagram + sizeof(MessageHeader), sizeof(subscription));
+        }
+
+        const std::wstring address = std::wstring(args.RemoteAddress().CanonicalName()) + L":" +
+            std::wstring(args.RemotePort());
+        std::shared_ptr<Subscriber> subscriber;
+        {
+            std::lock_guard<std::mutex> guard(m_subscribersMutex);
+            RemoveLostSubscribers();
+            subscriber = FindDatagramSubscriber(address);
+        }
+        if (!subscriber)
+        {
+            // anything else from an unknown sender, e.g. a stray or spoofed
+            // datagram, would hold a subscriber slot until it times out
+            if (!subscribe)
+            {
+                co_return;
+            }
+            IOutputStream output = co_await m_datagramSocket.GetOutputStreamAsync(args.RemoteAddress(), args.RemotePort());
+            std::lock_guard<std::mutex> guard(m_subscribersMutex);
+            // another Subscribe of the client may have got here first
+            subscriber = FindDatagramSubscriber(address);
+            if (!subscriber)
+            {
+                if (m_subscribers.size() >= kMaxSubscribers)
+                {
+#if DBG_ENABLE_ERROR_LOGGING
+                    OutputDebugStringW(L"StreamSocketSender::OnDatagramReceived: Too many subscribers.\n");
+#endif
+                    co_return;
+                }
+                subscriber = std::make_shared<Subscriber>(output, address, m_datagramSettings, m_queueSettings);
+                m_subscribers.push_back(subscriber);
+#if DBG_ENABLE_INFO_LOGGING
+                wchar_t msgBuffer[200];
+                swprintf_s(msgBuffer, L"StreamSocketSender::OnDatagramReceived: Datagram subscriber %ls.\n",
+                    address.c_str());
+                OutputDebugStringW(msgBuffer);
+#endif
+            }
+        }
+
+        const uint64_t now = MonotonicTicks();
+        std::shared_ptr<StreamControlRouter> streamControl;
+        {
+            std::lock_guard<std::mutex> guard(m_subscribersMutex);
+            subscriber->LastHeard = now;
+            streamControl = m_pStreamControl;
+        }
+        if (hasSubscription)
+        {
+            subscriber->Sessions.OnSubscribe(subscription, now);
+        }
+        subscriber->HandleRequest(request, control, m_supportedCodecs, streamControl);
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamSocketSender::OnDatagramReceived: Receiving failed with %d.\n",
+            (int)SocketError::GetStatus(ex.to_abi()));
+        OutputDebugStringW(msgBuffer);
+#endif
+    }
+}
+
+bool StreamSocketSender::IsConnected()
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    for (const auto& subscriber : m_subscribers)
+    {
+        if (!subscriber->ConnectionLost)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StreamSocketSender::SetSupportedCodecs(uint32_t codecs)
+{
+    m_supportedCodecs = codecs | CodecBit(DepthCodec::Raw);
+}
+
+uint32_t StreamSocketSender::RequestedCodecs()
+{
+    uint32_t codecs = 0;
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    for (const auto& subscriber : m_subscribers)
+    {
+        if (!subscriber->ConnectionLost)
+        {
+            codecs |= CodecBit(subscriber->Codec);
+        }
+    }
+    return codecs;
+}
+
+void StreamSocketSender::SetStreamControl(std::shared_ptr<StreamControlRouter> router)
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    m_pStreamControl = std::move(router);
+}
+
+void StreamSocketSender::SetSessionMessage(FrameBufferPtr message)
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    m_sessionMessage = std::move(message);
+}
+
+bool StreamSocketSender::Send(FrameBufferPtr frame, DepthCodec codec)
+{
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    FrameBufferPtr sessionMessage;
+    {
+        std::lock_guard<std::mutex> guard(m_subscribersMutex);
+        RemoveLostSubscribers();
+        subscribers = m_subscribers;
+        sessionMessage = m_sessionMessage;
+    }
+
+    bool queued = false;
+    for (const auto& subscriber : subscribers)
+    {
+        if (subscriber->Codec != codec)
+        {
+            continue;
+        }
+        // every queue holds a reference to the same buffer
+        if (subscriber->Queue.Push(frame, sessionMessage))
+        {
+            queued = true;
+            subscriber->PumpQueue();
+        }
+#if DBG_ENABLE_VERBOSE_LOGGING
+        else
+        {
+            OutputDebugStringW(L"StreamSocketSender::Send: Queue full, frame dropped.\n");
+        }
+#endif
+    }
+    return queued;
+}
+
+SendQueueStatistics StreamSocketSender::GetQueueStatistics() const
+{
+    std::lock_guard<std::mutex> guard(m_subscribersMutex);
+    SendQueueStatistics total = m_removedStatistics;
+    for (const auto& subscriber : m_subscribers)
+    {
+        const SendQueueStatistics statistics = subscriber->Queue.Statistics();
+        total.Queued += statistics.Queued;
+        total.Sent += statistics.Sent;
+        total.SentBytes += statistics.SentBytes;
+        total.Dropped += statistics.Dropped;
+        total.Pending += statistics.Pending;
+    }
+    return total;
+}
+
+std::shared_ptr<StreamSocketSender::Subscriber> StreamSocketSender::FindDatagramSubscriber(
+    const std::wstring& address) const
+{
+    for (const auto& subscriber : m_subscribers)
+    {
+        if (subscriber->Fragmenter && subscriber->Address == address)
+        {
+            return subscriber;
+        }
+    }
+    return nullptr;
+}
+
+void StreamSocketSender::RemoveLostSubscribers()
+{
+    const uint64_t now = MonotonicTicks();
+    const uint64_t timeout = m_datagramSettings.SubscriptionTimeoutMs * 10000ull;
+    auto keep = m_subscribers.begin();
+    for (auto& subscriber : m_subscribers)
+    {
+        if (subscriber->Fragmenter && !subscriber->ConnectionLost && now - subscriber->LastHeard > timeout)
+        {
+#if DBG_ENABLE_INFO_LOGGING
+            wchar_t msgBuffer[200];
+            swprintf_s(msgBuffer, L"StreamSocketSender::RemoveLostSubscribers: Datagram subscriber %ls timed out.\n",
+                subscriber->Address.c_str());
+            OutputDebugStringW(msgBuffer);
+#endif
+            subscriber->OnConnectionLost();
+        }
+        if (subscriber->ConnectionLost)
+        {
+            const SendQueueStatistics statistics = subscriber->Queue.Statistics();
+            m_removedStatistics.Queued += statistics.Queued;
+            m_removedStatistics.Sent += statistics.Sent;
+            m_removedStatistics.SentBytes += statistics.SentBytes;
+            m_removedStatistics.Dropped += statistics.Dropped;
+        }
+        else
+        {
+            *keep++ = std::move(subscriber);
+        }
+    }
+    m_subscribers.erase(keep, m_subscribers.end());
+}
+
+void StreamSocketSender::Subscriber::PumpQueue()
+{
+    while (!WriteInProgress.exchange(true))
+    {
+        FrameBufferPtr frame;
+        FrameBufferPtr session;
+        // replies go out ahead of the next frame
+        const bool reply = !ConnectionLost && Queue.TryPopReply(frame);
+        if (!reply && (ConnectionLost || !Queue.TryPop(frame, session)))
+        {
+            WriteInProgress = false;
+            // a frame pushed after TryPop but before the flag was cleared found the
+            // write in progress, so it is ours to send
+            if (!ConnectionLost && (Queue.Statistics().Pending > 0 || Queue.HasReplies()))
+            {
+                continue;
+            }
+            return;
+        }
+        // the session message goes out ahead of the first frame and again ahead
+        // of the first frame after it changed, or over UDP when the client
+        // reports it lost
+        if (Fragmenter ? !Sessions.NeedsSending(session) : (!session || session == SentSession))
+        {
+            session = nullptr;
+        }
+        else if (!Fragmenter)
+        {
+            SentSession = session;
+        }
+        if (Fragmenter)
+        {
+            WriteDatagrams(std::move(frame), std::move(session), reply);
+        }
+        else
+        {
+            Write(std::move(frame), std::move(session), reply);
+        }
+        return;
+    }
+}
+
+winrt::fire_and_forget StreamSocketSender::Subscriber::Write(
+    FrameBufferPtr frame,
+    FrameBufferPtr session,
+    bool reply)
+{
+    auto self = shared_from_this();
+    try
+    {
+        // Every write is a round trip through the socket, so a frame goes out in
+        // one. The frame is shared with the other subscribers, so it is copied,
+        // after the session message if there is one, into a buffer of this
+        // subscriber that keeps its memory, and the WriteTime goes into the copy.
+        const size_t sessionSize = session ? session->size() : 0;
+        const size_t bytes = sessionSize + frame->size();
+        WriteBuffer->resize(bytes);
+        if (session)
+        {
+            memcpy(WriteBuffer->data(), session->data(), sessionSize);
+            session = nullptr;
+        }
+        memcpy(WriteBuffer->data() + sessionSize, frame->data(), frame->size());
+        SetWriteTime(WriteBuffer->data() + sessionSize, frame->size(), MonotonicTicks());
+        // the frame can go back to its pool while the copy goes out
+        frame = nullptr;
+        co_await Output.WriteAsync(winrt::make<PooledBufferView>(WriteBuffer));
+        if (!reply)
+        {
+            Queue.MarkSent(bytes);
+        }
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamSocketSender::Write: Sending failed with %d.\n",
+            (int)SocketError::GetStatus(ex.to_abi()));
+        OutputDebugStringW(msgBuffer);
+#endif
+        OnConnectionLost();
+    }
+    WriteInProgress = false;
+    PumpQueue();
+}
+
+winrt::fire_and_forget StreamSocketSender::Subscriber::WriteDatagrams(
+    FrameBufferPtr frame,
+    FrameBufferPtr session,
+    bool reply)
+{
+    auto self = shared_from_this();
+    try
+    {
+        // A socket write takes one IBuffer, so every datagram is copied once,
+        // into a buffer that keeps its memory from one frame to the next.
+        Datagrams->clear();
+        DatagramSizes.clear();
+        auto gather = [this](const DatagramHeader& header, const uint8_t* pFragment, size_t size)
+        {
+            const size_t offset = Datagrams->size();
+            Datagrams->resize(offset + sizeof(header) + size);
+            memcpy(Datagrams->data() + offset, &header, sizeof(header));
+            memcpy(Datagrams->data() + offset + sizeof(header), pFragment, size);
+            DatagramSizes.push_back(static_cast<uint32_t>(sizeof(header) + size));
+            return true;
+        };
+        // the session message is left out of the statistics, as its datagrams
+        // leave faster than the link carries them
+        if (session)
+        {
+            Sessions.Sent(session, NextFrameId, MonotonicTicks());
+            Fragmenter->Fragment(NextFrameId++, session->data(), session->size(), 0, true, gather);
+            session = nullptr;
+        }
+        const size_t bytes = Fragmenter->Fragment(NextFrameId++, frame->data(), frame->size(), MonotonicTicks(), false, gather);
+        // the frame can go back to its pool while the datagrams go out
+        frame = nullptr;
+
+        size_t offset = 0;
+        for (const uint32_t size : DatagramSizes)
+        {
+            IBuffer datagram = winrt::make<PooledBufferView>(Datagrams, offset);
+            datagram.Length(size);
+            co_await Output.WriteAsync(datagram);
+            offset += size;
+        }
+        if (!reply)
+        {
+            Queue.MarkSent(bytes);
+        }
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        wchar_t msgBuffer[200];
+        swprintf_s(msgBuffer, L"StreamSocketSender::WriteDatagrams: Sending to %ls failed with %d.\n",
+            Address.c_str(), (int)SocketError::GetStatus(ex.to_abi()));
+        OutputDebugStringW(msgBuffer);
+#endif
+        // the client subscribes again with its next keep-alive
+        OnConnectionLost();
+    }
+    WriteInProgress = false;
+    PumpQueue();
+}
+
+winrt::fire_and_forget StreamSocketSender::Subscriber::ReceiveRequests(
+    uint32_t supportedCodecs,
+    std::shared_ptr<StreamControlRouter> streamControl)
+{
+    auto self = shared_from_this();
+    try
+    {
+        DataReader reader(Socket.InputStream());
+        reader.ByteOrder(ByteOrder::LittleEndian);
+        while (!ConnectionLost)
+        {
+            const uint32_t loaded = co_await reader.LoadAsync(sizeof(MessageHeader));
+            if (loaded < sizeof(MessageHeader))
+            {
+                // the client closed the connection
+                break;
+            }
+
+            MessageHeader request;
+            reader.ReadBytes(winrt::array_view<uint8_t>(
+                reinterpret_cast<uint8_t*>(&request), static_cast<uint32_t>(sizeof(request))));
+            if (!request.IsValid())
+            {
+                // there is no telling where the next message starts
+#if DBG_ENABLE_ERROR_LOGGING
+                OutputDebugStringW(L"StreamSocketSender::ReceiveRequests: Malformed message, closing connection.\n");
+#endif
+                break;
+            }
+
+            // a StreamControl message too short for its type header only asks for
+            // the state
+            StreamControlHeader control{};
+            uint32_t skipped = static_cast<uint32_t>(request.Size() - sizeof(MessageHeader));
+            if (request.MessageType == static_cast<uint16_t>(MessageType::StreamControl) &&
+                request.HeaderSize >= sizeof(MessageHeader) + sizeof(StreamControlHeader))
+            {
+                if (co_await reader.LoadAsync(sizeof(control)) < sizeof(control))
+                {
+                    break;
+                }
+                reader.ReadBytes(winrt::array_view<uint8_t>(
+                    reinterpret_cast<uint8_t*>(&control), static_cast<uint32_t>(sizeof(control))));
+                skipped -= static_cast<uint32_t>(sizeof(control));
+            }
+
+            // the rest of messages the sender does not take, or longer than it knows
+            if (skipped > 0)
+            {
+                if (co_await reader.LoadAsync(skipped) < skipped)
+                {
+                    break;
+                }
+                reader.ReadBuffer(skipped);
+            }
+            HandleRequest(request, control, supportedCodecs, streamControl);
+        }
+    }
+    catch (winrt::hresult_error const& ex)
+    {
+#if DBG_ENABLE_ERROR_LOGGING
+        winrt::hstring message = ex.message();
+        OutputDebugStringW(L"StreamSocketSender::ReceiveRequests: Receiving failed with ");
+        OutputDebugStringW(message.c_str());
+        OutputDebugStringW(L"\n");
+#endif
+    }
+    OnConnectionLost();
+}
+
+void StreamSocketSender::Subscriber::HandleRequest(
+    const MessageHeader& request,
+    const StreamControlHeader& control,
+    uint32_t supportedCodecs,
+    const std::shared_ptr<StreamControlRouter>& streamControl)
+{
+    if (request.MessageType == static_cast<uint16_t>(MessageType::StreamControl))
+    {
+        FrameBufferPtr reply = streamControl ?
+            streamControl->Apply(request.StreamId, control) :
+            StreamControlRouter::Serialize(request.StreamId, StreamControlHeader{});
+        // goes out ahead of the next frame, past a full queue
+        if (Queue.PushReply(std::move(reply)))
+        {
+            PumpQueue();
+        }
+        return;
+    }
+    if (request.MessageType != static_cast<uint16_t>(MessageType::CodecRequest))
+    {
+        return;
+    }
+
+    const bool supported = request.Codec < 32 &&
+        (supportedCodecs & CodecBit(static_cast<DepthCodec>(request.Codec)));
+    Codec = supported ? static_cast<DepthCodec>(request.Codec) : DepthCodec::Raw;
+#if DBG_ENABLE_VERBOSE_LOGGING
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"StreamSocketSender::HandleRequest: Codec %u requested, sending %u.\n",
+        request.Codec, static_cast<uint32_t>(Codec.load()));
+    OutputDebugStringW(msgBuffer);
+#endif
+}
+
+void StreamSocketSender::Subscriber::OnConnectionLost()
+{
+    ConnectionLost = true;
+    // the queue takes no more frames; the sender drops the subscriber on its next send
+    Queue.Close();
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+// IBuffer over a pooled frame buffer from offset on, so that a serialized frame
+// can be handed to IOutputStream::WriteAsync without going through a DataWriter.
+// The frame buffer goes back to its pool when the socket releases the IBuffer,
+// i.e. once the write has completed.
+struct PooledBufferView : winrt::implements<PooledBufferView,
+	winrt::Windows::Storage::Streams::IBuffer,
+	::Windows::Storage::Streams::IBufferByteAccess>
+{
+	explicit PooledBufferView(
+		FrameBufferPtr buffer,
+		size_t offset = 0) :
+		m_buffer(std::move(buffer)),
+		m_offset(offset),
+		m_length(static_cast<uint32_t>(m_buffer->size() - offset))
+	{
+	}
+
+	uint32_t Capacity() const { return static_cast<uint32_t>(m_buffer->size() - m_offset); }
+
+	uint32_t Length() const { return m_length; }
+
+	void Length(uint32_t value)
+	{
+		if (value > Capacity())
+		{
+			throw winrt::hresult_invalid_argument();
+		}
+		m_length = value;
+	}
+
+	HRESULT __stdcall Buffer(uint8_t** value) final
+	{
+		*value = m_buffer->data() + m_offset;
+		return S_OK;
+	}
+
+private:
+	FrameBufferPtr m_buffer;
+	size_t m_offset;
+	uint32_t m_length;
+};
+
+// Writes serialized frames to the subscribers of a streamer, e.g. a recorder and
+// a live viewer. Every subscriber has its own bounded FrameSendQueue that holds a
+// reference to the shared frame buffer, so a frame is serialized once however
+// many subscribers there are. Each frame goes out in one write of a copy, which
+// gets the WriteTime of the subscriber, and the completion of a frame
+// starts the next one for the same subscriber; a slow subscriber only loses its
+// own frames. Subscribers can ask for a codec with a MessageType::CodecRequest;
+// frames are then encoded once per codec in use.
+// MessageType::StreamControl requests go to the StreamControlRouter, and its reply
+// back to the subscriber ahead of the next frame, however full its queue is. With
+// EnableDatagrams clients can subscribe over UDP as well, see DatagramSettings;
+// they count against the same limit.
+class StreamSocketSender
+{
+public:
+	// subscribers beyond this are refused
+	static const uint32_t kMaxSubscribers = 4;
+
+	explicit StreamSocketSender(
+		const SendQueueSettings& queueSettings = SendQueueSettings());
+
+	// Returns false if the sender already has kMaxSubscribers subscribers.
+	bool AddSubscriber(
+		winrt::Windows::Networking::Sockets::StreamSocket socket);
+
+	// Also takes subscribers on the UDP port serviceName, the one of the
+	// listener. Call once, before subscribers arrive.
+	winrt::Windows::Foundation::IAsyncAction EnableDatagrams(
+		std::wstring serviceName,
+		DatagramSettings settings);
+
+	// true while at least one subscriber is connected or subscribed
+	bool IsConnected();
+
+	// Codecs subscribers may request, as a mask of CodecBit values. Raw is always
+	// supported.
+	void SetSupportedCodecs(
+		uint32_t codecs);
+
+	// codecs requested by the connected subscribers, as a mask of CodecBit values
+	uint32_t RequestedCodecs();
+
+	// Where StreamControl requests go; without a router they are answered with an
+	// empty state. Subscribers that are already connected keep the router they
+	// had.
+	void SetStreamControl(
+		std::shared_ptr<StreamControlRouter> router);
+
+	// Message every subscriber gets ahead of its first frame, e.g. the calibration
+	// of the camera. Frames sent from now on go with this message; subscribers
+	// that had another one get it again ahead of the first of them. nullptr sends
+	// none.
+	void SetSessionMessage(
+		FrameBufferPtr message);
+
+	// Queues a serialized frame for every subscriber that uses codec. Returns false
+	// if no subscriber took it.
+	bool Send(
+		FrameBufferPtr frame,
+		DepthCodec codec = DepthCodec::Raw);
+
+	// totals over all subscribers, including ones that have disconnected
+	SendQueueStatistics GetQueueStatistics() const;
+
+	const SendQueueSettings& QueueSettings() const { return m_queueSettings; }
+
+private:
+	struct Subscriber : std::enable_shared_from_this<Subscriber>
+	{
+		Subscriber(
+			winrt::Windows::Networking::Sockets::StreamSocket socket,
+			const SendQueueSettings& settings) :
+			Socket(socket),
+			Output(socket.OutputStream()),
+			Queue(settings)
+		{
+		}
+
+		// a datagram subscriber, output writing one datagram per write
+		Subscriber(
+			winrt::Windows::Storage::Streams::IOutputStream output,
+			std::wstring address,
+			const DatagramSettings& datagramSettings,
+			const SendQueueSettings& settings) :
+			Output(output),
+			Queue(settings),
+			Address(std::move(address)),
+			Fragmenter(std::make_unique<FrameFragmenter>(datagramSettings)),
+			Sessions(datagramSettings)
+		{
+		}
+
+		// Starts writing the next queued frame unless a write is in flight.
+		void PumpQueue();
+
+		// Writes session, if not nullptr, and a copy of frame with its WriteTime in
+		// one write and, once they are out, pumps the queue again. A reply to a
+		// request is not counted in the queue statistics.
+		winrt::fire_and_forget Write(
+			FrameBufferPtr frame,
+			FrameBufferPtr session,
+			bool reply);
+
+		// Write for a datagram subscriber: the datagrams of both messages are
+		// gathered in one buffer and written one after the other.
+		winrt::fire_and_forget WriteDatagrams(
+			FrameBufferPtr frame,
+			FrameBufferPtr session,
+			bool reply);
+
+		// Reads codec and stream control requests until the client disconnects.
+		winrt::fire_and_forget ReceiveRequests(
+			uint32_t supportedCodecs,
+			std::shared_ptr<StreamControlRouter> streamControl);
+
+		// Acts on a message of the client, over either transport. control is only
+		// read for StreamControl requests.
+		void HandleRequest(
+			const MessageHeader& request,
+			const StreamControlHeader& control,
+			uint32_t supportedCodecs,
+			const std::shared_ptr<StreamControlRouter>& streamControl);
+
+		void OnConnectionLost();
+
+		// nullptr for a datagram subscriber
+		winrt::Windows::Networking::Sockets::StreamSocket Socket = nullptr;
+		winrt::Windows::Storage::Streams::IOutputStream Output;
+		FrameSendQueue Queue;
+		std::atomic<bool> WriteInProgress{ false };
+		std::atomic<bool> ConnectionLost{ false };
+		std::atomic<DepthCodec> Codec{ DepthCodec::Raw };
+		// the session message written last, only touched by the writer that holds
+		// WriteInProgress
+		FrameBufferPtr SentSession;
+		// the copy being written: the session message, if any, and the frame
+		FrameBufferPtr WriteBuffer = std::make_shared<std::vector<uint8_t>>();
+
+		// Datagram subscribers only. Address, the remote host and port, and
+		// LastHeard are only touched under m_subscribersMutex, the rest only by the
+		// writer that holds WriteInProgress.
+		std::wstring Address;
+		uint64_t LastHeard = 0;
+		std::unique_ptr<FrameFragmenter> Fragmenter;
+		// when the session message goes out again; takes the reports of the client
+		// from any thread
+		DatagramSessionTracker Sessions;
+		uint32_t NextFrameId = 0;
+		// the datagrams of the messages being written, one after the other
+		FrameBufferPtr Datagrams = std::make_shared<std::vector<uint8_t>>();
+		std::vector<uint32_t> DatagramSizes;
+	};
+
+	// Subscribes the sender of a MessageType::Subscribe, or keeps its
+	// subscription alive, and acts on the message a datagram of a subscriber
+	// holds.
+	winrt::fire_and_forget OnDatagramReceived(
+		winrt::Windows::Networking::Sockets::DatagramSocket /* sender */,
+		winrt::Windows::Networking::Sockets::DatagramSocketMessageReceivedEventArgs args);
+
+	// The datagram subscriber at address, the remote host and port, or nullptr.
+	// The caller holds m_subscribersMutex.
+	std::shared_ptr<Subscriber> FindDatagramSubscriber(
+		const std::wstring& address) const;
+
+	// Also drops datagram subscribers that timed out. The caller holds
+	// m_subscribersMutex.
+	void RemoveLostSubscribers();
+
+	const SendQueueSettings m_queueSettings;
+	std::atomic<uint32_t> m_supportedCodecs{ CodecBit(DepthCodec::Raw) };
+	mutable std::mutex m_subscribersMutex;
+	// in-flight writes keep their subscriber alive until they complete
+	std::vector<std::shared_ptr<Subscriber>> m_subscribers;
+	FrameBufferPtr m_sessionMessage;
+	std::shared_ptr<StreamControlRouter> m_pStreamControl;
+	// counters of subscribers that are gone
+	SendQueueStatistics m_removedStatistics;
+
+	DatagramSettings m_datagramSettings;
+	winrt::Windows::Networking::Sockets::DatagramSocket m_datagramSocket = nullptr;
+};
@@ -3,12 +3,39 @@
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::Media::Capture;
 using namespace winrt::Windows::Media::Capture::Frames;
+using namespace winrt::Windows::Media::MediaProperties;
 
-const int  VideoCameraFrameProcessor::kImageWidth = 640;
 const wchar_t  VideoCameraFrameProcessor::kSensorName[3] = L"PV";
 
+namespace
+{
+    // a profile description and where it comes from
+    struct ProfileDescription
+    {
+        MediaFrameSourceGroup SourceGroup = nullptr;
+        MediaCaptureVideoProfile Profile = nullptr;
+        MediaCaptureVideoProfileMediaDescription Description = nullptr;
+    };
+
+    CaptureProfile ToCaptureProfile(const MediaFrameFormat& format)
+    {
+        CaptureProfile profile;
+        profile.Width = format.VideoFormat().Width();
+        profile.Height = format.VideoFormat().Height();
+        const auto frameRate = format.FrameRate();
+        profile.FrameRate = frameRate.Denominator() ?
+            static_cast<double>(frameRate.Numerator()) / frameRate.Denominator() : 0.0;
+        // anything but NV12 is converted like BGRA
+        profile.PixelFormat = _wcsicmp(format.Subtype().c_str(), MediaEncodingSubtypes::Nv12().c_str()) == 0 ?
+            VideoPixelFormat::Nv12 : VideoPixelFormat::Bgra8;
+        return profile;
+    }
+}
+
 IAsyncAction VideoCameraFrameProcessor::InitializeAsync(
     std::shared_ptr<IVideoFrameSink> pFrameSink,
+    CaptureProfileRequest profileRequest,
+    KnownVideoProfile profileKind,
     long long minDelta)
 {
 #if DBG_ENABLE_INFO_LOGGING
@@ -16,22 +43,23 @@ IAsyncAction VideoCameraFrameProcessor::InitializeAsync(
 #endif
     m_pFrameSink = pFrameSink;
 
-    m_minDelta = minDelta;
+    SetMinDelta(minDelta);
 
     winrt::Windows::Foundation::Collections::IVectorView<MediaFrameSourceGroup>
         mediaFrameSourceGroups{ co_await MediaFrameSourceGroup::FindAllAsync() };
 
-    MediaFrameSourceGroup selectedSourceGroup = nullptr;
-    MediaCaptureVideoProfile profile = nullptr;
-    MediaCaptureVideoProfileMediaDescription desc = nullptr;
+    std::vector<ProfileDescription> descriptions;
+    std::vector<CaptureProfile> candidates;
     std::vector<MediaFrameSourceInfo> selectedSourceInfos;
 
-    // Find MediaFrameSourceGroup
+    // every description of the profiles of the requested kind, in every group
     for (const MediaFrameSourceGroup& mediaFrameSourceGroup : mediaFrameSourceGroups)
     {
-        auto knownProfiles = MediaCapture::FindKnownVideoProfiles(
-            mediaFrameSourceGroup.Id(),
-            KnownVideoProfile::VideoConferencing);
+        auto knownProfiles = MediaCapture::FindKnownVideoProfiles(mediaFrameSourceGroup.Id(), profileKind);
+        if (knownProfiles.Size() == 0)
+        {
+            knownProfiles = MediaCapture::FindAllVideoProfiles(mediaFrameSourceGroup.Id());
+        }
 
         for (const auto& knownProfile : knownProfiles)
         {
@@ -43,18 +71,22 @@ IAsyncAction VideoCameraFrameProcessor::InitializeAsync(
                     knownDesc.Width(), knownDesc.Height(), knownDesc.FrameRate());
                 OutputDebugStringW(msgBuffer);
 #endif
-                if ((knownDesc.Width() == kImageWidth)) // && (std::round(knownDesc.FrameRate()) == 15))
-                {
-                    profile = knownProfile;
-                    desc = knownDesc;
-                    selectedSourceGroup = mediaFrameSourceGroup;
-                    break;
-                }
+                CaptureProfile candidate;
+                candidate.Width = knownDesc.Width();
+                candidate.Height = knownDesc.Height();
+                candidate.FrameRate = knownDesc.FrameRate();
+                // the descriptions do not tell, the frame formats below do
+                candidate.PixelFormat = VideoFrameEncoder::CaptureFormatFor(profileRequest.PixelFormat);
+                candidates.push_back(candidate);
+                descriptions.push_back({ mediaFrameSourceGroup, knownProfile, knownDesc });
             }
         }
     }
 
-    winrt::check_bool(selectedSourceGroup != nullptr);
+    const size_t selected = SelectCaptureProfile(profileRequest, candidates);
+    winrt::check_bool(selected != SIZE_MAX);
+    const ProfileDescription& description = descriptions[selected];
+    MediaFrameSourceGroup selectedSourceGroup = description.SourceGroup;
 
     for (auto sourceInfo : selectedSourceGroup.SourceInfos())
     {
@@ -69,8 +101,8 @@ IAsyncAction VideoCameraFrameProcessor::InitializeAsync(
 
     // Initialize a MediaCapture object
     MediaCaptureInitializationSettings settings;
-    settings.VideoProfile(profile);
-    settings.RecordMediaDescription(desc);
+    settings.VideoProfile(description.Profile);
+    settings.RecordMediaDescription(description.Description);
     settings.VideoDeviceId(selectedSourceGroup.Id());
     settings.StreamingCaptureMode(StreamingCaptureMode::Video);
     settings.MemoryPreference(MediaCaptureMemoryPreference::Cpu);
@@ -80,19 +112,30 @@ IAsyncAction VideoCameraFrameProcessor::InitializeAsync(
     MediaCapture mediaCapture = MediaCapture();
     co_await mediaCapture.InitializeAsync(settings);
 
+    // the frame format of the sources closest to the selected description, in the
+    // capture format the wire format needs if there is a choice
+    CaptureProfileRequest formatRequest = profileRequest;
+    formatRequest.Width = candidates[selected].Width;
+    formatRequest.Height = candidates[selected].Height;
+    formatRequest.FrameRate = candidates[selected].FrameRate;
+
     MediaFrameSource selectedSource = nullptr;
     MediaFrameFormat preferredFormat = nullptr;
+    double bestScore = 0.0;
 
     for (MediaFrameSourceInfo sourceInfo : selectedSourceInfos)
     {
         auto tmpSource = mediaCapture.FrameSources().Lookup(sourceInfo.Id());
         for (MediaFrameFormat format : tmpSource.SupportedFormats())
         {
-            if (format.VideoFormat().Width() == kImageWidth)
+            const CaptureProfile formatProfile = ToCaptureProfile(format);
+            const double score = ScoreCaptureProfile(formatRequest, formatProfile);
+            if (!preferredFormat || score < bestScore)
             {
                 selectedSource = tmpSource;
                 preferredFormat = format;
-                break;
+                bestScore = score;
+                m_selectedProfile = formatProfile;
             }
         }
     }
@@ -103,13 +146,19 @@ IAsyncAction VideoCameraFrameProcessor::InitializeAsync(
     m_mediaFrameReader = co_await mediaCapture.CreateFrameReaderAsync(selectedSource);
 
 #if DBG_ENABLE_INFO_LOGGING
-    OutputDebugStringW(L"VideoCameraFrameProcessor::InitializeAsync: Done. \n");
+    wchar_t msgBuffer[200];
+    swprintf_s(msgBuffer, L"VideoCameraFrameProcessor::InitializeAsync: Asked for %ux%u at %.1f fps, capturing %ux%u at %.1f fps in %ls.\n",
+        profileRequest.Width, profileRequest.Height, profileRequest.FrameRate,
+        m_selectedProfile.Width, m_selectedProfile.Height, m_selectedProfile.FrameRate,
+        preferredFormat.Subtype().c_str());
+    OutputDebugStringW(msgBuffer);
 #endif
 }
 
 IAsyncAction VideoCameraFrameProcessor::StartAsync()
 {
     m_fExit = false;
+    m_frameMailbox.Reset();
 
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(L"VideoCameraFrameProcessor::StartAsync: Starting video frame acquisition...\n");
@@ -133,6 +182,7 @@ IAsyncAction VideoCameraFrameProcessor::StartAsync()
 void VideoCameraFrameProcessor::Stop()
 {
     m_fExit = true;
+    m_frameMailbox.Close();
 
     if (m_processThread.joinable())
     {
@@ -142,7 +192,7 @@ void VideoCameraFrameProcessor::Stop()
     // revoke registered delegate
     m_mediaFrameReader.FrameArrived(m_OnFrameArrivedRegistration);
 
-    m_latestFrame = nullptr;
+    m_frameMailbox.Reset();
 
     isRunning = false;
 }
@@ -153,8 +203,11 @@ void VideoCameraFrameProcessor::OnFrameArrived(
 {
     if (MediaFrameReference frame = sender.TryAcquireLatestFrame())
     {
-        std::lock_guard<std::shared_mutex> lock(m_frameMutex);
-        m_latestFrame = frame;
+        // never blocks the capture callback on the processing thread
+        ArrivedVideoFrame arrived;
+        arrived.Frame = frame;
+        arrived.Sequence = m_sequence++;
+        m_frameMailbox.Publish(std::move(arrived));
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"VideoCameraFrameProcessor::OnFrameArrived: Updated frame.\n");
 #endif
@@ -168,21 +221,26 @@ void VideoCameraFrameProcessor::FrameProcesingThread(VideoCameraFrameProcessor*
 #endif
     while (!pProcessor->m_fExit)
     {
-        std::lock_guard<std::shared_mutex> reader_guard(pProcessor->m_frameMutex);
-        if (pProcessor->m_latestFrame)
+        // sleep until OnFrameArrived publishes a new frame
+        ArrivedVideoFrame arrived;
+        if (!pProcessor->m_frameMailbox.WaitForFrame(arrived, 100) || !arrived.Frame)
         {
-            MediaFrameReference frame = pProcessor->m_latestFrame;
-            long long timestamp = pProcessor->m_converter.RelativeTicksToAbsoluteTicks(
-                HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
-            if (timestamp != pProcessor->m_latestTimestamp)
-            {
-                long long delta = timestamp - pProcessor->m_latestTimestamp;
-                if (delta > pProcessor->m_minDelta)
-                {
-                    pProcessor->m_latestTimestamp = timestamp;
-                    pProcessor->m_pFrameSink->Send(frame, timestamp);
-                }
-            }
+            continue;
+        }
+        const MediaFrameReference& frame = arrived.Frame;
+
+        FrameTrace trace;
+        trace.Sequence = arrived.Sequence;
+        trace.CaptureTime = static_cast<uint64_t>(frame.SystemRelativeTime().Value().count());
+        trace.DequeueTime = MonotonicTicks();
+        long long timestamp = pProcessor->m_converter.RelativeTicksToAbsoluteTicks(
+            HundredsOfNanoseconds(frame.SystemRelativeTime().Value().count())).count();
+        if (pProcessor->m_enabled &&
+            timestamp != pProcessor->m_latestTimestamp &&
+            pProcessor->m_pacer.Accept(static_cast<uint64_t>(timestamp)))
+        {
+            pProcessor->m_latestTimestamp = timestamp;
+            pProcessor->m_pFrameSink->Send(frame, timestamp, trace);
         }
     }
 }
@@ -1,10 +1,20 @@
 #pragma once
+
+// A frame as OnFrameArrived got it from the reader.
+struct ArrivedVideoFrame
+{
+	winrt::Windows::Media::Capture::Frames::MediaFrameReference Frame = nullptr;
+	// frames that arrived before this one
+	uint32_t Sequence = 0;
+};
+
 class VideoCameraFrameProcessor
 {
 public:
 	virtual ~VideoCameraFrameProcessor()
 	{
 		m_fExit = true;
+		m_frameMailbox.Close();
 
 		if (m_processThread.joinable())
 		{
@@ -15,14 +25,44 @@ public:
 		m_mediaFrameReader.FrameArrived(m_OnFrameArrivedRegistration);
 	}
 
+	// Captures with the description of the profiles of kind profileKind that is
+	// closest to profileRequest (see SelectCaptureProfile), or of all profiles of
+	// the camera if it has none of that kind. Frames are paced to one per minDelta
+	// ticks, see FramePacer; 0 sends all of them.
 	winrt::Windows::Foundation::IAsyncAction InitializeAsync(
 		std::shared_ptr<IVideoFrameSink> pFrameSink,
+		CaptureProfileRequest profileRequest = CaptureProfileRequest(),
+		winrt::Windows::Media::Capture::KnownVideoProfile profileKind =
+			winrt::Windows::Media::Capture::KnownVideoProfile::VideoConferencing,
 		long long minDelta = 0);
 
 	winrt::Windows::Foundation::IAsyncAction StartAsync();
 
 	void Stop();
 
+	MailboxStatistics GetFrameStatistics() const
+	{
+		return m_frameMailbox.Statistics();
+	}
+
+	// Changes the pacing of the frames while streaming, e.g. by a RateController.
+	void SetMinDelta(long long minDelta)
+	{
+		m_pacer.SetInterval(static_cast<uint64_t>(std::max(0LL, minDelta)));
+	}
+
+	long long MinDelta() const { return static_cast<long long>(m_pacer.Interval()); }
+
+	// Stops handing frames to the sink, or resumes it, from the next frame on.
+	// The capture keeps running, so frames resume right away; the ones in between
+	// still count in the sequence numbers. May be called from any thread.
+	void SetEnabled(bool enabled) { m_enabled = enabled; }
+
+	bool IsEnabled() const { return m_enabled; }
+
+	// the format the camera captures in, once InitializeAsync completed
+	CaptureProfile SelectedProfile() const { return m_selectedProfile; }
+
 	bool isRunning = false;
 
 protected:
@@ -37,20 +77,25 @@ private:
 
 	std::shared_ptr<IVideoFrameSink> m_pFrameSink;
 
-	std::shared_mutex m_frameMutex;
+	// latest frame, handed from OnFrameArrived to the processing thread
+	LatestFrameMailbox<ArrivedVideoFrame> m_frameMailbox;
+	// frames that arrived so far, only touched by OnFrameArrived
+	uint32_t m_sequence = 0;
 	long long m_latestTimestamp = 0;
-	winrt::Windows::Media::Capture::Frames::MediaFrameReference m_latestFrame = nullptr;
 	winrt::Windows::Media::Capture::Frames::MediaFrameReader m_mediaFrameReader = nullptr;
 	winrt::event_token m_OnFrameArrivedRegistration;
 
-	bool m_fExit = false;
+	std::atomic<bool> m_fExit{ false };
 
 	TimeConverter m_converter;
 	std::thread m_processThread;
 
-	long long m_minDelta;
+	// only Accept is restricted to the processing thread
+	FramePacer m_pacer;
+	std::atomic<bool> m_enabled{ true };
+
+	CaptureProfile m_selectedProfile;
 
-	static const int kImageWidth;
 	static const wchar_t kSensorName[3];
 };
 
@@ -19,15 +19,35 @@ using namespace winrt::Windows::Storage::Streams;
 
 VideoCameraStreamer::VideoCameraStreamer(
     const SpatialCoordinateSystem& coordSystem,
-    std::wstring portName)
+    std::wstring portName,
+    int scaleFactor,
+    VideoPixelFormat pixelFormat,
+    const SendQueueSettings& queueSettings,
+    std::shared_ptr<RigPoseSampler> poseSampler) :
+    m_scaleFactor(scaleFactor),
+    m_pixelFormat(pixelFormat),
+    // serialized frames are shared by the queues of all subscribers and may be
+    // held by a synchronizer
+    m_wireBuffers(SendQueueBufferCount(queueSettings, StreamSocketSender::kMaxSubscribers) +
+        FrameSynchronizer::kMaxBufferedFrames),
+    m_sender(queueSettings)
 {
     m_worldCoordSystem = coordSystem;
+    m_pPoseSampler = std::move(poseSampler);
     m_portName = portName;
 
     StartServer();
     // m_streamingEnabled = true;
 }
 
+void VideoCameraStreamer::SetEncoding(
+    int scaleFactor,
+    VideoPixelFormat pixelFormat)
+{
+    m_scaleFactor = scaleFactor;
+    m_pixelFormat = pixelFormat;
+}
+
 IAsyncAction VideoCameraStreamer::StartServer()
 {
     try
@@ -67,12 +87,10 @@ void VideoCameraStreamer::OnConnectionReceived(
 {
     try
     {
-        m_streamSocket = args.Socket();
-        m_writer = DataWriter(args.Socket().OutputStream());
-        m_writer.UnicodeEncoding(UnicodeEncoding::Utf8);
-        m_writer.ByteOrder(ByteOrder::LittleEndian);
-
-        m_writeInProgress = false;
+        if (!m_sender.AddSubscriber(args.Socket()))
+        {
+            return;
+        }
         isConnected = true;
 #if DBG_ENABLE_INFO_LOGGING
         OutputDebugStringW(L"VideoCameraStreamer::OnConnectionReceived: Received connection! \n");
@@ -94,12 +112,14 @@ void VideoCameraStreamer::OnConnectionReceived(
 
 void VideoCameraStreamer::Send(
     MediaFrameReference pFrame,
-    long long pTimestamp)
+    long long pTimestamp,
+    const FrameTrace& trace)
 {
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Received frame for sending!\n");
 #endif
-    if (!m_streamSocket || !m_writer)
+    const bool synchronizing = m_pSynchronizer && m_pSynchronizer->IsActive();
+    if (!m_sender.IsConnected() && !synchronizing && !m_pLocalFrames)
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(
@@ -110,17 +130,10 @@ void VideoCameraStreamer::Send(
 
 
     // grab the frame info
-    float fx = pFrame.VideoMediaFrame().CameraIntrinsics().FocalLength().x;
-    float fy = pFrame.VideoMediaFrame().CameraIntrinsics().FocalLength().y;
+    auto intrinsics = pFrame.VideoMediaFrame().CameraIntrinsics();
 
     winrt::Windows::Foundation::Numerics::float4x4 PVtoWorldtransform;
-    auto PVtoWorld =
-        pFrame.CoordinateSystem().TryGetTransformTo(m_worldCoordSystem);
-    if (PVtoWorld)
-    {
-        PVtoWorldtransform = PVtoWorld.Value();
-    }
-    else
+    if (!TryGetPVToWorld(pFrame, PVtoWorldtransform))
     {
 #if DBG_ENABLE_VERBOSE_LOGGING
         OutputDebugStringW(L"Streamer::SendFrame: Could not locate frame.\n");
@@ -128,24 +141,26 @@ void VideoCameraStreamer::Send(
         return;
     }
 
-    // grab the frame data
-    SoftwareBitmap softwareBitmap = SoftwareBitmap::Convert(
-        pFrame.VideoMediaFrame().SoftwareBitmap(), BitmapPixelFormat::Bgra8);
-
-    int imageWidth = softwareBitmap.PixelWidth();
-    int imageHeight = softwareBitmap.PixelHeight();
+    m_encoder.scaleFactor = m_scaleFactor;
+    m_encoder.pixelFormat = m_pixelFormat;
 
-    int pixelStride = 4;
-    int scaleFactor = 1;
-
-    int rowStride = imageWidth * pixelStride;
+    // grab the frame data; the PV camera delivers NV12, so only BGR streaming
+    // needs a color conversion
+    const bool captureNv12 =
+        VideoFrameEncoder::CaptureFormatFor(m_encoder.pixelFormat) == VideoPixelFormat::Nv12;
+    const BitmapPixelFormat captureFormat = captureNv12 ? BitmapPixelFormat::Nv12 : BitmapPixelFormat::Bgra8;
+    SoftwareBitmap softwareBitmap = pFrame.VideoMediaFrame().SoftwareBitmap();
+    if (softwareBitmap.BitmapPixelFormat() != captureFormat)
+    {
+        softwareBitmap = SoftwareBitmap::Convert(softwareBitmap, captureFormat);
+    }
 
     // Get bitmap buffer object of the frame
     BitmapBuffer bitmapBuffer = softwareBitmap.LockBuffer(BitmapBufferAccessMode::Read);
 
     // Get raw pointer to the buffer object
     uint32_t pixelBufferDataLength = 0;
-    uint8_t* pixelBufferData;
+    uint8_t* pixelBufferData = nullptr;
 
     auto spMemoryBufferByteAccess{ bitmapBuffer.CreateReference()
         .as<::Windows::Foundation::IMemoryBufferByteAccess>() };
@@ -166,92 +181,128 @@ void VideoCameraStreamer::Send(
 #endif
     }
 
-    std::vector<uint8_t> imageBufferAsVector;
-    for (int row = 0; row < imageHeight; row += scaleFactor)
+    if (!pixelBufferData)
     {
-        for (int col = 0; col < rowStride; col += scaleFactor * pixelStride)
-        {
-            for (int j = 0; j < pixelStride - 1; j++)
-            {
-                imageBufferAsVector.emplace_back(
-                    pixelBufferData[row * rowStride + col + j]);
-            }
-        }
+        return;
     }
 
+    BitmapPlaneDescription plane = bitmapBuffer.GetPlaneDescription(0);
 
-    if (m_writeInProgress)
+    VideoFrameView frameView;
+    frameView.PixelFormat = captureNv12 ? VideoPixelFormat::Nv12 : VideoPixelFormat::Bgra8;
+    frameView.pData = pixelBufferData + plane.StartIndex;
+    frameView.DataLength = pixelBufferDataLength - plane.StartIndex;
+    frameView.Width = softwareBitmap.PixelWidth();
+    frameView.Height = softwareBitmap.PixelHeight();
+    frameView.RowStride = plane.Stride;
+    if (captureNv12 && bitmapBuffer.GetPlaneCount() > 1)
     {
-#if DBG_ENABLE_VERBOSE_LOGGING
-        OutputDebugStringW(
-            L"VideoCameraStreamer::SendFrame: Write in progress.\n");
-#endif
-        return;
+        BitmapPlaneDescription chromaPlane = bitmapBuffer.GetPlaneDescription(1);
+        frameView.pChroma = pixelBufferData + chromaPlane.StartIndex;
+        frameView.ChromaDataLength = pixelBufferDataLength - chromaPlane.StartIndex;
+        frameView.ChromaRowStride = chromaPlane.Stride;
     }
-    m_writeInProgress = true;
-    try
+    frameView.Timestamp = pTimestamp;
+    frameView.Fx = intrinsics.FocalLength().x;
+    frameView.Fy = intrinsics.FocalLength().y;
+    frameView.Cx = intrinsics.PrincipalPoint().x;
+    frameView.Cy = intrinsics.PrincipalPoint().y;
+    const auto radialDistortion = intrinsics.RadialDistortion();
+    frameView.RadialDistortion[0] = radialDistortion.x;
+    frameView.RadialDistortion[1] = radialDistortion.y;
+    frameView.RadialDistortion[2] = radialDistortion.z;
+    const auto tangentialDistortion = intrinsics.TangentialDistortion();
+    frameView.TangentialDistortion[0] = tangentialDistortion.x;
+    frameView.TangentialDistortion[1] = tangentialDistortion.y;
+    if (m_hasPVtoRig)
     {
-        // Write header
-        m_writer.WriteUInt64(pTimestamp);
-        m_writer.WriteInt32(imageWidth);
-        m_writer.WriteInt32(imageHeight);
-        m_writer.WriteInt32(pixelStride - 1);
-        m_writer.WriteInt32(imageWidth * (pixelStride - 1)); // adapted row stride
-        m_writer.WriteSingle(fx);
-        m_writer.WriteSingle(fy);
-
-        WriteMatrix4x4(PVtoWorldtransform);
-
-        m_writer.WriteBytes(imageBufferAsVector);
-        m_writer.StoreAsync();
+        frameView.PVtoRig = Float4x4::From(m_PVtoRig);
     }
-    catch (winrt::hresult_error const& ex)
+    frameView.Trace = trace;
+
+    if (m_pLocalFrames)
     {
-        SocketErrorStatus webErrorStatus{ SocketError::GetStatus(ex.to_abi()) };
-        if (webErrorStatus == SocketErrorStatus::ConnectionResetByPeer)
+        m_pLocalFrames->PublishVideo(frameView, static_cast<uint64_t>(pTimestamp), Float4x4::From(PVtoWorldtransform));
+        if (!m_sender.IsConnected() && !synchronizing)
         {
-            // the client disconnected!
-            m_writer == nullptr;
-            m_streamSocket == nullptr;
-            m_writeInProgress = false;
+            return;
         }
-#if DBG_ENABLE_ERROR_LOGGING
-        winrt::hstring message = ex.message();
-        OutputDebugStringW(L"VideoCameraStreamer::SendFrame: Sending failed with ");
-        OutputDebugStringW(message.c_str());
-        OutputDebugStringW(L"\n");
-#endif // DBG_ENABLE_ERROR_LOGGING
     }
 
-    m_writeInProgress = false;
+    FrameBufferPtr payload = m_bufferPool.Acquire();
+    if (!payload)
+    {
+        return;
+    }
+    VideoFrameHeader header;
+    if (!m_encoder.Encode(frameView, header, *payload))
+    {
+        return;
+    }
+
+    header.PVtoWorld = Float4x4::From(PVtoWorldtransform);
+
+    // a new calibration goes with this frame and the ones after it
+    FrameBufferPtr calibration = m_encoder.Calibration(frameView);
+    if (calibration != m_calibration)
+    {
+        m_calibration = calibration;
+        m_sender.SetSessionMessage(calibration);
+    }
+
+    // header and pixels go out as one buffer in a single write
+    m_message.SetHeader(StreamId::PhotoVideo, static_cast<uint32_t>(m_encoder.pixelFormat), header);
+    m_message.SetTrace(frameView.Trace);
+    m_message.AddPayload(payload);
+    FrameBufferPtr wire = m_message.Serialize(m_wireBuffers);
+    m_message.Clear();
+    if (wire && synchronizing)
+    {
+        m_pSynchronizer->AddVideo(header.Timestamp, wire);
+    }
+    if (!wire || !m_sender.Send(std::move(wire)))
+    {
+#if DBG_ENABLE_VERBOSE_LOGGING
+        OutputDebugStringW(
+            L"VideoCameraStreamer::SendFrame: Frame dropped.\n");
+#endif
+        return;
+    }
 
 #if DBG_ENABLE_VERBOSE_LOGGING
     OutputDebugStringW(
-        L"VideoCameraStreamer::SendFrame: Frame sent!\n");
+        L"VideoCameraStreamer::SendFrame: Frame queued!\n");
 #endif
 
 }
 
-void VideoCameraStreamer::WriteMatrix4x4(
-    _In_ winrt::Windows::Foundation::Numerics::float4x4 matrix)
+bool VideoCameraStreamer::TryGetPVToWorld(
+    const MediaFrameReference& frame,
+    winrt::Windows::Foundation::Numerics::float4x4& PVtoWorld)
 {
-    m_writer.WriteSingle(matrix.m11);
-    m_writer.WriteSingle(matrix.m12);
-    m_writer.WriteSingle(matrix.m13);
-    m_writer.WriteSingle(matrix.m14);
-
-    m_writer.WriteSingle(matrix.m21);
-    m_writer.WriteSingle(matrix.m22);
-    m_writer.WriteSingle(matrix.m23);
-    m_writer.WriteSingle(matrix.m24);
-
-    m_writer.WriteSingle(matrix.m31);
-    m_writer.WriteSingle(matrix.m32);
-    m_writer.WriteSingle(matrix.m33);
-    m_writer.WriteSingle(matrix.m34);
-
-    m_writer.WriteSingle(matrix.m41);
-    m_writer.WriteSingle(matrix.m42);
-    m_writer.WriteSingle(matrix.m43);
-    m_writer.WriteSingle(matrix.m44);
+    if (m_pPoseSampler && !m_hasPVtoRig)
+    {
+        auto PVtoRig = frame.CoordinateSystem().TryGetTransformTo(m_pPoseSampler->RigCoordinateSystem());
+        if (PVtoRig)
+        {
+            m_PVtoRig = PVtoRig.Value();
+            m_hasPVtoRig = true;
+        }
+    }
+
+    winrt::Windows::Foundation::Numerics::float4x4 rig2world;
+    if (m_hasPVtoRig &&
+        m_pPoseSampler->TryGetRigToWorld(frame.SystemRelativeTime().Value().count(), rig2world))
+    {
+        PVtoWorld = m_PVtoRig * rig2world;
+        return true;
+    }
+
+    auto PVtoWorldReference = frame.CoordinateSystem().TryGetTransformTo(m_worldCoordSystem);
+    if (!PVtoWorldReference)
+    {
+        return false;
+    }
+    PVtoWorld = PVtoWorldReference.Value();
+    return true;
 }
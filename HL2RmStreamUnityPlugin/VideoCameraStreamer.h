@@ -5,16 +5,55 @@ class VideoCameraStreamer : public IVideoFrameSink
 public:
     VideoCameraStreamer(
         const winrt::Windows::Perception::Spatial::SpatialCoordinateSystem& coordSystem,
-        std::wstring portName);
+        std::wstring portName,
+        int scaleFactor = 1,
+        VideoPixelFormat pixelFormat = VideoPixelFormat::Bgr8,
+        const SendQueueSettings& queueSettings = SendQueueSettings(),
+        std::shared_ptr<RigPoseSampler> poseSampler = nullptr);
 
     void Send(
         winrt::Windows::Media::Capture::Frames::MediaFrameReference pFrame,
-        long long pTimestamp);
+        long long pTimestamp,
+        const FrameTrace& trace);
+
+    // Changes decimation and wire format from the next frame on, e.g. by a
+    // RateController. May be called from any thread.
+    void SetEncoding(
+        int scaleFactor,
+        VideoPixelFormat pixelFormat);
+
+    int ScaleFactor() const { return m_scaleFactor; }
+
+    VideoPixelFormat PixelFormat() const { return m_pixelFormat; }
+
+    // Also hands every serialized frame to synchronizer while it is active, to be
+    // paired with the depth frames. Call before frames arrive.
+    void SetSynchronizer(std::shared_ptr<FrameSynchronizer> synchronizer) { m_pSynchronizer = std::move(synchronizer); }
+
+    // Also publishes the pixels of every frame to frames, as captured, for
+    // scripts in this process, whether or not anyone is connected. Call before
+    // frames arrive.
+    void SetLocalFrames(std::shared_ptr<LocalFrameExchange> frames) { m_pLocalFrames = std::move(frames); }
 
     // void StreamingToggle();
 public:
     bool isConnected = false;
 
+    // allocations of payload buffers, constant in steady state
+    FrameBufferPoolStatistics GetBufferStatistics() const { return m_bufferPool.Statistics(); }
+
+    FrameBufferPoolStatistics GetWireBufferStatistics() const { return m_wireBuffers.Statistics(); }
+
+    // Answers the StreamControl requests of the subscribers through router. Call
+    // before the first client connects.
+    void SetStreamControl(std::shared_ptr<StreamControlRouter> router) { m_sender.SetStreamControl(std::move(router)); }
+
+    // Also takes subscribers on the UDP port of the same number, see
+    // DatagramSettings. Call before the first client subscribes.
+    void EnableDatagrams(const DatagramSettings& settings) { m_sender.EnableDatagrams(m_portName, settings); }
+
+    SendQueueStatistics GetQueueStatistics() const { return m_sender.GetQueueStatistics(); }
+
 private:
     winrt::Windows::Foundation::IAsyncAction StartServer();
 
@@ -22,18 +61,36 @@ private:
         winrt::Windows::Networking::Sockets::StreamSocketListener /* sender */,
         winrt::Windows::Networking::Sockets::StreamSocketListenerConnectionReceivedEventArgs args);
 
-    void WriteMatrix4x4(
-        _In_ winrt::Windows::Foundation::Numerics::float4x4 matrix);
+    // PV to world from the cached rig pose once the PV to rig transform is known,
+    // else from the coordinate system of the frame
+    bool TryGetPVToWorld(
+        const winrt::Windows::Media::Capture::Frames::MediaFrameReference& frame,
+        winrt::Windows::Foundation::Numerics::float4x4& PVtoWorld);
 
     //bool m_streamingEnabled = true;
 
     TimeConverter m_converter;
+    VideoFrameEncoder m_encoder;
+    // what SetEncoding asked for, handed to m_encoder by Send
+    std::atomic<int> m_scaleFactor;
+    std::atomic<VideoPixelFormat> m_pixelFormat;
+    // encoded pixels; buffers grow only when the resolution does
+    FrameBufferPool m_bufferPool;
+    // serialized frames, held by the subscriber queues until they are written
+    FrameBufferPool m_wireBuffers;
+    std::shared_ptr<FrameSynchronizer> m_pSynchronizer;
+    std::shared_ptr<LocalFrameExchange> m_pLocalFrames;
 
     winrt::Windows::Perception::Spatial::SpatialCoordinateSystem m_worldCoordSystem = nullptr;
+    std::shared_ptr<RigPoseSampler> m_pPoseSampler;
+    // the PV camera is rigidly mounted, so this is queried only once
+    winrt::Windows::Foundation::Numerics::float4x4 m_PVtoRig;
+    bool m_hasPVtoRig = false;
     winrt::Windows::Networking::Sockets::StreamSocketListener m_streamSocketListener;
-    winrt::Windows::Networking::Sockets::StreamSocket m_streamSocket = nullptr;
-    winrt::Windows::Storage::Streams::DataWriter m_writer = nullptr;
-    bool m_writeInProgress = false;
+    StreamSocketSender m_sender;
+    FrameMessage m_message;
+    // the session message of the sender
+    FrameBufferPtr m_calibration;
 
     std::wstring m_portName;
 };
\ No newline at end of file
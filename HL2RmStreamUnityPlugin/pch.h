@@ -8,11 +8,13 @@
 #include <wchar.h>
 #include <comdef.h>
 #include <MemoryBuffer.h>
+#include <robuffer.h>
 
 #include <deque>
 #include <queue>
 #include <codecvt>
 #include <chrono>
+#include <mutex>
 
 #include <Eigen>
 
@@ -25,14 +27,38 @@
 #include <winrt\Windows.Perception.Spatial.Preview.h>
 #include <winrt\Windows.Media.Capture.Frames.h>
 #include <winrt\Windows.Media.Devices.Core.h>
+#include <winrt\Windows.Media.MediaProperties.h>
 #include <winrt\Windows.Graphics.Imaging.h>
 
 #include "TimeConverter.h"
 #include "ResearchModeApi.h"
+#include "SensorConsent.h"
+#include "FrameTrace.h"
+#include "LatestFrameMailbox.h"
 #include "IResearchModeFrameSink.h"
 #include "IVideoFrameSink.h"
+#include "SensorScheduler.h"
+#include "FramePacer.h"
+#include "CaptureProfileSelector.h"
 #include "ResearchModeFrameProcessor.h"
+#include "ResearchModeFrameEncoder.h"
+#include "ImuFrameEncoder.h"
+#include "VideoFrameEncoder.h"
+#include "FrameBufferPool.h"
+#include "FrameMessage.h"
+#include "FrameSendQueue.h"
+#include "DatagramFraming.h"
+#include "LocalFrameExchange.h"
+#include "FrameSynchronizer.h"
+#include "PoseCache.h"
+#include "RateController.h"
+#include "RateControlLoop.h"
+#include "StreamControlRouter.h"
+#include "StreamSocketSender.h"
+#include "RigPoseSampler.h"
 #include "ResearchModeFrameStreamer.h"
+#include "ImuStreamer.h"
+#include "FusedFrameStreamer.h"
 #include "VideoCameraFrameProcessor.h"
 #include "VideoCameraStreamer.h"
 
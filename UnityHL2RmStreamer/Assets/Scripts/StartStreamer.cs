@@ -4,22 +4,257 @@ using UnityEngine;
 
 public class StartStreamer : MonoBehaviour
 {
+    // wire format of the PV stream, values match VideoPixelFormat of the plugin
+    public enum VideoPixelFormat
+    {
+        Bgr8 = 0,
+        Nv12 = 1,
+        Luma8 = 2
+    }
+
+    public VideoPixelFormat videoPixelFormat = VideoPixelFormat.Bgr8;
+
+    // PV capture profile; the camera captures the closest one it has, e.g.
+    // 1920x1080 at 15 fps for detail or 424x240 at 30 fps for the lowest latency.
+    // 0 leaves a value to the camera. Values of the kind match KnownVideoProfile.
+    public enum VideoProfileKind
+    {
+        VideoRecording = 0,
+        HighQualityPhoto = 1,
+        BalancedVideoAndPhoto = 2,
+        VideoConferencing = 3
+    }
+
+    public int pvWidth = 640;
+    public int pvHeight = 360;
+    public int pvFrameRate = 30;
+    public VideoProfileKind pvProfileKind = VideoProfileKind.VideoConferencing;
+
+    // what a stream does with new frames when its client falls behind, values
+    // match SendQueuePolicy of the plugin
+    public enum SendQueuePolicy
+    {
+        DropOldest = 0,
+        DropNewest = 1,
+        MaxAge = 2
+    }
+
+    public int sendQueueDepth = 2;
+    public SendQueuePolicy sendQueuePolicy = SendQueuePolicy.DropOldest;
+    public int sendQueueMaxAgeMs = 100;
+
+    // depth stream, values match ResearchModeSensorType; AHAT is streamed on
+    // port 23941, Long Throw on 23942
+    public enum DepthSensor
+    {
+        Ahat = 4,
+        LongThrow = 5
+    }
+
+    public DepthSensor depthSensor = DepthSensor.Ahat;
+    // append the active brightness image to every depth frame
+    public bool includeAb = false;
+
+    // visible light cameras, streamed on ports 23943 to 23946
+    public bool leftFrontCamera = false;
+    public bool leftLeftCamera = false;
+    public bool rightFrontCamera = false;
+    public bool rightRightCamera = false;
+
+    // pair PV and depth frames on the device and stream the pairs on port 23950
+    public bool syncRgbd = false;
+    public int syncToleranceMs = 15;
+    // compress the depth of the pairs with RVL
+    public bool syncRvlDepth = false;
+
+    // IMU sensors, streamed on ports 23947 to 23949 in batches of samples
+    public bool accelerometer = false;
+    public bool gyroscope = false;
+    public bool magnetometer = false;
+
+    // worker threads shared by the depth and visible light sensors; 0 starts one
+    // per enabled sensor plus one, fewer make the sensors wait for each other and
+    // drop frames
+    public int sensorWorkers = 0;
+
+    // adapt the frame rate of the camera streams, and decimation and pixel format
+    // of PV, to what the link carries, down to one frame per rateMaxIntervalMs, a
+    // PV image of 1/rateMaxDecimation the size and rateCheapestPixelFormat
+    public bool adaptiveRate = false;
+    public int ratePeriodMs = 500;
+    public int rateMaxIntervalMs = 500;
+    public int rateMaxDecimation = 4;
+    public VideoPixelFormat rateCheapestPixelFormat = VideoPixelFormat.Luma8;
+
+    // also stream over UDP to clients that subscribe on the UDP port of a stream,
+    // in datagrams of datagramSize bytes with a parity datagram after every
+    // datagramParityGroup of them (0 for none)
+    public bool datagramTransport = false;
+    public int datagramSize = 1400;
+    public int datagramParityGroup = 8;
+
+    // keep the latest PV and depth frame in native memory for this app; Update
+    // copies every new one into pvTexture (BGRA captures only, i.e. the Bgr8 wire
+    // format) and depthTexture (the depth plane, 16 bit millimetres) without a
+    // socket in between
+    public bool localPvFrames = false;
+    public bool localDepthFrames = false;
+    public Texture2D pvTexture;
+    public Texture2D depthTexture;
+
+    // StreamId of the PV stream; research mode streams go by their sensor type
+    const int PhotoVideoStream = 0x100;
+
+    // mirrors LocalFrame of the plugin
+    [StructLayout(LayoutKind.Sequential)]
+    public struct LocalFrame
+    {
+        // valid until ReleaseLocalFrame
+        public IntPtr data;
+        public uint size;
+        // LocalFrameFormat: 0 BGRA, 1 NV12, 2 8 bit gray, 3 depth, 4 depth and AB
+        public uint format;
+        public uint width;
+        public uint height;
+        public uint rowStride;
+        public uint sequence;
+        // 100 ns ticks, as in the frame headers of the stream
+        public ulong timestamp;
+        // camera or rig to world, row-major in the row vector convention
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 16)]
+        public float[] pose;
+    }
+
+    bool hasPvFrame = false;
+    uint pvSequence = 0;
+    bool hasDepthFrame = false;
+    uint depthSequence = 0;
+
 #if ENABLE_WINMD_SUPPORT
     [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "Initialize", CallingConvention = CallingConvention.StdCall)]
     public static extern void InitializeDll();
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetVideoPixelFormat")]
+    public static extern void SetVideoPixelFormat(int pixelFormat);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetVideoCaptureProfile")]
+    public static extern void SetVideoCaptureProfile(int width, int height, int frameRate, int profileKind);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "GetVideoCaptureProfile")]
+    public static extern int GetVideoCaptureProfile(out int width, out int height, out float frameRate);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetSendQueue")]
+    public static extern void SetSendQueue(int depth, int policy, int maxAgeMs);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetDepthSensor")]
+    public static extern void SetDepthSensor(int sensorType, int includeAb);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetVisibleLightCameras")]
+    public static extern void SetVisibleLightCameras(int cameraMask);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetSensorWorkers")]
+    public static extern void SetSensorWorkers(int workerCount);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetImuSensors")]
+    public static extern void SetImuSensors(int sensorMask);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetFrameSync")]
+    public static extern void SetFrameSync(int enabled, int toleranceMs, int codec);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetRateControl")]
+    public static extern void SetRateControl(int enabled, int periodMs, int maxIntervalMs, int maxDecimation, int cheapestPixelFormat);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetDatagramTransport")]
+    public static extern void SetDatagramTransport(int enabled, int datagramSize, int parityGroupSize);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "SetLocalFrameAccess")]
+    public static extern void SetLocalFrameAccess(int streamMask);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "AcquireLocalFrame")]
+    public static extern int AcquireLocalFrame(int streamId, out LocalFrame frame);
+
+    [DllImport("HL2RmStreamUnityPlugin", EntryPoint = "ReleaseLocalFrame")]
+    public static extern void ReleaseLocalFrame(int streamId);
 #endif
 
     // Start is called before the first frame update
     void Start()
     {
 #if ENABLE_WINMD_SUPPORT
+        SetVideoPixelFormat((int)videoPixelFormat);
+        SetVideoCaptureProfile(pvWidth, pvHeight, pvFrameRate, (int)pvProfileKind);
+        SetSendQueue(sendQueueDepth, (int)sendQueuePolicy, sendQueueMaxAgeMs);
+        SetDepthSensor((int)depthSensor, includeAb ? 1 : 0);
+        SetVisibleLightCameras(
+            (leftFrontCamera ? 1 : 0) | (leftLeftCamera ? 2 : 0) |
+            (rightFrontCamera ? 4 : 0) | (rightRightCamera ? 8 : 0));
+        SetImuSensors((accelerometer ? 1 : 0) | (gyroscope ? 2 : 0) | (magnetometer ? 4 : 0));
+        SetSensorWorkers(sensorWorkers);
+        SetFrameSync(syncRgbd ? 1 : 0, syncToleranceMs, syncRvlDepth ? 1 : 0);
+        SetRateControl(adaptiveRate ? 1 : 0, ratePeriodMs, rateMaxIntervalMs, rateMaxDecimation, (int)rateCheapestPixelFormat);
+        SetDatagramTransport(datagramTransport ? 1 : 0, datagramSize, datagramParityGroup);
+        SetLocalFrameAccess((localPvFrames ? 1 : 0) | (localDepthFrames ? 2 : 0));
         InitializeDll();
+
+        int width, height;
+        float frameRate;
+        if (GetVideoCaptureProfile(out width, out height, out frameRate) != 0)
+        {
+            Debug.Log(string.Format("PV captures {0}x{1} at {2} fps", width, height, frameRate));
+        }
 #endif
     }
 
     // Update is called once per frame
     void Update()
     {
-     
+#if ENABLE_WINMD_SUPPORT
+        if (localPvFrames)
+        {
+            UpdateTexture(PhotoVideoStream, ref pvTexture, ref hasPvFrame, ref pvSequence);
+        }
+        if (localDepthFrames)
+        {
+            UpdateTexture((int)depthSensor, ref depthTexture, ref hasDepthFrame, ref depthSequence);
+        }
+#endif
+    }
+
+#if ENABLE_WINMD_SUPPORT
+    // Copies the latest frame of stream into texture if it is new, recreating the
+    // texture when the frame size changes, and releases the frame right away so
+    // that the stream keeps publishing.
+    void UpdateTexture(int stream, ref Texture2D texture, ref bool hasFrame, ref uint sequence)
+    {
+        LocalFrame frame;
+        if (AcquireLocalFrame(stream, out frame) == 0)
+        {
+            return;
+        }
+        TextureFormat textureFormat = TextureFormat.BGRA32;
+        bool supported = true;
+        switch (frame.format)
+        {
+            case 0: textureFormat = TextureFormat.BGRA32; break;
+            case 2: textureFormat = TextureFormat.R8; break;
+            // the AB image follows the depth plane and is left out
+            case 3:
+            case 4: textureFormat = TextureFormat.R16; break;
+            default: supported = false; break;
+        }
+        if (supported && (!hasFrame || frame.sequence != sequence))
+        {
+            if (texture == null || texture.width != frame.width || texture.height != frame.height ||
+                texture.format != textureFormat)
+            {
+                texture = new Texture2D((int)frame.width, (int)frame.height, textureFormat, false);
+            }
+            texture.LoadRawTextureData(frame.data, (int)(frame.rowStride * frame.height));
+            texture.Apply(false);
+            hasFrame = true;
+            sequence = frame.sequence;
+        }
+        ReleaseLocalFrame(stream);
     }
+#endif
 }
@@ -2,6 +2,7 @@ import socket
 import struct
 import abc
 import threading
+import time
 from datetime import datetime, timedelta
 from collections import namedtuple, deque
 from enum import Enum
@@ -11,20 +12,72 @@ import cv2
 np.warnings.filterwarnings('ignore')
 
 # Definitions
-# Protocol Header Format
+# Protocol Header Format, see HL2RmStreamCore/FrameHeaders.h
 # see https://docs.python.org/2/library/struct.html#format-characters
-VIDEO_STREAM_HEADER_FORMAT = "@qIIII18f"
+# Every message is a message header, the header of its type and PayloadSize bytes
+# of payload. Everything is little-endian without padding.
+MESSAGE_HEADER_FORMAT = "<IHHHHIII"
+MESSAGE_HEADER_SIZE = struct.calcsize(MESSAGE_HEADER_FORMAT)
+
+MESSAGE_HEADER = namedtuple(
+    'MessageHeader',
+    'Magic Version HeaderSize StreamId MessageType Codec PayloadSize Flags '
+)
+
+MESSAGE_MAGIC = 0x4D324C48
+PROTOCOL_VERSION = 2
+# bit of Flags: the headers end with a frame trace
+MESSAGE_FLAG_TRACE = 1
+
+# The sequence number and stage times of a frame, the last of its headers
+FRAME_TRACE_FORMAT = "<IIQQQQ"
+FRAME_TRACE_SIZE = struct.calcsize(FRAME_TRACE_FORMAT)
+
+FRAME_TRACE = namedtuple(
+    'FrameTrace',
+    'Sequence Reserved CaptureTime DequeueTime EncodeTime WriteTime '
+)
+
+
+class MessageType(Enum):
+    RESEARCH_MODE_FRAME = 1
+    VIDEO_FRAME = 2
+    IMU_PACKET = 3
+    FUSED_FRAME = 4
+    CALIBRATION = 5
+    CODEC_REQUEST = 6
+    STREAM_CONTROL = 7
+    # UDP only: subscribes to a stream and keeps the subscription alive
+    SUBSCRIBE = 8
+
+
+class StreamId(Enum):
+    LF_VLC = 0
+    LL_VLC = 1
+    RF_VLC = 2
+    RR_VLC = 3
+    AHAT = 4
+    LONG_THROW = 5
+    ACCEL = 6
+    GYRO = 7
+    MAG = 8
+    PHOTO_VIDEO = 0x100
+    FUSED = 0x101
+
+
+VIDEO_STREAM_HEADER_FORMAT = "<Qiiii16f2f"
 
 VIDEO_FRAME_STREAM_HEADER = namedtuple(
     'SensorFrameStreamHeader',
-    'Timestamp ImageWidth ImageHeight PixelStride RowStride fx fy '
+    'Timestamp ImageWidth ImageHeight PixelStride RowStride '
     'PVtoWorldtransformM11 PVtoWorldtransformM12 PVtoWorldtransformM13 PVtoWorldtransformM14 '
     'PVtoWorldtransformM21 PVtoWorldtransformM22 PVtoWorldtransformM23 PVtoWorldtransformM24 '
     'PVtoWorldtransformM31 PVtoWorldtransformM32 PVtoWorldtransformM33 PVtoWorldtransformM34 '
     'PVtoWorldtransformM41 PVtoWorldtransformM42 PVtoWorldtransformM43 PVtoWorldtransformM44 '
+    'fx fy '
 )
 
-RM_STREAM_HEADER_FORMAT = "@qIIII16f"
+RM_STREAM_HEADER_FORMAT = "<Qiiii16fIIQ"
 
 RM_FRAME_STREAM_HEADER = namedtuple(
     'SensorFrameStreamHeader',
@@ -33,11 +86,132 @@ RM_FRAME_STREAM_HEADER = namedtuple(
     'rig2worldTransformM21 rig2worldTransformM22 rig2worldTransformM23 rig2worldTransformM24 '
     'rig2worldTransformM31 rig2worldTransformM32 rig2worldTransformM33 rig2worldTransformM34 '
     'rig2worldTransformM41 rig2worldTransformM42 rig2worldTransformM43 rig2worldTransformM44 '
+    'AbSize Gain Exposure '
+)
+
+# Fused RGB-D pairs: this header, then a whole PV and a whole depth message
+FUSED_FRAME_HEADER_FORMAT = "<QiI"
+
+FUSED_FRAME_HEADER = namedtuple(
+    'FusedFrameHeader',
+    'Timestamp DepthOffset Reserved '
+)
+
+IMU_PACKET_HEADER_FORMAT = "<QII"
+
+IMU_PACKET_HEADER = namedtuple(
+    'ImuPacketHeader',
+    'Timestamp SampleCount SampleSize '
+)
+
+# One record per sample following an IMU packet header ("<QQ4f")
+IMU_SAMPLE_DTYPE = np.dtype([
+    ('Timestamp', '<u8'), ('SensorTicks', '<u8'), ('Values', '<f4', (3,)), ('Temperature', '<f4')])
+
+# Sent by the camera streams once per connection, ahead of the first frame
+CALIBRATION_HEADER_FORMAT = "<ii16f9fI"
+
+CALIBRATION_HEADER = namedtuple(
+    'CalibrationHeader',
+    'ImageWidth ImageHeight '
+    'ExtrinsicsM11 ExtrinsicsM12 ExtrinsicsM13 ExtrinsicsM14 '
+    'ExtrinsicsM21 ExtrinsicsM22 ExtrinsicsM23 ExtrinsicsM24 '
+    'ExtrinsicsM31 ExtrinsicsM32 ExtrinsicsM33 ExtrinsicsM34 '
+    'ExtrinsicsM41 ExtrinsicsM42 ExtrinsicsM43 ExtrinsicsM44 '
+    'fx fy cx cy k1 k2 k3 p1 p2 Reserved '
+)
+
+# Sent on the connection of any stream to reconfigure the one StreamId names; the
+# device answers every request with the state of that stream. Fields is a mask of
+# StreamControlField: a request sets those, an empty one only asks. A reply names
+# the fields the stream has, none if there is no such stream.
+STREAM_CONTROL_HEADER_FORMAT = "<IIIIII"
+
+STREAM_CONTROL_HEADER = namedtuple(
+    'StreamControlHeader',
+    'Fields Enabled IntervalUs Decimation PixelFormat Reserved '
+)
+
+
+class StreamControlField(Enum):
+    ENABLED = 1
+    INTERVAL = 2
+    DECIMATION = 4
+    PIXEL_FORMAT = 8
+
+
+# Over UDP every message is split into datagrams, each this header and a fragment of
+# the message: FragmentSize bytes per data fragment, the last one the rest. With
+# parity, every ParityGroupSize data fragments are followed by a parity datagram, the
+# XOR of them zero-padded to the first of them, which repairs the loss of any one.
+DATAGRAM_HEADER_FORMAT = "<IIIHHHHHH"
+DATAGRAM_HEADER_SIZE = struct.calcsize(DATAGRAM_HEADER_FORMAT)
+
+DATAGRAM_HEADER = namedtuple(
+    'DatagramHeader',
+    'Magic FrameId FrameSize StreamId Flags FragmentIndex FragmentCount '
+    'ParityGroupSize FragmentSize '
 )
 
+DATAGRAM_MAGIC = 0x44324C48
+DATAGRAM_FLAG_PARITY = 1
+# the datagrams of the session message, e.g. the calibration
+DATAGRAM_FLAG_SESSION = 2
+
+# Type header of the Subscribe message: the FrameId of the last session message the
+# client put together, if Flags is SUBSCRIBE_FLAG_HAS_SESSION, so that the device
+# sends it again if it was lost.
+SUBSCRIBE_HEADER_FORMAT = "<II"
+SUBSCRIBE_FLAG_HAS_SESSION = 1
+
+
+# type header of every message type; codec requests have none
+TYPE_HEADERS = {
+    MessageType.RESEARCH_MODE_FRAME.value: (RM_STREAM_HEADER_FORMAT, RM_FRAME_STREAM_HEADER),
+    MessageType.VIDEO_FRAME.value: (VIDEO_STREAM_HEADER_FORMAT, VIDEO_FRAME_STREAM_HEADER),
+    MessageType.IMU_PACKET.value: (IMU_PACKET_HEADER_FORMAT, IMU_PACKET_HEADER),
+    MessageType.FUSED_FRAME.value: (FUSED_FRAME_HEADER_FORMAT, FUSED_FRAME_HEADER),
+    MessageType.CALIBRATION.value: (CALIBRATION_HEADER_FORMAT, CALIBRATION_HEADER),
+    MessageType.STREAM_CONTROL.value: (STREAM_CONTROL_HEADER_FORMAT, STREAM_CONTROL_HEADER),
+}
+
+
+def unpack_message(data, offset=0):
+    """Splits the whole message at offset in data into its message header, type header
+    and payload. The payload is a view into data, nothing is copied. The type header is
+    None for types this client does not know; fields newer than this client are skipped."""
+    message = MESSAGE_HEADER(*struct.unpack_from(MESSAGE_HEADER_FORMAT, data, offset))
+    if message.Magic != MESSAGE_MAGIC or message.Version != PROTOCOL_VERSION:
+        raise RuntimeError('Stream does not speak protocol version %d' % PROTOCOL_VERSION)
+    header = None
+    if message.MessageType in TYPE_HEADERS:
+        header_format, header_data = TYPE_HEADERS[message.MessageType]
+        header = header_data(*struct.unpack_from(header_format, data, offset + MESSAGE_HEADER_SIZE))
+    start = offset + message.HeaderSize
+    return message, header, memoryview(data)[start:start + message.PayloadSize]
+
+
+def unpack_trace(data, message, offset=0):
+    """The frame trace of the whole message at offset in data, whose message header is
+    message; None if it has none."""
+    if not message.Flags & MESSAGE_FLAG_TRACE or message.HeaderSize < MESSAGE_HEADER_SIZE + FRAME_TRACE_SIZE:
+        return None
+    return FRAME_TRACE(*struct.unpack_from(
+        FRAME_TRACE_FORMAT, data, offset + message.HeaderSize - FRAME_TRACE_SIZE))
+
+
 # Each port corresponds to a single stream type
 VIDEO_STREAM_PORT = 23940
 AHAT_STREAM_PORT = 23941
+LONG_THROW_STREAM_PORT = 23942
+LF_VLC_STREAM_PORT = 23943
+LL_VLC_STREAM_PORT = 23944
+RF_VLC_STREAM_PORT = 23945
+RR_VLC_STREAM_PORT = 23946
+ACCEL_STREAM_PORT = 23947
+GYRO_STREAM_PORT = 23948
+MAG_STREAM_PORT = 23949
+FUSED_STREAM_PORT = 23950
 
 HOST = '192.168.47.2'
 
@@ -45,6 +219,71 @@ HundredsOfNsToMilliseconds = 1e-4
 MillisecondsToSeconds = 1e-3
 
 
+class VideoPixelFormat(Enum):
+    BGR8 = 0
+    NV12 = 1
+    LUMA8 = 2
+
+
+class DepthCodec(Enum):
+    RAW = 0
+    RVL = 1
+    # valid pixels as camera space points, x y z per point
+    POINTS_MM16 = 2  # little-endian int16 millimetres
+    POINTS_HALF = 3  # little-endian float16 metres
+
+
+# Codec requested for the AHAT stream; RVL cuts the bandwidth to about a quarter
+AHAT_DEPTH_CODEC = DepthCodec.RVL
+
+# Receive over UDP instead of TCP, e.g. on a lossy Wi-Fi link where waiting for a
+# lost frame to be sent again holds back the ones after it; the device needs
+# SetDatagramTransport. Can also be set per receiver before start_socket.
+USE_UDP = False
+
+
+def decode_rvl(data, pixel_count):
+    """Decodes an RVL compressed depth image, see HL2RmStreamCore/DepthCodec.h."""
+    words = np.frombuffer(data, dtype='<u4')
+    # nibbles are packed eight per word, the first one in the top bits
+    shifts = np.arange(28, -4, -4, dtype=np.uint32)
+    nibbles = ((words[:, None] >> shifts) & 0xF).ravel().astype(np.int64)
+
+    # every value ends with a nibble without the continuation bit
+    ends = np.flatnonzero((nibbles & 0x8) == 0)
+    starts = np.concatenate(([0], ends[:-1] + 1))
+    group = np.arange(ends[-1] + 1) - np.repeat(starts, ends - starts + 1)
+    values = np.add.reduceat((nibbles[:ends[-1] + 1] & 0x7) << (3 * group), starts)
+
+    # walk the run pairs: zero run length, valid run length, deltas
+    run_pixels = []
+    run_values = []
+    run_lengths = []
+    pixel = 0
+    index = 0
+    while pixel < pixel_count:
+        zeros, valid = values[index], values[index + 1]
+        pixel += zeros
+        index += 2
+        run_pixels.append(pixel)
+        run_values.append(index)
+        run_lengths.append(valid)
+        pixel += valid
+        index += valid
+
+    run_lengths = np.array(run_lengths, dtype=np.int64)
+    total = run_lengths.sum()
+    offsets = np.repeat(np.cumsum(run_lengths) - run_lengths, run_lengths)
+    positions = np.repeat(np.array(run_pixels, dtype=np.int64), run_lengths) + np.arange(total) - offsets
+    deltas = values[np.repeat(np.array(run_values, dtype=np.int64), run_lengths) + np.arange(total) - offsets]
+
+    # zigzag decode; deltas continue across runs
+    deltas = (deltas >> 1) ^ -(deltas & 1)
+    depth = np.zeros(pixel_count, dtype=np.uint16)
+    depth[positions] = np.cumsum(deltas)
+    return depth
+
+
 class SensorType(Enum):
     VIDEO = 1
     AHAT = 2
@@ -53,34 +292,237 @@ class SensorType(Enum):
     RF_VLC = 5
 
 
+class DatagramReassembler:
+    """Puts the messages the device sends over UDP back together. Messages are returned as
+    soon as they are complete and only ever newer than the last one: older ones still
+    missing fragments are given up, as are messages not complete deadline_ms after their
+    first datagram. A missing fragment is rebuilt from the parity of its group."""
+
+    def __init__(self, deadline_ms=100, max_pending=8):
+        self.deadline = deadline_ms * 1e-3
+        self.max_pending = max_pending
+        # FrameId -> [first arrival, header, data fragments, parity by first fragment]
+        self.pending = {}
+        self.last_frame_id = None
+        # FrameId of the last session message, see subscription
+        self.session_frame_id = None
+        self.repaired = 0
+        self.expired = 0
+
+    def subscription(self):
+        """The type header of the next Subscribe message."""
+        if self.session_frame_id is None:
+            return struct.pack(SUBSCRIBE_HEADER_FORMAT, 0, 0)
+        return struct.pack(SUBSCRIBE_HEADER_FORMAT, SUBSCRIBE_FLAG_HAS_SESSION, self.session_frame_id)
+
+    def is_new(self, frame_id):
+        return self.last_frame_id is None or 0 < (frame_id - self.last_frame_id) & 0xFFFFFFFF < 0x80000000
+
+    def deliver(self, header):
+        if header.Flags & DATAGRAM_FLAG_SESSION:
+            self.session_frame_id = header.FrameId
+        self.retire(header.FrameId)
+
+    def retire(self, frame_id):
+        if self.is_new(frame_id):
+            self.last_frame_id = frame_id
+        for old in [f for f in self.pending if not self.is_new(f)]:
+            del self.pending[old]
+            self.expired += 1
+
+    def add(self, datagram, now):
+        """Returns the message datagram completed, or None."""
+        for frame_id in [f for f, p in self.pending.items() if now - p[0] > self.deadline]:
+            if frame_id in self.pending:
+                del self.pending[frame_id]
+                self.expired += 1
+                self.retire(frame_id)
+        if len(datagram) < DATAGRAM_HEADER_SIZE:
+            return None
+        header = DATAGRAM_HEADER(*struct.unpack_from(DATAGRAM_HEADER_FORMAT, datagram))
+        if header.Magic != DATAGRAM_MAGIC or header.FragmentSize == 0 or \
+                header.FragmentIndex >= header.FragmentCount:
+            return None
+        if not self.is_new(header.FrameId) and (self.last_frame_id - header.FrameId) & 0xFFFFFFFF > 64:
+            # the device started over, e.g. after the subscription timed out
+            self.pending.clear()
+            self.last_frame_id = None
+            self.session_frame_id = None
+        if not self.is_new(header.FrameId):
+            return None
+        payload = datagram[DATAGRAM_HEADER_SIZE:]
+        parity = header.Flags & DATAGRAM_FLAG_PARITY
+        if header.FragmentCount == 1 and not parity:
+            self.deliver(header)
+            return payload
+
+        pending = self.pending.get(header.FrameId)
+        if pending is None:
+            if len(self.pending) >= self.max_pending:
+                oldest = min(self.pending, key=lambda f: self.pending[f][0])
+                del self.pending[oldest]
+                self.expired += 1
+            pending = self.pending[header.FrameId] = [now, header, {}, {}]
+        (pending[3] if parity else pending[2])[header.FragmentIndex] = payload
+        if header.ParityGroupSize:
+            self.repair(pending, header.FragmentIndex - header.FragmentIndex % header.ParityGroupSize)
+        if len(pending[2]) < header.FragmentCount:
+            return None
+        del self.pending[header.FrameId]
+        self.deliver(header)
+        return b''.join(pending[2][i] for i in range(header.FragmentCount))
+
+    def repair(self, pending, first):
+        header, fragments, parity = pending[1], pending[2], pending[3]
+        end = min(first + header.ParityGroupSize, header.FragmentCount)
+        missing = [i for i in range(first, end) if i not in fragments]
+        if first not in parity or len(missing) != 1:
+            return
+        rebuilt = np.frombuffer(parity[first], dtype=np.uint8).copy()
+        for i in range(first, end):
+            if i != missing[0]:
+                fragment = np.frombuffer(fragments[i], dtype=np.uint8)
+                rebuilt[:len(fragment)] ^= fragment
+        length = min(header.FragmentSize, header.FrameSize - missing[0] * header.FragmentSize)
+        fragments[missing[0]] = rebuilt[:length].tobytes()
+        self.repaired += 1
+
+
+def stage_times_ms(trace):
+    """Milliseconds a frame spent on the device waiting for the processing stage, being
+    encoded and in the send queue, from the stage times of its frame trace. They are
+    on the device clock, so the time on the network is not among them."""
+    return ((trace.DequeueTime - trace.CaptureTime) * 1e-4,
+            (trace.EncodeTime - trace.DequeueTime) * 1e-4,
+            (trace.WriteTime - trace.EncodeTime) * 1e-4)
+
+
 class FrameReceiverThread(threading.Thread):
-    def __init__(self, host, port, header_format, header_data):
+    def __init__(self, host, port, message_type):
         super(FrameReceiverThread, self).__init__()
-        self.header_size = struct.calcsize(header_format)
-        self.header_format = header_format
-        self.header_data = header_data
+        self.message_type = message_type
         self.host = host
         self.port = port
         self.latest_frame = None
+        self.latest_message = None
         self.latest_header = None
         self.socket = None
+        # camera streams only, see store_calibration
+        self.calibration = None
+        self.unit_plane = None
+        # frames received and lost on the way, from the sequence numbers
+        self.frames = 0
+        self.lost = 0
+        self.next_sequence = None
+        # stage_times_ms of the latest frame
+        self.latest_stage_times = None
+        # latest StreamControl reply per StreamId value, see send_stream_control
+        self.stream_control = {}
+        # over UDP, see USE_UDP
+        self.udp = USE_UDP
+        self.reassembler = None
+        self.last_keep_alive = 0.0
 
     def get_data_from_socket(self):
-        # read the header in chunks
-        reply = self.recvall(self.header_size)
-
-        if not reply:
-            print('ERROR: Failed to receive data from stream.')
+        """Returns the message header, type header and payload of the next frame. Other
+        messages are taken care of on the way: the calibration and StreamControl
+        replies are stored, messages of unknown types are skipped."""
+        while True:
+            data = self.receive_message()
+            if data is None:
+                print('ERROR: Failed to receive data from stream.')
+                return
+            message, header, payload = unpack_message(data)
+            if message.MessageType == MessageType.CALIBRATION.value:
+                self.store_calibration(header, payload)
+            elif message.MessageType == MessageType.STREAM_CONTROL.value:
+                self.stream_control[message.StreamId] = header
+            elif message.MessageType == self.message_type.value:
+                self.count_frame(unpack_trace(data, message))
+                return message, header, payload
+
+    def receive_message(self):
+        """The next whole message in one buffer, which payloads are views of; None if the
+        connection is closed."""
+        if self.udp:
+            while True:
+                self.keep_alive()
+                try:
+                    datagram = self.socket.recv(65536)
+                except (socket.timeout, ConnectionRefusedError):
+                    continue
+                message = self.reassembler.add(datagram, time.monotonic())
+                if message is not None:
+                    return message
+        reply = self.recvall(MESSAGE_HEADER_SIZE)
+        if len(reply) < MESSAGE_HEADER_SIZE:
+            return None
+        message = MESSAGE_HEADER(*struct.unpack(MESSAGE_HEADER_FORMAT, reply))
+        if message.Magic != MESSAGE_MAGIC or message.Version != PROTOCOL_VERSION:
+            raise RuntimeError('Stream does not speak protocol version %d' % PROTOCOL_VERSION)
+        return reply + self.recvall(message.HeaderSize + message.PayloadSize - MESSAGE_HEADER_SIZE)
+
+    def send_message(self, data):
+        """Sends a whole message, over UDP as one datagram."""
+        if self.udp:
+            self.socket.send(data)
+        else:
+            self.socket.sendall(data)
+
+    def keep_alive(self):
+        """Over UDP, subscribes once a second; the device drops subscribers it has not
+        heard from for a few seconds, and sends the calibration again if it was lost."""
+        if time.monotonic() - self.last_keep_alive < 1.0:
             return
-
-        data = struct.unpack(self.header_format, reply)
-        header = self.header_data(*data)
-
-        # read the image in chunks
-        image_size_bytes = header.ImageHeight * header.RowStride
-        image_data = self.recvall(image_size_bytes)
-
-        return header, image_data
+        self.last_keep_alive = time.monotonic()
+        subscription = self.reassembler.subscription()
+        self.send_message(struct.pack(
+            MESSAGE_HEADER_FORMAT, MESSAGE_MAGIC, PROTOCOL_VERSION, MESSAGE_HEADER_SIZE + len(subscription),
+            0, MessageType.SUBSCRIBE.value, 0, 0, 0) + subscription)
+
+    def count_frame(self, trace):
+        """Counts the frames the device or the send queue dropped since the last one,
+        from the frame trace of the frame, if it has one."""
+        self.frames += 1
+        if trace is None:
+            return
+        if self.next_sequence is not None:
+            self.lost += (trace.Sequence - self.next_sequence) & 0xFFFFFFFF
+        self.next_sequence = (trace.Sequence + 1) & 0xFFFFFFFF
+        self.latest_stage_times = stage_times_ms(trace)
+
+    def store_calibration(self, calibration, table):
+        """Keeps the calibration message the camera streams start every connection with,
+        and the one that replaces it when the device changes the image size, e.g. PV
+        decimation by rate control; it holds for the frames that follow it.
+        Research mode cameras send the unit plane point of every pixel, kept as an
+        ImageHeight x ImageWidth x 2 array in unit_plane, NaN where the camera has none."""
+        self.calibration = calibration
+        if len(table):
+            self.unit_plane = np.frombuffer(table, dtype='<f4').reshape(
+                (calibration.ImageHeight, calibration.ImageWidth, 2))
+
+    def send_stream_control(self, stream_id, enabled=None, interval_ms=None, decimation=None,
+                            pixel_format=None):
+        """Reconfigures the stream stream_id (a StreamId) of the device, which need not be
+        the one of this connection, e.g. to turn PV off from a depth client. Settings left
+        at None stay as they are; with none the device only reports the state. The reply
+        arrives in stream_control once the listening thread gets to it."""
+        fields = 0
+        if enabled is not None:
+            fields |= StreamControlField.ENABLED.value
+        if interval_ms is not None:
+            fields |= StreamControlField.INTERVAL.value
+        if decimation is not None:
+            fields |= StreamControlField.DECIMATION.value
+        if pixel_format is not None:
+            fields |= StreamControlField.PIXEL_FORMAT.value
+        control = struct.pack(
+            STREAM_CONTROL_HEADER_FORMAT, fields, 1 if enabled else 0, int((interval_ms or 0) * 1000),
+            decimation or 0, pixel_format.value if pixel_format is not None else 0, 0)
+        self.send_message(struct.pack(
+            MESSAGE_HEADER_FORMAT, MESSAGE_MAGIC, PROTOCOL_VERSION, MESSAGE_HEADER_SIZE + len(control),
+            stream_id.value, MessageType.STREAM_CONTROL.value, 0, 0, 0) + control)
 
     def recvall(self, size):
         msg = bytes()
@@ -92,6 +534,16 @@ class FrameReceiverThread(threading.Thread):
         return msg
 
     def start_socket(self):
+        if self.udp:
+            self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            # a frame arrives as a burst of datagrams
+            self.socket.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 8 * 1024 * 1024)
+            self.socket.settimeout(0.1)
+            self.socket.connect((self.host, self.port))
+            self.reassembler = DatagramReassembler()
+            self.keep_alive()
+            print('INFO: Subscribed to ' + self.host + ' on UDP port ' + str(self.port))
+            return
         self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
         self.socket.connect((self.host, self.port))
         # send_message(self.socket, b'socket connected at ')
@@ -112,37 +564,160 @@ class FrameReceiverThread(threading.Thread):
 
 class VideoReceiverThread(FrameReceiverThread):
     def __init__(self, host):
-        super().__init__(host, VIDEO_STREAM_PORT, VIDEO_STREAM_HEADER_FORMAT,
-                         VIDEO_FRAME_STREAM_HEADER)
+        super().__init__(host, VIDEO_STREAM_PORT, MessageType.VIDEO_FRAME)
 
     def listen(self):
         while True:
-            self.latest_header, image_data = self.get_data_from_socket()
-            self.latest_frame = np.frombuffer(image_data, dtype=np.uint8).reshape((self.latest_header.ImageHeight,
-                                                                                   self.latest_header.ImageWidth,
-                                                                                   self.latest_header.PixelStride))
+            self.latest_message, self.latest_header, image_data = self.get_data_from_socket()
+            self.latest_frame = self.decode_image(self.latest_message, self.latest_header, image_data)
+
+    @staticmethod
+    def decode_image(message, header, image_data):
+        pixels = np.frombuffer(image_data, dtype=np.uint8)
+        pixel_format = VideoPixelFormat(message.Codec)
+        if pixel_format == VideoPixelFormat.BGR8:
+            return pixels.reshape((header.ImageHeight, header.ImageWidth, header.PixelStride))
+        luma = pixels[:header.ImageHeight * header.ImageWidth].reshape((header.ImageHeight, header.ImageWidth))
+        if pixel_format == VideoPixelFormat.LUMA8 or header.ImageWidth % 2 or header.ImageHeight % 2:
+            return luma
+        # NV12: Y plane followed by the half resolution interleaved UV plane
+        return cv2.cvtColor(pixels.reshape((header.ImageHeight * 3 // 2, header.ImageWidth)),
+                            cv2.COLOR_YUV2BGR_NV12)
 
     def get_mat_from_header(self, header):
-        pv_to_world_transform = np.array(header[7:24]).reshape((4, 4)).T
+        pv_to_world_transform = np.array(header[5:21]).reshape((4, 4)).T
         return pv_to_world_transform
 
 
-class AhatReceiverThread(FrameReceiverThread):
-    def __init__(self, host):
-        super().__init__(host,
-                         AHAT_STREAM_PORT, RM_STREAM_HEADER_FORMAT, RM_FRAME_STREAM_HEADER)
+class DepthReceiverThread(FrameReceiverThread):
+    def __init__(self, host, port, stream_id, codec):
+        super().__init__(host, port, MessageType.RESEARCH_MODE_FRAME)
+        self.stream_id = stream_id
+        self.codec = codec
+        self.latest_ab = None
+
+    def start_socket(self):
+        super().start_socket()
+        if self.codec != DepthCodec.RAW:
+            self.send_message(struct.pack(
+                MESSAGE_HEADER_FORMAT, MESSAGE_MAGIC, PROTOCOL_VERSION, MESSAGE_HEADER_SIZE,
+                self.stream_id.value, MessageType.CODEC_REQUEST.value, self.codec.value, 0, 0))
+
+    def listen(self):
+        while True:
+            self.latest_message, self.latest_header, image_data = self.get_data_from_socket()
+            self.latest_frame, self.latest_ab = self.decode_depth(self.latest_message, self.latest_header, image_data)
+
+    def points_from_depth(self, depth):
+        """Camera space points in metres of the valid pixels of a depth image, from the
+        unit plane table of the calibration; the depth is the distance along the ray."""
+        rays = np.dstack((self.unit_plane, np.ones(self.unit_plane.shape[:2], dtype=np.float32)))
+        rays /= np.linalg.norm(rays, axis=2, keepdims=True)
+        valid = (depth > 0) & np.isfinite(rays[:, :, 2])
+        return rays[valid] * (depth[valid, None] * 0.001)
+
+    @staticmethod
+    def decode_depth(message, header, image_data):
+        """Returns the depth image and the AB image, or None if the stream has no AB.
+        For the point codecs the depth is an N x 3 array of camera space points in metres."""
+        shape = (header.ImageHeight, header.ImageWidth)
+        depth_size = len(image_data) - header.AbSize
+        ab = None
+        if header.AbSize:
+            # the AB image follows the depth, always raw big-endian
+            ab = np.frombuffer(image_data, dtype='>u2', offset=depth_size).reshape(shape)
+        codec = DepthCodec(message.Codec)
+        if codec == DepthCodec.POINTS_MM16:
+            depth = np.frombuffer(image_data, dtype='<i2', count=depth_size // 2).reshape((-1, 3)) * 0.001
+        elif codec == DepthCodec.POINTS_HALF:
+            depth = np.frombuffer(image_data, dtype='<f2', count=depth_size // 2).reshape((-1, 3)).astype(np.float32)
+        elif codec == DepthCodec.RVL:
+            depth = decode_rvl(image_data[:depth_size], header.ImageHeight * header.ImageWidth).reshape(shape)
+        else:
+            # raw depth is big-endian
+            depth = np.frombuffer(image_data, dtype='>u2', count=shape[0] * shape[1]).reshape(shape)
+        return depth, ab
+
+    def get_mat_from_header(self, header):
+        rig_to_world_transform = np.array(header[5:21]).reshape((4, 4)).T
+        return rig_to_world_transform
+
+
+class AhatReceiverThread(DepthReceiverThread):
+    def __init__(self, host, codec=AHAT_DEPTH_CODEC):
+        super().__init__(host, AHAT_STREAM_PORT, StreamId.AHAT, codec)
+
+
+class LongThrowReceiverThread(DepthReceiverThread):
+    def __init__(self, host, codec=AHAT_DEPTH_CODEC):
+        super().__init__(host, LONG_THROW_STREAM_PORT, StreamId.LONG_THROW, codec)
+
+
+class VlcReceiverThread(FrameReceiverThread):
+    """Visible light camera stream: raw 8-bit grayscale with exposure and gain in the header."""
+    def __init__(self, host, port=LF_VLC_STREAM_PORT):
+        super().__init__(host, port, MessageType.RESEARCH_MODE_FRAME)
 
     def listen(self):
         while True:
-            self.latest_header, image_data = self.get_data_from_socket()
-            self.latest_frame = np.frombuffer(image_data, dtype=np.uint16).reshape((self.latest_header.ImageHeight,
-                                                                                    self.latest_header.ImageWidth))
+            self.latest_message, self.latest_header, image_data = self.get_data_from_socket()
+            self.latest_frame = self.decode_image(self.latest_header, image_data)
+
+    @staticmethod
+    def decode_image(header, image_data):
+        pixels = np.frombuffer(image_data, dtype=np.uint8)
+        return pixels.reshape((header.ImageHeight, header.RowStride))[:, :header.ImageWidth]
 
     def get_mat_from_header(self, header):
-        rig_to_world_transform = np.array(header[5:22]).reshape((4, 4)).T
+        rig_to_world_transform = np.array(header[5:21]).reshape((4, 4)).T
         return rig_to_world_transform
 
 
+class ImuReceiverThread(FrameReceiverThread):
+    """IMU stream: every packet is one batch of samples, kept in order in `samples`."""
+    def __init__(self, host, port=ACCEL_STREAM_PORT, max_samples=10000):
+        super().__init__(host, port, MessageType.IMU_PACKET)
+        # unlike frames, samples are not superseded by newer ones
+        self.samples = deque(maxlen=max_samples)
+
+    def listen(self):
+        while True:
+            self.latest_message, self.latest_header, sample_data = self.get_data_from_socket()
+            self.latest_frame = self.decode_samples(self.latest_header, sample_data)
+            self.samples.extend(self.latest_frame)
+
+    @staticmethod
+    def decode_samples(header, sample_data):
+        return np.frombuffer(sample_data, dtype=IMU_SAMPLE_DTYPE, count=header.SampleCount)
+
+    def get_mat_from_header(self, header):
+        return None
+
+
+class FusedReceiverThread(FrameReceiverThread):
+    """RGB-D pairs matched on the device; latest_frame is (pv image, depth, ab), with their headers in latest_pair_headers."""
+    def __init__(self, host, port=FUSED_STREAM_PORT):
+        super().__init__(host, port, MessageType.FUSED_FRAME)
+        self.latest_pair_headers = None
+
+    def listen(self):
+        while True:
+            self.latest_message, self.latest_header, pair_data = self.get_data_from_socket()
+            self.latest_pair_headers, self.latest_frame = self.decode_pair(pair_data)
+
+    @staticmethod
+    def decode_pair(pair_data):
+        video_message, video_header, image_data = unpack_message(pair_data)
+        depth_message, depth_header, depth_data = unpack_message(
+            pair_data, video_message.HeaderSize + video_message.PayloadSize)
+        image = VideoReceiverThread.decode_image(video_message, video_header, image_data)
+        depth, ab = DepthReceiverThread.decode_depth(depth_message, depth_header, depth_data)
+        return (video_header, depth_header), (image, depth, ab)
+
+    def get_mat_from_header(self, header):
+        return None
+
+
 if __name__ == '__main__':
     video_receiver = VideoReceiverThread(HOST)
     video_receiver.start_socket()